@@ -50,6 +50,14 @@ function (do_pthread_checks)
         ${INCLUDE_MISC_PTHREAD_HEADERS}
         int main() { (void)pthread_get_stackaddr_np(pthread_self()); }
         " HAVE_PTHREAD_GET_STACKADDR_NP)
+    # pthread_setaffinity_np(<thread_id>, <size>, <cpu_set>) - Glibc
+    check_c_source_compiles("
+        #include <pthread.h>
+        #include <sched.h>
+        ${INCLUDE_MISC_PTHREAD_HEADERS}
+        int main() { cpu_set_t s; CPU_ZERO(&s);
+            pthread_setaffinity_np(pthread_self(), sizeof(s), &s); }
+        " HAVE_PTHREAD_SETAFFINITY_NP)
 endfunction (do_pthread_checks)
 do_pthread_checks()
 
@@ -51,6 +51,7 @@
 #include "schema.h"
 #include "engine.h"
 #include "memtx_engine.h"
+#include "snap_reader.h"
 #include "sysview.h"
 #include "blackhole.h"
 #include "service_engine.h"
@@ -76,6 +77,9 @@
 #include "func.h"
 #include "sequence.h"
 #include "sql_stmt_cache.h"
+#include "info/info.h"
+#include "affinity.h"
+#include "coio_pool.h"
 
 static char status[64] = "unknown";
 
@@ -560,6 +564,77 @@ box_check_readahead(int readahead)
 	}
 }
 
+static double
+box_check_iproto_buffer_idle_timeout(void)
+{
+	double timeout = cfg_getd("iproto_buffer_idle_timeout");
+	if (timeout < 0) {
+		tnt_raise(ClientError, ER_CFG, "iproto_buffer_idle_timeout",
+			  "the value must not be negative");
+	}
+	return timeout;
+}
+
+static double
+box_check_busy_poll(void)
+{
+	double max_time = cfg_getd("busy_poll");
+	if (max_time < 0 || max_time > 1) {
+		tnt_raise(ClientError, ER_CFG, "busy_poll",
+			  "the value must be in [0, 1]");
+	}
+	return max_time;
+}
+
+static double
+box_check_wal_group_commit_window(void)
+{
+	double window = cfg_getd("wal_group_commit_window");
+	if (window < 0 || window > 1) {
+		tnt_raise(ClientError, ER_CFG, "wal_group_commit_window",
+			  "the value must be in [0, 1]");
+	}
+	return window;
+}
+
+static int64_t
+box_check_wal_group_commit_size(void)
+{
+	int64_t size = cfg_geti64("wal_group_commit_size");
+	if (size <= 0) {
+		tnt_raise(ClientError, ER_CFG, "wal_group_commit_size",
+			  "the value must be greater than 0");
+	}
+	return size;
+}
+
+static void
+box_check_cpu_affinity(void)
+{
+	for (int i = 0; i < cord_class_MAX; i++) {
+		const char *option = tt_sprintf("cpu_affinity_%s",
+						cord_class_strs[i]);
+		const char *cpus = cfg_gets(option);
+		if (cpus != NULL && affinity_check(cpus) != 0) {
+			tnt_raise(ClientError, ER_CFG, option,
+				  diag_last_error(diag_get())->errmsg);
+		}
+	}
+}
+
+static int
+box_check_iproto_threads(void)
+{
+	int threads = cfg_geti("iproto_threads");
+	if (threads <= 0 || threads > IPROTO_THREADS_MAX) {
+		diag_set(ClientError, ER_CFG, "iproto_threads",
+			 tt_sprintf("must be greater than 0 and less than "
+				    "or equal to %d", IPROTO_THREADS_MAX));
+		return -1;
+	}
+	return threads;
+}
+
 static void
 box_check_checkpoint_count(int checkpoint_count)
 {
@@ -569,6 +644,97 @@ box_check_checkpoint_count(int checkpoint_count)
 	}
 }
 
+/**
+ * wal_stripe_dirs, copied by box_check_wal_stripe_dirs().
+ * The option can't be changed dynamically. A directory may be
+ * appended to the list, but not removed from it while there
+ * are WAL files striped over it, see recovery_scan().
+ */
+static char wal_stripe_dirs[XLOG_STRIPES_MAX - 1][PATH_MAX];
+static int wal_stripe_dir_count;
+
+static void
+box_check_wal_stripe_dirs(void)
+{
+	int count = cfg_getarr_size("wal_stripe_dirs");
+	if (count >= XLOG_STRIPES_MAX) {
+		tnt_raise(ClientError, ER_CFG, "wal_stripe_dirs",
+			  tt_sprintf("the number of directories must be "
+				     "less than %d", XLOG_STRIPES_MAX));
+	}
+	for (int i = 0; i < count; i++) {
+		const char *dir = cfg_getarr_elem("wal_stripe_dirs", i);
+		if (strlen(dir) >= PATH_MAX) {
+			tnt_raise(ClientError, ER_CFG, "wal_stripe_dirs",
+				  "the path is too long");
+		}
+		strcpy(wal_stripe_dirs[i], dir);
+		bool is_unique = strcmp(wal_stripe_dirs[i],
+					cfg_gets("wal_dir")) != 0;
+		for (int j = 0; j < i; j++) {
+			if (strcmp(wal_stripe_dirs[i], wal_stripe_dirs[j]) == 0)
+				is_unique = false;
+		}
+		if (!is_unique) {
+			tnt_raise(ClientError, ER_CFG, "wal_stripe_dirs",
+				  "the directories must differ from each "
+				  "other and from wal_dir");
+		}
+	}
+	/*
+	 * A batch is atomic across the stripes only if the
+	 * stripe of its first row reaches the disk after the
+	 * others, which only the fsync mode enforces.
+	 */
+	if (count > 0 &&
+	    box_check_wal_mode(cfg_gets("wal_mode")) != WAL_FSYNC) {
+		tnt_raise(ClientError, ER_CFG, "wal_stripe_dirs",
+			  "a striped WAL requires wal_mode = 'fsync'");
+	}
+	wal_stripe_dir_count = count;
+}
+
+int
+box_wal_stripe_dirs(const char **dirs)
+{
+	for (int i = 0; i < wal_stripe_dir_count; i++)
+		dirs[i] = wal_stripe_dirs[i];
+	return wal_stripe_dir_count;
+}
+
+/**
+ * Check wal_prealloc_count. Must be called after
+ * box_check_wal_stripe_dirs().
+ */
+static int
+box_check_wal_prealloc_count(void)
+{
+	int count = cfg_geti("wal_prealloc_count");
+	if (count < 0 || count > WAL_PREALLOC_COUNT_MAX) {
+		tnt_raise(ClientError, ER_CFG, "wal_prealloc_count",
+			  tt_sprintf("the value must be in range [0, %d]",
+				     WAL_PREALLOC_COUNT_MAX));
+	}
+	if (count > 0 && wal_stripe_dir_count > 0) {
+		tnt_raise(ClientError, ER_CFG, "wal_prealloc_count",
+			  "preallocated files can't be used with "
+			  "wal_stripe_dirs");
+	}
+	return count;
+}
+
+static int
+box_check_memtx_recovery_threads(void)
+{
+	int count = cfg_geti("memtx_recovery_threads");
+	if (count < 0 || count > SNAP_READER_THREADS_MAX) {
+		tnt_raise(ClientError, ER_CFG, "memtx_recovery_threads",
+			  tt_sprintf("the value must be in range [0, %d]",
+				     SNAP_READER_THREADS_MAX));
+	}
+	return count;
+}
+
 static int64_t
 box_check_wal_max_size(int64_t wal_max_size)
 {
@@ -659,12 +825,22 @@ box_check_config()
 	box_check_replication_sync_lag();
 	box_check_replication_sync_timeout();
 	box_check_readahead(cfg_geti("readahead"));
+	box_check_iproto_buffer_idle_timeout();
+	box_check_busy_poll();
+	box_check_cpu_affinity();
+	if (box_check_iproto_threads() < 0)
+		diag_raise();
 	box_check_checkpoint_count(cfg_geti("checkpoint_count"));
 	box_check_wal_max_size(cfg_geti64("wal_max_size"));
 	box_check_wal_mode(cfg_gets("wal_mode"));
+	box_check_wal_stripe_dirs();
+	box_check_wal_prealloc_count();
+	box_check_wal_group_commit_window();
+	box_check_wal_group_commit_size();
 	if (box_check_memory_quota("memtx_memory") < 0)
 		diag_raise();
 	box_check_memtx_min_tuple_size(cfg_geti64("memtx_min_tuple_size"));
+	box_check_memtx_recovery_threads();
 	box_check_vinyl_options();
 	if (box_check_sql_cache_size(cfg_geti("sql_cache_size")) != 0)
 		diag_raise();
@@ -985,15 +1161,158 @@ box_set_vinyl_timeout(void)
 }
 
 void
-box_set_net_msg_max(void)
+box_set_iproto_buffer_idle_timeout(void)
+{
+	iproto_set_buffer_idle_timeout(box_check_iproto_buffer_idle_timeout());
+}
+
+void
+box_set_busy_poll(void)
+{
+	double max_time = box_check_busy_poll();
+	busy_poll_set_max_time(&cord()->busy_poll, max_time);
+	iproto_set_busy_poll(max_time);
+	wal_set_busy_poll(max_time);
+}
+
+void
+box_set_wal_group_commit(void)
 {
-	int new_iproto_msg_max = cfg_geti("net_msg_max");
-	iproto_set_msg_max(new_iproto_msg_max);
+	wal_set_group_commit(box_check_wal_group_commit_window(),
+			     box_check_wal_group_commit_size());
+}
+
+void
+box_set_cpu_affinity(void)
+{
+	box_check_cpu_affinity();
+	for (int i = 0; i < cord_class_MAX; i++) {
+		const char *option = tt_sprintf("cpu_affinity_%s",
+						cord_class_strs[i]);
+		if (affinity_set((enum cord_class)i, cfg_gets(option)) != 0)
+			diag_raise();
+	}
+	/*
+	 * Move the tuples to the memory of the tx thread. Is
+	 * done by memtx_engine_new() on the first configuration.
+	 */
+	struct memtx_engine *memtx =
+		(struct memtx_engine *)engine_by_name("memtx");
+	if (memtx != NULL)
+		memtx_engine_set_numa_node(memtx,
+					   affinity_numa_node(CORD_CLASS_TX));
+}
+
+static void
+box_busy_poll_info(struct info_handler *h, const char *name,
+		   const struct busy_poll *poll)
+{
+	info_table_begin(h, name);
+	info_append_double(h, "spin_time", poll->spin_time);
+	info_append_int(h, "hits", poll->hit_count);
+	info_append_int(h, "misses", poll->miss_count);
+	info_append_double(h, "spin_limit", poll->spin_limit);
+	info_table_end(h);
+}
+
+void
+box_busy_poll_stat(struct info_handler *h)
+{
+	info_begin(h);
+	box_busy_poll_info(h, "tx", &cord()->busy_poll);
+	if (iproto_threads_count == 1) {
+		box_busy_poll_info(h, "net", iproto_thread_busy_poll(0));
+	} else {
+		for (int i = 0; i < iproto_threads_count; i++) {
+			char name[16];
+			snprintf(name, sizeof(name), "net_%d", i + 1);
+			box_busy_poll_info(h, name, iproto_thread_busy_poll(i));
+		}
+	}
+	box_busy_poll_info(h, "wal", wal_busy_poll());
+	info_end(h);
+}
+
+void
+box_coio_stat(struct info_handler *h)
+{
+	struct coio_pool_stat stat;
+	coio_pool_stat(&stat);
+	info_begin(h);
+	info_append_int(h, "threads", stat.size);
+	for (int prio = 0; prio < coio_prio_MAX; prio++) {
+		info_table_begin(h, coio_prio_strs[prio]);
+		info_append_int(h, "queued", stat.lanes[prio].queued);
+		info_append_int(h, "done", stat.lanes[prio].done);
+		info_append_double(h, "wait_time", stat.lanes[prio].wait_time);
+		info_append_double(h, "exec_time", stat.lanes[prio].exec_time);
+		info_table_end(h);
+	}
+	info_end(h);
+}
+
+void
+box_set_iproto_shm_listen(void)
+{
+	iproto_shm_listen(cfg_gets("iproto_shm_listen"));
+}
+
+/**
+ * Size the tx fiber pool after the quotas of all request
+ * classes, so that every class has its own share of fibers
+ * and critical requests never wait for a fiber behind the
+ * default ones.
+ */
+static void
+box_update_tx_fiber_pool_size(void)
+{
+	int msg_max = cfg_geti("net_msg_max") +
+		      cfg_geti("iproto_critical_msg_max");
+	/* The limits are per network thread. */
 	fiber_pool_set_max_size(&tx_fiber_pool,
-				new_iproto_msg_max *
+				msg_max * iproto_threads_count *
 				IPROTO_FIBER_POOL_SIZE_FACTOR);
 }
 
+void
+box_set_net_msg_max(void)
+{
+	iproto_set_msg_max(cfg_geti("net_msg_max"));
+	box_update_tx_fiber_pool_size();
+}
+
+void
+box_set_iproto_critical_msg_max(void)
+{
+	iproto_set_critical_msg_max(cfg_geti("iproto_critical_msg_max"));
+	box_update_tx_fiber_pool_size();
+}
+
+void
+box_set_iproto_critical_users(void)
+{
+	int count = cfg_getarr_size("iproto_critical_users");
+	struct region *region = &fiber()->gc;
+	size_t used = region_used(region);
+	const char **names = (const char **)
+		region_alloc_xc(region, count * sizeof(*names));
+	for (int i = 0; i < count; i++) {
+		const char *name = cfg_getarr_elem("iproto_critical_users", i);
+		size_t len = strlen(name) + 1;
+		char *copy = (char *) region_alloc_xc(region, len);
+		memcpy(copy, name, len);
+		names[i] = copy;
+	}
+	iproto_set_critical_users(names, count);
+	region_truncate(region, used);
+}
+
+void
+box_set_iproto_reject_overload(void)
+{
+	iproto_set_reject_overload(cfg_getb("iproto_reject_overload"));
+}
+
 int
 box_set_prepared_stmt_cache_size(void)
 {
@@ -1143,10 +1462,51 @@ box_process1(struct request *request, box_tuple_t **result)
 	return box_process_rw(request, space, result);
 }
 
+int
+box_process_batch(struct batch_request *request, box_tuple_t **results)
+{
+	if (in_txn() != NULL) {
+		diag_set(ClientError, ER_ACTIVE_TRANSACTION);
+		return -1;
+	}
+	struct txn *txn = txn_begin();
+	if (txn == NULL)
+		return -1;
+	const char *data = request->stmts;
+	uint32_t i;
+	for (i = 0; i < request->stmt_count; i++) {
+		struct request stmt;
+		struct tuple *tuple;
+		if (xrow_decode_batch_stmt(&data, request->stmts_end,
+					   &stmt) != 0 ||
+		    box_process1(&stmt, &tuple) != 0) {
+			txn_rollback(txn);
+			goto error;
+		}
+		/*
+		 * The statement holds the tuple only until
+		 * the transaction ends.
+		 */
+		if (tuple != NULL)
+			tuple_ref(tuple);
+		results[i] = tuple;
+	}
+	if (txn_commit(txn) != 0)
+		goto error;
+	return 0;
+error:
+	while (i-- > 0) {
+		if (results[i] != NULL)
+			tuple_unref(results[i]);
+	}
+	return -1;
+}
+
 int
 box_select(uint32_t space_id, uint32_t index_id,
 	   int iterator, uint32_t offset, uint32_t limit,
 	   const char *key, const char *key_end,
+	   const char *after, const char *after_end,
 	   struct port *port)
 {
 	(void)key_end;
@@ -1173,6 +1533,10 @@ box_select(uint32_t space_id, uint32_t index_id,
 	uint32_t part_count = key ? mp_decode_array(&key) : 0;
 	if (key_validate(index->def, type, key, part_count))
 		return -1;
+	if (after != NULL &&
+	    iterator_position_validate(index->def, type, key, part_count,
+				       after, after_end) != 0)
+		return -1;
 
 	ERROR_INJECT(ERRINJ_TESTING, {
 		diag_set(ClientError, ER_INJECTION, "ERRINJ_TESTING");
@@ -1183,8 +1547,10 @@ box_select(uint32_t space_id, uint32_t index_id,
 	if (txn_begin_ro_stmt(space, &txn) != 0)
 		return -1;
 
-	struct iterator *it = index_create_iterator(index, type,
-						    key, part_count);
+	struct iterator *it = after == NULL ?
+		index_create_iterator(index, type, key, part_count) :
+		index_create_iterator_after(index, type, key, part_count,
+					    after);
 	if (it == NULL) {
 		txn_rollback_stmt(txn);
 		return -1;
@@ -1966,6 +2332,10 @@ engine_init()
 				    cfg_getd("slab_alloc_factor"));
 	engine_register((struct engine *)memtx);
 	box_set_memtx_max_tuple_size();
+	memtx_engine_set_recovery_threads(memtx,
+			box_check_memtx_recovery_threads());
+	memtx_engine_set_snap_index_order(memtx,
+			cfg_getb("memtx_snap_index_order"));
 
 	struct sysview_engine *sysview = sysview_engine_new_xc();
 	engine_register((struct engine *)sysview);
@@ -2183,9 +2553,11 @@ local_recovery(const struct tt_uuid *instance_uuid,
 	struct wal_stream wal_stream;
 	wal_stream_create(&wal_stream);
 
+	const char *stripe_dirs[XLOG_STRIPES_MAX - 1];
+	int stripe_dir_count = box_wal_stripe_dirs(stripe_dirs);
 	struct recovery *recovery;
-	recovery = recovery_new(cfg_gets("wal_dir"),
-				cfg_geti("force_recovery"),
+	recovery = recovery_new(cfg_gets("wal_dir"), stripe_dirs,
+				stripe_dir_count, cfg_geti("force_recovery"),
 				checkpoint_vclock);
 
 	/*
@@ -2356,18 +2728,34 @@ box_cfg_xc(void)
 	rmean_box = rmean_new(iproto_type_strs, IPROTO_TYPE_STAT_MAX);
 	rmean_error = rmean_new(rmean_error_strings, RMEAN_ERROR_LAST);
 
+	/*
+	 * Bind the threads before the memtx arena is allocated
+	 * and the other threads are started, to have the memory
+	 * of each thread on the NUMA node it runs on.
+	 */
+	box_set_cpu_affinity();
+
 	gc_init();
 	engine_init();
 	schema_init();
 	replication_init();
 	port_init();
-	iproto_init();
+	int iproto_threads = box_check_iproto_threads();
+	if (iproto_threads < 0)
+		diag_raise();
+	iproto_init(iproto_threads, cfg_geti("iproto_uring"));
 	sql_init();
 
 	int64_t wal_max_size = box_check_wal_max_size(cfg_geti64("wal_max_size"));
 	enum wal_mode wal_mode = box_check_wal_mode(cfg_gets("wal_mode"));
+	box_check_wal_stripe_dirs();
+	int wal_prealloc_count = box_check_wal_prealloc_count();
+	const char *stripe_dirs[XLOG_STRIPES_MAX - 1];
+	int stripe_dir_count = box_wal_stripe_dirs(stripe_dirs);
 	if (wal_init(wal_mode, txn_complete_async, cfg_gets("wal_dir"),
-		     wal_max_size, &INSTANCE_UUID, on_wal_garbage_collection,
+		     stripe_dirs, stripe_dir_count, wal_prealloc_count,
+		     wal_max_size,
+		     &INSTANCE_UUID, on_wal_garbage_collection,
 		     on_wal_checkpoint_threshold) != 0) {
 		diag_raise();
 	}
@@ -2381,7 +2769,13 @@ box_cfg_xc(void)
 	if (box_set_prepared_stmt_cache_size() != 0)
 		diag_raise();
 	box_set_net_msg_max();
+	box_set_iproto_critical_msg_max();
+	box_set_iproto_critical_users();
+	box_set_iproto_reject_overload();
 	box_set_readahead();
+	box_set_iproto_buffer_idle_timeout();
+	box_set_busy_poll();
+	box_set_wal_group_commit();
 	box_set_too_long_threshold();
 	box_set_replication_timeout();
 	box_set_replication_connect_timeout();
@@ -2441,6 +2835,9 @@ box_cfg_xc(void)
 	/* Follow replica */
 	replicaset_follow();
 
+	/* Local clients are accepted when the box is ready. */
+	box_set_iproto_shm_listen();
+
 	fiber_gc();
 	is_box_configured = true;
 
@@ -2542,5 +2939,6 @@ box_reset_stat(void)
 	rmean_cleanup(rmean_box);
 	rmean_cleanup(rmean_error);
 	engine_reset_stat();
+	wal_reset_stat();
 	space_foreach(box_reset_space_stat, NULL);
 }
@@ -46,12 +46,14 @@ extern "C" {
 
 struct port;
 struct request;
+struct batch_request;
 struct xrow_header;
 struct obuf;
 struct ev_io;
 struct auth_request;
 struct space;
 struct vclock;
+struct info_handler;
 
 /**
  * Pointer to TX thread local vclock.
@@ -176,6 +178,32 @@ const char *box_status(void);
 void
 box_reset_stat(void);
 
+/**
+ * Store the directories the WAL is striped over in addition
+ * to wal_dir in @a dirs, which must have room for
+ * XLOG_STRIPES_MAX - 1 of them, and return their number.
+ */
+int
+box_wal_stripe_dirs(const char **dirs);
+
+/**
+ * Dump busy polling statistics of the tx, iproto and WAL
+ * threads: the time spent spinning, the number of spins
+ * ended by an event (hits) and by the timeout (misses), and
+ * the current spin limit.
+ */
+void
+box_busy_poll_stat(struct info_handler *h);
+
+/**
+ * Dump statistics of the coio thread pool: the number of
+ * threads and, per priority lane, the number of queued and
+ * executed jobs and the total time the jobs have waited for
+ * a thread and have been executed.
+ */
+void
+box_coio_stat(struct info_handler *h);
+
 #if defined(__cplusplus)
 } /* extern "C" */
 
@@ -247,6 +275,14 @@ void box_set_replication_sync_timeout(void);
 void box_set_replication_skip_conflict(void);
 void box_set_replication_anon(void);
 void box_set_net_msg_max(void);
+void box_set_iproto_critical_msg_max(void);
+void box_set_iproto_critical_users(void);
+void box_set_iproto_reject_overload(void);
+void box_set_iproto_buffer_idle_timeout(void);
+void box_set_iproto_shm_listen(void);
+void box_set_busy_poll(void);
+void box_set_wal_group_commit(void);
+void box_set_cpu_affinity(void);
 
 int
 box_set_prepared_stmt_cache_size(void);
@@ -256,11 +292,16 @@ extern "C" {
 
 typedef struct tuple box_tuple_t;
 
-/* box_select is private and used only by FFI */
+/*
+ * box_select is private and used only by FFI. If @a after is
+ * not NULL, the selection continues after the tuple at this
+ * position, see box_index_tuple_position().
+ */
 API_EXPORT int
 box_select(uint32_t space_id, uint32_t index_id,
 	   int iterator, uint32_t offset, uint32_t limit,
 	   const char *key, const char *key_end,
+	   const char *after, const char *after_end,
 	   struct port *port);
 
 /** \cond public */
@@ -471,6 +512,23 @@ box_sequence_reset(uint32_t seq_id);
 int
 box_process1(struct request *request, box_tuple_t **result);
 
+/**
+ * Execute all statements of a BATCH request in one transaction,
+ * which is written to WAL as a single journal entry. Either all
+ * the statements are committed or none of them.
+ *
+ * \param request BATCH request
+ * \param[out] results Array of request->stmt_count tuples, a
+ *        result of each statement or NULL. Each tuple is
+ *        referenced, the caller must unreference it.
+ * \retval 0 in success, -1 otherwise
+ *
+ * The fiber region is not freed, so \a results may be
+ * allocated on it. The caller must call fiber_gc().
+ */
+int
+box_process_batch(struct batch_request *request, box_tuple_t **results);
+
 /**
  * Execute request on given space.
  *
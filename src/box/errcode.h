@@ -265,6 +265,8 @@ struct errcode_record {
 	/*210 */_(ER_SQL_PREPARE,		"Failed to prepare SQL statement: %s") \
 	/*211 */_(ER_WRONG_QUERY_ID,		"Prepared statement with id %u does not exist") \
 	/*212 */_(ER_SEQUENCE_NOT_STARTED,		"Sequence '%s' is not started") \
+	/*213 */_(ER_REQUEST_OVERLOAD,		"Too many requests of class '%s' in progress") \
+	/*214 */_(ER_ITERATOR_POSITION,		"Iterator position is invalid") \
 
 /*
  * !IMPORTANT! Please follow instructions at start of the file
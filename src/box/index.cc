@@ -177,6 +177,79 @@ check_index(uint32_t space_id, uint32_t index_id,
 	return 0;
 }
 
+int
+iterator_position_validate(const struct index_def *index_def,
+			   enum iterator_type type, const char *key,
+			   uint32_t part_count, const char *pos,
+			   const char *pos_end)
+{
+	struct key_def *cmp_def = index_def->cmp_def;
+	const char *end = pos;
+	if (pos == pos_end || mp_typeof(*pos) != MP_ARRAY ||
+	    mp_check(&end, pos_end) != 0 || end != pos_end)
+		goto invalid;
+	end = pos;
+	if (mp_decode_array(&end) != cmp_def->part_count ||
+	    key_validate_parts(cmp_def, end, cmp_def->part_count, true,
+			       &end) != 0)
+		goto invalid;
+	if (part_count > 0) {
+		/* key_compare() needs the array header of the key. */
+		const char *key_end = key;
+		for (uint32_t i = 0; i < part_count; i++)
+			mp_next(&key_end);
+		struct region *region = &fiber()->gc;
+		size_t region_svp = region_used(region);
+		size_t size = mp_sizeof_array(part_count) + (key_end - key);
+		char *key_array = (char *) region_alloc(region, size);
+		if (key_array == NULL) {
+			diag_set(OutOfMemory, size, "region_alloc", "key");
+			return -1;
+		}
+		char *data = mp_encode_array(key_array, part_count);
+		memcpy(data, key, key_end - key);
+		int cmp = key_compare(pos, HINT_NONE, key_array, HINT_NONE,
+				      cmp_def);
+		region_truncate(region, region_svp);
+		/*
+		 * The tuple at the position must match the key,
+		 * otherwise the iteration would return the tuples
+		 * which do not.
+		 */
+		switch (type) {
+		case ITER_EQ:
+		case ITER_REQ:
+			if (cmp != 0)
+				goto invalid;
+			break;
+		case ITER_ALL:
+		case ITER_GE:
+			if (cmp < 0)
+				goto invalid;
+			break;
+		case ITER_GT:
+			if (cmp <= 0)
+				goto invalid;
+			break;
+		case ITER_LE:
+			if (cmp > 0)
+				goto invalid;
+			break;
+		case ITER_LT:
+			if (cmp >= 0)
+				goto invalid;
+			break;
+		default:
+			/* Rejected by ordered indexes. */
+			break;
+		}
+	}
+	return 0;
+invalid:
+	diag_set(ClientError, ER_ITERATOR_POSITION);
+	return -1;
+}
+
 /* }}} */
 
 /* {{{ Public API */
@@ -356,6 +429,15 @@ box_index_count(uint32_t space_id, uint32_t index_id, int type,
 box_iterator_t *
 box_index_iterator(uint32_t space_id, uint32_t index_id, int type,
                    const char *key, const char *key_end)
+{
+	return box_index_iterator_after(space_id, index_id, type,
+					key, key_end, NULL, NULL);
+}
+
+box_iterator_t *
+box_index_iterator_after(uint32_t space_id, uint32_t index_id, int type,
+			 const char *key, const char *key_end,
+			 const char *pos, const char *pos_end)
 {
 	assert(key != NULL && key_end != NULL);
 	mp_tuple_assert(key, key_end);
@@ -373,11 +455,17 @@ box_index_iterator(uint32_t space_id, uint32_t index_id, int type,
 	uint32_t part_count = mp_decode_array(&key);
 	if (key_validate(index->def, itype, key, part_count))
 		return NULL;
+	if (pos != NULL &&
+	    iterator_position_validate(index->def, itype, key, part_count,
+				       pos, pos_end) != 0)
+		return NULL;
 	struct txn *txn;
 	if (txn_begin_ro_stmt(space, &txn) != 0)
 		return NULL;
-	struct iterator *it = index_create_iterator(index, itype,
-						    key, part_count);
+	struct iterator *it = pos == NULL ?
+		index_create_iterator(index, itype, key, part_count) :
+		index_create_iterator_after(index, itype, key, part_count,
+					    pos);
 	if (it == NULL) {
 		txn_rollback_stmt(txn);
 		return NULL;
@@ -404,6 +492,21 @@ box_iterator_free(box_iterator_t *it)
 	iterator_delete(it);
 }
 
+const char *
+box_index_tuple_position(uint32_t space_id, uint32_t index_id,
+			 struct tuple *tuple, uint32_t *size)
+{
+	struct space *space;
+	struct index *index;
+	if (check_index(space_id, index_id, &space, &index) != 0)
+		return NULL;
+	/* Lua may pass a tuple of another space. */
+	if (tuple_format(tuple) != space->format &&
+	    tuple_validate(space->format, tuple) != 0)
+		return NULL;
+	return index_tuple_position(index, tuple, size);
+}
+
 /* }}} */
 
 /* {{{ Other index functions */
@@ -691,6 +794,30 @@ generic_index_create_iterator(struct index *base, enum iterator_type type,
 }
 
 
+const char *
+index_tuple_position(struct index *index, struct tuple *tuple,
+		     uint32_t *size)
+{
+	struct key_def *cmp_def = index->def->cmp_def;
+	/* A tuple has many or no positions in these indexes. */
+	if (cmp_def->is_multikey || cmp_def->for_func_index) {
+		diag_set(UnsupportedIndexFeature, index->def, "pagination");
+		return NULL;
+	}
+	return tuple_extract_key(tuple, cmp_def, MULTIKEY_NONE, size);
+}
+
+struct iterator *
+generic_index_create_iterator_after(struct index *base,
+				    enum iterator_type type,
+				    const char *key, uint32_t part_count,
+				    const char *pos)
+{
+	(void) type; (void) key; (void) part_count; (void) pos;
+	diag_set(UnsupportedIndexFeature, base->def, "pagination");
+	return NULL;
+}
+
 struct snapshot_iterator *
 generic_index_create_snapshot_iterator(struct index *index)
 {
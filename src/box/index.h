@@ -235,6 +235,32 @@ box_index_stat(uint32_t space_id, uint32_t index_id,
 int
 box_index_compact(uint32_t space_id, uint32_t index_id);
 
+/**
+ * Same as box_index_iterator(), but the iteration continues
+ * after the tuple at position \a pos, see
+ * box_index_tuple_position(). Both the key and the position
+ * must stay valid until the iterator is freed.
+ */
+box_iterator_t *
+box_index_iterator_after(uint32_t space_id, uint32_t index_id, int type,
+			 const char *key, const char *key_end,
+			 const char *pos, const char *pos_end);
+
+/**
+ * Return the position of a tuple in an index, which an
+ * iteration over the index can be resumed after. The position
+ * is MessagePack allocated on the fiber region.
+ *
+ * \param space_id space identifier
+ * \param index_id index identifier
+ * \param tuple tuple to get the position of
+ * \param[out] size size of the position
+ * \retval NULL on error (check box_error_last())
+ */
+const char *
+box_index_tuple_position(uint32_t space_id, uint32_t index_id,
+			 struct tuple *tuple, uint32_t *size);
+
 struct iterator {
 	/**
 	 * Iterate to the next tuple.
@@ -327,6 +353,21 @@ int
 exact_key_validate(struct key_def *key_def, const char *key,
 		   uint32_t part_count);
 
+/**
+ * Check that @a pos is a tuple position in the index, as
+ * returned by index_tuple_position(), and an iteration of
+ * @a type by @a key may continue after it, i.e. the tuple
+ * at the position matches the key.
+ *
+ * @retval 0  The position is valid.
+ * @retval -1 The position is invalid.
+ */
+int
+iterator_position_validate(const struct index_def *index_def,
+			   enum iterator_type type, const char *key,
+			   uint32_t part_count, const char *pos,
+			   const char *pos_end);
+
 /**
  * The manner in which replace in a unique index must treat
  * duplicates (tuples with the same value of indexed key),
@@ -419,6 +460,16 @@ struct index_vtab {
 	struct iterator *(*create_iterator)(struct index *index,
 			enum iterator_type type,
 			const char *key, uint32_t part_count);
+	/**
+	 * Create an index iterator which skips the tuples up to
+	 * and including the one at position @a pos, see
+	 * index_tuple_position(). The position is validated by
+	 * the caller.
+	 */
+	struct iterator *(*create_iterator_after)(struct index *index,
+			enum iterator_type type,
+			const char *key, uint32_t part_count,
+			const char *pos);
 	/**
 	 * Create an ALL iterator with personal read view so further
 	 * index modifications will not affect the iteration results.
@@ -637,6 +688,25 @@ index_create_iterator(struct index *index, enum iterator_type type,
 	return index->vtab->create_iterator(index, type, key, part_count);
 }
 
+static inline struct iterator *
+index_create_iterator_after(struct index *index, enum iterator_type type,
+			    const char *key, uint32_t part_count,
+			    const char *pos)
+{
+	return index->vtab->create_iterator_after(index, type, key,
+						  part_count, pos);
+}
+
+/**
+ * Return the position of @a tuple in @a index: the tuple
+ * fields compared by the index, including the primary key
+ * ones, encoded as a MessagePack array. The position is
+ * allocated on the fiber region.
+ */
+const char *
+index_tuple_position(struct index *index, struct tuple *tuple,
+		     uint32_t *size);
+
 static inline struct snapshot_iterator *
 index_create_snapshot_iterator(struct index *index)
 {
@@ -715,6 +785,11 @@ int generic_index_reserve(struct index *, uint32_t);
 struct iterator *
 generic_index_create_iterator(struct index *base, enum iterator_type type,
 			      const char *key, uint32_t part_count);
+struct iterator *
+generic_index_create_iterator_after(struct index *base,
+				    enum iterator_type type,
+				    const char *key, uint32_t part_count,
+				    const char *pos);
 int generic_index_build_next(struct index *, struct tuple *);
 void generic_index_end_build(struct index *);
 int
@@ -36,6 +36,7 @@
 #include <msgpuck.h>
 #include <small/ibuf.h>
 #include <small/obuf.h>
+#include <zstd.h>
 #include "third_party/base64.h"
 
 #include "version.h"
@@ -44,10 +45,15 @@
 #include "say.h"
 #include "sio.h"
 #include "evio.h"
+#include "uring.h"
+#include "shm_chan.h"
 #include "coio.h"
 #include "scoped_guard.h"
 #include "memory.h"
 #include "random.h"
+#include "clock.h"
+#include "latency.h"
+#include "info/info.h"
 
 #include "bind.h"
 #include "port.h"
@@ -55,6 +61,7 @@
 #include "call.h"
 #include "tuple_convert.h"
 #include "session.h"
+#include "user.h"
 #include "xrow.h"
 #include "schema.h" /* schema_version */
 #include "replication.h" /* instance_uuid */
@@ -67,6 +74,17 @@
 enum {
 	IPROTO_SALT_SIZE = 32,
 	IPROTO_PACKET_SIZE_MAX = 2UL * 1024 * 1024 * 1024,
+	/** zstd level of compressed connections, see IPROTO_COMPRESS. */
+	IPROTO_ZSTD_LEVEL = 1,
+	/**
+	 * Max window of compressed input, 8 MB, the window of the
+	 * highest standard zstd level. The window is allocated by
+	 * the decompressor, which is created before the client is
+	 * authenticated, so a frame asking for more is refused.
+	 */
+	IPROTO_ZSTD_WINDOW_LOG_MAX = 23,
+	/** Size of a ring of a shared memory connection. */
+	IPROTO_SHM_RING_SIZE = 1024 * 1024,
 };
 
 /**
@@ -87,6 +105,57 @@ iproto_wpos_create(struct iproto_wpos *wpos, struct obuf *out)
 	wpos->svp = obuf_create_svp(out);
 }
 
+enum {
+	/**
+	 * SELECT result tuples of this size or bigger are not
+	 * copied to the output buffer, see struct iproto_splice.
+	 */
+	IPROTO_SPLICE_SIZE_MIN = 1024,
+	/** Max number of splices written with one writev(). */
+	IPROTO_SPLICE_IOV_MAX = 64,
+};
+
+/**
+ * A tuple written to the socket right from the tuple data
+ * rather than copied to the connection output buffer first.
+ * tx creates a splice instead of copying a big tuple of
+ * a SELECT result and passes it to iproto with the request
+ * message. iproto inserts the tuple data into the output at
+ * the splice position and returns the splice back to tx when
+ * the data is written. The tuple is referenced meanwhile.
+ */
+struct iproto_splice {
+	/**
+	 * Link in iproto_msg::splices, then in
+	 * iproto_connection::splices, then in a release list.
+	 */
+	struct stailq_entry in_list;
+	/** Position in the output to insert the data at. */
+	struct iproto_wpos wpos;
+	/** The tuple and its MessagePack data. */
+	struct tuple *tuple;
+	const char *data;
+	uint32_t size;
+	/** How many bytes of the data are already written. */
+	uint32_t written;
+};
+
+/** Splices are allocated and freed in tx. */
+static struct mempool iproto_splice_pool;
+
+/**
+ * A message returning written splices to tx to release the
+ * tuples. Every network thread has one, it is reused.
+ */
+struct iproto_splice_msg {
+	struct cmsg base;
+	struct iproto_thread *iproto_thread;
+	/** Splices to release. */
+	struct stailq splices;
+	/** True while the message is on its way to tx and back. */
+	bool is_sent;
+};
+
 /**
  * In Greek mythology, Kharon is the ferryman who carries souls
  * of the newly deceased across the river Styx that divided the
@@ -109,6 +178,25 @@ struct iproto_kharon {
 	struct iproto_wpos wpos;
 };
 
+/**
+ * A message to release the output buffers of an idle connection
+ * in tx. The buffers are released if everything written to them
+ * is flushed. See iproto_connection_release_buffers().
+ */
+struct iproto_release_msg {
+	struct cmsg base;
+	/**
+	 * The flushed position in the output, set by iproto.
+	 * Tx resets it to the start of the new output buffer if
+	 * the buffers are released.
+	 */
+	struct iproto_wpos wpos;
+	/** True if tx has released the buffers. */
+	bool is_released;
+	/** True while the message is on its way. */
+	bool is_sent;
+};
+
 /**
  * Network readahead. A signed integer to avoid
  * automatic type coercion to an unsigned type.
@@ -126,9 +214,34 @@ struct iproto_kharon {
  */
 unsigned iproto_readahead = 16320;
 
-/* The maximal number of iproto messages in fly. */
+/**
+ * The maximal number of iproto messages in fly, per network
+ * thread. Is set in tx and read in network threads.
+ */
 static int iproto_msg_max = IPROTO_MSG_MAX_MIN;
 
+/**
+ * The maximal number of critical requests in fly, per network
+ * thread, on top of iproto_msg_max. Is set in tx and read in
+ * network threads.
+ */
+static int iproto_critical_msg_max = IPROTO_MSG_MAX_MIN;
+
+/**
+ * Reply with an error to requests exceeding the quota of their
+ * class instead of stopping the connection input. Is set in tx
+ * and read in network threads.
+ */
+static bool iproto_reject_overload;
+
+/**
+ * Names of the users which requests are critical, separated
+ * by zero bytes, see box.cfg.iproto_critical_users. Is used
+ * in tx only.
+ */
+static char *iproto_critical_users;
+static int iproto_critical_user_count;
+
 /**
  * Address the iproto listens for, stored in TX
  * thread. Is kept in TX to be shown in box.info.
@@ -175,6 +288,27 @@ iproto_reset_input(struct ibuf *ibuf)
 
 /* {{{ iproto_msg - declaration */
 
+/**
+ * Classes of requests. Every class has its own quota of
+ * messages in fly, so when one class is overloaded, requests
+ * of the other are not queued behind it.
+ */
+enum iproto_msg_class {
+	/** Requests of the application. */
+	IPROTO_MSG_CLASS_DEFAULT,
+	/**
+	 * Pings, handshake and replication requests and
+	 * requests of box.cfg.iproto_critical_users.
+	 */
+	IPROTO_MSG_CLASS_CRITICAL,
+	iproto_msg_class_MAX,
+};
+
+static const char *iproto_msg_class_strs[] = {
+	"default",
+	"critical",
+};
+
 /**
  * A single msg from io thread. All requests
  * from all connections are queued into a single queue
@@ -197,6 +331,8 @@ struct iproto_msg
 		struct auth_request auth;
 		/* SQL request, if this is the EXECUTE/PREPARE request. */
 		struct sql_request sql;
+		/** List of DML statements, if this is a BATCH. */
+		struct batch_request batch;
 		/** In case of iproto parse error, saved diagnostics. */
 		struct diag diag;
 	};
@@ -232,62 +368,58 @@ struct iproto_msg
 	 * and the connection must be closed.
 	 */
 	bool close_connection;
+	/** Time the request was read by iproto, for latency stats. */
+	double recv_time;
+	/** Time the request was accepted by tx, for latency stats. */
+	double tx_time;
+	/** Tuples of the reply to write bypassing the output buffer. */
+	struct stailq splices;
+	/**
+	 * Class of the request, iproto_msg_class_MAX if the
+	 * message is out of any quota: connects and rejected
+	 * requests.
+	 */
+	enum iproto_msg_class msg_class;
+	/**
+	 * Used in AUTH and connect msgs, true if the requests of
+	 * the session user are critical after the message is
+	 * processed.
+	 */
+	bool is_critical_user;
 };
 
-static struct mempool iproto_msg_pool;
+struct iproto_thread;
 
 static struct iproto_msg *
-iproto_msg_new(struct iproto_connection *con);
+iproto_msg_new(struct iproto_connection *con, enum iproto_msg_class msg_class);
 
 /**
  * Resume stopped connections, if any.
  */
 static void
-iproto_resume();
+iproto_resume(struct iproto_thread *iproto_thread);
 
 static void
 iproto_msg_decode(struct iproto_msg *msg, const char **pos, const char *reqend,
 		  bool *stop_input);
 
-static inline void
-iproto_msg_delete(struct iproto_msg *msg)
-{
-	mempool_free(&iproto_msg_pool, msg);
-	iproto_resume();
-}
-
-/**
- * A single global queue for all requests in all connections. All
- * requests from all connections are processed concurrently.
- * Is also used as a queue for just established connections and to
- * execute disconnect triggers. A few notes about these triggers:
- * - they need to be run in a fiber
- * - unlike an ordinary request failure, on_connect trigger
- *   failure must lead to connection close.
- * - on_connect trigger must be processed before any other
- *   request on this connection.
- */
-static struct cpipe tx_pipe;
-static struct cpipe net_pipe;
-
-/**
- * Network thread.
- */
-static struct cord net_cord;
+static void
+iproto_msg_reject(struct iproto_msg *msg, const char **pos, const char *reqend,
+		  enum iproto_msg_class msg_class);
 
-/**
- * Slab cache used for allocating memory for output network buffers
- * in the tx thread.
- */
-static struct slab_cache net_slabc;
+static inline void
+iproto_msg_delete(struct iproto_msg *msg);
 
-struct rmean *rmean_net;
+static void
+iproto_thread_release_splices(struct iproto_thread *iproto_thread,
+			      struct stailq *splices);
 
 enum rmean_net_name {
 	IPROTO_SENT,
 	IPROTO_RECEIVED,
 	IPROTO_CONNECTIONS,
 	IPROTO_REQUESTS,
+	IPROTO_REJECTED,
 	IPROTO_LAST,
 };
 
@@ -296,19 +428,162 @@ const char *rmean_net_strings[IPROTO_LAST] = {
 	"RECEIVED",
 	"CONNECTIONS",
 	"REQUESTS",
+	"REJECTED",
+};
+
+/**
+ * Context of a network io thread. Every thread has its own
+ * listening socket, serves its own set of connections and
+ * talks to tx through its own pair of pipes, so connections
+ * are sharded between threads and never migrate.
+ */
+struct iproto_thread {
+	/** Thread number, in range [0, iproto_threads_count). */
+	int id;
+	/**
+	 * A single global queue for all requests in all
+	 * connections of the thread. All requests from all
+	 * connections are processed concurrently.
+	 * Is also used as a queue for just established
+	 * connections and to execute disconnect triggers. A few
+	 * notes about these triggers:
+	 * - they need to be run in a fiber
+	 * - unlike an ordinary request failure, on_connect
+	 *   trigger failure must lead to connection close.
+	 * - on_connect trigger must be processed before any
+	 *   other request on this connection.
+	 */
+	struct cpipe tx_pipe;
+	/** A pipe from tx to the thread, used in tx. */
+	struct cpipe net_pipe;
+	/** Network thread. */
+	struct cord net_cord;
+	/**
+	 * Slab cache used for allocating memory for output
+	 * network buffers in the tx thread.
+	 */
+	struct slab_cache net_slabc;
+	/** Iproto messages of the thread connections. */
+	struct mempool iproto_msg_pool;
+	/** Connections served by the thread. */
+	struct mempool iproto_connection_pool;
+	/** Messages in fly by request class. */
+	int msg_count[iproto_msg_class_MAX];
+	/**
+	 * Connections which input is stopped because the quota
+	 * of a request class is exhausted, by class.
+	 */
+	struct rlist stopped_connections[iproto_msg_class_MAX];
+	/**
+	 * Connections in order of their last input or output,
+	 * the least recently active first. Used to find idle
+	 * connections and release their buffers.
+	 */
+	struct rlist active_connections;
+	/** Timer to release the buffers of idle connections. */
+	struct ev_timer idle_timer;
+	/** box.cfg.iproto_buffer_idle_timeout, 0 if disabled. */
+	double buffer_idle_timeout;
+	/** Slab cache of the connection input buffers. */
+	struct slab_cache ibuf_slabc;
+	/** Binary protocol listener of the thread. */
+	struct evio_service binary;
+	/**
+	 * Listener of local clients of the shared memory
+	 * transport, see box.cfg.iproto_shm_listen. Only the
+	 * first thread listens.
+	 */
+	struct evio_service shm;
+	/**
+	 * Ring to batch socket reads and writes of the thread
+	 * connections, valid if is_uring_enabled is set.
+	 */
+	struct uring uring;
+	bool is_uring_enabled;
+	/** Network statistics, collected in the thread. */
+	struct rmean *rmean;
+	/**
+	 * Output flush latency by request type, collected in
+	 * the thread, see iproto_connection::flush_time.
+	 */
+	struct latency flush_latency[IPROTO_TYPE_STAT_MAX];
+	/** Written splices waiting for splice_msg to return. */
+	struct stailq written_splices;
+	/** Message to release written splices in tx. */
+	struct iproto_splice_msg splice_msg;
+	/**
+	 * Message routes. They can not be static, because the
+	 * pipes a message travels through are different for
+	 * every thread.
+	 */
+	struct cmsg_hop destroy_route[2];
+	struct cmsg_hop disconnect_route[2];
+	struct cmsg_hop push_route[2];
+	struct cmsg_hop misc_route[2];
+	struct cmsg_hop call_route[2];
+	struct cmsg_hop select_route[2];
+	struct cmsg_hop process1_route[2];
+	struct cmsg_hop batch_route[2];
+	struct cmsg_hop sql_route[2];
+	struct cmsg_hop join_route[2];
+	struct cmsg_hop subscribe_route[2];
+	struct cmsg_hop error_route[2];
+	struct cmsg_hop connect_route[2];
+	struct cmsg_hop splice_route[2];
+	struct cmsg_hop compress_route[2];
+	struct cmsg_hop release_route[2];
+	const struct cmsg_hop *dml_route[IPROTO_TYPE_STAT_MAX];
+};
+
+/** Network threads, iproto_threads_count in total. */
+static struct iproto_thread *iproto_threads;
+
+int iproto_threads_count;
+
+/** Use io_uring in the network threads, see box.cfg.iproto_uring. */
+static bool iproto_use_uring;
+
+enum {
+	/** Size of a network thread io_uring submission queue. */
+	IPROTO_URING_ENTRIES = 1024,
+};
+
+/** Phases of request processing, for latency stats. */
+enum iproto_phase {
+	/** Waiting in the queue from a network thread to tx. */
+	IPROTO_PHASE_NET,
+	/** Execution in tx, except waiting for WAL. */
+	IPROTO_PHASE_TX,
+	/** Waiting for WAL write in tx. */
+	IPROTO_PHASE_WAL,
+	/** Writing the reply to the socket, in a network thread. */
+	IPROTO_PHASE_FLUSH,
+	iproto_phase_MAX,
+};
+
+static const char *iproto_phase_strs[] = {
+	"net",
+	"tx",
+	"wal",
+	"flush",
 };
 
+/**
+ * Latency of the request processing phases collected in tx,
+ * by request type. The flush phase is collected in the network
+ * threads, see iproto_thread::flush_latency.
+ */
+static struct latency tx_latency[IPROTO_TYPE_STAT_MAX][IPROTO_PHASE_FLUSH];
+
+/** Flush latency summed over all network threads, used in tx. */
+static struct latency flush_latency_sum;
+
 static void
 tx_process_destroy(struct cmsg *m);
 
 static void
 net_finish_destroy(struct cmsg *m);
 
-static const struct cmsg_hop destroy_route[] = {
-	{ tx_process_destroy, &net_pipe },
-	{ net_finish_destroy, NULL },
-};
-
 /** Fire on_disconnect triggers in the tx thread. */
 static void
 tx_process_disconnect(struct cmsg *m);
@@ -317,11 +592,6 @@ tx_process_disconnect(struct cmsg *m);
 static void
 net_finish_disconnect(struct cmsg *m);
 
-static const struct cmsg_hop disconnect_route[] = {
-	{ tx_process_disconnect, &net_pipe },
-	{ net_finish_disconnect, NULL }
-};
-
 /**
  * Kharon is in the dead world (iproto). Schedule an event to
  * flush new obuf as reflected in the fresh wpos.
@@ -339,12 +609,6 @@ iproto_process_push(struct cmsg *m);
 static void
 tx_end_push(struct cmsg *m);
 
-static const struct cmsg_hop push_route[] = {
-	{ iproto_process_push, &tx_pipe },
-	{ tx_end_push, NULL }
-};
-
-
 /* }}} */
 
 /* {{{ iproto_connection - declaration and definition */
@@ -375,6 +639,18 @@ enum iproto_connection_state {
 	IPROTO_CONNECTION_DESTROYED,
 };
 
+/**
+ * Shared memory transport of a connection. The input and the
+ * output of the connection are the rings of the channel, and
+ * the input and output watchers wait on the channel eventfds.
+ * The socket the channel was passed through is only watched
+ * for the client hangup.
+ */
+struct iproto_shm {
+	struct shm_chan chan;
+	struct ev_io socket;
+};
+
 /**
  * Context of a single client connection.
  * Interaction scheme:
@@ -485,6 +761,68 @@ struct iproto_connection
 	 */
 	enum iproto_connection_state state;
 	struct rlist in_stop_list;
+	/**
+	 * Requests of the session user are critical. Is updated
+	 * by the replies to connect and AUTH and is used by the
+	 * network thread to classify requests.
+	 */
+	bool is_critical_user;
+	/** Time of the last input or output. */
+	double last_active;
+	/** Link in iproto_thread::active_connections. */
+	struct rlist in_active_list;
+	/** Message to release the output buffers when idle. */
+	struct iproto_release_msg release_msg;
+	/**
+	 * Time when a reply was queued to the output while
+	 * it had nothing to flush, or 0. The time until the
+	 * output is flushed completely is accounted as the
+	 * flush latency of the reply type, flush_type. So
+	 * the flush latency is sampled once per output batch.
+	 */
+	double flush_time;
+	uint32_t flush_type;
+	/**
+	 * Splices of the replies in the output buffers, in the
+	 * order of their positions. Used by the iproto thread.
+	 */
+	struct stailq splices;
+	/**
+	 * Streaming compression of the connection data, see
+	 * IPROTO_COMPRESS. Used by the iproto thread, NULL if
+	 * the data is not compressed.
+	 */
+	ZSTD_DStream *zin;
+	ZSTD_CStream *zout;
+	/** Input which is read but not decompressed yet. */
+	struct ibuf zibuf;
+	/** True if zin may have output without more input. */
+	bool is_zin_full;
+	/** Output which is compressed but not written yet. */
+	struct ibuf zobuf;
+	/**
+	 * The end of the reply to IPROTO_COMPRESS in the output.
+	 * The output is written as is up to this position, and
+	 * compressed after it.
+	 */
+	struct iproto_wpos zout_start;
+	/** True until the output is written up to zout_start. */
+	bool is_zout_pending;
+	/**
+	 * Socket read and write queued to io_uring of the
+	 * thread, see iproto_thread::uring. The buffers they
+	 * are done to are not touched while they are busy.
+	 */
+	struct uring_op read_op;
+	struct uring_op write_op;
+	/** The end and the size of the output in write_op. */
+	struct obuf_svp write_end;
+	size_t write_size;
+	/**
+	 * Shared memory transport of a local connection, NULL
+	 * if the connection uses the socket.
+	 */
+	struct iproto_shm *shm;
 	/**
 	 * Kharon is used to implement box.session.push().
 	 * When a new push is ready, tx uses kharon to notify
@@ -534,42 +872,145 @@ struct iproto_connection
 	} tx;
 	/** Authentication salt. */
 	char salt[IPROTO_SALT_SIZE];
+	/** Network thread serving the connection. */
+	struct iproto_thread *iproto_thread;
 };
 
-static struct mempool iproto_connection_pool;
-static RLIST_HEAD(stopped_connections);
-
 /**
  * Return true if we have not enough spare messages
- * in the message pool.
+ * in the quota of the request class.
+ */
+static inline bool
+iproto_check_msg_max(struct iproto_thread *iproto_thread,
+		     enum iproto_msg_class msg_class)
+{
+	int msg_max = msg_class == IPROTO_MSG_CLASS_CRITICAL ?
+		      iproto_critical_msg_max : iproto_msg_max;
+	return iproto_thread->msg_count[msg_class] > msg_max;
+}
+
+/**
+ * Return true if we have not enough spare messages in the
+ * message pool of the thread. Besides the messages within the
+ * class quotas the pool has room for as many rejected requests,
+ * so that rejection can't deplete the fiber pool in tx.
  */
 static inline bool
-iproto_check_msg_max()
+iproto_check_msg_pool(struct iproto_thread *iproto_thread)
+{
+	size_t request_count = mempool_count(&iproto_thread->iproto_msg_pool);
+	return request_count >
+	       2 * (size_t) (iproto_msg_max + iproto_critical_msg_max);
+}
+
+static inline void
+iproto_msg_delete(struct iproto_msg *msg)
+{
+	struct iproto_thread *iproto_thread = msg->connection->iproto_thread;
+	assert(stailq_empty(&msg->splices));
+	if (msg->msg_class != iproto_msg_class_MAX)
+		iproto_thread->msg_count[msg->msg_class]--;
+	mempool_free(&iproto_thread->iproto_msg_pool, msg);
+	iproto_resume(iproto_thread);
+}
+
+/**
+ * The socket of the connection. The input and output
+ * watchers of a shared memory connection are not on the
+ * socket, but on the eventfds of the channel.
+ */
+static inline int
+iproto_connection_fd(struct iproto_connection *con)
 {
-	size_t request_count = mempool_count(&iproto_msg_pool);
-	return request_count > (size_t) iproto_msg_max;
+	if (con->shm != NULL)
+		return con->shm->socket.fd;
+	return con->input.fd;
 }
 
 static struct iproto_msg *
-iproto_msg_new(struct iproto_connection *con)
+iproto_msg_new(struct iproto_connection *con, enum iproto_msg_class msg_class)
 {
+	struct mempool *iproto_msg_pool = &con->iproto_thread->iproto_msg_pool;
 	struct iproto_msg *msg =
-		(struct iproto_msg *) mempool_alloc(&iproto_msg_pool);
+		(struct iproto_msg *) mempool_alloc(iproto_msg_pool);
 	ERROR_INJECT(ERRINJ_TESTING, {
-		mempool_free(&iproto_msg_pool, msg);
+		mempool_free(iproto_msg_pool, msg);
 		msg = NULL;
 	});
 	if (msg == NULL) {
 		diag_set(OutOfMemory, sizeof(*msg), "mempool_alloc", "msg");
 		say_warn("can not allocate memory for a new message, "
-			 "connection %s", sio_socketname(con->input.fd));
+			 "connection %s",
+			 sio_socketname(iproto_connection_fd(con)));
 		return NULL;
 	}
 	msg->connection = con;
-	rmean_collect(rmean_net, IPROTO_REQUESTS, 1);
+	stailq_create(&msg->splices);
+	msg->msg_class = msg_class;
+	if (msg_class != iproto_msg_class_MAX)
+		con->iproto_thread->msg_count[msg_class]++;
+	msg->is_critical_user = con->is_critical_user;
+	rmean_collect(con->iproto_thread->rmean, IPROTO_REQUESTS, 1);
 	return msg;
 }
 
+/** True if requests of the type are critical by themselves. */
+static inline bool
+iproto_type_is_critical(uint64_t type)
+{
+	switch (type) {
+	case IPROTO_PING:
+	case IPROTO_AUTH:
+	case IPROTO_VOTE_DEPRECATED:
+	case IPROTO_VOTE:
+	case IPROTO_JOIN:
+	case IPROTO_FETCH_SNAPSHOT:
+	case IPROTO_REGISTER:
+	case IPROTO_SUBSCRIBE:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/**
+ * Find out the class of a request which packet body starts at
+ * @a pos. Only the request type is looked up in the header.
+ * The packet is not validated yet, so anything unexpected
+ * makes the request a default one, the error is reported when
+ * the request is decoded.
+ */
+static enum iproto_msg_class
+iproto_connection_msg_class(struct iproto_connection *con,
+			    const char *pos, const char *end)
+{
+	if (con->is_critical_user)
+		return IPROTO_MSG_CLASS_CRITICAL;
+	if (pos == end || mp_typeof(*pos) != MP_MAP ||
+	    mp_check_map(pos, end) > 0)
+		return IPROTO_MSG_CLASS_DEFAULT;
+	uint32_t size = mp_decode_map(&pos);
+	for (uint32_t i = 0; i < size; i++) {
+		if (pos == end || mp_typeof(*pos) != MP_UINT ||
+		    mp_check_uint(pos, end) > 0)
+			break;
+		uint64_t key = mp_decode_uint(&pos);
+		if (pos == end)
+			break;
+		if (key != IPROTO_REQUEST_TYPE) {
+			if (mp_check(&pos, end) != 0)
+				break;
+			continue;
+		}
+		if (mp_typeof(*pos) != MP_UINT || mp_check_uint(pos, end) > 0)
+			break;
+		if (iproto_type_is_critical(mp_decode_uint(&pos)))
+			return IPROTO_MSG_CLASS_CRITICAL;
+		break;
+	}
+	return IPROTO_MSG_CLASS_DEFAULT;
+}
+
 /**
  * A connection is idle when the client is gone
  * and there are no outstanding msgs in the msg queue.
@@ -603,25 +1044,29 @@ iproto_connection_stop_readahead_limit(struct iproto_connection *con)
 {
 	say_warn_ratelimited("stopping input on connection %s, "
 			     "readahead limit is reached",
-			     sio_socketname(con->input.fd));
+			     sio_socketname(iproto_connection_fd(con)));
 	assert(rlist_empty(&con->in_stop_list));
 	ev_io_stop(con->loop, &con->input);
 }
 
 static inline void
-iproto_connection_stop_msg_max_limit(struct iproto_connection *con)
+iproto_connection_stop_msg_max_limit(struct iproto_connection *con,
+				     enum iproto_msg_class msg_class)
 {
 	assert(rlist_empty(&con->in_stop_list));
 
 	say_warn_ratelimited("stopping input on connection %s, "
-			     "net_msg_max limit is reached",
-			     sio_socketname(con->input.fd));
+			     "%s limit is reached",
+			     sio_socketname(iproto_connection_fd(con)),
+			     msg_class == IPROTO_MSG_CLASS_CRITICAL ?
+			     "iproto_critical_msg_max" : "net_msg_max");
 	ev_io_stop(con->loop, &con->input);
 	/*
 	 * Important to add to tail and fetch from head to ensure
 	 * strict lifo order (fairness) for stopped connections.
 	 */
-	rlist_add_tail(&stopped_connections, &con->in_stop_list);
+	rlist_add_tail(&con->iproto_thread->stopped_connections[msg_class],
+		       &con->in_stop_list);
 }
 
 /**
@@ -650,7 +1095,7 @@ iproto_connection_try_to_start_destroy(struct iproto_connection *con)
 	 * other parts of the connection.
 	 */
 	con->state = IPROTO_CONNECTION_DESTROYED;
-	cpipe_push(&tx_pipe, &con->destroy_msg);
+	cpipe_push(&con->iproto_thread->tx_pipe, &con->destroy_msg);
 }
 
 /**
@@ -665,11 +1110,17 @@ iproto_connection_close(struct iproto_connection *con)
 		/* Clears all pending events. */
 		ev_io_stop(con->loop, &con->input);
 		ev_io_stop(con->loop, &con->output);
+		/* The buffers are not going to be used. */
+		uring_op_cancel(&con->read_op);
+		uring_op_cancel(&con->write_op);
 
 		int fd = con->input.fd;
 		/* Make evio_has_fd() happy */
 		con->input.fd = con->output.fd = -1;
-		close(fd);
+		if (con->shm != NULL)
+			iproto_connection_close_shm(con);
+		else
+			close(fd);
 		/*
 		 * Discard unparsed data, to recycle the
 		 * connection in net_send_msg() as soon as all
@@ -677,7 +1128,11 @@ iproto_connection_close(struct iproto_connection *con)
 		 * is done only once.
 		 */
 		con->p_ibuf->wpos -= con->parse_size;
-		cpipe_push(&tx_pipe, &con->disconnect_msg);
+		/* The output is not going to be written. */
+		iproto_thread_release_splices(con->iproto_thread,
+					      &con->splices);
+		cpipe_push(&con->iproto_thread->tx_pipe, &con->disconnect_msg);
+		rlist_del(&con->in_active_list);
 		assert(con->state == IPROTO_CONNECTION_ALIVE);
 		con->state = IPROTO_CONNECTION_CLOSED;
 	} else if (con->state == IPROTO_CONNECTION_PENDING_DESTROY) {
@@ -688,89 +1143,533 @@ iproto_connection_close(struct iproto_connection *con)
 	rlist_del(&con->in_stop_list);
 }
 
-static inline struct ibuf *
-iproto_connection_next_input(struct iproto_connection *con)
+/* {{{ shared memory transport */
+
+/**
+ * Fail an operation on a shared memory channel broken by the
+ * client, so that the caller closes the connection.
+ */
+static ssize_t
+iproto_shm_broken(void)
 {
-	return &con->ibuf[con->p_ibuf == &con->ibuf[0]];
+	errno = EPROTO;
+	diag_set(SystemError, "shared memory channel is broken by the "
+		 "client");
+	return -1;
 }
 
 /**
- * If there is no space for reading input, we can do one of the
- * following:
- * - try to get a new ibuf, so that it can fit the request.
- *   Always getting a new input buffer when there is no space
- *   makes the instance susceptible to input-flood attacks.
- *   Therefore, at most 2 ibufs are used in a single connection,
- *   one is "open", receiving input, and the other is closed,
- *   waiting for flushing output from a corresponding obuf.
- * - stop input and wait until the client reads piled up output,
- *   so the input buffer can be reused. This complements
- *   the previous strategy. It is only safe to stop input if it
- *   is known that there is output. In this case input event
- *   flow will be resumed when all replies to previous requests
- *   are sent. Since there are two buffers, the input is only
- *   stopped when both of them are fully used up.
- *
- * To make this strategy work, each ibuf in use must fit at least
- * one request. Otherwise, both obufs may end up having no data to
- * flush, while current ibuf is too small to fit a big incoming
- * request.
+ * Read input of the connection from the socket or from the
+ * shared memory channel. Returns the same as sio_read().
  */
-static struct ibuf *
-iproto_connection_input_buffer(struct iproto_connection *con)
+static ssize_t
+iproto_connection_recv(struct iproto_connection *con, void *buf, size_t size)
 {
-	struct ibuf *old_ibuf = con->p_ibuf;
-
-	size_t to_read = 3; /* Smallest possible valid request. */
-
-	/* The type code is checked in iproto_enqueue_batch() */
-	if (con->parse_size) {
-		const char *pos = old_ibuf->wpos - con->parse_size;
-		if (mp_check_uint(pos, old_ibuf->wpos) <= 0)
-			to_read = mp_decode_uint(&pos);
-	}
-
-	if (ibuf_unused(old_ibuf) >= to_read) {
-		/*
-		 * If all read data is discarded, move read
-		 * position to the start of the buffer, to
-		 * reduce chances of unaccounted growth of the
-		 * buffer as read position is shifted to the
-		 * end of the buffer.
-		 */
-		if (ibuf_used(old_ibuf) == 0)
-			ibuf_reset(old_ibuf);
-		return old_ibuf;
+	if (con->shm == NULL)
+		return sio_read(con->input.fd, buf, size);
+	struct shm_chan *chan = &con->shm->chan;
+	size_t nrd;
+	while ((nrd = shm_chan_read(chan, buf, size)) == 0) {
+		if (shm_chan_is_broken(chan))
+			return iproto_shm_broken();
+		if (shm_chan_is_closed(chan))
+			return 0;
+		if (shm_chan_prepare_wait(chan, true, false)) {
+			errno = EAGAIN;
+			return -1;
+		}
 	}
+	return nrd;
+}
 
+/**
+ * Write the output of the connection to the socket or to the
+ * shared memory channel. Returns the same as sio_writev().
+ */
+static ssize_t
+iproto_connection_sendv(struct iproto_connection *con,
+			const struct iovec *iov, int iovcnt)
+{
+	if (con->shm == NULL)
+		return sio_writev(con->output.fd, iov, iovcnt);
+	struct shm_chan *chan = &con->shm->chan;
+	size_t nwr = shm_chan_writev(chan, iov, iovcnt);
+	size_t total = 0;
+	for (int i = 0; i < iovcnt; i++)
+		total += iov[i].iov_len;
+	if (nwr == total)
+		return nwr;
+	if (shm_chan_is_broken(chan))
+		return iproto_shm_broken();
 	/*
-	 * Reuse the buffer if all requests are processed
-	 * (in only has unparsed content).
+	 * The ring is full, the caller waits for the output
+	 * watcher. Wake it up right away if the client has
+	 * freed some space meanwhile.
 	 */
-	if (ibuf_used(old_ibuf) == con->parse_size) {
-		ibuf_reserve_xc(old_ibuf, to_read);
-		return old_ibuf;
-	}
+	if (!shm_chan_prepare_wait(chan, false, true))
+		ev_feed_event(con->loop, &con->output, EV_WRITE);
+	if (nwr > 0)
+		return nwr;
+	errno = EAGAIN;
+	return -1;
+}
 
-	struct ibuf *new_ibuf = iproto_connection_next_input(con);
-	if (ibuf_used(new_ibuf) != 0) {
-		/*
-		 * Wait until the second buffer is flushed
-		 * and becomes available for reuse.
-		 */
-		return NULL;
-	}
-	/* Update buffer size if readahead has changed. */
-	if (new_ibuf->start_capacity != iproto_readahead) {
-		ibuf_destroy(new_ibuf);
-		ibuf_create(new_ibuf, cord_slab_cache(), iproto_readahead);
-	}
+static inline ssize_t
+iproto_connection_send(struct iproto_connection *con,
+		       const void *buf, size_t size)
+{
+	struct iovec iov = {(void *) buf, size};
+	return iproto_connection_sendv(con, &iov, 1);
+}
 
-	ibuf_reserve_xc(new_ibuf, to_read + con->parse_size);
-	/*
-	 * Discard unparsed data in the old buffer, otherwise it
-	 * won't be recycled when all parsed requests are processed.
-	 */
+/**
+ * Best effort at sending an error to the client of a broken
+ * connection, bypassing the output. The client of a shared
+ * memory connection does not read the socket, so it gets the
+ * error only in the log.
+ */
+static void
+iproto_connection_write_error(struct iproto_connection *con,
+			      const struct error *e)
+{
+	if (con->shm == NULL)
+		iproto_write_error(con->input.fd, e, ::schema_version, 0);
+}
+
+/** Close the shared memory transport of a closed connection. */
+static void
+iproto_connection_close_shm(struct iproto_connection *con)
+{
+	struct iproto_shm *shm = con->shm;
+	ev_io_stop(con->loop, &shm->socket);
+	close(shm->socket.fd);
+	/* Keep iproto_connection_fd() working, as for sockets. */
+	shm->socket.fd = -1;
+	shm_chan_destroy(&shm->chan);
+}
+
+/**
+ * The client never writes to the socket of a shared memory
+ * connection, so it becomes readable on the client hangup.
+ */
+static void
+iproto_connection_on_shm_hangup(ev_loop *loop, struct ev_io *watcher,
+				int /* revents */)
+{
+	(void) loop;
+	struct iproto_connection *con =
+		(struct iproto_connection *) watcher->data;
+	iproto_connection_close(con);
+}
+
+/* }}} */
+
+/* {{{ compression */
+
+/**
+ * Start decompressing the input on IPROTO_COMPRESS request.
+ * The output is compressed after the reply to the request,
+ * see net_send_compress().
+ */
+static int
+iproto_connection_start_decompression(struct iproto_connection *con,
+				      const struct compress_request *request)
+{
+	if (con->zin != NULL) {
+		diag_set(ClientError, ER_UNSUPPORTED,
+			 "Compressed connection", "IPROTO_COMPRESS");
+		return -1;
+	}
+	if (request->algorithm_len != strlen("zstd") ||
+	    memcmp(request->algorithm, "zstd", strlen("zstd")) != 0) {
+		diag_set(ClientError, ER_UNSUPPORTED, "IPROTO",
+			 tt_sprintf("compression algorithm '%.*s'",
+				    (int) request->algorithm_len,
+				    request->algorithm));
+		return -1;
+	}
+	ZSTD_DStream *zin = ZSTD_createDStream();
+	if (zin == NULL) {
+		diag_set(OutOfMemory, sizeof(zin), "ZSTD_createDStream",
+			 "zin");
+		return -1;
+	}
+	ZSTD_initDStream(zin);
+	size_t rc = ZSTD_DCtx_setParameter(zin, ZSTD_d_windowLogMax,
+					   IPROTO_ZSTD_WINDOW_LOG_MAX);
+	if (ZSTD_isError(rc)) {
+		ZSTD_freeDStream(zin);
+		diag_set(ClientError, ER_DECOMPRESSION, ZSTD_getErrorName(rc));
+		return -1;
+	}
+	con->zin = zin;
+	con->is_zin_full = false;
+	return 0;
+}
+
+/**
+ * Move the input which follows IPROTO_COMPRESS request to
+ * the compressed input buffer.
+ */
+static int
+iproto_connection_move_to_zin(struct iproto_connection *con,
+			      struct ibuf *in)
+{
+	size_t size = con->parse_size;
+	if (size == 0)
+		return 0;
+	void *ptr = ibuf_alloc(&con->zibuf, size);
+	if (ptr == NULL) {
+		diag_set(OutOfMemory, size, "ibuf_alloc", "zibuf");
+		return -1;
+	}
+	in->wpos -= size;
+	memcpy(ptr, in->wpos, size);
+	con->parse_size = 0;
+	return 0;
+}
+
+/** True if there is input to decompress without reading. */
+static inline bool
+iproto_connection_has_zin(struct iproto_connection *con)
+{
+	return con->zin != NULL &&
+	       (ibuf_used(&con->zibuf) != 0 || con->is_zin_full);
+}
+
+/**
+ * Read input to @a in, decompressing it if the connection is
+ * compressed. Returns the number of bytes added to @a in, 0 on
+ * EOF, -1 if the socket is not ready.
+ */
+static ssize_t
+iproto_connection_read(struct iproto_connection *con, struct ibuf *in)
+{
+	struct rmean *rmean = con->iproto_thread->rmean;
+	if (con->zin == NULL) {
+		ssize_t nrd = iproto_connection_recv(con, in->wpos,
+						     ibuf_unused(in));
+		if (nrd > 0)
+			rmean_collect(rmean, IPROTO_RECEIVED, nrd);
+		return nrd;
+	}
+	struct ibuf *zibuf = &con->zibuf;
+	while (true) {
+		if (iproto_connection_has_zin(con)) {
+			ZSTD_inBuffer input = {
+				zibuf->rpos, ibuf_used(zibuf), 0
+			};
+			ZSTD_outBuffer output = {
+				in->wpos, ibuf_unused(in), 0
+			};
+			size_t rc = ZSTD_decompressStream(con->zin, &output,
+							  &input);
+			if (ZSTD_isError(rc)) {
+				tnt_raise(ClientError, ER_DECOMPRESSION,
+					  ZSTD_getErrorName(rc));
+			}
+			zibuf->rpos += input.pos;
+			con->is_zin_full = output.pos == output.size;
+			if (output.pos > 0)
+				return output.pos;
+		}
+		if (ibuf_used(zibuf) == 0)
+			ibuf_reset(zibuf);
+		ibuf_reserve_xc(zibuf, ZSTD_DStreamInSize());
+		ssize_t nrd = iproto_connection_recv(con, zibuf->wpos,
+						     ibuf_unused(zibuf));
+		if (nrd <= 0)
+			return nrd;
+		rmean_collect(rmean, IPROTO_RECEIVED, nrd);
+		zibuf->wpos += nrd;
+	}
+}
+
+/**
+ * Compress the output data to the compressed output buffer.
+ * The compression stream is flushed, so the peer can
+ * decompress all the data without waiting for more.
+ */
+static void
+iproto_connection_compress(struct iproto_connection *con,
+			   const struct iovec *iov, int iovcnt)
+{
+	struct ibuf *zobuf = &con->zobuf;
+	size_t rc;
+	for (int i = 0; i < iovcnt; i++) {
+		ZSTD_inBuffer input = {iov[i].iov_base, iov[i].iov_len, 0};
+		while (input.pos < input.size) {
+			ibuf_reserve_xc(zobuf, ZSTD_CStreamOutSize());
+			ZSTD_outBuffer output = {
+				zobuf->wpos, ibuf_unused(zobuf), 0
+			};
+			rc = ZSTD_compressStream(con->zout, &output, &input);
+			if (ZSTD_isError(rc))
+				goto error;
+			zobuf->wpos += output.pos;
+		}
+	}
+	do {
+		ibuf_reserve_xc(zobuf, ZSTD_CStreamOutSize());
+		ZSTD_outBuffer output = {zobuf->wpos, ibuf_unused(zobuf), 0};
+		rc = ZSTD_flushStream(con->zout, &output);
+		if (ZSTD_isError(rc))
+			goto error;
+		zobuf->wpos += output.pos;
+	} while (rc != 0);
+	return;
+error:
+	tnt_raise(ClientError, ER_COMPRESSION, ZSTD_getErrorName(rc));
+}
+
+/**
+ * Write the compressed output. Returns 0 if it is written
+ * entirely, -1 if the socket is not ready.
+ */
+static int
+iproto_connection_write_zout(struct iproto_connection *con)
+{
+	struct ibuf *zobuf = &con->zobuf;
+	ssize_t nwr = iproto_connection_send(con, zobuf->rpos,
+					     ibuf_used(zobuf));
+	if (nwr < 0) {
+		if (! sio_wouldblock(errno))
+			diag_raise();
+		return -1;
+	}
+	rmean_collect(con->iproto_thread->rmean, IPROTO_SENT, nwr);
+	zobuf->rpos += nwr;
+	if (ibuf_used(zobuf) != 0)
+		return -1;
+	ibuf_reset(zobuf);
+	return 0;
+}
+
+/* }}} */
+
+/* {{{ idle connections */
+
+/** Mark the connection active: it has got input or output. */
+static inline void
+iproto_connection_touch(struct iproto_connection *con)
+{
+	struct iproto_thread *iproto_thread = con->iproto_thread;
+	con->last_active = ev_monotonic_now(con->loop);
+	rlist_move_tail_entry(&iproto_thread->active_connections, con,
+			      in_active_list);
+}
+
+/** Free the memory of an empty buffer, it is allocated on demand. */
+static inline void
+iproto_connection_release_ibuf(struct iproto_connection *con,
+			       struct ibuf *ibuf)
+{
+	assert(ibuf_used(ibuf) == 0);
+	ibuf_destroy(ibuf);
+	ibuf_create(ibuf, &con->iproto_thread->ibuf_slabc, iproto_readahead);
+}
+
+/**
+ * Release the buffers of a connection which has been idle for
+ * iproto_thread::buffer_idle_timeout. The input buffers are
+ * freed right away. The output buffers are used by tx, so they
+ * are freed in tx, if everything is flushed by then.
+ */
+static void
+iproto_connection_release_buffers(struct iproto_connection *con)
+{
+	if (!evio_has_fd(&con->input) || !iproto_connection_is_idle(con) ||
+	    con->parse_size != 0 || uring_op_is_busy(&con->read_op) ||
+	    uring_op_is_busy(&con->write_op))
+		return;
+	iproto_connection_release_ibuf(con, &con->ibuf[0]);
+	iproto_connection_release_ibuf(con, &con->ibuf[1]);
+	if (ibuf_used(&con->zibuf) == 0 && !con->is_zin_full)
+		iproto_connection_release_ibuf(con, &con->zibuf);
+	if (ibuf_used(&con->zobuf) == 0)
+		iproto_connection_release_ibuf(con, &con->zobuf);
+
+	struct iproto_release_msg *msg = &con->release_msg;
+	if (msg->is_sent || con->is_zout_pending ||
+	    !stailq_empty(&con->splices) ||
+	    con->wpos.obuf != con->wend.obuf ||
+	    con->wpos.svp.used != con->wend.svp.used)
+		return;
+	cmsg_init(&msg->base, con->iproto_thread->release_route);
+	msg->wpos = con->wpos;
+	msg->is_released = false;
+	msg->is_sent = true;
+	cpipe_push(&con->iproto_thread->tx_pipe, &msg->base);
+}
+
+static void
+iproto_thread_on_idle_timer(ev_loop *loop, struct ev_timer *watcher,
+			    int /* revents */)
+{
+	struct iproto_thread *iproto_thread =
+		(struct iproto_thread *) watcher->data;
+	double deadline = ev_monotonic_now(loop) -
+			  iproto_thread->buffer_idle_timeout;
+	struct iproto_connection *con, *next;
+	rlist_foreach_entry_safe(con, &iproto_thread->active_connections,
+				 in_active_list, next) {
+		if (con->last_active > deadline)
+			break;
+		/*
+		 * The connection gets back to the list on the
+		 * next input or output.
+		 */
+		rlist_del(&con->in_active_list);
+		iproto_connection_release_buffers(con);
+	}
+}
+
+/** Release the output buffers if everything is flushed. Runs in tx. */
+static void
+tx_release_buffers(struct cmsg *m)
+{
+	struct iproto_release_msg *msg = (struct iproto_release_msg *) m;
+	struct iproto_connection *con =
+		container_of(msg, struct iproto_connection, release_msg);
+	struct obuf *obuf = msg->wpos.obuf;
+	/*
+	 * The flushed position must be the end of the output,
+	 * and there must be no push on its way to iproto.
+	 * Buffers are flushed in order, so if the position is
+	 * in the current buffer, the previous one is flushed.
+	 */
+	if (con->tx.is_push_sent || msg->wpos.svp.used != obuf_size(obuf) ||
+	    (obuf != con->tx.p_obuf && obuf_size(con->tx.p_obuf) != 0))
+		return;
+	for (int i = 0; i < 2; i++) {
+		obuf_destroy(&con->obuf[i]);
+		obuf_create(&con->obuf[i], &con->iproto_thread->net_slabc,
+			    iproto_readahead);
+	}
+	con->tx.p_obuf = &con->obuf[0];
+	iproto_wpos_create(&msg->wpos, con->tx.p_obuf);
+	msg->is_released = true;
+}
+
+/**
+ * The output which tx writes after releasing the buffers is
+ * sent to iproto after this message, so the write position can
+ * be simply moved to the start of the new buffer.
+ */
+static void
+net_end_release_buffers(struct cmsg *m)
+{
+	struct iproto_release_msg *msg = (struct iproto_release_msg *) m;
+	struct iproto_connection *con =
+		container_of(msg, struct iproto_connection, release_msg);
+	msg->is_sent = false;
+	if (msg->is_released) {
+		con->wpos = msg->wpos;
+		con->wend = msg->wpos;
+	}
+}
+
+/** Start or stop the idle timer on timeout change. */
+static void
+iproto_thread_set_idle_timeout(struct iproto_thread *iproto_thread,
+			       double timeout)
+{
+	struct ev_timer *timer = &iproto_thread->idle_timer;
+	iproto_thread->buffer_idle_timeout = timeout;
+	ev_timer_stop(loop(), timer);
+	if (timeout > 0) {
+		/* Release the buffers in [timeout, 1.5 * timeout]. */
+		ev_timer_set(timer, timeout / 2, timeout / 2);
+		ev_timer_start(loop(), timer);
+	}
+}
+
+/* }}} */
+
+static inline struct ibuf *
+iproto_connection_next_input(struct iproto_connection *con)
+{
+	return &con->ibuf[con->p_ibuf == &con->ibuf[0]];
+}
+
+/**
+ * If there is no space for reading input, we can do one of the
+ * following:
+ * - try to get a new ibuf, so that it can fit the request.
+ *   Always getting a new input buffer when there is no space
+ *   makes the instance susceptible to input-flood attacks.
+ *   Therefore, at most 2 ibufs are used in a single connection,
+ *   one is "open", receiving input, and the other is closed,
+ *   waiting for flushing output from a corresponding obuf.
+ * - stop input and wait until the client reads piled up output,
+ *   so the input buffer can be reused. This complements
+ *   the previous strategy. It is only safe to stop input if it
+ *   is known that there is output. In this case input event
+ *   flow will be resumed when all replies to previous requests
+ *   are sent. Since there are two buffers, the input is only
+ *   stopped when both of them are fully used up.
+ *
+ * To make this strategy work, each ibuf in use must fit at least
+ * one request. Otherwise, both obufs may end up having no data to
+ * flush, while current ibuf is too small to fit a big incoming
+ * request.
+ */
+static struct ibuf *
+iproto_connection_input_buffer(struct iproto_connection *con)
+{
+	struct ibuf *old_ibuf = con->p_ibuf;
+
+	size_t to_read = 3; /* Smallest possible valid request. */
+
+	/* The type code is checked in iproto_enqueue_batch() */
+	if (con->parse_size) {
+		const char *pos = old_ibuf->wpos - con->parse_size;
+		if (mp_check_uint(pos, old_ibuf->wpos) <= 0)
+			to_read = mp_decode_uint(&pos);
+	}
+
+	if (ibuf_unused(old_ibuf) >= to_read) {
+		/*
+		 * If all read data is discarded, move read
+		 * position to the start of the buffer, to
+		 * reduce chances of unaccounted growth of the
+		 * buffer as read position is shifted to the
+		 * end of the buffer.
+		 */
+		if (ibuf_used(old_ibuf) == 0)
+			ibuf_reset(old_ibuf);
+		return old_ibuf;
+	}
+
+	/*
+	 * Reuse the buffer if all requests are processed
+	 * (in only has unparsed content).
+	 */
+	if (ibuf_used(old_ibuf) == con->parse_size) {
+		ibuf_reserve_xc(old_ibuf, to_read);
+		return old_ibuf;
+	}
+
+	struct ibuf *new_ibuf = iproto_connection_next_input(con);
+	if (ibuf_used(new_ibuf) != 0) {
+		/*
+		 * Wait until the second buffer is flushed
+		 * and becomes available for reuse.
+		 */
+		return NULL;
+	}
+	/* Update buffer size if readahead has changed. */
+	if (new_ibuf->start_capacity != iproto_readahead) {
+		ibuf_destroy(new_ibuf);
+		ibuf_create(new_ibuf, &con->iproto_thread->ibuf_slabc,
+			    iproto_readahead);
+	}
+
+	ibuf_reserve_xc(new_ibuf, to_read + con->parse_size);
+	/*
+	 * Discard unparsed data in the old buffer, otherwise it
+	 * won't be recycled when all parsed requests are processed.
+	 */
 	old_ibuf->wpos -= con->parse_size;
 	if (con->parse_size != 0) {
 		/* Move the cached request prefix to the new buffer. */
@@ -807,13 +1706,17 @@ static inline int
 iproto_enqueue_batch(struct iproto_connection *con, struct ibuf *in)
 {
 	assert(rlist_empty(&con->in_stop_list));
+	struct iproto_thread *iproto_thread = con->iproto_thread;
+	struct cpipe *tx_pipe = &iproto_thread->tx_pipe;
 	int n_requests = 0;
 	bool stop_input = false;
 	const char *errmsg;
+	double recv_time = clock_monotonic();
 	while (con->parse_size != 0 && !stop_input) {
-		if (iproto_check_msg_max()) {
-			iproto_connection_stop_msg_max_limit(con);
-			cpipe_flush_input(&tx_pipe);
+		if (iproto_check_msg_pool(iproto_thread)) {
+			iproto_connection_stop_msg_max_limit(
+				con, IPROTO_MSG_CLASS_DEFAULT);
+			cpipe_flush_input(tx_pipe);
 			return 0;
 		}
 		const char *reqstart = in->wpos - con->parse_size;
@@ -822,7 +1725,7 @@ iproto_enqueue_batch(struct iproto_connection *con, struct ibuf *in)
 		if (mp_typeof(*pos) != MP_UINT) {
 			errmsg = "packet length";
 err_msgpack:
-			cpipe_flush_input(&tx_pipe);
+			cpipe_flush_input(tx_pipe);
 			diag_set(ClientError, ER_INVALID_MSGPACK,
 				 errmsg);
 			return -1;
@@ -839,31 +1742,56 @@ err_msgpack:
 		const char *reqend = pos + len;
 		if (reqend > in->wpos)
 			break;
-		struct iproto_msg *msg = iproto_msg_new(con);
+		enum iproto_msg_class msg_class =
+			iproto_connection_msg_class(con, pos, reqend);
+		bool is_rejected = false;
+		if (iproto_check_msg_max(iproto_thread, msg_class)) {
+			if (!iproto_reject_overload) {
+				iproto_connection_stop_msg_max_limit(con,
+								     msg_class);
+				cpipe_flush_input(tx_pipe);
+				return 0;
+			}
+			is_rejected = true;
+		}
+		struct iproto_msg *msg = iproto_msg_new(con, is_rejected ?
+							iproto_msg_class_MAX :
+							msg_class);
 		if (msg == NULL) {
 			/*
 			 * Do not treat it as an error - just wait
 			 * until some of requests are finished.
 			 */
-			iproto_connection_stop_msg_max_limit(con);
+			iproto_connection_stop_msg_max_limit(con, msg_class);
 			return 0;
 		}
 		msg->p_ibuf = con->p_ibuf;
 		msg->wpos = con->wpos;
+		msg->recv_time = recv_time;
 
 		msg->len = reqend - reqstart; /* total request length */
 
-		iproto_msg_decode(msg, &pos, reqend, &stop_input);
+		ZSTD_DStream *zin = con->zin;
+		if (is_rejected)
+			iproto_msg_reject(msg, &pos, reqend, msg_class);
+		else
+			iproto_msg_decode(msg, &pos, reqend, &stop_input);
 		/*
 		 * This can't throw, but should not be
 		 * done in case of exception.
 		 */
-		cpipe_push_input(&tx_pipe, &msg->base);
+		cpipe_push_input(tx_pipe, &msg->base);
 		n_requests++;
 		/* Request is parsed */
 		assert(reqend > reqstart);
 		assert(con->parse_size >= (size_t) (reqend - reqstart));
 		con->parse_size -= reqend - reqstart;
+		/* The input after IPROTO_COMPRESS is compressed. */
+		if (zin == NULL && con->zin != NULL &&
+		    iproto_connection_move_to_zin(con, in) != 0) {
+			cpipe_flush_input(tx_pipe);
+			return -1;
+		}
 	}
 	if (stop_input) {
 		/**
@@ -876,7 +1804,8 @@ err_msgpack:
 		 */
 		ev_io_stop(con->loop, &con->output);
 		ev_io_stop(con->loop, &con->input);
-	} else if (n_requests != 1 || con->parse_size != 0) {
+	} else if (n_requests != 1 || con->parse_size != 0 ||
+		   iproto_connection_has_zin(con)) {
 		/*
 		 * Keep reading input, as long as the socket
 		 * supplies data, but don't waste CPU on an extra
@@ -892,11 +1821,12 @@ err_msgpack:
 		 * is fully read and enqueued.
 		 * If there is unparsed data, or 0 queued
 		 * requests, keep reading input, if only to avoid
-		 * a deadlock on this connection.
+		 * a deadlock on this connection. The same for
+		 * input which is read but not decompressed yet.
 		 */
 		ev_feed_event(con->loop, &con->input, EV_READ);
 	}
-	cpipe_flush_input(&tx_pipe);
+	cpipe_flush_input(tx_pipe);
 	return 0;
 }
 
@@ -908,7 +1838,6 @@ err_msgpack:
 static void
 iproto_connection_resume(struct iproto_connection *con)
 {
-	assert(! iproto_check_msg_max());
 	rlist_del(&con->in_stop_list);
 	/*
 	 * Enqueue_batch() stops the connection again, if the
@@ -916,7 +1845,7 @@ iproto_connection_resume(struct iproto_connection *con)
 	 */
 	if (iproto_enqueue_batch(con, con->p_ibuf) != 0) {
 		struct error *e = box_error_last();
-		iproto_write_error(con->input.fd, e, ::schema_version, 0);
+		iproto_connection_write_error(con, e);
 		error_log(e);
 		iproto_connection_close(con);
 	}
@@ -932,18 +1861,88 @@ iproto_connection_resume(struct iproto_connection *con)
  * necessary to use up the limit.
  */
 static void
-iproto_resume()
+iproto_resume(struct iproto_thread *iproto_thread)
 {
-	while (!iproto_check_msg_max() && !rlist_empty(&stopped_connections)) {
+	for (int i = 0; i < iproto_msg_class_MAX; i++) {
+		enum iproto_msg_class msg_class = (enum iproto_msg_class) i;
+		struct rlist *stopped =
+			&iproto_thread->stopped_connections[msg_class];
 		/*
-		 * Shift from list head to ensure strict FIFO
-		 * (fairness) for resumed connections.
+		 * When overload is rejected, a resumed connection
+		 * is stopped again only by the message pool limit.
 		 */
-		struct iproto_connection *con =
-			rlist_first_entry(&stopped_connections,
-					  struct iproto_connection,
-					  in_stop_list);
-		iproto_connection_resume(con);
+		while ((iproto_reject_overload ||
+			!iproto_check_msg_max(iproto_thread, msg_class)) &&
+		       !iproto_check_msg_pool(iproto_thread) &&
+		       !rlist_empty(stopped)) {
+			/*
+			 * Shift from list head to ensure strict FIFO
+			 * (fairness) for resumed connections.
+			 */
+			struct iproto_connection *con =
+				rlist_first_entry(stopped,
+						  struct iproto_connection,
+						  in_stop_list);
+			iproto_connection_resume(con);
+		}
+	}
+}
+
+/**
+ * Handle the result of reading @a nrd bytes of input to @a in,
+ * the same as of iproto_connection_read().
+ */
+static void
+iproto_connection_process_input(struct iproto_connection *con,
+				struct ibuf *in, ssize_t nrd)
+{
+	if (nrd < 0) {                  /* Socket is not ready. */
+		if (! sio_wouldblock(errno))
+			diag_raise();
+		ev_io_start(con->loop, &con->input);
+		return;
+	}
+	if (nrd == 0) {                 /* EOF */
+		iproto_connection_close(con);
+		return;
+	}
+	/* Update the read position and connection state. */
+	in->wpos += nrd;
+	con->parse_size += nrd;
+	iproto_connection_touch(con);
+	/* Enqueue all requests which are fully read up. */
+	if (iproto_enqueue_batch(con, in) != 0)
+		diag_raise();
+}
+
+/** Completion of a read queued to io_uring. */
+static void
+iproto_connection_on_read(struct uring_op *op, int res)
+{
+	struct iproto_connection *con =
+		container_of(op, struct iproto_connection, read_op);
+	int fd = con->input.fd;
+	try {
+		ssize_t nrd = res;
+		if (res == -ECONNRESET) {
+			/* Treat the same as EOF, like sio_read(). */
+			nrd = 0;
+		} else if (res < 0) {
+			errno = -res;
+			nrd = -1;
+			if (! sio_wouldblock(errno)) {
+				diag_set(SocketError, sio_socketname(fd),
+					 "recvmsg");
+			}
+		} else if (res > 0) {
+			rmean_collect(con->iproto_thread->rmean,
+				      IPROTO_RECEIVED, res);
+		}
+		iproto_connection_process_input(con, con->p_ibuf, nrd);
+	} catch (Exception *e) {
+		iproto_connection_write_error(con, e);
+		e->log();
+		iproto_connection_close(con);
 	}
 }
 
@@ -957,13 +1956,19 @@ iproto_connection_on_input(ev_loop *loop, struct ev_io *watcher,
 	assert(fd >= 0);
 	assert(rlist_empty(&con->in_stop_list));
 	assert(loop == con->loop);
+	(void) loop;
+	/* The input is processed on the read completion. */
+	if (uring_op_is_busy(&con->read_op))
+		return;
 	/*
 	 * Throttle if there are too many pending requests,
 	 * otherwise we might deplete the fiber pool in tx
-	 * thread and deadlock.
+	 * thread and deadlock. The class quotas are checked
+	 * per request, when it is read up.
 	 */
-	if (iproto_check_msg_max()) {
-		iproto_connection_stop_msg_max_limit(con);
+	if (iproto_check_msg_pool(con->iproto_thread)) {
+		iproto_connection_stop_msg_max_limit(con,
+						     IPROTO_MSG_CLASS_DEFAULT);
 		return;
 	}
 
@@ -974,90 +1979,327 @@ iproto_connection_on_input(ev_loop *loop, struct ev_io *watcher,
 			iproto_connection_stop_readahead_limit(con);
 			return;
 		}
+		/*
+		 * Queue the read to io_uring to batch it with
+		 * reads and writes of other connections. The
+		 * compressed input and the input of shared memory
+		 * connections are read synchronously.
+		 */
+		struct iproto_thread *thread = con->iproto_thread;
+		if (thread->is_uring_enabled && con->zin == NULL &&
+		    con->shm == NULL &&
+		    uring_recv(&thread->uring, &con->read_op, fd, in->wpos,
+			       ibuf_unused(in), iproto_connection_on_read) == 0)
+			return;
 		/* Read input. */
-		int nrd = sio_read(fd, in->wpos, ibuf_unused(in));
-		if (nrd < 0) {                  /* Socket is not ready. */
-			if (! sio_wouldblock(errno))
-				diag_raise();
-			ev_io_start(loop, &con->input);
+		ssize_t nrd = iproto_connection_read(con, in);
+		iproto_connection_process_input(con, in, nrd);
+	} catch (Exception *e) {
+		/* Best effort at sending the error message to the client. */
+		iproto_connection_write_error(con, e);
+		e->log();
+		iproto_connection_close(con);
+	}
+}
+
+/* {{{ splices */
+
+/** Release tuples of splices and free them. Runs in tx. */
+static void
+tx_free_splices(struct stailq *splices)
+{
+	struct iproto_splice *splice, *next;
+	stailq_foreach_entry_safe(splice, next, splices, in_list) {
+		tuple_unref(splice->tuple);
+		mempool_free(&iproto_splice_pool, splice);
+	}
+	stailq_create(splices);
+}
+
+static void
+tx_release_splices(struct cmsg *m)
+{
+	struct iproto_splice_msg *msg = (struct iproto_splice_msg *) m;
+	tx_free_splices(&msg->splices);
+}
+
+/**
+ * Send written splices to tx to release them. If the splice
+ * message of the thread is busy, the splices wait for its
+ * return.
+ */
+static void
+iproto_thread_release_splices(struct iproto_thread *iproto_thread,
+			      struct stailq *splices)
+{
+	stailq_concat(&iproto_thread->written_splices, splices);
+	struct iproto_splice_msg *msg = &iproto_thread->splice_msg;
+	if (msg->is_sent || stailq_empty(&iproto_thread->written_splices))
+		return;
+	stailq_create(&msg->splices);
+	stailq_concat(&msg->splices, &iproto_thread->written_splices);
+	msg->iproto_thread = iproto_thread;
+	msg->is_sent = true;
+	cmsg_init(&msg->base, iproto_thread->splice_route);
+	cpipe_push(&iproto_thread->tx_pipe, &msg->base);
+}
+
+static void
+net_end_release_splices(struct cmsg *m)
+{
+	struct iproto_splice_msg *msg = (struct iproto_splice_msg *) m;
+	struct stailq empty;
+	stailq_create(&empty);
+	msg->is_sent = false;
+	/* Send the splices written while the message was away. */
+	iproto_thread_release_splices(msg->iproto_thread, &empty);
+}
+
+/** First splice to write if it is in the given output buffer. */
+static inline struct iproto_splice *
+iproto_connection_first_splice(struct iproto_connection *con,
+			       struct obuf *obuf)
+{
+	if (stailq_empty(&con->splices))
+		return NULL;
+	struct iproto_splice *splice =
+		stailq_first_entry(&con->splices, struct iproto_splice,
+				   in_list);
+	return splice->wpos.obuf == obuf ? splice : NULL;
+}
+
+/** Next splice in the same output buffer. */
+static inline struct iproto_splice *
+iproto_splice_next(struct iproto_splice *splice)
+{
+	struct stailq_entry *next = stailq_next(&splice->in_list);
+	if (next == NULL)
+		return NULL;
+	struct iproto_splice *result =
+		stailq_entry(next, struct iproto_splice, in_list);
+	return result->wpos.obuf == splice->wpos.obuf ? result : NULL;
+}
+
+/**
+ * Return @a splice if it is positioned before @a end. Splices
+ * after the end are possible while the reply to IPROTO_COMPRESS
+ * is written.
+ */
+static inline struct iproto_splice *
+iproto_splice_before(struct iproto_splice *splice,
+		     const struct obuf_svp *end)
+{
+	return splice != NULL && splice->wpos.svp.used <= end->used ?
+	       splice : NULL;
+}
+
+/** Advance a flush position by @a size written bytes. */
+static void
+iproto_svp_advance(struct obuf *obuf, struct obuf_svp *svp, size_t size)
+{
+	svp->used += size;
+	while (size > 0) {
+		size_t avail = obuf->iov[svp->pos].iov_len - svp->iov_len;
+		if (size < avail) {
+			svp->iov_len += size;
 			return;
 		}
-		if (nrd == 0) {                 /* EOF */
-			iproto_connection_close(con);
-			return;
+		size -= avail;
+		svp->pos++;
+		svp->iov_len = 0;
+	}
+}
+
+/* }}} */
+
+/**
+ * Advance the output write position by @a nwr written bytes
+ * of the output up to @a end and release the written splices.
+ */
+static void
+iproto_flush_advance(struct iproto_connection *con,
+		     const struct obuf_svp *end, size_t nwr)
+{
+	struct obuf *obuf = con->wpos.obuf;
+	struct obuf_svp *begin = &con->wpos.svp;
+	struct iproto_splice *splice =
+		iproto_splice_before(iproto_connection_first_splice(con, obuf),
+				     end);
+	iproto_connection_touch(con);
+	struct stailq written;
+	stailq_create(&written);
+	size_t left = nwr;
+	while (left > 0) {
+		const struct obuf_svp *stop = splice != NULL ?
+					      &splice->wpos.svp : end;
+		size_t size = stop->used - begin->used;
+		if (left < size) {
+			/* advance write position */
+			iproto_svp_advance(obuf, begin, left);
+			break;
 		}
-		/* Count statistics */
-		rmean_collect(rmean_net, IPROTO_RECEIVED, nrd);
+		*begin = *stop;
+		left -= size;
+		if (splice == NULL)
+			break;
+		size = splice->size - splice->written;
+		if (left < size) {
+			splice->written += left;
+			break;
+		}
+		left -= size;
+		stailq_shift(&con->splices);
+		stailq_add_tail_entry(&written, splice, in_list);
+		splice = iproto_connection_first_splice(con, obuf);
+	}
+	iproto_thread_release_splices(con->iproto_thread, &written);
+}
 
-		/* Update the read position and connection state. */
-		in->wpos += nrd;
-		con->parse_size += nrd;
-		/* Enqueue all requests which are fully read up. */
-		if (iproto_enqueue_batch(con, in) != 0)
-			diag_raise();
-	} catch (Exception *e) {
-		/* Best effort at sending the error message to the client. */
-		iproto_write_error(fd, e, ::schema_version, 0);
-		e->log();
+/** Completion of a write queued to io_uring. */
+static void
+iproto_connection_on_write(struct uring_op *op, int res)
+{
+	struct iproto_connection *con =
+		container_of(op, struct iproto_connection, write_op);
+	if (res < 0) {
+		if (sio_wouldblock(-res)) {
+			ev_io_start(con->loop, &con->output);
+			return;
+		}
+		errno = -res;
+		say_syserror("%s: sendmsg", sio_socketname(con->output.fd));
 		iproto_connection_close(con);
+		return;
+	}
+	rmean_collect(con->iproto_thread->rmean, IPROTO_SENT, res);
+	iproto_flush_advance(con, &con->write_end, res);
+	if ((size_t) res < con->write_size) {
+		ev_io_start(con->loop, &con->output);
+		return;
 	}
+	/* Continue flushing as iproto_connection_on_output() does. */
+	if (! ev_is_active(&con->input) && rlist_empty(&con->in_stop_list))
+		ev_feed_event(con->loop, &con->input, EV_READ);
+	ev_feed_event(con->loop, &con->output, EV_WRITE);
 }
 
-/** writev() to the socket and handle the result. */
+/**
+ * writev() to the socket and handle the result. The output
+ * buffer data is interleaved with the data of splices. If the
+ * connection is compressed, the data is compressed first.
+ * Returns 0 if the output is written entirely, 1 if there is
+ * nothing to write, -1 if the socket is not ready, 2 if the
+ * write is queued to io_uring or is in progress.
+ */
 
 static int
 iproto_flush(struct iproto_connection *con)
 {
 	int fd = con->output.fd;
+	if (uring_op_is_busy(&con->write_op))
+		return 2;
+	if (ibuf_used(&con->zobuf) != 0)
+		return iproto_connection_write_zout(con);
+	if (con->is_zout_pending &&
+	    con->wpos.obuf == con->zout_start.obuf &&
+	    con->wpos.svp.used == con->zout_start.svp.used) {
+		/* The reply to IPROTO_COMPRESS is written. */
+		con->is_zout_pending = false;
+	}
+	bool is_compressed = con->zout != NULL && !con->is_zout_pending;
+	const struct iproto_wpos *wend = con->is_zout_pending ?
+					 &con->zout_start : &con->wend;
 	struct obuf *obuf = con->wpos.obuf;
 	struct obuf_svp obuf_end = obuf_create_svp(obuf);
 	struct obuf_svp *begin = &con->wpos.svp;
-	struct obuf_svp *end = &con->wend.svp;
-	if (con->wend.obuf != obuf) {
+	const struct obuf_svp *end = &wend->svp;
+	struct iproto_splice *splice =
+		iproto_connection_first_splice(con, obuf);
+	if (wend->obuf != obuf) {
 		/*
 		 * Flush the current buffer before
 		 * advancing to the next one.
 		 */
-		if (begin->used == obuf_end.used) {
-			obuf = con->wpos.obuf = con->wend.obuf;
+		if (begin->used == obuf_end.used && splice == NULL) {
+			obuf = con->wpos.obuf = wend->obuf;
 			obuf_svp_reset(begin);
+			splice = iproto_connection_first_splice(con, obuf);
 		} else {
 			end = &obuf_end;
 		}
 	}
-	if (begin->used == end->used) {
+	splice = iproto_splice_before(splice, end);
+	if (begin->used == end->used && splice == NULL) {
 		/* Nothing to do. */
 		return 1;
 	}
-	assert(begin->used < end->used);
-	struct iovec iov[SMALL_OBUF_IOV_MAX+1];
+	assert(begin->used <= end->used);
+	struct iovec iov[SMALL_OBUF_IOV_MAX + 1 + 2 * IPROTO_SPLICE_IOV_MAX];
 	struct iovec *src = obuf->iov;
-	int iovcnt = end->pos - begin->pos + 1;
+	int iovcnt = 0;
+	size_t total = 0;
 	/*
-	 * iov[i].iov_len may be concurrently modified in tx thread,
-	 * but only for the last position.
+	 * Collect the buffer data up to the next splice, the
+	 * splice data, and so on till the end of the output.
 	 */
-	memcpy(iov, src + begin->pos, iovcnt * sizeof(struct iovec));
-	sio_add_to_iov(iov, -begin->iov_len);
-	/* *Overwrite* iov_len of the last pos as it may be garbage. */
-	iov[iovcnt-1].iov_len = end->iov_len - begin->iov_len * (iovcnt == 1);
+	struct obuf_svp pos = *begin;
+	struct iproto_splice *next = splice;
+	while (iovcnt + SMALL_OBUF_IOV_MAX + 2 <= (int) lengthof(iov)) {
+		const struct obuf_svp *stop = next != NULL ?
+					      &next->wpos.svp : end;
+		if (pos.used < stop->used) {
+			int cnt = stop->pos - pos.pos + 1;
+			struct iovec *dst = iov + iovcnt;
+			/*
+			 * iov[i].iov_len may be concurrently modified
+			 * in tx thread, but only for the last position.
+			 */
+			memcpy(dst, src + pos.pos, cnt * sizeof(struct iovec));
+			sio_add_to_iov(dst, -pos.iov_len);
+			/*
+			 * *Overwrite* iov_len of the last pos as it
+			 * may be garbage.
+			 */
+			dst[cnt - 1].iov_len = stop->iov_len -
+					       pos.iov_len * (cnt == 1);
+			iovcnt += cnt;
+			total += stop->used - pos.used;
+			pos = *stop;
+		}
+		if (next == NULL)
+			break;
+		size_t written = next == splice ? next->written : 0;
+		iov[iovcnt].iov_base = (char *) next->data + written;
+		iov[iovcnt].iov_len = next->size - written;
+		total += next->size - written;
+		iovcnt++;
+		next = iproto_splice_before(iproto_splice_next(next), end);
+	}
 
-	ssize_t nwr = sio_writev(fd, iov, iovcnt);
+	ssize_t nwr;
+	struct iproto_thread *thread = con->iproto_thread;
+	if (is_compressed) {
+		iproto_connection_compress(con, iov, iovcnt);
+		nwr = total;
+	} else if (thread->is_uring_enabled && con->shm == NULL &&
+		   uring_sendmsg(&thread->uring, &con->write_op, fd, iov,
+				 iovcnt, iproto_connection_on_write) == 0) {
+		con->write_end = *end;
+		con->write_size = total;
+		return 2;
+	} else {
+		nwr = iproto_connection_sendv(con, iov, iovcnt);
+		/* Count statistics */
+		if (nwr > 0) {
+			rmean_collect(con->iproto_thread->rmean, IPROTO_SENT,
+				      nwr);
+		}
+	}
 
 	if (nwr > 0) {
-		/* Count statistics */
-		rmean_collect(rmean_net, IPROTO_SENT, nwr);
-		if (begin->used + nwr == end->used) {
-			*begin = *end;
+		iproto_flush_advance(con, end, nwr);
+		if ((size_t) nwr == total)
 			return 0;
-		}
-		size_t offset = 0;
-		int advance = 0;
-		advance = sio_move_iov(iov, nwr, &offset);
-		begin->used += nwr;             /* advance write position */
-		begin->iov_len = advance == 0 ? begin->iov_len + offset: offset;
-		begin->pos += advance;
-		assert(begin->pos <= end->pos);
 	} else if (nwr < 0 && ! sio_wouldblock(errno)) {
 		diag_raise();
 	}
@@ -1082,8 +2324,19 @@ iproto_connection_on_output(ev_loop *loop, struct ev_io *watcher,
 				ev_feed_event(loop, &con->input, EV_READ);
 			}
 		}
+		/* The write completion continues the flush. */
+		if (rc == 2)
+			return;
 		if (ev_is_active(&con->output))
 			ev_io_stop(con->loop, &con->output);
+		if (con->flush_time != 0) {
+			/* The output is flushed, end the sample. */
+			struct iproto_thread *thread = con->iproto_thread;
+			uint32_t type = con->flush_type;
+			latency_collect(&thread->flush_latency[type],
+					clock_monotonic() - con->flush_time);
+			con->flush_time = 0;
+		}
 	} catch (Exception *e) {
 		e->log();
 		iproto_connection_close(con);
@@ -1091,10 +2344,10 @@ iproto_connection_on_output(ev_loop *loop, struct ev_io *watcher,
 }
 
 static struct iproto_connection *
-iproto_connection_new(int fd)
+iproto_connection_new(struct iproto_thread *iproto_thread, int fd)
 {
 	struct iproto_connection *con = (struct iproto_connection *)
-		mempool_alloc(&iproto_connection_pool);
+		mempool_alloc(&iproto_thread->iproto_connection_pool);
 	if (con == NULL) {
 		diag_set(OutOfMemory, sizeof(*con), "mempool_alloc", "con");
 		return NULL;
@@ -1103,10 +2356,14 @@ iproto_connection_new(int fd)
 	con->loop = loop();
 	ev_io_init(&con->input, iproto_connection_on_input, fd, EV_READ);
 	ev_io_init(&con->output, iproto_connection_on_output, fd, EV_WRITE);
-	ibuf_create(&con->ibuf[0], cord_slab_cache(), iproto_readahead);
-	ibuf_create(&con->ibuf[1], cord_slab_cache(), iproto_readahead);
-	obuf_create(&con->obuf[0], &net_slabc, iproto_readahead);
-	obuf_create(&con->obuf[1], &net_slabc, iproto_readahead);
+	ibuf_create(&con->ibuf[0], &iproto_thread->ibuf_slabc,
+		    iproto_readahead);
+	ibuf_create(&con->ibuf[1], &iproto_thread->ibuf_slabc,
+		    iproto_readahead);
+	obuf_create(&con->obuf[0], &iproto_thread->net_slabc,
+		    iproto_readahead);
+	obuf_create(&con->obuf[1], &iproto_thread->net_slabc,
+		    iproto_readahead);
 	con->p_ibuf = &con->ibuf[0];
 	con->tx.p_obuf = &con->obuf[0];
 	iproto_wpos_create(&con->wpos, con->tx.p_obuf);
@@ -1114,14 +2371,31 @@ iproto_connection_new(int fd)
 	con->parse_size = 0;
 	con->long_poll_count = 0;
 	con->session = NULL;
+	con->iproto_thread = iproto_thread;
 	rlist_create(&con->in_stop_list);
+	con->is_critical_user = false;
+	rlist_create(&con->in_active_list);
+	con->release_msg.is_sent = false;
 	/* It may be very awkward to allocate at close. */
-	cmsg_init(&con->destroy_msg, destroy_route);
-	cmsg_init(&con->disconnect_msg, disconnect_route);
+	cmsg_init(&con->destroy_msg, iproto_thread->destroy_route);
+	cmsg_init(&con->disconnect_msg, iproto_thread->disconnect_route);
 	con->state = IPROTO_CONNECTION_ALIVE;
+	con->flush_time = 0;
+	stailq_create(&con->splices);
+	con->zin = NULL;
+	con->zout = NULL;
+	ibuf_create(&con->zibuf, &iproto_thread->ibuf_slabc,
+		    iproto_readahead);
+	ibuf_create(&con->zobuf, &iproto_thread->ibuf_slabc,
+		    iproto_readahead);
+	con->is_zin_full = false;
+	con->is_zout_pending = false;
+	uring_op_create(&con->read_op);
+	uring_op_create(&con->write_op);
+	con->shm = NULL;
 	con->tx.is_push_pending = false;
 	con->tx.is_push_sent = false;
-	rmean_collect(rmean_net, IPROTO_CONNECTIONS, 1);
+	rmean_collect(iproto_thread->rmean, IPROTO_CONNECTIONS, 1);
 	return con;
 }
 
@@ -1140,11 +2414,16 @@ iproto_connection_delete(struct iproto_connection *con)
 	 */
 	ibuf_destroy(&con->ibuf[0]);
 	ibuf_destroy(&con->ibuf[1]);
+	ibuf_destroy(&con->zibuf);
+	ibuf_destroy(&con->zobuf);
+	ZSTD_freeDStream(con->zin);
+	ZSTD_freeCStream(con->zout);
+	free(con->shm);
 	assert(con->obuf[0].pos == 0 &&
 	       con->obuf[0].iov[0].iov_base == NULL);
 	assert(con->obuf[1].pos == 0 &&
 	       con->obuf[1].iov[0].iov_base == NULL);
-	mempool_free(&iproto_connection_pool, con);
+	mempool_free(&con->iproto_thread->iproto_connection_pool, con);
 }
 
 /* }}} iproto_connection */
@@ -1160,6 +2439,9 @@ tx_process_call(struct cmsg *msg);
 static void
 tx_process1(struct cmsg *msg);
 
+static void
+tx_process_batch(struct cmsg *msg);
+
 static void
 tx_process_select(struct cmsg *msg);
 
@@ -1178,6 +2460,9 @@ net_send_msg(struct cmsg *msg);
 static void
 net_send_error(struct cmsg *msg);
 
+static void
+net_send_compress(struct cmsg *msg);
+
 static void
 tx_process_replication(struct cmsg *msg);
 
@@ -1187,67 +2472,94 @@ net_end_join(struct cmsg *msg);
 static void
 net_end_subscribe(struct cmsg *msg);
 
-static const struct cmsg_hop misc_route[] = {
-	{ tx_process_misc, &net_pipe },
-	{ net_send_msg, NULL },
-};
-
-static const struct cmsg_hop call_route[] = {
-	{ tx_process_call, &net_pipe },
-	{ net_send_msg, NULL },
-};
-
-static const struct cmsg_hop select_route[] = {
-	{ tx_process_select, &net_pipe },
-	{ net_send_msg, NULL },
-};
-
-static const struct cmsg_hop process1_route[] = {
-	{ tx_process1, &net_pipe },
-	{ net_send_msg, NULL },
-};
-
-static const struct cmsg_hop sql_route[] = {
-	{ tx_process_sql, &net_pipe },
-	{ net_send_msg, NULL },
-};
-
-static const struct cmsg_hop *dml_route[IPROTO_TYPE_STAT_MAX] = {
-	NULL,                                   /* IPROTO_OK */
-	select_route,                           /* IPROTO_SELECT */
-	process1_route,                         /* IPROTO_INSERT */
-	process1_route,                         /* IPROTO_REPLACE */
-	process1_route,                         /* IPROTO_UPDATE */
-	process1_route,                         /* IPROTO_DELETE */
-	call_route,                             /* IPROTO_CALL_16 */
-	misc_route,                             /* IPROTO_AUTH */
-	call_route,                             /* IPROTO_EVAL */
-	process1_route,                         /* IPROTO_UPSERT */
-	call_route,                             /* IPROTO_CALL */
-	sql_route,                              /* IPROTO_EXECUTE */
-	NULL,                                   /* IPROTO_NOP */
-	sql_route,                              /* IPROTO_PREPARE */
-};
+static void
+tx_process_connect(struct cmsg *m);
 
-static const struct cmsg_hop join_route[] = {
-	{ tx_process_replication, &net_pipe },
-	{ net_end_join, NULL },
-};
+static void
+net_send_greeting(struct cmsg *m);
 
-static const struct cmsg_hop subscribe_route[] = {
-	{ tx_process_replication, &net_pipe },
-	{ net_end_subscribe, NULL },
-};
+/**
+ * Initialize a two-hop route: the message is delivered to
+ * @a first, then travels through @a pipe and is delivered to
+ * @a second.
+ */
+static inline void
+iproto_route_create(struct cmsg_hop *route, cmsg_f first, struct cpipe *pipe,
+		    cmsg_f second)
+{
+	route[0].f = first;
+	route[0].pipe = pipe;
+	route[1].f = second;
+	route[1].pipe = NULL;
+}
 
-static const struct cmsg_hop error_route[] = {
-	{ tx_reply_iproto_error, &net_pipe },
-	{ net_send_error, NULL },
-};
+/** Initialize message routes of a network thread. */
+static void
+iproto_thread_init_routes(struct iproto_thread *iproto_thread)
+{
+	struct cpipe *net_pipe = &iproto_thread->net_pipe;
+	struct cpipe *tx_pipe = &iproto_thread->tx_pipe;
+	iproto_route_create(iproto_thread->destroy_route,
+			    tx_process_destroy, net_pipe, net_finish_destroy);
+	iproto_route_create(iproto_thread->disconnect_route,
+			    tx_process_disconnect, net_pipe,
+			    net_finish_disconnect);
+	iproto_route_create(iproto_thread->push_route,
+			    iproto_process_push, tx_pipe, tx_end_push);
+	iproto_route_create(iproto_thread->misc_route,
+			    tx_process_misc, net_pipe, net_send_msg);
+	iproto_route_create(iproto_thread->call_route,
+			    tx_process_call, net_pipe, net_send_msg);
+	iproto_route_create(iproto_thread->select_route,
+			    tx_process_select, net_pipe, net_send_msg);
+	iproto_route_create(iproto_thread->process1_route,
+			    tx_process1, net_pipe, net_send_msg);
+	iproto_route_create(iproto_thread->batch_route,
+			    tx_process_batch, net_pipe, net_send_msg);
+	iproto_route_create(iproto_thread->sql_route,
+			    tx_process_sql, net_pipe, net_send_msg);
+	iproto_route_create(iproto_thread->join_route,
+			    tx_process_replication, net_pipe, net_end_join);
+	iproto_route_create(iproto_thread->subscribe_route,
+			    tx_process_replication, net_pipe,
+			    net_end_subscribe);
+	iproto_route_create(iproto_thread->error_route,
+			    tx_reply_iproto_error, net_pipe, net_send_error);
+	iproto_route_create(iproto_thread->connect_route,
+			    tx_process_connect, net_pipe, net_send_greeting);
+	iproto_route_create(iproto_thread->splice_route,
+			    tx_release_splices, net_pipe,
+			    net_end_release_splices);
+	iproto_route_create(iproto_thread->compress_route,
+			    tx_process_misc, net_pipe, net_send_compress);
+	iproto_route_create(iproto_thread->release_route,
+			    tx_release_buffers, net_pipe,
+			    net_end_release_buffers);
+
+	const struct cmsg_hop **dml_route = iproto_thread->dml_route;
+	memset(dml_route, 0, sizeof(iproto_thread->dml_route));
+	dml_route[IPROTO_SELECT] = iproto_thread->select_route;
+	dml_route[IPROTO_INSERT] = iproto_thread->process1_route;
+	dml_route[IPROTO_REPLACE] = iproto_thread->process1_route;
+	dml_route[IPROTO_UPDATE] = iproto_thread->process1_route;
+	dml_route[IPROTO_DELETE] = iproto_thread->process1_route;
+	dml_route[IPROTO_CALL_16] = iproto_thread->call_route;
+	dml_route[IPROTO_AUTH] = iproto_thread->misc_route;
+	dml_route[IPROTO_EVAL] = iproto_thread->call_route;
+	dml_route[IPROTO_UPSERT] = iproto_thread->process1_route;
+	dml_route[IPROTO_CALL] = iproto_thread->call_route;
+	dml_route[IPROTO_EXECUTE] = iproto_thread->sql_route;
+	dml_route[IPROTO_PREPARE] = iproto_thread->sql_route;
+	dml_route[IPROTO_BATCH] = iproto_thread->batch_route;
+}
 
 static void
 iproto_msg_decode(struct iproto_msg *msg, const char **pos, const char *reqend,
 		  bool *stop_input)
 {
+	struct iproto_connection *con = msg->connection;
+	struct iproto_thread *iproto_thread = con->iproto_thread;
+	struct compress_request compress;
 	uint8_t type;
 
 	if (xrow_header_decode(&msg->header, pos, reqend, true))
@@ -1271,43 +2583,65 @@ iproto_msg_decode(struct iproto_msg *msg, const char **pos, const char *reqend,
 		if (xrow_decode_dml(&msg->header, &msg->dml,
 				    dml_request_key_map(type)))
 			goto error;
-		assert(type < sizeof(dml_route)/sizeof(*dml_route));
-		cmsg_init(&msg->base, dml_route[type]);
+		assert(type < IPROTO_TYPE_STAT_MAX);
+		cmsg_init(&msg->base, iproto_thread->dml_route[type]);
 		break;
 	case IPROTO_CALL_16:
 	case IPROTO_CALL:
 	case IPROTO_EVAL:
 		if (xrow_decode_call(&msg->header, &msg->call))
 			goto error;
-		cmsg_init(&msg->base, call_route);
+		cmsg_init(&msg->base, iproto_thread->call_route);
 		break;
 	case IPROTO_EXECUTE:
 	case IPROTO_PREPARE:
 		if (xrow_decode_sql(&msg->header, &msg->sql) != 0)
 			goto error;
-		cmsg_init(&msg->base, sql_route);
+		cmsg_init(&msg->base, iproto_thread->sql_route);
+		break;
+	case IPROTO_BATCH:
+		if (xrow_decode_batch(&msg->header, &msg->batch) != 0)
+			goto error;
+		cmsg_init(&msg->base, iproto_thread->batch_route);
 		break;
 	case IPROTO_PING:
-		cmsg_init(&msg->base, misc_route);
+		cmsg_init(&msg->base, iproto_thread->misc_route);
 		break;
 	case IPROTO_JOIN:
 	case IPROTO_FETCH_SNAPSHOT:
 	case IPROTO_REGISTER:
-		cmsg_init(&msg->base, join_route);
-		*stop_input = true;
-		break;
 	case IPROTO_SUBSCRIBE:
-		cmsg_init(&msg->base, subscribe_route);
+		/* Relay writes to the socket bypassing iproto. */
+		if (con->zin != NULL) {
+			diag_set(ClientError, ER_UNSUPPORTED,
+				 "Compressed connection", "replication");
+			goto error;
+		}
+		if (con->shm != NULL) {
+			diag_set(ClientError, ER_UNSUPPORTED,
+				 "Shared memory connection", "replication");
+			goto error;
+		}
+		cmsg_init(&msg->base, type == IPROTO_SUBSCRIBE ?
+			  iproto_thread->subscribe_route :
+			  iproto_thread->join_route);
 		*stop_input = true;
 		break;
 	case IPROTO_VOTE_DEPRECATED:
 	case IPROTO_VOTE:
-		cmsg_init(&msg->base, misc_route);
+		cmsg_init(&msg->base, iproto_thread->misc_route);
 		break;
 	case IPROTO_AUTH:
 		if (xrow_decode_auth(&msg->header, &msg->auth))
 			goto error;
-		cmsg_init(&msg->base, misc_route);
+		cmsg_init(&msg->base, iproto_thread->misc_route);
+		break;
+	case IPROTO_COMPRESS:
+		if (xrow_decode_compress(&msg->header, &compress) != 0 ||
+		    iproto_connection_start_decompression(con,
+							  &compress) != 0)
+			goto error;
+		cmsg_init(&msg->base, iproto_thread->compress_route);
 		break;
 	default:
 		diag_set(ClientError, ER_UNKNOWN_REQUEST_TYPE,
@@ -1320,7 +2654,30 @@ error:
 	diag_log();
 	diag_create(&msg->diag);
 	diag_move(&fiber()->diag, &msg->diag);
-	cmsg_init(&msg->base, error_route);
+	cmsg_init(&msg->base, iproto_thread->error_route);
+}
+
+/**
+ * Reply to a request with ER_REQUEST_OVERLOAD without executing
+ * it, when the quota of the request class is exhausted and
+ * box.cfg.iproto_reject_overload is set. Only the header is
+ * decoded to get the sync of the reply.
+ */
+static void
+iproto_msg_reject(struct iproto_msg *msg, const char **pos, const char *reqend,
+		  enum iproto_msg_class msg_class)
+{
+	struct iproto_thread *iproto_thread = msg->connection->iproto_thread;
+	if (xrow_header_decode(&msg->header, pos, reqend, true) == 0) {
+		diag_set(ClientError, ER_REQUEST_OVERLOAD,
+			 iproto_msg_class_strs[msg_class]);
+		rmean_collect(iproto_thread->rmean, IPROTO_REJECTED, 1);
+	} else {
+		diag_log();
+	}
+	diag_create(&msg->diag);
+	diag_move(&fiber()->diag, &msg->diag);
+	cmsg_init(&msg->base, iproto_thread->error_route);
 }
 
 static void
@@ -1345,6 +2702,28 @@ tx_fiber_init(struct session *session, uint64_t sync)
 	 */
 	fiber_set_session(f, session);
 	fiber_set_user(f, &session->credentials);
+	f->storage.net.wal_time = 0;
+}
+
+/**
+ * Return true if the requests of the session user are critical,
+ * see box.cfg.iproto_critical_users.
+ */
+static bool
+tx_session_is_critical(struct session *session)
+{
+	if (iproto_critical_user_count == 0)
+		return false;
+	struct user *user = user_by_id(session->credentials.uid);
+	if (user == NULL)
+		return false;
+	const char *name = iproto_critical_users;
+	for (int i = 0; i < iproto_critical_user_count; i++) {
+		if (strcmp(name, user->def->name) == 0)
+			return true;
+		name += strlen(name) + 1;
+	}
+	return false;
 }
 
 static void
@@ -1436,7 +2815,8 @@ tx_discard_input(struct iproto_msg *msg)
 		{ net_discard_input, NULL },
 	};
 	cmsg_init(&msg->discard_input, discard_input_route);
-	cpipe_push(&net_pipe, &msg->discard_input);
+	cpipe_push(&msg->connection->iproto_thread->net_pipe,
+		   &msg->discard_input);
 }
 
 /**
@@ -1482,11 +2862,35 @@ static inline struct iproto_msg *
 tx_accept_msg(struct cmsg *m)
 {
 	struct iproto_msg *msg = (struct iproto_msg *) m;
+	msg->tx_time = clock_monotonic();
 	tx_accept_wpos(msg->connection, &msg->wpos);
 	tx_fiber_init(msg->connection->session, msg->header.sync);
 	return msg;
 }
 
+/**
+ * Advance write position to the end of the reply and account
+ * the request time in net queue, tx and WAL in the latency
+ * stats.
+ */
+static inline void
+tx_end_msg(struct iproto_msg *msg, struct obuf *out)
+{
+	iproto_wpos_create(&msg->wpos, out);
+	uint32_t type = msg->header.type;
+	if (type >= IPROTO_TYPE_STAT_MAX)
+		return;
+	struct latency *latency = tx_latency[type];
+	double wal_time = fiber()->storage.net.wal_time;
+	double tx_time = clock_monotonic() - msg->tx_time - wal_time;
+	latency_collect(&latency[IPROTO_PHASE_NET],
+			msg->tx_time - msg->recv_time);
+	latency_collect(&latency[IPROTO_PHASE_TX], tx_time);
+	/* Do not dilute WAL latency with requests not writing it. */
+	if (wal_time > 0)
+		latency_collect(&latency[IPROTO_PHASE_WAL], wal_time);
+}
+
 /**
  * Write error message to the output buffer and advance
  * write position. Doesn't throw.
@@ -1497,7 +2901,7 @@ tx_reply_error(struct iproto_msg *msg)
 	struct obuf *out = msg->connection->tx.p_obuf;
 	iproto_reply_error(out, diag_last_error(&fiber()->diag),
 			   msg->header.sync, ::schema_version);
-	iproto_wpos_create(&msg->wpos, out);
+	tx_end_msg(msg, out);
 }
 
 /**
@@ -1511,7 +2915,7 @@ tx_reply_iproto_error(struct cmsg *m)
 	struct obuf *out = msg->connection->tx.p_obuf;
 	iproto_reply_error(out, diag_last_error(&msg->diag),
 			   msg->header.sync, ::schema_version);
-	iproto_wpos_create(&msg->wpos, out);
+	tx_end_msg(msg, out);
 }
 
 /** Inject a short delay on tx request processing for testing. */
@@ -1524,30 +2928,234 @@ tx_inject_delay()
 	});
 }
 
-static void
-tx_process1(struct cmsg *m)
+static void
+tx_process1(struct cmsg *m)
+{
+	struct iproto_msg *msg = tx_accept_msg(m);
+	if (tx_check_schema(msg->header.schema_version))
+		goto error;
+
+	struct tuple *tuple;
+	struct obuf_svp svp;
+	struct obuf *out;
+	tx_inject_delay();
+	if (box_process1(&msg->dml, &tuple) != 0)
+		goto error;
+	out = msg->connection->tx.p_obuf;
+	if (iproto_prepare_select(out, &svp) != 0)
+		goto error;
+	if (tuple && tuple_to_obuf(tuple, out))
+		goto error;
+	iproto_reply_select(out, &svp, msg->header.sync, ::schema_version,
+			    tuple != 0);
+	tx_end_msg(msg, out);
+	return;
+error:
+	tx_reply_error(msg);
+}
+
+static void
+tx_process_batch(struct cmsg *m)
+{
+	struct iproto_msg *msg = tx_accept_msg(m);
+	struct batch_request *req = &msg->batch;
+	struct tuple **results;
+	struct obuf_svp svp;
+	struct obuf *out;
+	uint32_t i;
+	if (tx_check_schema(msg->header.schema_version))
+		goto error;
+
+	tx_inject_delay();
+	results = (struct tuple **)
+		region_alloc(&fiber()->gc, sizeof(*results) * req->stmt_count);
+	if (results == NULL) {
+		diag_set(OutOfMemory, sizeof(*results) * req->stmt_count,
+			 "region_alloc", "results");
+		goto error;
+	}
+	if (box_process_batch(req, results) != 0)
+		goto error;
+	out = msg->connection->tx.p_obuf;
+	if (iproto_prepare_select(out, &svp) != 0)
+		goto error_unref;
+	/* A result of each statement: a tuple or nil. */
+	for (i = 0; i < req->stmt_count; i++) {
+		if (results[i] != NULL) {
+			if (tuple_to_obuf(results[i], out) != 0)
+				goto error_rollback;
+		} else {
+			char *nil = (char *) obuf_alloc(out, mp_sizeof_nil());
+			if (nil == NULL) {
+				diag_set(OutOfMemory, mp_sizeof_nil(),
+					 "obuf_alloc", "nil");
+				goto error_rollback;
+			}
+			mp_encode_nil(nil);
+		}
+	}
+	iproto_reply_select(out, &svp, msg->header.sync, ::schema_version,
+			    req->stmt_count);
+	tx_end_msg(msg, out);
+	for (i = 0; i < req->stmt_count; i++) {
+		if (results[i] != NULL)
+			tuple_unref(results[i]);
+	}
+	fiber_gc();
+	return;
+error_rollback:
+	/* Discard the prepared select. */
+	obuf_rollback_to_svp(out, &svp);
+error_unref:
+	for (i = 0; i < req->stmt_count; i++) {
+		if (results[i] != NULL)
+			tuple_unref(results[i]);
+	}
+error:
+	fiber_gc();
+	tx_reply_error(msg);
+}
+
+/**
+ * Dump SELECT result tuples to the output buffer. Big tuples
+ * are not copied: a splice is added to @a splices instead.
+ * Returns the number of tuples or -1 on error. @a spliced_size
+ * is set to the total size of the spliced data.
+ */
+static int
+tx_dump_select(struct port *base, struct obuf *out,
+	       struct stailq *splices, size_t *spliced_size)
+{
+	struct port_tuple *port = port_tuple(base);
+	struct port_tuple_entry *pe;
+	*spliced_size = 0;
+	for (pe = port->first; pe != NULL; pe = pe->next) {
+		uint32_t size;
+		const char *data = tuple_data_range(pe->tuple, &size);
+		ERROR_INJECT(ERRINJ_PORT_DUMP, {
+			diag_set(OutOfMemory, size, "obuf_dup", "data");
+			return -1;
+		});
+		if (size < IPROTO_SPLICE_SIZE_MIN) {
+			if (obuf_dup(out, data, size) != size) {
+				diag_set(OutOfMemory, size, "obuf_dup",
+					 "data");
+				return -1;
+			}
+			continue;
+		}
+		struct iproto_splice *splice = (struct iproto_splice *)
+			mempool_alloc(&iproto_splice_pool);
+		if (splice == NULL) {
+			diag_set(OutOfMemory, sizeof(*splice),
+				 "mempool_alloc", "splice");
+			return -1;
+		}
+		iproto_wpos_create(&splice->wpos, out);
+		splice->tuple = pe->tuple;
+		tuple_ref(splice->tuple);
+		splice->data = data;
+		splice->size = size;
+		splice->written = 0;
+		stailq_add_tail_entry(splices, splice, in_list);
+		*spliced_size += size;
+	}
+	return port->size;
+}
+
+/**
+ * Check a SELECT projection: every field must be a field number
+ * or a non-empty JSON path.
+ */
+static int
+tx_check_select_fields(const struct request *req)
+{
+	const char *pos = req->fields;
+	uint32_t count = mp_decode_array(&pos);
+	for (uint32_t i = 0; i < count; i++) {
+		uint32_t len;
+		switch (mp_typeof(*pos)) {
+		case MP_UINT:
+			mp_next(&pos);
+			continue;
+		case MP_STR:
+			mp_decode_str(&pos, &len);
+			if (len > 0)
+				continue;
+			break;
+		default:
+			break;
+		}
+		diag_set(ClientError, ER_ILLEGAL_PARAMS, "projection field "
+			 "must be a field number or a JSON path");
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * Find a field of a SELECT projection in a tuple and advance
+ * @a pos past the field description. Returns NULL if the tuple
+ * has no such field.
+ */
+static const char *
+tx_select_field(struct tuple *tuple, const char **pos, int index_base)
+{
+	if (mp_typeof(**pos) == MP_UINT) {
+		uint64_t fieldno = mp_decode_uint(pos);
+		if (fieldno < (uint64_t) index_base ||
+		    fieldno - index_base > UINT32_MAX)
+			return NULL;
+		return tuple_field(tuple, fieldno - index_base);
+	}
+	uint32_t len;
+	const char *path = mp_decode_str(pos, &len);
+	return tuple_field_raw_by_full_path(tuple_format(tuple),
+					    tuple_data(tuple),
+					    tuple_field_map(tuple), path, len,
+					    field_name_hash(path, len));
+}
+
+/**
+ * Dump SELECT result tuples projected to the fields requested
+ * in IPROTO_FIELDS: every tuple is encoded as an array of the
+ * fields, a missing field is nil. Returns the number of tuples
+ * or -1 on error.
+ */
+static int
+tx_dump_select_fields(struct port *base, struct obuf *out,
+		      const struct request *req)
 {
-	struct iproto_msg *msg = tx_accept_msg(m);
-	if (tx_check_schema(msg->header.schema_version))
-		goto error;
-
-	struct tuple *tuple;
-	struct obuf_svp svp;
-	struct obuf *out;
-	tx_inject_delay();
-	if (box_process1(&msg->dml, &tuple) != 0)
-		goto error;
-	out = msg->connection->tx.p_obuf;
-	if (iproto_prepare_select(out, &svp) != 0)
-		goto error;
-	if (tuple && tuple_to_obuf(tuple, out))
-		goto error;
-	iproto_reply_select(out, &svp, msg->header.sync, ::schema_version,
-			    tuple != 0);
-	iproto_wpos_create(&msg->wpos, out);
-	return;
+	struct port_tuple *port = port_tuple(base);
+	const char *fields = req->fields;
+	uint32_t field_count = mp_decode_array(&fields);
+	char nil[1];
+	mp_encode_nil(nil);
+	size_t size = 0;
+	struct port_tuple_entry *pe;
+	for (pe = port->first; pe != NULL; pe = pe->next) {
+		size = mp_sizeof_array(field_count);
+		char *header = (char *) obuf_alloc(out, size);
+		if (header == NULL)
+			goto error;
+		mp_encode_array(header, field_count);
+		const char *pos = fields;
+		for (uint32_t i = 0; i < field_count; i++) {
+			const char *field = tx_select_field(pe->tuple, &pos,
+							    req->index_base);
+			if (field == NULL)
+				field = nil;
+			const char *field_end = field;
+			mp_next(&field_end);
+			size = field_end - field;
+			if (obuf_dup(out, field, size) != size)
+				goto error;
+		}
+	}
+	return port->size;
 error:
-	tx_reply_error(msg);
+	diag_set(OutOfMemory, size, "obuf_dup", "data");
+	return -1;
 }
 
 static void
@@ -1558,17 +3166,36 @@ tx_process_select(struct cmsg *m)
 	struct obuf_svp svp;
 	struct port port;
 	int count;
+	size_t spliced_size;
+	struct tuple *last;
+	const char *position;
+	uint32_t position_size;
 	int rc;
 	struct request *req = &msg->dml;
 	if (tx_check_schema(msg->header.schema_version))
 		goto error;
+	if (req->fields != NULL && tx_check_select_fields(req) != 0)
+		goto error;
 
 	tx_inject_delay();
 	rc = box_select(req->space_id, req->index_id,
 			req->iterator, req->offset, req->limit,
-			req->key, req->key_end, &port);
+			req->key, req->key_end, req->after_position,
+			req->after_position_end, &port);
 	if (rc < 0)
 		goto error;
+	/* The position is allocated on the fiber region. */
+	position = NULL;
+	if (req->fetch_position && port_tuple(&port)->size > 0) {
+		last = port_tuple(&port)->last->tuple;
+		position = box_index_tuple_position(req->space_id,
+						    req->index_id, last,
+						    &position_size);
+		if (position == NULL) {
+			port_destroy(&port);
+			goto error;
+		}
+	}
 
 	out = msg->connection->tx.p_obuf;
 	if (iproto_prepare_select(out, &svp) != 0) {
@@ -1578,18 +3205,30 @@ tx_process_select(struct cmsg *m)
 	/*
 	 * SELECT output format has not changed since Tarantool 1.6
 	 */
-	count = port_dump_msgpack_16(&port, out);
+	if (req->fields != NULL) {
+		count = tx_dump_select_fields(&port, out, req);
+		spliced_size = 0;
+	} else {
+		count = tx_dump_select(&port, out, &msg->splices,
+				       &spliced_size);
+	}
 	port_destroy(&port);
-	if (count < 0) {
+	if (count < 0 || (position != NULL &&
+			  iproto_reply_select_position(out, position,
+						       position_size) != 0)) {
 		/* Discard the prepared select. */
 		obuf_rollback_to_svp(out, &svp);
+		tx_free_splices(&msg->splices);
 		goto error;
 	}
-	iproto_reply_select(out, &svp, msg->header.sync,
-			    ::schema_version, count);
-	iproto_wpos_create(&msg->wpos, out);
+	iproto_reply_select_spliced(out, &svp, msg->header.sync,
+				    ::schema_version, count, spliced_size,
+				    position != NULL);
+	tx_end_msg(msg, out);
+	fiber_gc();
 	return;
 error:
+	fiber_gc();
 	tx_reply_error(msg);
 }
 
@@ -1677,7 +3316,7 @@ tx_process_call(struct cmsg *m)
 
 	iproto_reply_select(out, &svp, msg->header.sync,
 			    ::schema_version, count);
-	iproto_wpos_create(&msg->wpos, out);
+	tx_end_msg(msg, out);
 	return;
 error:
 	tx_reply_error(msg);
@@ -1697,10 +3336,13 @@ tx_process_misc(struct cmsg *m)
 		switch (msg->header.type) {
 		case IPROTO_AUTH:
 			box_process_auth(&msg->auth, con->salt);
+			msg->is_critical_user =
+				tx_session_is_critical(con->session);
 			iproto_reply_ok_xc(out, msg->header.sync,
 					   ::schema_version);
 			break;
 		case IPROTO_PING:
+		case IPROTO_COMPRESS:
 			iproto_reply_ok_xc(out, msg->header.sync,
 					   ::schema_version);
 			break;
@@ -1717,7 +3359,7 @@ tx_process_misc(struct cmsg *m)
 		default:
 			unreachable();
 		}
-		iproto_wpos_create(&msg->wpos, out);
+		tx_end_msg(msg, out);
 	} catch (Exception *e) {
 		tx_reply_error(msg);
 	}
@@ -1800,7 +3442,7 @@ tx_process_sql(struct cmsg *m)
 	if (is_unprepare) {
 		if (iproto_reply_ok(out, msg->header.sync, schema_version) != 0)
 			goto error;
-		iproto_wpos_create(&msg->wpos, out);
+		tx_end_msg(msg, out);
 		return;
 	}
 	struct obuf_svp header_svp;
@@ -1816,7 +3458,7 @@ tx_process_sql(struct cmsg *m)
 	}
 	port_destroy(&port);
 	iproto_reply_sql(out, &header_svp, msg->header.sync, schema_version);
-	iproto_wpos_create(&msg->wpos, out);
+	tx_end_msg(msg, out);
 	return;
 error:
 	tx_reply_error(msg);
@@ -1880,6 +3522,19 @@ net_send_msg(struct cmsg *m)
 		con->long_poll_count--;
 	}
 	con->wend = msg->wpos;
+	if (msg->header.type == IPROTO_AUTH)
+		con->is_critical_user = msg->is_critical_user;
+	if (! evio_has_fd(&con->output)) {
+		iproto_thread_release_splices(con->iproto_thread,
+					      &msg->splices);
+	} else {
+		stailq_concat(&con->splices, &msg->splices);
+	}
+	if (con->flush_time == 0 &&
+	    msg->header.type < IPROTO_TYPE_STAT_MAX) {
+		con->flush_time = clock_monotonic();
+		con->flush_type = msg->header.type;
+	}
 
 	if (evio_has_fd(&con->output)) {
 		if (! ev_is_active(&con->output))
@@ -1903,6 +3558,30 @@ net_send_error(struct cmsg *m)
 	net_send_msg(m);
 }
 
+/**
+ * Complete sending the reply to IPROTO_COMPRESS: the output
+ * following the reply is compressed.
+ */
+static void
+net_send_compress(struct cmsg *m)
+{
+	struct iproto_msg *msg = (struct iproto_msg *) m;
+	struct iproto_connection *con = msg->connection;
+	if (evio_has_fd(&con->output)) {
+		assert(con->zout == NULL);
+		con->zout = ZSTD_createCStream();
+		if (con->zout == NULL) {
+			say_error("failed to create a compression stream");
+			iproto_connection_close(con);
+		} else {
+			ZSTD_initCStream(con->zout, IPROTO_ZSTD_LEVEL);
+			con->zout_start = msg->wpos;
+			con->is_zout_pending = true;
+		}
+	}
+	net_send_msg(m);
+}
+
 static void
 net_end_join(struct cmsg *m)
 {
@@ -1963,6 +3642,7 @@ tx_process_connect(struct cmsg *m)
 			if (session_run_on_connect_triggers(con->session) != 0)
 				diag_raise();
 		}
+		msg->is_critical_user = tx_session_is_critical(con->session);
 		iproto_wpos_create(&msg->wpos, out);
 	} catch (Exception *e) {
 		tx_reply_error(msg);
@@ -1981,12 +3661,13 @@ net_send_greeting(struct cmsg *m)
 	struct iproto_connection *con = msg->connection;
 	if (msg->close_connection) {
 		struct obuf *out = msg->wpos.obuf;
-		int64_t nwr = sio_writev(con->output.fd, out->iov,
-					 obuf_iovcnt(out));
+		int64_t nwr = iproto_connection_sendv(con, out->iov,
+						      obuf_iovcnt(out));
 
 		if (nwr > 0) {
 			/* Count statistics. */
-			rmean_collect(rmean_net, IPROTO_SENT, nwr);
+			rmean_collect(con->iproto_thread->rmean, IPROTO_SENT,
+				      nwr);
 		} else if (nwr < 0 && ! sio_wouldblock(errno)) {
 			diag_log();
 		}
@@ -1996,6 +3677,7 @@ net_send_greeting(struct cmsg *m)
 		return;
 	}
 	con->wend = msg->wpos;
+	con->is_critical_user = msg->is_critical_user;
 	/*
 	 * Connect is synchronous, so no one could have been
 	 * messing up with the connection while it was in
@@ -2007,89 +3689,189 @@ net_send_greeting(struct cmsg *m)
 	iproto_msg_delete(msg);
 }
 
-static const struct cmsg_hop connect_route[] = {
-	{ tx_process_connect, &net_pipe },
-	{ net_send_greeting, NULL },
-};
-
 /** }}} */
 
 /**
- * Create a connection and start input.
+ * Send the connect message of a new connection to tx. The
+ * input is started when the greeting is sent.
  */
 static int
-iproto_on_accept(struct evio_service * /* service */, int fd,
-		 struct sockaddr *addr, socklen_t addrlen)
+iproto_connection_start(struct iproto_connection *con)
 {
-	(void) addr;
-	(void) addrlen;
-	struct iproto_msg *msg;
-	struct iproto_connection *con = iproto_connection_new(fd);
-	if (con == NULL)
-		return -1;
+	struct iproto_thread *iproto_thread = con->iproto_thread;
 	/*
 	 * Ignore msg allocation failure - the queue size is
 	 * fixed so there is a limited number of msgs in
 	 * use, all stored in just a few blocks of the memory pool.
 	 */
-	msg = iproto_msg_new(con);
-	if (msg == NULL) {
-		mempool_free(&iproto_connection_pool, con);
+	struct iproto_msg *msg = iproto_msg_new(con, iproto_msg_class_MAX);
+	if (msg == NULL)
 		return -1;
-	}
-	cmsg_init(&msg->base, connect_route);
+	cmsg_init(&msg->base, iproto_thread->connect_route);
 	msg->p_ibuf = con->p_ibuf;
 	msg->wpos = con->wpos;
 	msg->close_connection = false;
-	cpipe_push(&tx_pipe, &msg->base);
+	cpipe_push(&iproto_thread->tx_pipe, &msg->base);
+	/*
+	 * Not before the connection is started: a connection
+	 * which fails to start is freed by the caller, and must
+	 * not stay in the list walked by the idle timer.
+	 */
+	iproto_connection_touch(con);
+	return 0;
+}
+
+/**
+ * Create a connection and start input.
+ */
+static int
+iproto_on_accept(struct evio_service *service, int fd,
+		 struct sockaddr *addr, socklen_t addrlen)
+{
+	(void) addr;
+	(void) addrlen;
+	struct iproto_thread *iproto_thread =
+		(struct iproto_thread *) service->on_accept_param;
+	struct iproto_connection *con =
+		iproto_connection_new(iproto_thread, fd);
+	if (con == NULL)
+		return -1;
+	if (iproto_connection_start(con) != 0) {
+		mempool_free(&iproto_thread->iproto_connection_pool, con);
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * Create a shared memory channel for a local client, pass it
+ * through the accepted Unix socket and start a connection on
+ * the channel. The rest is the same as for socket connections.
+ */
+static int
+iproto_on_shm_accept(struct evio_service *service, int fd,
+		     struct sockaddr *addr, socklen_t addrlen)
+{
+	(void) addr;
+	(void) addrlen;
+	struct iproto_thread *iproto_thread =
+		(struct iproto_thread *) service->on_accept_param;
+	struct iproto_shm *shm = (struct iproto_shm *) malloc(sizeof(*shm));
+	if (shm == NULL) {
+		diag_set(OutOfMemory, sizeof(*shm), "malloc", "shm");
+		return -1;
+	}
+	if (shm_chan_create(&shm->chan, IPROTO_SHM_RING_SIZE) != 0)
+		goto error_free;
+	if (shm_chan_send(&shm->chan, fd) != 0)
+		goto error_destroy;
+	struct iproto_connection *con;
+	con = iproto_connection_new(iproto_thread, shm->chan.read_efd);
+	if (con == NULL)
+		goto error_destroy;
+	/* The output waits for space in the ring on its eventfd. */
+	ev_io_set(&con->output, shm->chan.write_efd, EV_READ);
+	con->shm = shm;
+	ev_io_init(&shm->socket, iproto_connection_on_shm_hangup, fd,
+		   EV_READ);
+	shm->socket.data = con;
+	if (iproto_connection_start(con) != 0) {
+		mempool_free(&iproto_thread->iproto_connection_pool, con);
+		goto error_destroy;
+	}
+	ev_io_start(con->loop, &shm->socket);
 	return 0;
+error_destroy:
+	shm_chan_destroy(&shm->chan);
+error_free:
+	free(shm);
+	return -1;
 }
 
-static struct evio_service binary; /* iproto binary listener */
+/**
+ * Name of the cbus endpoint of a network thread. The first
+ * thread keeps the historical "net" name.
+ */
+static void
+iproto_thread_endpoint_name(struct iproto_thread *iproto_thread,
+			    char *buf)
+{
+	if (iproto_thread->id == 0)
+		snprintf(buf, FIBER_NAME_MAX, "net");
+	else
+		snprintf(buf, FIBER_NAME_MAX, "net%d", iproto_thread->id);
+}
 
 /**
  * The network io thread main function:
  * begin serving the message bus.
  */
 static int
-net_cord_f(va_list /* ap */)
+net_cord_f(va_list ap)
 {
-	mempool_create(&iproto_msg_pool, &cord()->slabc,
+	struct iproto_thread *iproto_thread =
+		va_arg(ap, struct iproto_thread *);
+
+	mempool_create(&iproto_thread->iproto_msg_pool, &cord()->slabc,
 		       sizeof(struct iproto_msg));
-	mempool_create(&iproto_connection_pool, &cord()->slabc,
+	mempool_create(&iproto_thread->iproto_connection_pool, &cord()->slabc,
 		       sizeof(struct iproto_connection));
 
-	evio_service_init(loop(), &binary, "binary",
-			  iproto_on_accept, NULL);
+	evio_service_init(loop(), &iproto_thread->binary, "binary",
+			  iproto_on_accept, iproto_thread);
+	evio_service_init(loop(), &iproto_thread->shm, "shm",
+			  iproto_on_shm_accept, iproto_thread);
+	slab_cache_create(&iproto_thread->ibuf_slabc, &runtime);
+	ev_timer_init(&iproto_thread->idle_timer, iproto_thread_on_idle_timer,
+		      0, 0);
+	iproto_thread->idle_timer.data = iproto_thread;
 
 
 	/* Init statistics counter */
-	rmean_net = rmean_new(rmean_net_strings, IPROTO_LAST);
+	iproto_thread->rmean = rmean_new(rmean_net_strings, IPROTO_LAST);
 
-	if (rmean_net == NULL) {
+	if (iproto_thread->rmean == NULL) {
 		tnt_raise(OutOfMemory, sizeof(struct rmean),
 			  "rmean", "struct rmean");
 	}
 
+	if (iproto_use_uring) {
+		if (uring_create(&iproto_thread->uring, IPROTO_URING_ENTRIES,
+				 loop()) == 0) {
+			iproto_thread->is_uring_enabled = true;
+		} else {
+			diag_log();
+			say_warn("io_uring is unavailable, iproto falls "
+				 "back to the event loop socket I/O");
+		}
+	}
+
 	struct cbus_endpoint endpoint;
 	/* Create "net" endpoint. */
-	cbus_endpoint_create(&endpoint, "net", fiber_schedule_cb, fiber());
+	char endpoint_name[FIBER_NAME_MAX];
+	iproto_thread_endpoint_name(iproto_thread, endpoint_name);
+	cbus_endpoint_create(&endpoint, endpoint_name, fiber_schedule_cb,
+			     fiber());
 	/* Create a pipe to "tx" thread. */
-	cpipe_create(&tx_pipe, "tx");
-	cpipe_set_max_input(&tx_pipe, iproto_msg_max / 2);
+	cpipe_create(&iproto_thread->tx_pipe, "tx");
+	cpipe_set_max_input(&iproto_thread->tx_pipe, iproto_msg_max / 2);
 	/* Process incomming messages. */
 	cbus_loop(&endpoint);
 
-	cpipe_destroy(&tx_pipe);
+	cpipe_destroy(&iproto_thread->tx_pipe);
 	/*
 	 * Nothing to do in the fiber so far, the service
 	 * will take care of creating events for incoming
 	 * connections.
 	 */
-	if (evio_service_is_active(&binary))
-		evio_service_stop(&binary);
-
-	rmean_delete(rmean_net);
+	if (evio_service_is_active(&iproto_thread->binary))
+		evio_service_stop(&iproto_thread->binary);
+	if (evio_service_is_active(&iproto_thread->shm))
+		evio_service_stop(&iproto_thread->shm);
+
+	if (iproto_thread->is_uring_enabled)
+		uring_destroy(&iproto_thread->uring);
+	rmean_delete(iproto_thread->rmean);
 	return 0;
 }
 
@@ -2098,7 +3880,7 @@ iproto_session_fd(struct session *session)
 {
 	struct iproto_connection *con =
 		(struct iproto_connection *) session->meta.connection;
-	return con->output.fd;
+	return iproto_connection_fd(con);
 }
 
 int64_t
@@ -2131,11 +3913,12 @@ static void
 tx_begin_push(struct iproto_connection *con)
 {
 	assert(! con->tx.is_push_sent);
-	cmsg_init(&con->kharon.base, push_route);
+	cmsg_init(&con->kharon.base, con->iproto_thread->push_route);
 	iproto_wpos_create(&con->kharon.wpos, con->tx.p_obuf);
 	con->tx.is_push_pending = false;
 	con->tx.is_push_sent = true;
-	cpipe_push(&net_pipe, (struct cmsg *) &con->kharon);
+	cpipe_push(&con->iproto_thread->net_pipe,
+		   (struct cmsg *) &con->kharon);
 }
 
 static void
@@ -2183,18 +3966,61 @@ iproto_session_push(struct session *session, uint64_t sync, struct port *port)
 
 /** }}} */
 
-/** Initialize the iproto subsystem and start network io thread */
-void
-iproto_init()
-{
-	slab_cache_create(&net_slabc, &runtime);
 
-	if (cord_costart(&net_cord, "iproto", net_cord_f, NULL))
-		panic("failed to initialize iproto thread");
+/** Create @a count latency counters, throw on OOM. */
+static void
+iproto_latency_create(struct latency *latency, int count)
+{
+	for (int i = 0; i < count; i++) {
+		if (latency_create(&latency[i]) != 0) {
+			tnt_raise(OutOfMemory, sizeof(*latency), "malloc",
+				  "struct latency");
+		}
+	}
+}
 
-	/* Create a pipe to "net" thread. */
-	cpipe_create(&net_pipe, "net");
-	cpipe_set_max_input(&net_pipe, iproto_msg_max / 2);
+/** Initialize the iproto subsystem and start network io threads */
+void
+iproto_init(int threads_count, bool use_uring)
+{
+	assert(threads_count > 0 && threads_count <= IPROTO_THREADS_MAX);
+	iproto_use_uring = use_uring;
+	iproto_threads = (struct iproto_thread *)
+		calloc(threads_count, sizeof(struct iproto_thread));
+	if (iproto_threads == NULL) {
+		tnt_raise(OutOfMemory, threads_count *
+			  sizeof(struct iproto_thread), "calloc",
+			  "struct iproto_thread");
+	}
+	iproto_threads_count = threads_count;
+	mempool_create(&iproto_splice_pool, &cord()->slabc,
+		       sizeof(struct iproto_splice));
+	iproto_latency_create(&tx_latency[0][0], lengthof(tx_latency) *
+			      lengthof(tx_latency[0]));
+	iproto_latency_create(&flush_latency_sum, 1);
+	for (int i = 0; i < threads_count; i++) {
+		struct iproto_thread *iproto_thread = &iproto_threads[i];
+		iproto_thread->id = i;
+		stailq_create(&iproto_thread->written_splices);
+		iproto_latency_create(iproto_thread->flush_latency,
+				      lengthof(iproto_thread->flush_latency));
+		for (int j = 0; j < iproto_msg_class_MAX; j++)
+			rlist_create(&iproto_thread->stopped_connections[j]);
+		rlist_create(&iproto_thread->active_connections);
+		iproto_thread_init_routes(iproto_thread);
+		slab_cache_create(&iproto_thread->net_slabc, &runtime);
+
+		if (cord_costart(&iproto_thread->net_cord, "iproto",
+				 net_cord_f, iproto_thread))
+			panic("failed to initialize iproto thread");
+
+		/* Create a pipe to "net" thread. */
+		char endpoint_name[FIBER_NAME_MAX];
+		iproto_thread_endpoint_name(iproto_thread, endpoint_name);
+		cpipe_create(&iproto_thread->net_pipe, endpoint_name);
+		cpipe_set_max_input(&iproto_thread->net_pipe,
+				    iproto_msg_max / 2);
+	}
 	struct session_vtab iproto_session_vtab = {
 		/* .push = */ iproto_session_push,
 		/* .fd = */ iproto_session_fd,
@@ -2206,7 +4032,13 @@ iproto_init()
 /** Available iproto configuration changes. */
 enum iproto_cfg_op {
 	IPROTO_CFG_MSG_MAX,
-	IPROTO_CFG_LISTEN
+	IPROTO_CFG_LISTEN,
+	IPROTO_CFG_STOP,
+	IPROTO_CFG_BUFFER_IDLE_TIMEOUT,
+	IPROTO_CFG_MSG_CLASS,
+	IPROTO_CFG_SHM_LISTEN,
+	IPROTO_CFG_BUSY_POLL,
+	IPROTO_CFG_RESET_STAT,
 };
 
 /**
@@ -2219,10 +4051,18 @@ struct iproto_cfg_msg: public cbus_call_msg
 {
 	/** Operation to execute in iproto thread. */
 	enum iproto_cfg_op op;
+	/** Thread to execute the operation in. */
+	struct iproto_thread *iproto_thread;
 	union {
 		struct {
 			/** New URI to bind to. */
 			const char *uri;
+			/**
+			 * If not NULL, bind to the same address as
+			 * the given service, which belongs to another
+			 * thread and is already bound.
+			 */
+			const struct evio_service *attach_to;
 			/** Result address. */
 			struct sockaddr_storage addr;
 			/** Address length. */
@@ -2231,6 +4071,10 @@ struct iproto_cfg_msg: public cbus_call_msg
 
 		/** New iproto max message count. */
 		int iproto_msg_max;
+		/** New idle connection buffer release timeout. */
+		double buffer_idle_timeout;
+		/** New max busy polling time. */
+		double busy_poll;
 	};
 };
 
@@ -2241,30 +4085,87 @@ iproto_cfg_msg_create(struct iproto_cfg_msg *msg, enum iproto_cfg_op op)
 	msg->op = op;
 }
 
+/**
+ * Reset the statistics of a net thread. They are collected by
+ * the net thread itself, so they can't be reset by tx.
+ */
+static void
+iproto_thread_reset_stat(struct iproto_thread *iproto_thread)
+{
+	rmean_cleanup(iproto_thread->rmean);
+	for (int type = 0; type < IPROTO_TYPE_STAT_MAX; type++)
+		latency_reset(&iproto_thread->flush_latency[type]);
+}
+
 static int
 iproto_do_cfg_f(struct cbus_call_msg *m)
 {
 	struct iproto_cfg_msg *cfg_msg = (struct iproto_cfg_msg *) m;
-	int old;
+	struct iproto_thread *iproto_thread = cfg_msg->iproto_thread;
+	struct evio_service *binary = &iproto_thread->binary;
 	try {
 		switch (cfg_msg->op) {
 		case IPROTO_CFG_MSG_MAX:
-			cpipe_set_max_input(&tx_pipe,
+			/*
+			 * The limit itself is shared by all threads
+			 * and is updated by tx. If it has grown,
+			 * some of stopped connections can be
+			 * resumed now.
+			 */
+			cpipe_set_max_input(&iproto_thread->tx_pipe,
 					    cfg_msg->iproto_msg_max / 2);
-			old = iproto_msg_max;
-			iproto_msg_max = cfg_msg->iproto_msg_max;
-			if (old < iproto_msg_max)
-				iproto_resume();
+			iproto_resume(iproto_thread);
 			break;
-		case IPROTO_CFG_LISTEN:
-			if (evio_service_is_active(&binary))
-				evio_service_stop(&binary);
+		case IPROTO_CFG_STOP:
+			if (evio_service_is_active(binary))
+				evio_service_stop(binary);
+			break;
+		case IPROTO_CFG_BUFFER_IDLE_TIMEOUT:
+			iproto_thread_set_idle_timeout(iproto_thread,
+					cfg_msg->buffer_idle_timeout);
+			break;
+		case IPROTO_CFG_MSG_CLASS:
+			/*
+			 * The class quotas and the overload policy
+			 * are shared by all threads and are updated
+			 * by tx. Stopped connections can be resumed
+			 * or have their requests rejected now.
+			 */
+			iproto_resume(iproto_thread);
+			break;
+		case IPROTO_CFG_BUSY_POLL:
+			busy_poll_set_max_time(&cord()->busy_poll,
+					       cfg_msg->busy_poll);
+			break;
+		case IPROTO_CFG_RESET_STAT:
+			iproto_thread_reset_stat(iproto_thread);
+			break;
+		case IPROTO_CFG_SHM_LISTEN:
+			if (evio_service_is_active(&iproto_thread->shm))
+				evio_service_stop(&iproto_thread->shm);
 			if (cfg_msg->uri != NULL &&
-			    (evio_service_bind(&binary, cfg_msg->uri) != 0 ||
-			     evio_service_listen(&binary) != 0))
+			    (evio_service_bind(&iproto_thread->shm,
+					       cfg_msg->uri) != 0 ||
+			     evio_service_listen(&iproto_thread->shm) != 0))
+				diag_raise();
+			break;
+		case IPROTO_CFG_LISTEN:
+			assert(!evio_service_is_active(binary));
+			binary->reuse_port = iproto_threads_count > 1;
+			if (cfg_msg->attach_to != NULL) {
+				const struct evio_service *src =
+					cfg_msg->attach_to;
+				if (evio_service_attach(binary, src) != 0 ||
+				    evio_service_listen(binary) != 0)
+					diag_raise();
+			} else if (cfg_msg->uri != NULL &&
+				   (evio_service_bind(binary,
+						      cfg_msg->uri) != 0 ||
+				    evio_service_listen(binary) != 0)) {
 				diag_raise();
-			cfg_msg->addrlen = binary.addr_len;
-			cfg_msg->addr = binary.addrstorage;
+			}
+			cfg_msg->addrlen = binary->addr_len;
+			cfg_msg->addr = binary->addrstorage;
 			break;
 		default:
 			unreachable();
@@ -2276,10 +4177,11 @@ iproto_do_cfg_f(struct cbus_call_msg *m)
 }
 
 static inline void
-iproto_do_cfg(struct iproto_cfg_msg *msg)
+iproto_do_cfg(struct iproto_thread *iproto_thread, struct iproto_cfg_msg *msg)
 {
-	if (cbus_call(&net_pipe, &tx_pipe, msg, iproto_do_cfg_f,
-		      NULL, TIMEOUT_INFINITY) != 0)
+	msg->iproto_thread = iproto_thread;
+	if (cbus_call(&iproto_thread->net_pipe, &iproto_thread->tx_pipe, msg,
+		      iproto_do_cfg_f, NULL, TIMEOUT_INFINITY) != 0)
 		diag_raise();
 }
 
@@ -2287,35 +4189,201 @@ void
 iproto_listen(const char *uri)
 {
 	struct iproto_cfg_msg cfg_msg;
+	/*
+	 * Stop all listeners first: the threads share the
+	 * address, so a new one can be bound only when all of
+	 * them are released.
+	 */
+	for (int i = iproto_threads_count - 1; i >= 0; i--) {
+		iproto_cfg_msg_create(&cfg_msg, IPROTO_CFG_STOP);
+		iproto_do_cfg(&iproto_threads[i], &cfg_msg);
+	}
+	iproto_bound_address_len = 0;
+	if (uri == NULL)
+		return;
+	/*
+	 * The first thread resolves the URI and binds. The rest
+	 * bind to the resulting address, which may differ from
+	 * the URI, e.g. when an ephemeral port is requested.
+	 */
 	iproto_cfg_msg_create(&cfg_msg, IPROTO_CFG_LISTEN);
 	cfg_msg.uri = uri;
-	iproto_do_cfg(&cfg_msg);
+	iproto_do_cfg(&iproto_threads[0], &cfg_msg);
 	iproto_bound_address_storage = cfg_msg.addr;
 	iproto_bound_address_len = cfg_msg.addrlen;
+	for (int i = 1; i < iproto_threads_count; i++) {
+		iproto_cfg_msg_create(&cfg_msg, IPROTO_CFG_LISTEN);
+		cfg_msg.attach_to = &iproto_threads[0].binary;
+		iproto_do_cfg(&iproto_threads[i], &cfg_msg);
+	}
+}
+
+void
+iproto_shm_listen(const char *path)
+{
+	struct iproto_cfg_msg cfg_msg;
+	iproto_cfg_msg_create(&cfg_msg, IPROTO_CFG_SHM_LISTEN);
+	if (path != NULL)
+		cfg_msg.uri = tt_sprintf("unix/:%s", path);
+	iproto_do_cfg(&iproto_threads[0], &cfg_msg);
+}
+
+size_t
+iproto_thread_mem_used(int thread_id)
+{
+	assert(thread_id >= 0 && thread_id < iproto_threads_count);
+	struct iproto_thread *iproto_thread = &iproto_threads[thread_id];
+	return slab_cache_used(&iproto_thread->net_cord.slabc) +
+	       slab_cache_used(&iproto_thread->ibuf_slabc) +
+	       slab_cache_used(&iproto_thread->net_slabc);
+}
+
+size_t
+iproto_thread_buffer_mem_used(int thread_id)
+{
+	assert(thread_id >= 0 && thread_id < iproto_threads_count);
+	struct iproto_thread *iproto_thread = &iproto_threads[thread_id];
+	return slab_cache_used(&iproto_thread->ibuf_slabc) +
+	       slab_cache_used(&iproto_thread->net_slabc);
+}
+
+size_t
+iproto_buffer_mem_used(void)
+{
+	size_t mem = 0;
+	for (int i = 0; i < iproto_threads_count; i++)
+		mem += iproto_thread_buffer_mem_used(i);
+	return mem;
+}
+
+size_t
+iproto_thread_connection_count(int thread_id)
+{
+	assert(thread_id >= 0 && thread_id < iproto_threads_count);
+	return mempool_count(&iproto_threads[thread_id].iproto_connection_pool);
+}
+
+size_t
+iproto_thread_request_count(int thread_id)
+{
+	assert(thread_id >= 0 && thread_id < iproto_threads_count);
+	return mempool_count(&iproto_threads[thread_id].iproto_msg_pool);
 }
 
 size_t
 iproto_mem_used(void)
 {
-	return slab_cache_used(&net_cord.slabc) + slab_cache_used(&net_slabc);
+	size_t mem = 0;
+	for (int i = 0; i < iproto_threads_count; i++)
+		mem += iproto_thread_mem_used(i);
+	return mem;
 }
 
 size_t
 iproto_connection_count(void)
 {
-	return mempool_count(&iproto_connection_pool);
+	size_t count = 0;
+	for (int i = 0; i < iproto_threads_count; i++)
+		count += iproto_thread_connection_count(i);
+	return count;
 }
 
 size_t
 iproto_request_count(void)
 {
-	return mempool_count(&iproto_msg_pool);
+	size_t count = 0;
+	for (int i = 0; i < iproto_threads_count; i++)
+		count += iproto_thread_request_count(i);
+	return count;
+}
+
+int
+iproto_thread_rmean_foreach(int thread_id, rmean_cb cb, void *cb_ctx)
+{
+	assert(thread_id >= 0 && thread_id < iproto_threads_count);
+	return rmean_foreach(iproto_threads[thread_id].rmean, cb, cb_ctx);
+}
+
+int
+iproto_rmean_foreach(rmean_cb cb, void *cb_ctx)
+{
+	for (size_t i = 0; i < IPROTO_LAST; i++) {
+		int64_t mean = 0;
+		int64_t total = 0;
+		for (int j = 0; j < iproto_threads_count; j++) {
+			mean += rmean_mean(iproto_threads[j].rmean, i);
+			total += rmean_total(iproto_threads[j].rmean, i);
+		}
+		int rc = cb(rmean_net_strings[i], mean, total, cb_ctx);
+		if (rc != 0)
+			return rc;
+	}
+	return 0;
 }
 
 void
 iproto_reset_stat(void)
 {
-	rmean_cleanup(rmean_net);
+	struct iproto_cfg_msg cfg_msg;
+	/*
+	 * Called from Lua without a try/catch, so the call
+	 * must neither raise nor be interrupted: resetting
+	 * the statistics can't fail in the net thread.
+	 */
+	bool cancellable = fiber_set_cancellable(false);
+	for (int i = 0; i < iproto_threads_count; i++) {
+		struct iproto_thread *iproto_thread = &iproto_threads[i];
+		iproto_cfg_msg_create(&cfg_msg, IPROTO_CFG_RESET_STAT);
+		cfg_msg.iproto_thread = iproto_thread;
+		cbus_call(&iproto_thread->net_pipe, &iproto_thread->tx_pipe,
+			  &cfg_msg, iproto_do_cfg_f, NULL, TIMEOUT_INFINITY);
+	}
+	fiber_set_cancellable(cancellable);
+	for (int type = 0; type < IPROTO_TYPE_STAT_MAX; type++) {
+		for (int phase = 0; phase < IPROTO_PHASE_FLUSH; phase++)
+			latency_reset(&tx_latency[type][phase]);
+	}
+}
+
+static void
+iproto_latency_append(struct info_handler *h, enum iproto_phase phase,
+		      struct latency *latency)
+{
+	info_table_begin(h, iproto_phase_strs[phase]);
+	info_append_double(h, "p50", latency_get(latency, 50));
+	info_append_double(h, "p99", latency_get(latency, 99));
+	info_append_double(h, "p999", latency_get(latency, 99.9));
+	info_table_end(h);
+}
+
+void
+iproto_latency_stat(struct info_handler *h)
+{
+	info_begin(h);
+	for (uint32_t type = 0; type < IPROTO_TYPE_STAT_MAX; type++) {
+		const char *name = iproto_type_name(type);
+		if (name == NULL)
+			continue;
+		info_table_begin(h, name);
+		for (int phase = 0; phase < IPROTO_PHASE_FLUSH; phase++) {
+			iproto_latency_append(h, (enum iproto_phase) phase,
+					      &tx_latency[type][phase]);
+		}
+		/*
+		 * Flush latency is collected by every network
+		 * thread separately. The dirty read is fine for
+		 * statistics, like in iproto_rmean_foreach().
+		 */
+		latency_reset(&flush_latency_sum);
+		for (int i = 0; i < iproto_threads_count; i++) {
+			latency_merge(&flush_latency_sum,
+				      &iproto_threads[i].flush_latency[type]);
+		}
+		iproto_latency_append(h, IPROTO_PHASE_FLUSH,
+				      &flush_latency_sum);
+		info_table_end(h);
+	}
+	info_end(h);
 }
 
 void
@@ -2326,23 +4394,115 @@ iproto_set_msg_max(int new_iproto_msg_max)
 			  tt_sprintf("minimal value is %d",
 				     IPROTO_MSG_MAX_MIN));
 	}
+	iproto_msg_max = new_iproto_msg_max;
+	struct iproto_cfg_msg cfg_msg;
+	for (int i = 0; i < iproto_threads_count; i++) {
+		iproto_cfg_msg_create(&cfg_msg, IPROTO_CFG_MSG_MAX);
+		cfg_msg.iproto_msg_max = new_iproto_msg_max;
+		iproto_do_cfg(&iproto_threads[i], &cfg_msg);
+		cpipe_set_max_input(&iproto_threads[i].net_pipe,
+				    new_iproto_msg_max / 2);
+	}
+}
+
+/** Let the network threads apply new request class settings. */
+static void
+iproto_update_msg_class(void)
+{
+	struct iproto_cfg_msg cfg_msg;
+	for (int i = 0; i < iproto_threads_count; i++) {
+		iproto_cfg_msg_create(&cfg_msg, IPROTO_CFG_MSG_CLASS);
+		iproto_do_cfg(&iproto_threads[i], &cfg_msg);
+	}
+}
+
+void
+iproto_set_critical_msg_max(int new_iproto_critical_msg_max)
+{
+	if (new_iproto_critical_msg_max < IPROTO_MSG_MAX_MIN) {
+		tnt_raise(ClientError, ER_CFG, "iproto_critical_msg_max",
+			  tt_sprintf("minimal value is %d",
+				     IPROTO_MSG_MAX_MIN));
+	}
+	iproto_critical_msg_max = new_iproto_critical_msg_max;
+	iproto_update_msg_class();
+}
+
+void
+iproto_set_reject_overload(bool reject_overload)
+{
+	iproto_reject_overload = reject_overload;
+	iproto_update_msg_class();
+}
+
+void
+iproto_set_critical_users(const char **names, int count)
+{
+	size_t size = 0;
+	for (int i = 0; i < count; i++)
+		size += strlen(names[i]) + 1;
+	char *users = NULL;
+	if (size > 0) {
+		users = (char *) malloc(size);
+		if (users == NULL) {
+			tnt_raise(OutOfMemory, size, "malloc",
+				  "iproto_critical_users");
+		}
+	}
+	char *pos = users;
+	for (int i = 0; i < count; i++) {
+		size_t len = strlen(names[i]) + 1;
+		memcpy(pos, names[i], len);
+		pos += len;
+	}
+	free(iproto_critical_users);
+	iproto_critical_users = users;
+	iproto_critical_user_count = count;
+}
+
+void
+iproto_set_buffer_idle_timeout(double timeout)
+{
+	struct iproto_cfg_msg cfg_msg;
+	for (int i = 0; i < iproto_threads_count; i++) {
+		iproto_cfg_msg_create(&cfg_msg,
+				      IPROTO_CFG_BUFFER_IDLE_TIMEOUT);
+		cfg_msg.buffer_idle_timeout = timeout;
+		iproto_do_cfg(&iproto_threads[i], &cfg_msg);
+	}
+}
+
+void
+iproto_set_busy_poll(double max_time)
+{
 	struct iproto_cfg_msg cfg_msg;
-	iproto_cfg_msg_create(&cfg_msg, IPROTO_CFG_MSG_MAX);
-	cfg_msg.iproto_msg_max = new_iproto_msg_max;
-	iproto_do_cfg(&cfg_msg);
-	cpipe_set_max_input(&net_pipe, new_iproto_msg_max / 2);
+	for (int i = 0; i < iproto_threads_count; i++) {
+		iproto_cfg_msg_create(&cfg_msg, IPROTO_CFG_BUSY_POLL);
+		cfg_msg.busy_poll = max_time;
+		iproto_do_cfg(&iproto_threads[i], &cfg_msg);
+	}
+}
+
+const struct busy_poll *
+iproto_thread_busy_poll(int thread_id)
+{
+	assert(thread_id >= 0 && thread_id < iproto_threads_count);
+	return &iproto_threads[thread_id].net_cord.busy_poll;
 }
 
 void
 iproto_free()
 {
-	tt_pthread_cancel(net_cord.id);
-	tt_pthread_join(net_cord.id, NULL);
-	/*
-	* Close socket descriptor to prevent hot standby instance
-	* failing to bind in case it tries to bind before socket
-	* is closed by OS.
-	*/
-	if (evio_service_is_active(&binary))
-		close(binary.ev.fd);
+	for (int i = 0; i < iproto_threads_count; i++) {
+		struct iproto_thread *iproto_thread = &iproto_threads[i];
+		tt_pthread_cancel(iproto_thread->net_cord.id);
+		tt_pthread_join(iproto_thread->net_cord.id, NULL);
+		/*
+		 * Close socket descriptor to prevent hot standby
+		 * instance failing to bind in case it tries to
+		 * bind before socket is closed by OS.
+		 */
+		if (evio_service_is_active(&iproto_thread->binary))
+			close(iproto_thread->binary.ev.fd);
+	}
 }
@@ -33,10 +33,14 @@
 
 #include <stddef.h>
 
+#include "rmean.h"
+
 #if defined(__cplusplus)
 extern "C" {
 #endif /* defined(__cplusplus) */
 
+struct busy_poll;
+
 enum {
 	/** The minimal value for net_msg_max. */
 	IPROTO_MSG_MAX_MIN = 2,
@@ -52,10 +56,15 @@ enum {
 	 * processing stops until some new fibers are freed up.
 	 */
 	IPROTO_FIBER_POOL_SIZE_FACTOR = 5,
+	/** Maximal number of iproto network threads. */
+	IPROTO_THREADS_MAX = 1000,
 };
 
 extern unsigned iproto_readahead;
 
+/** Number of running iproto network threads. */
+extern int iproto_threads_count;
+
 /**
  * Return size of memory used for storing network buffers.
  */
@@ -74,12 +83,71 @@ iproto_connection_count(void);
 size_t
 iproto_request_count(void);
 
+/**
+ * Return size of memory used for storing network buffers
+ * by the iproto thread with the given id.
+ */
+size_t
+iproto_thread_mem_used(int thread_id);
+
+/**
+ * Return size of memory held by input and output buffers of
+ * the connections, summed over all iproto threads.
+ */
+size_t
+iproto_buffer_mem_used(void);
+
+/**
+ * Return size of memory held by input and output buffers of
+ * the connections of the iproto thread with the given id.
+ */
+size_t
+iproto_thread_buffer_mem_used(int thread_id);
+
+/**
+ * Return the number of active connections served by the
+ * iproto thread with the given id.
+ */
+size_t
+iproto_thread_connection_count(int thread_id);
+
+/**
+ * Return the number of requests in flight in the iproto
+ * thread with the given id.
+ */
+size_t
+iproto_thread_request_count(int thread_id);
+
+/**
+ * Invoke @a cb for every network statistics counter, summed
+ * over all iproto threads. See rmean_foreach().
+ */
+int
+iproto_rmean_foreach(rmean_cb cb, void *cb_ctx);
+
+/**
+ * Invoke @a cb for every network statistics counter of the
+ * iproto thread with the given id. See rmean_foreach().
+ */
+int
+iproto_thread_rmean_foreach(int thread_id, rmean_cb cb, void *cb_ctx);
+
 /**
  * Reset network statistics.
  */
 void
 iproto_reset_stat(void);
 
+struct info_handler;
+
+/**
+ * Dump latency percentiles of every request type, split into
+ * time in the network queue, in tx, waiting for WAL and
+ * flushing the reply to the socket.
+ */
+void
+iproto_latency_stat(struct info_handler *h);
+
 /**
  * String representation of the address served by
  * iproto. To be shown in box.info.
@@ -90,15 +158,66 @@ iproto_bound_address(void);
 #if defined(__cplusplus)
 } /* extern "C" */
 
+/**
+ * Initialize the iproto subsystem and start @a threads_count
+ * network threads. If @a use_uring is set, the threads batch
+ * socket reads and writes with io_uring, if it is available.
+ */
 void
-iproto_init();
+iproto_init(int threads_count, bool use_uring);
 
 void
 iproto_listen(const char *uri);
 
+/**
+ * Accept local clients of the shared memory transport on the
+ * Unix socket @a path. NULL stops accepting them.
+ */
+void
+iproto_shm_listen(const char *path);
+
 void
 iproto_set_msg_max(int iproto_msg_max);
 
+/**
+ * Set the maximal number of critical requests in fly per
+ * network thread, on top of net_msg_max.
+ */
+void
+iproto_set_critical_msg_max(int iproto_critical_msg_max);
+
+/**
+ * Make requests of the users with the given names critical.
+ * Is applied to a connection on authentication.
+ */
+void
+iproto_set_critical_users(const char **names, int count);
+
+/**
+ * Reply with ER_REQUEST_OVERLOAD to requests exceeding the
+ * quota of their class instead of stopping the input.
+ */
+void
+iproto_set_reject_overload(bool reject_overload);
+
+/**
+ * Release the buffers of connections which have been idle for
+ * @a timeout seconds. 0 disables the release.
+ */
+void
+iproto_set_buffer_idle_timeout(double timeout);
+
+/**
+ * Set the max time the event loops of the iproto threads spin
+ * before blocking, 0 disables busy polling.
+ */
+void
+iproto_set_busy_poll(double max_time);
+
+/** Busy polling state of the iproto thread with the given id. */
+const struct busy_poll *
+iproto_thread_busy_poll(int thread_id);
+
 void
 iproto_free();
 
@@ -73,7 +73,10 @@ const unsigned char iproto_key_type[IPROTO_KEY_MAX] =
 		/* 0x1c */	MP_UINT,
 		/* 0x1d */	MP_UINT,
 		/* 0x1e */	MP_UINT,
-		/* 0x1f */	MP_UINT,
+	/* }}} */
+
+	/* {{{ body -- boolean keys */
+		/* 0x1f */	MP_BOOL, /* IPROTO_FETCH_POSITION */
 	/* }}} */
 
 	/* {{{ body -- all keys */
@@ -89,6 +92,10 @@ const unsigned char iproto_key_type[IPROTO_KEY_MAX] =
 	/* 0x29 */	MP_MAP, /* IPROTO_BALLOT */
 	/* 0x2a */	MP_MAP, /* IPROTO_TUPLE_META */
 	/* 0x2b */	MP_MAP, /* IPROTO_OPTIONS */
+	/* 0x2c */	MP_ARRAY, /* IPROTO_STATEMENTS */
+	/* 0x2d */	MP_STR, /* IPROTO_COMPRESSION */
+	/* 0x2e */	MP_ARRAY, /* IPROTO_FIELDS */
+	/* 0x2f */	MP_STR, /* IPROTO_AFTER_POSITION */
 	/* }}} */
 };
 
@@ -108,6 +115,7 @@ const char *iproto_type_strs[] =
 	"EXECUTE",
 	NULL, /* NOP */
 	"PREPARE",
+	NULL, /* BATCH */
 };
 
 #define bit(c) (1ULL<<IPROTO_##c)
@@ -126,6 +134,7 @@ const uint64_t iproto_body_key_map[IPROTO_TYPE_STAT_MAX] = {
 	0,                                                     /* EXECUTE */
 	0,                                                     /* NOP */
 	0,                                                     /* PREPARE */
+	bit(STATEMENTS),                                       /* BATCH */
 };
 #undef bit
 
@@ -161,7 +170,7 @@ const char *iproto_key_strs[IPROTO_KEY_MAX] = {
 	NULL,               /* 0x1c */
 	NULL,               /* 0x1d */
 	NULL,               /* 0x1e */
-	NULL,               /* 0x1f */
+	"fetch position",   /* 0x1f */
 	"key",              /* 0x20 */
 	"tuple",            /* 0x21 */
 	"function name",    /* 0x22 */
@@ -174,16 +183,16 @@ const char *iproto_key_strs[IPROTO_KEY_MAX] = {
 	"ballot",           /* 0x29 */
 	"tuple meta",       /* 0x2a */
 	"options",          /* 0x2b */
-	NULL,               /* 0x2c */
-	NULL,               /* 0x2d */
-	NULL,               /* 0x2e */
-	NULL,               /* 0x2f */
+	"statements",       /* 0x2c */
+	"compression",      /* 0x2d */
+	"fields",           /* 0x2e */
+	"after position",   /* 0x2f */
 	"data",             /* 0x30 */
 	"error",            /* 0x31 */
 	"metadata",         /* 0x32 */
 	"bind meta",        /* 0x33 */
 	"bind count",       /* 0x34 */
-	NULL,               /* 0x35 */
+	"position",         /* 0x35 */
 	NULL,               /* 0x36 */
 	NULL,               /* 0x37 */
 	NULL,               /* 0x38 */
@@ -226,3 +235,12 @@ const char *vy_row_index_key_strs[VY_ROW_INDEX_KEY_MAX] = {
 	NULL,
 	"row index",
 };
+
+const char *memtx_index_order_key_strs[MEMTX_INDEX_ORDER_KEY_MAX] = {
+	NULL,
+	"space id",
+	"index id",
+	"count",
+	"offset",
+	"order",
+};
@@ -74,6 +74,8 @@ enum iproto_key {
 	IPROTO_OFFSET = 0x13,
 	IPROTO_ITERATOR = 0x14,
 	IPROTO_INDEX_BASE = 0x15,
+	/** Send IPROTO_POSITION of the last SELECT result tuple. */
+	IPROTO_FETCH_POSITION = 0x1f,
 
 	/* Leave a gap between integer values and other keys */
 	IPROTO_KEY = 0x20,
@@ -98,6 +100,29 @@ enum iproto_key {
 	IPROTO_BALLOT = 0x29,
 	IPROTO_TUPLE_META = 0x2a,
 	IPROTO_OPTIONS = 0x2b,
+	/**
+	 * IPROTO_STATEMENTS: [
+	 *      { IPROTO_REQUEST_TYPE: type, <DML request body> },
+	 *      { ... },
+	 *      ...
+	 * ]
+	 */
+	IPROTO_STATEMENTS = 0x2c,
+	/** Compression algorithm name, see IPROTO_COMPRESS. */
+	IPROTO_COMPRESSION = 0x2d,
+	/**
+	 * SELECT projection: IPROTO_FIELDS: [field, ...], where
+	 * a field is a number counted from IPROTO_INDEX_BASE or
+	 * a JSON path. Only these fields of the found tuples are
+	 * sent, in the given order.
+	 */
+	IPROTO_FIELDS = 0x2e,
+	/**
+	 * SELECT continues after the tuple at this position, as
+	 * returned in IPROTO_POSITION. The position is opaque
+	 * MessagePack wrapped in MP_STR.
+	 */
+	IPROTO_AFTER_POSITION = 0x2f,
 
 	/* Leave a gap between request keys and response keys */
 	IPROTO_DATA = 0x30,
@@ -112,6 +137,8 @@ enum iproto_key {
 	IPROTO_METADATA = 0x32,
 	IPROTO_BIND_METADATA = 0x33,
 	IPROTO_BIND_COUNT = 0x34,
+	/** Position of the last tuple of a SELECT response. */
+	IPROTO_POSITION = 0x35,
 
 	/* Leave a gap between response keys and SQL keys. */
 	IPROTO_SQL_TEXT = 0x40,
@@ -156,7 +183,9 @@ enum iproto_ballot_key {
 			  bit(LSN) | bit(SCHEMA_VERSION))
 #define IPROTO_DML_BODY_BMAP (bit(SPACE_ID) | bit(INDEX_ID) | bit(LIMIT) |\
 			      bit(OFFSET) | bit(ITERATOR) | bit(INDEX_BASE) |\
-			      bit(KEY) | bit(TUPLE) | bit(OPS) | bit(TUPLE_META))
+			      bit(KEY) | bit(TUPLE) | bit(OPS) |\
+			      bit(TUPLE_META) | bit(FIELDS) |\
+			      bit(FETCH_POSITION) | bit(AFTER_POSITION))
 
 static inline bool
 xrow_header_has_key(const char *pos, const char *end)
@@ -215,6 +244,8 @@ enum iproto_type {
 	IPROTO_NOP = 12,
 	/** Prepare SQL statement. */
 	IPROTO_PREPARE = 13,
+	/** Execute a list of DML statements in one transaction. */
+	IPROTO_BATCH = 14,
 	/** The maximum typecode used for box.stat() */
 	IPROTO_TYPE_STAT_MAX,
 
@@ -232,6 +263,14 @@ enum iproto_type {
 	IPROTO_FETCH_SNAPSHOT = 69,
 	/** REGISTER request to leave anonymous replication. */
 	IPROTO_REGISTER = 70,
+	/**
+	 * Switch the connection to streaming compression with
+	 * the algorithm given in IPROTO_COMPRESSION ("zstd").
+	 * The input following the request and the output
+	 * following the reply are compressed. A client should
+	 * not send anything else until the reply comes.
+	 */
+	IPROTO_COMPRESS = 71,
 
 	/** Vinyl run info stored in .index file */
 	VY_INDEX_RUN_INFO = 100,
@@ -239,6 +278,8 @@ enum iproto_type {
 	VY_INDEX_PAGE_INFO = 101,
 	/** Vinyl row index stored in .run file */
 	VY_RUN_ROW_INDEX = 102,
+	/** Memtx TREE index order stored in .snap file */
+	MEMTX_INDEX_ORDER = 103,
 
 	/** Non-final response type. */
 	IPROTO_CHUNK = 128,
@@ -260,11 +301,13 @@ static inline const char *
 iproto_type_name(uint32_t type)
 {
 	/*
-	 * Sic: iptoto_type_strs[IPROTO_NOP] is NULL
-	 * to suppress box.stat() output.
+	 * Sic: iptoto_type_strs[IPROTO_NOP] and [IPROTO_BATCH]
+	 * are NULL to suppress box.stat() output.
 	 */
 	if (type == IPROTO_NOP)
 		return "NOP";
+	if (type == IPROTO_BATCH)
+		return "BATCH";
 
 	if (type < IPROTO_TYPE_STAT_MAX)
 		return iproto_type_strs[type];
@@ -276,6 +319,8 @@ iproto_type_name(uint32_t type)
 		return "PAGEINFO";
 	case VY_RUN_ROW_INDEX:
 		return "ROWINDEX";
+	case MEMTX_INDEX_ORDER:
+		return "INDEXORDER";
 	default:
 		return NULL;
 	}
@@ -467,6 +512,37 @@ vy_row_index_key_name(enum vy_row_index_key key)
 	return vy_row_index_key_strs[key];
 }
 
+/**
+ * Xrow keys for memtx index order.
+ */
+enum memtx_index_order_key {
+	/** Space id. */
+	MEMTX_INDEX_ORDER_SPACE_ID = 1,
+	/** Index id. */
+	MEMTX_INDEX_ORDER_INDEX_ID = 2,
+	/** Number of tuples in the index. */
+	MEMTX_INDEX_ORDER_COUNT = 3,
+	/** Position of the first row number of the chunk. */
+	MEMTX_INDEX_ORDER_OFFSET = 4,
+	/** Array of primary key row numbers in index order. */
+	MEMTX_INDEX_ORDER_DATA = 5,
+	/** The last key in this enum + 1 */
+	MEMTX_INDEX_ORDER_KEY_MAX
+};
+
+/**
+ * Return memtx index order key name by @a key code.
+ * @param key key
+ */
+static inline const char *
+memtx_index_order_key_name(enum memtx_index_order_key key)
+{
+	if (key <= 0 || key >= MEMTX_INDEX_ORDER_KEY_MAX)
+		return NULL;
+	extern const char *memtx_index_order_key_strs[];
+	return memtx_index_order_key_strs[key];
+}
+
 #if defined(__cplusplus)
 } /* extern "C" */
 #endif
@@ -37,7 +37,7 @@
 #include "lua/utils.h"
 
 #include "box/box.h"
-#include "libeio/eio.h"
+#include "coio_pool.h"
 
 extern "C" {
 	#include <lua.h>
@@ -274,6 +274,94 @@ lbox_cfg_set_net_msg_max(struct lua_State *L)
 	return 0;
 }
 
+static int
+lbox_cfg_set_iproto_buffer_idle_timeout(struct lua_State *L)
+{
+	try {
+		box_set_iproto_buffer_idle_timeout();
+	} catch (Exception *) {
+		luaT_error(L);
+	}
+	return 0;
+}
+
+static int
+lbox_cfg_set_busy_poll(struct lua_State *L)
+{
+	try {
+		box_set_busy_poll();
+	} catch (Exception *) {
+		luaT_error(L);
+	}
+	return 0;
+}
+
+static int
+lbox_cfg_set_wal_group_commit(struct lua_State *L)
+{
+	try {
+		box_set_wal_group_commit();
+	} catch (Exception *) {
+		luaT_error(L);
+	}
+	return 0;
+}
+
+static int
+lbox_cfg_set_cpu_affinity(struct lua_State *L)
+{
+	try {
+		box_set_cpu_affinity();
+	} catch (Exception *) {
+		luaT_error(L);
+	}
+	return 0;
+}
+
+static int
+lbox_cfg_set_iproto_shm_listen(struct lua_State *L)
+{
+	try {
+		box_set_iproto_shm_listen();
+	} catch (Exception *) {
+		luaT_error(L);
+	}
+	return 0;
+}
+
+static int
+lbox_cfg_set_iproto_critical_msg_max(struct lua_State *L)
+{
+	try {
+		box_set_iproto_critical_msg_max();
+	} catch (Exception *) {
+		luaT_error(L);
+	}
+	return 0;
+}
+
+static int
+lbox_cfg_set_iproto_critical_users(struct lua_State *L)
+{
+	try {
+		box_set_iproto_critical_users();
+	} catch (Exception *) {
+		luaT_error(L);
+	}
+	return 0;
+}
+
+static int
+lbox_cfg_set_iproto_reject_overload(struct lua_State *L)
+{
+	try {
+		box_set_iproto_reject_overload();
+	} catch (Exception *) {
+		luaT_error(L);
+	}
+	return 0;
+}
+
 static int
 lbox_set_prepared_stmt_cache_size(struct lua_State *L)
 {
@@ -286,8 +374,7 @@ static int
 lbox_cfg_set_worker_pool_threads(struct lua_State *L)
 {
 	(void) L;
-	eio_set_min_parallel(cfg_geti("worker_pool_threads"));
-	eio_set_max_parallel(cfg_geti("worker_pool_threads"));
+	coio_pool_set_size(cfg_geti("worker_pool_threads"));
 	return 0;
 }
 
@@ -398,6 +485,14 @@ box_lua_cfg_init(struct lua_State *L)
 		{"cfg_set_replication_skip_conflict", lbox_cfg_set_replication_skip_conflict},
 		{"cfg_set_replication_anon", lbox_cfg_set_replication_anon},
 		{"cfg_set_net_msg_max", lbox_cfg_set_net_msg_max},
+		{"cfg_set_iproto_buffer_idle_timeout", lbox_cfg_set_iproto_buffer_idle_timeout},
+		{"cfg_set_iproto_shm_listen", lbox_cfg_set_iproto_shm_listen},
+		{"cfg_set_busy_poll", lbox_cfg_set_busy_poll},
+		{"cfg_set_wal_group_commit", lbox_cfg_set_wal_group_commit},
+		{"cfg_set_cpu_affinity", lbox_cfg_set_cpu_affinity},
+		{"cfg_set_iproto_critical_msg_max", lbox_cfg_set_iproto_critical_msg_max},
+		{"cfg_set_iproto_critical_users", lbox_cfg_set_iproto_critical_users},
+		{"cfg_set_iproto_reject_overload", lbox_cfg_set_iproto_reject_overload},
 		{"cfg_set_sql_cache_size", lbox_set_prepared_stmt_cache_size},
 		{NULL, NULL}
 	};
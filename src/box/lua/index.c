@@ -34,7 +34,9 @@
 #include "info/info.h"
 #include "box/box.h"
 #include "box/index.h"
+#include "box/tuple.h"
 #include "box/lua/tuple.h"
+#include "fiber.h"
 #include "box/lua/misc.h" /* lbox_encode_tuple_on_gc() */
 
 /** {{{ box.index Lua library: access to spaces and indexes
@@ -242,9 +244,10 @@ box_index_init_iterator_types(struct lua_State *L, int idx)
 static int
 lbox_index_iterator(lua_State *L)
 {
-	if (lua_gettop(L) != 4 || !lua_isnumber(L, 1) || !lua_isnumber(L, 2) ||
-	    !lua_isnumber(L, 3))
-		return luaL_error(L, "usage index.iterator(space_id, index_id, type, key)");
+	int argc = lua_gettop(L);
+	if ((argc != 4 && argc != 5) || !lua_isnumber(L, 1) ||
+	    !lua_isnumber(L, 2) || !lua_isnumber(L, 3))
+		return luaL_error(L, "usage index.iterator(space_id, index_id, type, key[, after])");
 
 	uint32_t space_id = lua_tonumber(L, 1);
 	uint32_t index_id = lua_tonumber(L, 2);
@@ -252,8 +255,18 @@ lbox_index_iterator(lua_State *L)
 	size_t mpkey_len;
 	const char *mpkey = lua_tolstring(L, 4, &mpkey_len); /* Key encoded by Lua */
 	/* const char *key = lbox_encode_tuple_on_gc(L, 4, key_len); */
-	struct iterator *it = box_index_iterator(space_id, index_id, iterator,
-						 mpkey, mpkey + mpkey_len);
+	/* Position of the tuple to start after, kept alive by Lua. */
+	const char *pos = NULL;
+	const char *pos_end = NULL;
+	if (argc == 5 && !lua_isnil(L, 5)) {
+		size_t pos_len;
+		pos = lua_tolstring(L, 5, &pos_len);
+		pos_end = pos + pos_len;
+	}
+	struct iterator *it = box_index_iterator_after(space_id, index_id,
+						       iterator, mpkey,
+						       mpkey + mpkey_len, pos,
+						       pos_end);
 	if (it == NULL)
 		return luaT_error(L);
 
@@ -298,6 +311,34 @@ lbox_truncate(struct lua_State *L)
 
 /* {{{ Introspection */
 
+static int
+lbox_index_tuple_pos(lua_State *L)
+{
+	if (lua_gettop(L) != 3 || !lua_isnumber(L, 1) || !lua_isnumber(L, 2))
+		return luaL_error(L, "usage index.tuple_pos(space_id, index_id, tuple)");
+
+	uint32_t space_id = lua_tonumber(L, 1);
+	uint32_t index_id = lua_tonumber(L, 2);
+	struct tuple *tuple = luaT_istuple(L, 3);
+	if (tuple == NULL) {
+		tuple = luaT_tuple_new(L, 3, box_tuple_format_default());
+		if (tuple == NULL)
+			return luaT_error(L);
+	}
+	tuple_ref(tuple);
+	struct region *region = &fiber()->gc;
+	size_t region_svp = region_used(region);
+	uint32_t size;
+	const char *pos = box_index_tuple_position(space_id, index_id,
+						   tuple, &size);
+	tuple_unref(tuple);
+	if (pos == NULL)
+		return luaT_error(L);
+	lua_pushlstring(L, pos, size);
+	region_truncate(region, region_svp);
+	return 1;
+}
+
 static int
 lbox_index_stat(lua_State *L)
 {
@@ -362,6 +403,7 @@ box_lua_index_init(struct lua_State *L)
 		{"count", lbox_index_count},
 		{"iterator", lbox_index_iterator},
 		{"iterator_next", lbox_iterator_next},
+		{"tuple_pos", lbox_index_tuple_pos},
 		{"truncate", lbox_truncate},
 		{"stat", lbox_index_stat},
 		{"compact", lbox_index_compact},
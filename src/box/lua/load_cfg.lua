@@ -28,10 +28,14 @@ local default_cfg = {
     strip_core          = true,
     memtx_min_tuple_size = 16,
     memtx_max_tuple_size = 1024 * 1024,
+    memtx_recovery_threads = 4,
+    memtx_snap_index_order = false,
     slab_alloc_factor   = 1.05,
     work_dir            = nil,
     memtx_dir           = ".",
     wal_dir             = ".",
+    wal_stripe_dirs     = nil,
+    wal_prealloc_count  = 0,
 
     vinyl_dir           = '.',
     vinyl_memory        = 128 * 1024 * 1024,
@@ -47,6 +51,8 @@ local default_cfg = {
     vinyl_bloom_fpr           = 0.05,
     log                 = nil,
     log_nonblock        = nil,
+    log_async           = nil,
+    log_async_drop      = nil,
     log_level           = 5,
     log_format          = "plain",
     io_collect_interval = nil,
@@ -55,6 +61,8 @@ local default_cfg = {
     too_long_threshold  = 0.5,
     wal_mode            = "write",
     wal_max_size        = 256 * 1024 * 1024,
+    wal_group_commit_window = 0,
+    wal_group_commit_size = 128 * 1024,
     wal_dir_rescan_delay= 2,
     force_recovery      = false,
     replication         = nil,
@@ -82,6 +90,20 @@ local default_cfg = {
     feedback_host         = "https://feedback.tarantool.io",
     feedback_interval     = 3600,
     net_msg_max           = 768,
+    iproto_threads        = 1,
+    iproto_uring          = false,
+    iproto_buffer_idle_timeout = 60,
+    iproto_critical_msg_max = 64,
+    iproto_critical_users = nil,
+    iproto_reject_overload = false,
+    iproto_shm_listen     = nil,
+    busy_poll             = 0,
+    cpu_affinity_tx       = nil,
+    cpu_affinity_net      = nil,
+    cpu_affinity_wal      = nil,
+    cpu_affinity_relay    = nil,
+    cpu_affinity_vinyl    = nil,
+    cpu_affinity_coio     = nil,
     sql_cache_size        = 5 * 1024 * 1024,
 }
 
@@ -93,10 +115,14 @@ local template_cfg = {
     strip_core          = 'boolean',
     memtx_min_tuple_size  = 'number',
     memtx_max_tuple_size  = 'number',
+    memtx_recovery_threads = 'number',
+    memtx_snap_index_order = 'boolean',
     slab_alloc_factor   = 'number',
     work_dir            = 'string',
     memtx_dir            = 'string',
     wal_dir             = 'string',
+    wal_stripe_dirs     = 'string, table',
+    wal_prealloc_count  = 'number',
     vinyl_dir           = 'string',
     vinyl_memory        = 'number',
     vinyl_cache               = 'number',
@@ -112,6 +138,8 @@ local template_cfg = {
 
     log              = 'string',
     log_nonblock     = 'boolean',
+    log_async        = 'boolean',
+    log_async_drop   = 'boolean',
     log_level           = 'number',
     log_format          = 'string',
     io_collect_interval = 'number',
@@ -120,6 +148,8 @@ local template_cfg = {
     too_long_threshold  = 'number',
     wal_mode            = 'string',
     wal_max_size        = 'number',
+    wal_group_commit_window = 'number',
+    wal_group_commit_size = 'number',
     wal_dir_rescan_delay= 'number',
     force_recovery      = 'boolean',
     replication         = 'string, number, table',
@@ -147,6 +177,20 @@ local template_cfg = {
     feedback_host         = 'string',
     feedback_interval     = 'number',
     net_msg_max           = 'number',
+    iproto_threads        = 'number',
+    iproto_uring          = 'boolean',
+    iproto_buffer_idle_timeout = 'number',
+    iproto_critical_msg_max = 'number',
+    iproto_critical_users = 'string, table',
+    iproto_reject_overload = 'boolean',
+    iproto_shm_listen     = 'string',
+    busy_poll             = 'number',
+    cpu_affinity_tx       = 'string',
+    cpu_affinity_net      = 'string',
+    cpu_affinity_wal      = 'string',
+    cpu_affinity_relay    = 'string',
+    cpu_affinity_vinyl    = 'string',
+    cpu_affinity_coio     = 'string',
     sql_cache_size        = 'number',
 }
 
@@ -255,6 +299,20 @@ local dynamic_cfg = {
     instance_uuid           = check_instance_uuid,
     replicaset_uuid         = check_replicaset_uuid,
     net_msg_max             = private.cfg_set_net_msg_max,
+    iproto_buffer_idle_timeout = private.cfg_set_iproto_buffer_idle_timeout,
+    iproto_critical_msg_max = private.cfg_set_iproto_critical_msg_max,
+    iproto_critical_users   = private.cfg_set_iproto_critical_users,
+    iproto_reject_overload  = private.cfg_set_iproto_reject_overload,
+    iproto_shm_listen       = private.cfg_set_iproto_shm_listen,
+    busy_poll               = private.cfg_set_busy_poll,
+    wal_group_commit_window = private.cfg_set_wal_group_commit,
+    wal_group_commit_size   = private.cfg_set_wal_group_commit,
+    cpu_affinity_tx         = private.cfg_set_cpu_affinity,
+    cpu_affinity_net        = private.cfg_set_cpu_affinity,
+    cpu_affinity_wal        = private.cfg_set_cpu_affinity,
+    cpu_affinity_relay      = private.cfg_set_cpu_affinity,
+    cpu_affinity_vinyl      = private.cfg_set_cpu_affinity,
+    cpu_affinity_coio       = private.cfg_set_cpu_affinity,
     sql_cache_size          = private.cfg_set_sql_cache_size,
 }
 
@@ -324,6 +382,20 @@ local dynamic_cfg_skip_at_load = {
     replicaset_uuid         = true,
     net_msg_max             = true,
     readahead               = true,
+    iproto_buffer_idle_timeout = true,
+    iproto_critical_msg_max = true,
+    iproto_critical_users   = true,
+    iproto_reject_overload  = true,
+    iproto_shm_listen       = true,
+    busy_poll               = true,
+    wal_group_commit_window = true,
+    wal_group_commit_size   = true,
+    cpu_affinity_tx         = true,
+    cpu_affinity_net        = true,
+    cpu_affinity_wal        = true,
+    cpu_affinity_relay      = true,
+    cpu_affinity_vinyl      = true,
+    cpu_affinity_coio       = true,
 }
 
 local function convert_gb(size)
@@ -98,10 +98,12 @@ port_msgpack_dump_lua(struct port *base, struct lua_State *L, bool is_flat)
 static int
 lbox_select(lua_State *L)
 {
-	if (lua_gettop(L) != 6 || !lua_isnumber(L, 1) || !lua_isnumber(L, 2) ||
-		!lua_isnumber(L, 3) || !lua_isnumber(L, 4) || !lua_isnumber(L, 5)) {
+	int argc = lua_gettop(L);
+	if ((argc != 6 && argc != 7) || !lua_isnumber(L, 1) ||
+	    !lua_isnumber(L, 2) || !lua_isnumber(L, 3) ||
+	    !lua_isnumber(L, 4) || !lua_isnumber(L, 5)) {
 		return luaL_error(L, "Usage index:select(iterator, offset, "
-				  "limit, key)");
+				  "limit, key[, after])");
 	}
 
 	uint32_t space_id = lua_tonumber(L, 1);
@@ -112,10 +114,17 @@ lbox_select(lua_State *L)
 
 	size_t key_len;
 	const char *key = lbox_encode_tuple_on_gc(L, 6, &key_len);
+	const char *after = NULL;
+	const char *after_end = NULL;
+	if (argc == 7 && !lua_isnil(L, 7)) {
+		size_t after_len;
+		after = lua_tolstring(L, 7, &after_len);
+		after_end = after + after_len;
+	}
 
 	struct port port;
 	if (box_select(space_id, index_id, iterator, offset, limit,
-		       key, key + key_len, &port) != 0) {
+		       key, key + key_len, after, after_end, &port) != 0) {
 		return luaT_error(L);
 	}
 
@@ -33,6 +33,7 @@
 
 #include <small/ibuf.h>
 #include <msgpuck.h> /* mp_store_u32() */
+#include <zstd.h>
 #include "scramble.h"
 
 #include "box/iproto_constants.h"
@@ -45,6 +46,7 @@
 #include "third_party/base64.h"
 
 #include "coio.h"
+#include "shm_chan.h"
 #include "box/errcode.h"
 #include "lua/fiber.h"
 #include "mpstream.h"
@@ -157,6 +159,27 @@ netbox_encode_auth(lua_State *L)
 	return 0;
 }
 
+static int
+netbox_encode_compress(lua_State *L)
+{
+	if (lua_gettop(L) < 3) {
+		return luaL_error(L, "Usage: netbox.encode_compress(ibuf, "
+				     "sync, algorithm)");
+	}
+
+	struct mpstream stream;
+	size_t svp = netbox_prepare_request(L, &stream, IPROTO_COMPRESS);
+
+	size_t algorithm_len;
+	const char *algorithm = lua_tolstring(L, 3, &algorithm_len);
+	mpstream_encode_map(&stream, 1);
+	mpstream_encode_uint(&stream, IPROTO_COMPRESSION);
+	mpstream_encode_strn(&stream, algorithm, algorithm_len);
+
+	netbox_encode_request(&stream, svp);
+	return 0;
+}
+
 static int
 netbox_encode_call_impl(lua_State *L, enum iproto_type type)
 {
@@ -229,13 +252,19 @@ netbox_encode_select(lua_State *L)
 	if (lua_gettop(L) < 8) {
 		return luaL_error(L, "Usage netbox.encode_select(ibuf, sync, "
 				     "space_id, index_id, iterator, offset, "
-				     "limit, key)");
+				     "limit, key[, fields[, after[, "
+				     "fetch_pos]]])");
 	}
+	int argc = lua_gettop(L);
+	bool has_fields = argc >= 9 && !lua_isnil(L, 9);
+	bool has_after = argc >= 10 && !lua_isnil(L, 10);
+	bool fetch_pos = argc >= 11 && lua_toboolean(L, 11);
 
 	struct mpstream stream;
 	size_t svp = netbox_prepare_request(L, &stream, IPROTO_SELECT);
 
-	mpstream_encode_map(&stream, 6);
+	mpstream_encode_map(&stream, 6 + (has_fields ? 2 : 0) +
+			    (has_after ? 1 : 0) + (fetch_pos ? 1 : 0));
 
 	uint32_t space_id = lua_tonumber(L, 3);
 	uint32_t index_id = lua_tonumber(L, 4);
@@ -263,6 +292,26 @@ netbox_encode_select(lua_State *L)
 	mpstream_encode_uint(&stream, IPROTO_LIMIT);
 	mpstream_encode_uint(&stream, limit);
 
+	/* encode projection, field numbers are 1-based in Lua */
+	if (has_fields) {
+		mpstream_encode_uint(&stream, IPROTO_INDEX_BASE);
+		mpstream_encode_uint(&stream, 1);
+		mpstream_encode_uint(&stream, IPROTO_FIELDS);
+		luamp_encode_tuple(L, cfg, &stream, 9);
+	}
+
+	/* encode pagination */
+	if (has_after) {
+		size_t len;
+		const char *after = lua_tolstring(L, 10, &len);
+		mpstream_encode_uint(&stream, IPROTO_AFTER_POSITION);
+		mpstream_encode_strn(&stream, after, len);
+	}
+	if (fetch_pos) {
+		mpstream_encode_uint(&stream, IPROTO_FETCH_POSITION);
+		mpstream_encode_bool(&stream, true);
+	}
+
 	/* encode key */
 	mpstream_encode_uint(&stream, IPROTO_KEY);
 	luamp_convert_key(L, cfg, &stream, 8);
@@ -450,8 +499,261 @@ netbox_decode_greeting(lua_State *L)
 	return 1;
 }
 
+enum {
+	/** How much to read from the socket at once. */
+	NETBOX_READAHEAD = 16320,
+	/** zstd level used by net.box, the same as iproto uses. */
+	NETBOX_ZSTD_LEVEL = 1,
+};
+
+/**
+ * Period of checking the socket of a shared memory connection
+ * for the server hangup, in seconds.
+ */
+static const ev_tstamp NETBOX_SHM_HANGUP_CHECK_PERIOD = 1;
+
+/**
+ * Streaming compression of a connection switched to compressed
+ * mode with IPROTO_COMPRESS request.
+ */
+struct netbox_compression {
+	ZSTD_CStream *zout;
+	ZSTD_DStream *zin;
+	/** Compressed data which is not sent yet. */
+	struct ibuf send_buf;
+	/** Received data which is not decompressed yet. */
+	struct ibuf recv_buf;
+	/** True if zin may have output without more input. */
+	bool is_zin_full;
+};
+
+static const char netbox_compression_typename[] = "net.box.compression";
+
+static inline struct netbox_compression *
+netbox_check_compression(struct lua_State *L, int idx)
+{
+	return (struct netbox_compression *)
+		luaL_checkudata(L, idx, netbox_compression_typename);
+}
+
 /**
- * communicate(fd, send_buf, recv_buf, limit_or_boundary, timeout)
+ * new_compression(algorithm) -> compression
+ * Create a compression context to pass to communicate().
+ */
+static int
+netbox_new_compression(struct lua_State *L)
+{
+	const char *algorithm = luaL_checkstring(L, 1);
+	if (strcmp(algorithm, "zstd") != 0) {
+		return luaL_error(L, "Unsupported compression algorithm '%s'",
+				  algorithm);
+	}
+	struct netbox_compression *c = (struct netbox_compression *)
+		lua_newuserdata(L, sizeof(*c));
+	memset(c, 0, sizeof(*c));
+	ibuf_create(&c->send_buf, cord_slab_cache(), NETBOX_READAHEAD);
+	ibuf_create(&c->recv_buf, cord_slab_cache(), NETBOX_READAHEAD);
+	luaL_getmetatable(L, netbox_compression_typename);
+	lua_setmetatable(L, -2);
+	c->zout = ZSTD_createCStream();
+	c->zin = ZSTD_createDStream();
+	if (c->zout == NULL || c->zin == NULL)
+		return luaL_error(L, "out of memory");
+	ZSTD_initCStream(c->zout, NETBOX_ZSTD_LEVEL);
+	ZSTD_initDStream(c->zin);
+	return 1;
+}
+
+static int
+netbox_compression_gc(struct lua_State *L)
+{
+	struct netbox_compression *c = netbox_check_compression(L, 1);
+	ZSTD_freeCStream(c->zout);
+	ZSTD_freeDStream(c->zin);
+	ibuf_destroy(&c->send_buf);
+	ibuf_destroy(&c->recv_buf);
+	return 0;
+}
+
+/**
+ * Shared memory channel of a connection to the Unix socket
+ * of box.cfg.iproto_shm_listen. The socket is only used to
+ * receive the channel and to notice the server hangup.
+ */
+struct netbox_shm {
+	struct shm_chan chan;
+	/** False if the channel is not received or closed. */
+	bool is_open;
+	/** True if the server has closed the socket. */
+	bool is_hangup;
+};
+
+static const char netbox_shm_typename[] = "net.box.shm";
+
+static inline struct netbox_shm *
+netbox_check_shm(struct lua_State *L, int idx)
+{
+	return (struct netbox_shm *) luaL_checkudata(L, idx,
+						     netbox_shm_typename);
+}
+
+/**
+ * new_shm(fd, timeout) -> shm
+ *                      -> nil, error
+ * Receive a shared memory channel from a connected socket to
+ * pass it to communicate().
+ */
+static int
+netbox_new_shm(struct lua_State *L)
+{
+	int fd = lua_tointeger(L, 1);
+	ev_tstamp timeout = TIMEOUT_INFINITY;
+	if (lua_type(L, 2) == LUA_TNUMBER)
+		timeout = lua_tonumber(L, 2);
+	struct netbox_shm *shm = (struct netbox_shm *)
+		lua_newuserdata(L, sizeof(*shm));
+	shm->is_open = false;
+	shm->is_hangup = false;
+	luaL_getmetatable(L, netbox_shm_typename);
+	lua_setmetatable(L, -2);
+	while (shm_chan_recv(&shm->chan, fd) != 0) {
+		if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+			goto error;
+		ev_tstamp deadline = ev_monotonic_now(loop()) + timeout;
+		if (coio_wait(fd, EV_READ, timeout) == 0 &&
+		    deadline <= ev_monotonic_now(loop())) {
+			lua_pushnil(L);
+			lua_pushstring(L, "Timeout exceeded");
+			return 2;
+		}
+		luaL_testcancel(L);
+		timeout = MAX(0.0, deadline - ev_monotonic_now(loop()));
+	}
+	shm->is_open = true;
+	return 1;
+error:
+	lua_pushnil(L);
+	lua_pushstring(L, diag_last_error(diag_get())->errmsg);
+	return 2;
+}
+
+static int
+netbox_shm_close(struct lua_State *L)
+{
+	struct netbox_shm *shm = netbox_check_shm(L, 1);
+	if (shm->is_open)
+		shm_chan_destroy(&shm->chan);
+	shm->is_open = false;
+	return 0;
+}
+
+/** recv() from a shared memory channel. */
+static ssize_t
+netbox_shm_recv(struct netbox_shm *shm, void *buf, size_t size)
+{
+	size_t rc = shm_chan_read(&shm->chan, buf, size);
+	if (rc > 0)
+		return rc;
+	if (shm->is_hangup || shm_chan_is_closed(&shm->chan))
+		return 0;
+	errno = EAGAIN;
+	return -1;
+}
+
+/** send() to a shared memory channel. */
+static ssize_t
+netbox_shm_send(struct netbox_shm *shm, const void *buf, size_t size)
+{
+	size_t rc = shm_chan_write(&shm->chan, buf, size);
+	if (rc > 0)
+		return rc;
+	errno = shm_chan_is_broken(&shm->chan) ? EPROTO : EAGAIN;
+	return -1;
+}
+
+/**
+ * Wait for input and, if @a write is set, for space for the
+ * output of a shared memory channel. A crashed server can not
+ * wake the client up, so the socket @a fd is checked for the
+ * hangup periodically. Returns the same as coio_wait().
+ */
+static int
+netbox_shm_wait(struct netbox_shm *shm, int fd, bool write,
+		ev_tstamp timeout)
+{
+	/* The eventfd does not tell what is ready, try both. */
+	int revents = COIO_READ | COIO_WRITE;
+	if (!shm_chan_prepare_wait(&shm->chan, true, write))
+		return revents;
+	ev_tstamp period = MIN(timeout, NETBOX_SHM_HANGUP_CHECK_PERIOD);
+	if (coio_wait(shm->chan.read_efd, EV_READ, period) != 0)
+		return revents;
+	char byte;
+	if (recv(fd, &byte, 1, MSG_PEEK | MSG_DONTWAIT) == 0)
+		shm->is_hangup = true;
+	return shm->is_hangup || timeout > period ? revents : 0;
+}
+
+/**
+ * Compress all data of @a send_buf to the compression send
+ * buffer and flush the compression stream.
+ * Returns 0 on success, the zstd error code otherwise.
+ */
+static size_t
+netbox_compress(struct lua_State *L, struct netbox_compression *c,
+		struct ibuf *send_buf)
+{
+	ZSTD_inBuffer input = {send_buf->rpos, ibuf_used(send_buf), 0};
+	size_t rc;
+	do {
+		if (ibuf_reserve(&c->send_buf, ZSTD_CStreamOutSize()) == NULL)
+			luaL_error(L, "out of memory");
+		ZSTD_outBuffer output = {
+			c->send_buf.wpos, ibuf_unused(&c->send_buf), 0
+		};
+		if (input.pos < input.size)
+			rc = ZSTD_compressStream(c->zout, &output, &input);
+		else
+			rc = ZSTD_flushStream(c->zout, &output);
+		if (ZSTD_isError(rc))
+			return rc;
+		c->send_buf.wpos += output.pos;
+	} while (input.pos < input.size || rc != 0);
+	send_buf->rpos = send_buf->wpos;
+	return 0;
+}
+
+/**
+ * Decompress the received data to @a recv_buf. @a size is set
+ * to the number of decompressed bytes.
+ * Returns 0 on success, the zstd error code otherwise.
+ */
+static size_t
+netbox_decompress(struct netbox_compression *c, struct ibuf *recv_buf,
+		  size_t *size)
+{
+	*size = 0;
+	if (ibuf_used(&c->recv_buf) == 0 && !c->is_zin_full)
+		return 0;
+	ZSTD_inBuffer input = {
+		c->recv_buf.rpos, ibuf_used(&c->recv_buf), 0
+	};
+	ZSTD_outBuffer output = {recv_buf->wpos, ibuf_unused(recv_buf), 0};
+	size_t rc = ZSTD_decompressStream(c->zin, &output, &input);
+	if (ZSTD_isError(rc))
+		return rc;
+	c->recv_buf.rpos += input.pos;
+	if (ibuf_used(&c->recv_buf) == 0)
+		ibuf_reset(&c->recv_buf);
+	c->is_zin_full = output.pos == output.size;
+	recv_buf->wpos += output.pos;
+	*size = output.pos;
+	return 0;
+}
+
+/**
+ * communicate(fd, send_buf, recv_buf, limit_or_boundary, timeout,
+ *             compression, shm)
  *  -> errno, error
  *  -> nil, limit/boundary_pos
  *
@@ -463,14 +765,28 @@ netbox_decode_greeting(lua_State *L)
  * Instead, this function takes an fd, input and output buffer,
  * and does sending and receiving on it in a single event loop
  * interaction.
+ *
+ * If the compression context is passed, the data is compressed
+ * before sending and decompressed after receiving. If the
+ * shared memory channel is passed, the data is sent and
+ * received through it instead of the socket.
  */
 static int
 netbox_communicate(lua_State *L)
 {
 	uint32_t fd = lua_tonumber(L, 1);
-	const int NETBOX_READAHEAD = 16320;
 	struct ibuf *send_buf = (struct ibuf *) lua_topointer(L, 2);
 	struct ibuf *recv_buf = (struct ibuf *) lua_topointer(L, 3);
+	struct netbox_compression *c = NULL;
+	if (!lua_isnoneornil(L, 6))
+		c = netbox_check_compression(L, 6);
+	struct netbox_shm *shm = NULL;
+	if (!lua_isnoneornil(L, 7))
+		shm = netbox_check_shm(L, 7);
+	/* The buffers to do the socket I/O with. */
+	struct ibuf *out = c != NULL ? &c->send_buf : send_buf;
+	struct ibuf *in = c != NULL ? &c->recv_buf : recv_buf;
+	size_t zrc;
 
 	/* limit or boundary */
 	size_t limit = SIZE_MAX;
@@ -515,14 +831,27 @@ check_limit:
 			void *p = ibuf_reserve(recv_buf, NETBOX_READAHEAD);
 			if (p == NULL)
 				luaL_error(L, "out of memory");
-			ssize_t rc = recv(
-				fd, recv_buf->wpos, ibuf_unused(recv_buf), 0);
+			if (c != NULL) {
+				size_t size;
+				zrc = netbox_decompress(c, recv_buf, &size);
+				if (zrc != 0)
+					goto handle_zstd_error;
+				if (size > 0)
+					goto check_limit;
+				p = ibuf_reserve(in, NETBOX_READAHEAD);
+				if (p == NULL)
+					luaL_error(L, "out of memory");
+			}
+			ssize_t rc = shm != NULL ?
+				     netbox_shm_recv(shm, in->wpos,
+						     ibuf_unused(in)) :
+				     recv(fd, in->wpos, ibuf_unused(in), 0);
 			if (rc == 0) {
 				lua_pushinteger(L, ER_NO_CONNECTION);
 				lua_pushstring(L, "Peer closed");
 				return 2;
 			} if (rc > 0) {
-				recv_buf->wpos += rc;
+				in->wpos += rc;
 				goto check_limit;
 			} else if (errno == EAGAIN || errno == EWOULDBLOCK)
 				revents &= ~COIO_READ;
@@ -530,11 +859,18 @@ check_limit:
 				goto handle_error;
 		}
 
-		while ((revents & COIO_WRITE) && ibuf_used(send_buf) != 0) {
-			ssize_t rc = send(
-				fd, send_buf->rpos, ibuf_used(send_buf), 0);
+		if (c != NULL && ibuf_used(send_buf) != 0) {
+			zrc = netbox_compress(L, c, send_buf);
+			if (zrc != 0)
+				goto handle_zstd_error;
+		}
+		while ((revents & COIO_WRITE) && ibuf_used(out) != 0) {
+			ssize_t rc = shm != NULL ?
+				     netbox_shm_send(shm, out->rpos,
+						     ibuf_used(out)) :
+				     send(fd, out->rpos, ibuf_used(out), 0);
 			if (rc >= 0)
-				send_buf->rpos += rc;
+				out->rpos += rc;
 			else if (errno == EAGAIN || errno == EWOULDBLOCK)
 				revents &= ~COIO_WRITE;
 			else if (errno != EINTR)
@@ -542,8 +878,13 @@ check_limit:
 		}
 
 		ev_tstamp deadline = ev_monotonic_now(loop()) + timeout;
-		revents = coio_wait(fd, EV_READ | (ibuf_used(send_buf) != 0 ?
-				EV_WRITE : 0), timeout);
+		if (shm != NULL) {
+			revents = netbox_shm_wait(shm, fd, ibuf_used(out) != 0,
+						  timeout);
+		} else {
+			revents = coio_wait(fd, EV_READ | (ibuf_used(out) != 0 ?
+					    EV_WRITE : 0), timeout);
+		}
 		luaL_testcancel(L);
 		timeout = deadline - ev_monotonic_now(loop());
 		timeout = MAX(0.0, timeout);
@@ -557,6 +898,10 @@ handle_error:
 	lua_pushinteger(L, ER_NO_CONNECTION);
 	lua_pushstring(L, strerror(errno));
 	return 2;
+handle_zstd_error:
+	lua_pushinteger(L, ER_NO_CONNECTION);
+	lua_pushstring(L, ZSTD_getErrorName(zrc));
+	return 2;
 }
 
 static int
@@ -641,10 +986,11 @@ netbox_decode_data(struct lua_State *L, const char **data,
 }
 
 /**
- * Decode Tarantool response body consisting of single
- * IPROTO_DATA key into array of tuples.
+ * Decode Tarantool response body consisting of IPROTO_DATA key
+ * and optional IPROTO_POSITION into array of tuples.
  * @param Lua stack[1] Raw MessagePack pointer.
- * @retval Tuples array and position of the body end.
+ * @retval Tuples array, position of the body end and
+ *         IPROTO_POSITION if present.
  */
 static int
 netbox_decode_select(struct lua_State *L)
@@ -660,14 +1006,23 @@ netbox_decode_select(struct lua_State *L)
 	assert(mp_typeof(*data) == MP_MAP);
 	uint32_t map_size = mp_decode_map(&data);
 	/* Until 2.0 body has no keys except DATA. */
-	assert(map_size == 1);
-	(void) map_size;
+	assert(map_size == 1 || map_size == 2);
 	uint32_t key = mp_decode_uint(&data);
 	assert(key == IPROTO_DATA);
 	(void) key;
 	netbox_decode_data(L, &data, format);
+	const char *position = NULL;
+	uint32_t position_len = 0;
+	if (map_size == 2) {
+		key = mp_decode_uint(&data);
+		assert(key == IPROTO_POSITION);
+		position = mp_decode_str(&data, &position_len);
+	}
 	*(const char **)luaL_pushcdata(L, ctypeid) = data;
-	return 2;
+	if (position == NULL)
+		return 2;
+	lua_pushlstring(L, position, position_len);
+	return 3;
 }
 
 /** Decode optional (i.e. may be present in response) metadata fields. */
@@ -901,13 +1256,28 @@ luaopen_net_box(struct lua_State *L)
 		{ "encode_execute", netbox_encode_execute},
 		{ "encode_prepare", netbox_encode_prepare},
 		{ "encode_auth",    netbox_encode_auth },
+		{ "encode_compress", netbox_encode_compress },
 		{ "decode_greeting",netbox_decode_greeting },
 		{ "communicate",    netbox_communicate },
+		{ "new_compression", netbox_new_compression },
+		{ "new_shm",        netbox_new_shm },
 		{ "decode_select",  netbox_decode_select },
 		{ "decode_execute", netbox_decode_execute },
 		{ "decode_prepare", netbox_decode_prepare },
 		{ NULL, NULL}
 	};
+	static const struct luaL_Reg compression_meta[] = {
+		{ "__gc", netbox_compression_gc },
+		{ NULL, NULL }
+	};
+	luaL_register_type(L, netbox_compression_typename,
+			   compression_meta);
+	static const struct luaL_Reg shm_meta[] = {
+		{ "__gc", netbox_shm_close },
+		{ "close", netbox_shm_close },
+		{ NULL, NULL }
+	};
+	luaL_register_type(L, netbox_shm_typename, shm_meta);
 	/* luaL_register_module polutes _G */
 	lua_newtable(L);
 	luaL_openlib(L, NULL, net_box_lib, 0);
@@ -19,12 +19,15 @@ local decode_map_header = msgpack.decode_map_header
 
 local table_new           = require('table.new')
 local check_iterator_type = box.internal.check_iterator_type
+local check_select_fields = box.internal.check_select_fields
+local check_select_after = box.internal.check_select_after
 local check_index_arg     = box.internal.check_index_arg
 local check_space_arg     = box.internal.check_space_arg
 local check_primary_index = box.internal.check_primary_index
 
 local communicate     = internal.communicate
 local encode_auth     = internal.encode_auth
+local encode_compress = internal.encode_compress
 local encode_select   = internal.encode_select
 local decode_greeting = internal.decode_greeting
 
@@ -68,6 +71,12 @@ local function decode_tuple(raw_data, raw_data_end, format)
     local response, raw_end = internal.decode_select(raw_data, nil, format)
     return response[1], raw_end
 end
+-- Select with IPROTO_FETCH_POSITION returns the tuples and
+-- the position of the last one.
+local function decode_select_pos(raw_data, raw_data_end, format)
+    local tuples, raw_end, pos = internal.decode_select(raw_data, nil, format)
+    return {tuples, pos}, raw_end
+end
 local function decode_get(raw_data, raw_data_end, format)
     local body, raw_end = internal.decode_select(raw_data, nil, format)
     if body[2] then
@@ -103,6 +112,7 @@ local method_encoder = {
     update  = internal.encode_update,
     upsert  = internal.encode_upsert,
     select  = internal.encode_select,
+    select_pos = internal.encode_select,
     execute = internal.encode_execute,
     prepare = internal.encode_prepare,
     unprepare = internal.encode_prepare,
@@ -129,6 +139,7 @@ local method_decoder = {
     update  = decode_tuple,
     upsert  = decode_nil,
     select  = internal.decode_select,
+    select_pos = decode_select_pos,
     execute = internal.decode_execute,
     prepare = internal.decode_prepare,
     unprepare = decode_nil,
@@ -142,35 +153,73 @@ local method_decoder = {
 
 local function next_id(id) return band(id + 1, 0x7FFFFFFF) end
 
+--
+-- Receive a shared memory channel from a socket connected to
+-- box.cfg.iproto_shm_listen and read the greeting from it.
+--
+-- @retval nil, err Error occured. The reason is returned.
+-- @retval two non-nils The channel and the greeting.
+--
+local function establish_shm(s, timeout)
+    local begin = fiber.clock()
+    local shm, err = internal.new_shm(s:fd(), timeout)
+    if not shm then
+        return nil, err
+    end
+    local send_buf = buffer.ibuf()
+    local recv_buf = buffer.ibuf()
+    local msg
+    err, msg = communicate(s:fd(), send_buf, recv_buf, IPROTO_GREETING_SIZE,
+                           timeout - (fiber.clock() - begin), nil, shm)
+    if err then
+        shm:close()
+        return nil, msg
+    end
+    return shm, ffi.string(recv_buf.rpos, IPROTO_GREETING_SIZE)
+end
+
 --
 -- Connect to a remote server, do handshake.
 -- @param host Hostname.
 -- @param port TCP port.
 -- @param timeout Timeout to connect and receive greeting.
+-- @param use_shm Use the shared memory transport.
 --
 -- @retval nil, err Error occured. The reason is returned.
 -- @retval two non-nils A connected socket and a decoded greeting.
+--         The shared memory channel is the third value, if
+--         it is used.
 --
-local function establish_connection(host, port, timeout)
+local function establish_connection(host, port, timeout, use_shm)
     local timeout = timeout or DEFAULT_CONNECT_TIMEOUT
     local begin = fiber.clock()
     local s = socket.tcp_connect(host, port, timeout)
     if not s then
         return nil, errno.strerror(errno())
     end
-    local msg = s:read({chunk = IPROTO_GREETING_SIZE},
-                        timeout - (fiber.clock() - begin))
-    if not msg then
-        local err = s:error()
-        s:close()
-        return nil, err
+    local msg, shm
+    if use_shm then
+        shm, msg = establish_shm(s, timeout - (fiber.clock() - begin))
+        if not shm then
+            s:close()
+            return nil, msg
+        end
+    else
+        msg = s:read({chunk = IPROTO_GREETING_SIZE},
+                     timeout - (fiber.clock() - begin))
+        if not msg then
+            local err = s:error()
+            s:close()
+            return nil, err
+        end
     end
     local greeting, err = decode_greeting(msg)
     if not greeting then
+        if shm then shm:close() end
         s:close()
         return nil, err
     end
-    return s, greeting
+    return s, greeting, shm
 end
 
 --
@@ -201,7 +250,7 @@ local function on_push_sync_default(...) end
 --
 -- connecting -> initial +-> active
 --                        \
---                         +-> auth -> fetch_schema <-> active
+--                         +-> [compress ->] auth -> fetch_schema <-> active
 --
 --  (any state, on error) -> error_reconnect -> connecting -> ...
 --                                           \
@@ -224,6 +273,8 @@ local function on_push_sync_default(...) end
 --  'did_fetch_schema', schema_version, spaces, indices
 --  'reconnect_timeout'   -> get reconnect timeout if set and > 0,
 --                           else nil is returned.
+--  'compression'         -> compression algorithm name or nil
+--  'shm'                 -> true to use the shared memory transport
 --
 -- Suggestion for callback writers: sleep a few secs before approving
 -- reconnect.
@@ -256,6 +307,10 @@ local function create_transport(host, port, user, password, callback,
     local worker_fiber
     local send_buf         = buffer.ibuf(buffer.READAHEAD)
     local recv_buf         = buffer.ibuf(buffer.READAHEAD)
+    -- Compression context, if the connection is compressed.
+    local compression
+    -- Shared memory channel, if the connection uses it.
+    local shm
 
     --
     -- Async request metamethods.
@@ -452,6 +507,10 @@ local function create_transport(host, port, user, password, callback,
                 connection:close()
                 connection = nil
             end
+            if shm then
+                shm:close()
+                shm = nil
+            end
             timeout = callback('reconnect_timeout')
     ::do_reconnect::
             if not timeout or state ~= 'error_reconnect' then
@@ -463,8 +522,9 @@ local function create_transport(host, port, user, password, callback,
                 goto stop
             end
     ::do_connect::
-            connection, greeting =
-                establish_connection(host, port, callback('fetch_connect_timeout'))
+            connection, greeting, shm =
+                establish_connection(host, port, callback('fetch_connect_timeout'),
+                                     callback('shm'))
             if connection then
                 goto handle_connection
             end
@@ -618,7 +678,7 @@ local function create_transport(host, port, user, password, callback,
     -- IO (WORKER FIBER) --
     local function send_and_recv(limit_or_boundary, timeout)
         return communicate(connection:fd(), send_buf, recv_buf,
-                           limit_or_boundary, timeout)
+                           limit_or_boundary, timeout, compression, shm)
     end
 
     local function send_and_recv_iproto(timeout)
@@ -664,7 +724,8 @@ local function create_transport(host, port, user, password, callback,
     -- tail-recursive calls to each other. Yep, Lua optimizes
     -- such calls, and yep, this is the canonical way to implement
     -- a state machine in Lua.
-    local console_sm, iproto_auth_sm, iproto_schema_sm, iproto_sm, error_sm
+    local console_sm, iproto_compress_sm, iproto_auth_sm, iproto_schema_sm
+    local iproto_sm, error_sm
 
     --
     -- Protocol_sm is a core function of netbox. It calls all
@@ -697,7 +758,7 @@ local function create_transport(host, port, user, password, callback,
             set_state('active')
             return console_sm(rid)
         elseif greeting.protocol == 'Binary' then
-            return iproto_auth_sm(greeting.salt)
+            return iproto_compress_sm(greeting.salt)
         else
             return error_sm(E_NO_CONNECTION,
                             'Unknown protocol: '..greeting.protocol)
@@ -722,6 +783,28 @@ local function create_transport(host, port, user, password, callback,
         end
     end
 
+    iproto_compress_sm = function(salt)
+        local algorithm = callback('compression')
+        if not algorithm then
+            return iproto_auth_sm(salt)
+        end
+        set_state('compress')
+        -- The data following the request and the reply is
+        -- compressed, so nothing is sent until the reply comes.
+        encode_compress(send_buf, new_request_id(), algorithm)
+        local err, hdr, body_rpos, body_end = send_and_recv_iproto()
+        if err then
+            return error_sm(err, hdr)
+        end
+        if hdr[IPROTO_STATUS_KEY] ~= 0 then
+            local body
+            body, body_end = decode(body_rpos)
+            return error_sm(E_NO_CONNECTION, body[IPROTO_ERROR_KEY])
+        end
+        compression = internal.new_compression(algorithm)
+        return iproto_auth_sm(salt)
+    end
+
     iproto_auth_sm = function(salt)
         set_state('auth')
         if not user or not password then
@@ -822,8 +905,10 @@ local function create_transport(host, port, user, password, callback,
 
     error_sm = function(err, msg)
         if connection then connection:close(); connection = nil end
+        if shm then shm:close(); shm = nil end
         send_buf:recycle()
         recv_buf:recycle()
+        compression = nil
         if state ~= 'closed' then
             if callback('reconnect_timeout') then
                 set_state('error_reconnect', err, msg)
@@ -975,6 +1060,10 @@ local function new_sm(host, port, opts, connection, greeting)
                opts.reconnect_after > 0 then
                 return opts.reconnect_after
             end
+        elseif what == 'compression' then
+            return opts.compression
+        elseif what == 'shm' then
+            return opts.shm
         end
     end
     -- @deprecated since 1.10
@@ -1451,9 +1540,23 @@ index_metatable = function(remote)
         local iterator = check_iterator_type(opts, key_is_nil)
         local offset = tonumber(opts and opts.offset) or 0
         local limit = tonumber(opts and opts.limit) or 0xFFFFFFFF
-        return (remote:_request('select', opts, self.space._format_cdata,
-                                self.space.id, self.id, iterator, offset,
-                                limit, key))
+        local fields = check_select_fields(opts)
+        local after = check_select_after(opts)
+        local fetch_pos = type(opts) == 'table' and opts.fetch_pos == true
+        -- Projected tuples don't match the space format.
+        local format = fields == nil and self.space._format_cdata or nil
+        if not fetch_pos then
+            return (remote:_request('select', opts, format, self.space.id,
+                                    self.id, iterator, offset, limit, key,
+                                    fields, after))
+        end
+        local res = remote:_request('select_pos', opts, format,
+                                    self.space.id, self.id, iterator,
+                                    offset, limit, key, fields, after, true)
+        if opts.is_async or opts.buffer ~= nil then
+            return res
+        end
+        return res[1], res[2]
     end
 
     function methods:get(key, opts)
@@ -0,0 +1,210 @@
+/*
+ * Copyright 2010-2020, Tarantool AUTHORS, please see AUTHORS file.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include "box/lua/profiler.h"
+
+#include <stdio.h>
+
+#include <lua.h>
+#include <lauxlib.h>
+#include <lualib.h>
+
+#include "lua/utils.h"
+#include "lua/init.h"
+
+#include "fiber.h"
+#include "profiler.h"
+
+enum {
+	/** Max number of Lua frames in a sample. */
+	LUA_PROFILER_DEPTH_MAX = 32,
+	/** Max length of a Lua frame name. */
+	LUA_PROFILER_FRAME_MAX = 64,
+};
+
+/**
+ * The sample waiting for its Lua stack. The stack can not be
+ * walked in the signal handler, since the interrupted code may
+ * be in the middle of a Lua VM instruction. Instead, the
+ * handler sets a count hook, which is invoked at the next
+ * instruction executed by the VM.
+ */
+static struct profiler_sample *volatile lua_profiler_pending = NULL;
+
+static void
+lua_profiler_hook(struct lua_State *L, lua_Debug *ar);
+
+/** Discard the pending sample and remove the hook. */
+static void
+lua_profiler_reset(void)
+{
+	lua_profiler_pending = NULL;
+	if (lua_gethook(tarantool_L) == lua_profiler_hook)
+		lua_sethook(tarantool_L, NULL, 0, 0);
+}
+
+static void
+lua_profiler_hook(struct lua_State *L, lua_Debug *ar)
+{
+	(void) ar;
+	struct profiler_sample *sample = lua_profiler_pending;
+	lua_profiler_reset();
+	/*
+	 * The hook is global, skip it if the sampled fiber has
+	 * switched to C code and another fiber has run Lua.
+	 */
+	if (sample == NULL || sample->fid != fiber()->fid)
+		return;
+	char frames[LUA_PROFILER_DEPTH_MAX][LUA_PROFILER_FRAME_MAX];
+	int depth = 0;
+	lua_Debug info;
+	while (depth < LUA_PROFILER_DEPTH_MAX &&
+	       lua_getstack(L, depth, &info) == 1) {
+		lua_getinfo(L, "Sn", &info);
+		if (*info.what == 'C') {
+			snprintf(frames[depth], LUA_PROFILER_FRAME_MAX, "%s",
+				 info.name != NULL ? info.name : "[C]");
+		} else {
+			snprintf(frames[depth], LUA_PROFILER_FRAME_MAX,
+				 "%s@%s:%d", info.name != NULL ? info.name :
+				 "?", info.short_src, info.linedefined);
+		}
+		depth++;
+	}
+	/* Fold the stack, the outermost frame first. */
+	char *pos = sample->lua_stack;
+	char *end = sample->lua_stack + sizeof(sample->lua_stack);
+	for (int i = depth - 1; i >= 0 && pos < end; i--) {
+		pos += snprintf(pos, end - pos, i == depth - 1 ? "%s" : ";%s",
+				frames[i]);
+	}
+}
+
+/**
+ * Is called by the signal handler of the profiler for the
+ * samples taken in the main cord.
+ */
+static void
+lua_profiler_sample(struct profiler_sample *sample)
+{
+	if (fiber()->storage.lua.stack == NULL)
+		return;
+	/* Do not override a hook set by the user. */
+	lua_Hook hook = lua_gethook(tarantool_L);
+	if (hook != NULL && hook != lua_profiler_hook)
+		return;
+	lua_profiler_pending = sample;
+	lua_sethook(tarantool_L, lua_profiler_hook, LUA_MASKCOUNT, 1);
+}
+
+/**
+ * box.profiler.start({interval = <seconds>, samples = <count>})
+ */
+static int
+lbox_profiler_start(struct lua_State *L)
+{
+	double interval = PROFILER_INTERVAL_DEFAULT;
+	uint32_t sample_max = PROFILER_SAMPLE_MAX_DEFAULT;
+	if (lua_gettop(L) > 0 && !lua_isnil(L, 1)) {
+		if (!lua_istable(L, 1))
+			return luaL_error(L, "Usage: box.profiler.start("
+					  "{interval = <seconds>, "
+					  "samples = <count>})");
+		lua_getfield(L, 1, "interval");
+		if (!lua_isnil(L, -1))
+			interval = luaL_checknumber(L, -1);
+		lua_getfield(L, 1, "samples");
+		if (!lua_isnil(L, -1)) {
+			lua_Integer count = luaL_checkinteger(L, -1);
+			if (count <= 0 || count > UINT32_MAX)
+				return luaL_error(L, "samples must be a "
+						  "positive number");
+			sample_max = count;
+		}
+		lua_pop(L, 2);
+	}
+	lua_profiler_reset();
+	if (profiler_start(interval, sample_max) != 0)
+		return luaT_error(L);
+	return 0;
+}
+
+static int
+lbox_profiler_stop(struct lua_State *L)
+{
+	(void) L;
+	profiler_stop();
+	lua_profiler_reset();
+	return 0;
+}
+
+/**
+ * box.profiler.dump(path) writes the samples as folded stacks
+ * and returns the number of written stacks.
+ */
+static int
+lbox_profiler_dump(struct lua_State *L)
+{
+	const char *path = luaL_checkstring(L, 1);
+	int count = profiler_dump(path);
+	if (count < 0)
+		return luaT_error(L);
+	lua_pushinteger(L, count);
+	return 1;
+}
+
+static int
+lbox_profiler_info(struct lua_State *L)
+{
+	lua_createtable(L, 0, 3);
+	lua_pushboolean(L, profiler_is_running());
+	lua_setfield(L, -2, "running");
+	luaL_pushuint64(L, profiler_sample_count());
+	lua_setfield(L, -2, "samples");
+	luaL_pushuint64(L, profiler_dropped_count());
+	lua_setfield(L, -2, "dropped");
+	return 1;
+}
+
+static const struct luaL_Reg lbox_profiler_lib[] = {
+	{"start", lbox_profiler_start},
+	{"stop", lbox_profiler_stop},
+	{"dump", lbox_profiler_dump},
+	{"info", lbox_profiler_info},
+	{NULL, NULL}
+};
+
+void
+box_lua_profiler_init(struct lua_State *L)
+{
+	profiler_lua_sample_cb = lua_profiler_sample;
+	luaL_register_module(L, "box.profiler", lbox_profiler_lib);
+	lua_pop(L, 1);
+}
@@ -43,6 +43,10 @@ ffi.cdef[[
     void
     box_iterator_free(box_iterator_t *itr);
     /** \endcond public */
+    box_iterator_t *
+    box_index_iterator_after(uint32_t space_id, uint32_t index_id, int type,
+                             const char *key, const char *key_end,
+                             const char *pos, const char *pos_end);
     /** \cond public */
     ssize_t
     box_index_len(uint32_t space_id, uint32_t index_id);
@@ -101,6 +105,7 @@ ffi.cdef[[
     box_select(uint32_t space_id, uint32_t index_id,
                int iterator, uint32_t offset, uint32_t limit,
                const char *key, const char *key_end,
+               const char *after, const char *after_end,
                struct port *port);
 
     void password_prepare(const char *password, int len,
@@ -1359,6 +1364,60 @@ end
 
 internal.check_iterator_type = check_iterator_type -- export for net.box
 
+-- Check the 'fields' option of select: a projection of the
+-- result tuples to the listed fields. A field is a number or
+-- a JSON path, like in tuple[field].
+local function check_select_fields(opts)
+    if type(opts) ~= 'table' or opts.fields == nil then
+        return nil
+    end
+    local fields = opts.fields
+    if type(fields) ~= 'table' then
+        box.error(box.error.ILLEGAL_PARAMS,
+                  "options parameter 'fields' should be of type table")
+    end
+    for _, field in ipairs(fields) do
+        if type(field) ~= 'number' and
+           (type(field) ~= 'string' or #field == 0) then
+            box.error(box.error.ILLEGAL_PARAMS, "projection field "..
+                      "must be a field number or a JSON path")
+        end
+    end
+    return fields
+end
+
+internal.check_select_fields = check_select_fields -- export for net.box
+
+-- Check the 'after' option of select and pairs: the position
+-- to continue the iteration after, as returned by
+-- index:tuple_pos() or select with 'fetch_pos'.
+local function check_select_after(opts)
+    if type(opts) ~= 'table' or opts.after == nil then
+        return nil
+    end
+    if type(opts.after) ~= 'string' then
+        box.error(box.error.ILLEGAL_PARAMS,
+                  "options parameter 'after' should be of type string")
+    end
+    return opts.after
+end
+
+internal.check_select_after = check_select_after -- export for net.box
+
+-- Make a tuple of the given fields of a tuple, a missing field
+-- is nil.
+local function tuple_project(tuple, fields)
+    local values = {}
+    for i, field in ipairs(fields) do
+        local value = tuple[field]
+        if value == nil then
+            value = box.NULL
+        end
+        values[i] = value
+    end
+    return box.tuple.new(values)
+end
+
 local base_index_mt = {}
 base_index_mt.__index = base_index_mt
 --
@@ -1456,11 +1515,22 @@ base_index_mt.pairs_ffi = function(index, key, opts)
     check_index_arg(index, 'pairs')
     local pkey, pkey_end = tuple_encode(key)
     local itype = check_iterator_type(opts, pkey + 1 >= pkey_end);
+    local after = check_select_after(opts)
 
     local keybuf = ffi.string(pkey, pkey_end - pkey)
     local pkeybuf = ffi.cast('const char *', keybuf)
-    local cdata = builtin.box_index_iterator(index.space_id, index.id,
-        itype, pkeybuf, pkeybuf + #keybuf);
+    local cdata
+    if after == nil then
+        cdata = builtin.box_index_iterator(index.space_id, index.id,
+            itype, pkeybuf, pkeybuf + #keybuf);
+    else
+        -- The iterator reads the position on the first step,
+        -- keep it along with the key.
+        local pafter = ffi.cast('const char *', after)
+        cdata = builtin.box_index_iterator_after(index.space_id, index.id,
+            itype, pkeybuf, pkeybuf + #keybuf, pafter, pafter + #after);
+        keybuf = {keybuf, after}
+    end
     if cdata == nil then
         box.error()
     end
@@ -1471,9 +1541,14 @@ base_index_mt.pairs_luac = function(index, key, opts)
     check_index_arg(index, 'pairs')
     key = keify(key)
     local itype = check_iterator_type(opts, #key == 0);
+    local after = check_select_after(opts)
     local keymp = msgpack.encode(key)
     local keybuf = ffi.string(keymp, #keymp)
-    local cdata = internal.iterator(index.space_id, index.id, itype, keymp);
+    local cdata = internal.iterator(index.space_id, index.id, itype, keymp,
+                                    after);
+    if after ~= nil then
+        keybuf = {keybuf, after}
+    end
     return fun.wrap(iterator_gen_luac, keybuf,
         ffi.gc(cdata, builtin.box_iterator_free))
 end
@@ -1527,18 +1602,44 @@ local function check_select_opts(opts, key_is_nil)
             limit = opts.limit
         end
     end
-    return iterator, offset, limit
+    local fetch_pos = type(opts) == 'table' and opts.fetch_pos == true
+    return iterator, offset, limit, check_select_fields(opts),
+           check_select_after(opts), fetch_pos
+end
+
+-- Finish select with the 'fields' and 'fetch_pos' options.
+local function select_result(index, ret, fields, fetch_pos)
+    local pos
+    if fetch_pos and #ret > 0 then
+        pos = internal.tuple_pos(index.space_id, index.id, ret[#ret])
+    end
+    if fields ~= nil then
+        for i, tuple in ipairs(ret) do
+            ret[i] = tuple_project(tuple, fields)
+        end
+    end
+    if fetch_pos then
+        return ret, pos
+    end
+    return ret
 end
 
 base_index_mt.select_ffi = function(index, key, opts)
     check_index_arg(index, 'select')
     local key, key_end = tuple_encode(key)
-    local iterator, offset, limit = check_select_opts(opts, key + 1 >= key_end)
+    local iterator, offset, limit, fields, after, fetch_pos =
+        check_select_opts(opts, key + 1 >= key_end)
 
     local port = ffi.cast('struct port *', port_tuple)
+    local pafter, pafter_end
+    if after ~= nil then
+        pafter = ffi.cast('const char *', after)
+        pafter_end = pafter + #after
+    end
 
     if builtin.box_select(index.space_id, index.id,
-        iterator, offset, limit, key, key_end, port) ~= 0 then
+        iterator, offset, limit, key, key_end, pafter, pafter_end,
+        port) ~= 0 then
         return box.error()
     end
 
@@ -1549,15 +1650,25 @@ base_index_mt.select_ffi = function(index, key, opts)
         entry = entry.next
     end
     builtin.port_destroy(port);
-    return ret
+    if fields == nil and not fetch_pos then
+        return ret
+    end
+    return select_result(index, ret, fields, fetch_pos)
 end
 
 base_index_mt.select_luac = function(index, key, opts)
     check_index_arg(index, 'select')
     local key = keify(key)
-    local iterator, offset, limit = check_select_opts(opts, #key == 0)
-    return internal.select(index.space_id, index.id, iterator,
-        offset, limit, key)
+    local iterator, offset, limit, fields, after, fetch_pos =
+        check_select_opts(opts, #key == 0)
+    local ret = internal.select(index.space_id, index.id, iterator,
+        offset, limit, key, after)
+    return select_result(index, ret, fields, fetch_pos)
+end
+
+base_index_mt.tuple_pos = function(index, tuple)
+    check_index_arg(index, 'tuple_pos')
+    return internal.tuple_pos(index.space_id, index.id, tuple)
 end
 
 base_index_mt.update = function(index, key, ops)
@@ -43,14 +43,13 @@
 #include "box/engine.h"
 #include "box/vinyl.h"
 #include "box/sql.h"
+#include "box/wal.h"
 #include "info/info.h"
 #include "lua/info.h"
 #include "lua/utils.h"
 
 extern struct rmean *rmean_box;
 extern struct rmean *rmean_error;
-/** network statistics (iproto & cbus) */
-extern struct rmean *rmean_net;
 extern struct rmean *rmean_tx_wal_bus;
 
 static void
@@ -136,6 +135,22 @@ lbox_stat_reset(struct lua_State *L)
 	return 0;
 }
 
+/**
+ * Push a table with memory held by connection buffers: in
+ * total and per connection on average.
+ */
+static void
+push_buffers_item(struct lua_State *L, size_t mem, size_t connections)
+{
+	lua_newtable(L);
+	lua_pushstring(L, "current");
+	lua_pushnumber(L, mem);
+	lua_rawset(L, -3);
+	lua_pushstring(L, "per_connection");
+	lua_pushnumber(L, connections != 0 ? mem / connections : 0);
+	lua_rawset(L, -3);
+}
+
 /**
  * Push a table with a network metric to a Lua stack.
  *
@@ -148,7 +163,12 @@ static int
 lbox_stat_net_index(struct lua_State *L)
 {
 	const char *key = luaL_checkstring(L, -1);
-	if (rmean_foreach(rmean_net, seek_stat_item, L) == 0)
+	if (strcmp(key, "BUFFERS") == 0) {
+		push_buffers_item(L, iproto_buffer_mem_used(),
+				  iproto_connection_count());
+		return 1;
+	}
+	if (iproto_rmean_foreach(seek_stat_item, L) == 0)
 		return 0;
 
 	if (strcmp(key, "CONNECTIONS") == 0) {
@@ -170,7 +190,9 @@ lbox_stat_net_index(struct lua_State *L)
  *
  * - SENT (packets): total, rps;
  * - RECEIVED (packets): total, rps;
+ * - REJECTED (requests over the quota of their class): total, rps;
  * - CONNECTIONS: current.
+ * - BUFFERS (bytes): current, per_connection.
  *
  * These fields have the following meaning:
  *
@@ -183,7 +205,7 @@ static int
 lbox_stat_net_call(struct lua_State *L)
 {
 	lua_newtable(L);
-	rmean_foreach(rmean_net, set_stat_item, L);
+	iproto_rmean_foreach(set_stat_item, L);
 
 	lua_pushstring(L, "CONNECTIONS");
 	lua_rawget(L, -2);
@@ -199,6 +221,103 @@ lbox_stat_net_call(struct lua_State *L)
 	lua_rawset(L, -3);
 	lua_pop(L, 1);
 
+	lua_pushstring(L, "BUFFERS");
+	push_buffers_item(L, iproto_buffer_mem_used(),
+			  iproto_connection_count());
+	lua_rawset(L, -3);
+
+	return 1;
+}
+
+/**
+ * Push an array of per-thread network metrics to a Lua stack.
+ * Every element has the same format as lbox_stat_net_call()
+ * result and describes one iproto thread.
+ */
+static int
+lbox_stat_net_thread(struct lua_State *L)
+{
+	lua_createtable(L, iproto_threads_count, 0);
+	for (int i = 0; i < iproto_threads_count; i++) {
+		lua_newtable(L);
+		iproto_thread_rmean_foreach(i, set_stat_item, L);
+
+		lua_pushstring(L, "CONNECTIONS");
+		lua_rawget(L, -2);
+		lua_pushstring(L, "current");
+		lua_pushnumber(L, iproto_thread_connection_count(i));
+		lua_rawset(L, -3);
+		lua_pop(L, 1);
+
+		lua_pushstring(L, "REQUESTS");
+		lua_rawget(L, -2);
+		lua_pushstring(L, "current");
+		lua_pushnumber(L, iproto_thread_request_count(i));
+		lua_rawset(L, -3);
+		lua_pop(L, 1);
+
+		lua_pushstring(L, "BUFFERS");
+		push_buffers_item(L, iproto_thread_buffer_mem_used(i),
+				  iproto_thread_connection_count(i));
+		lua_rawset(L, -3);
+
+		lua_rawseti(L, -2, i + 1);
+	}
+	return 1;
+}
+
+/**
+ * Push a table of request latencies to a Lua stack. For every
+ * request type it contains p50, p99 and p999 percentiles, in
+ * seconds, of time spent in the network queue (net), in the
+ * transaction processor (tx), waiting for WAL (wal) and writing
+ * the reply to the socket (flush).
+ */
+static int
+lbox_stat_latency(struct lua_State *L)
+{
+	struct info_handler info;
+	luaT_info_handler_create(&info, L);
+	iproto_latency_stat(&info);
+	return 1;
+}
+
+/**
+ * Push a table of busy polling statistics of the tx, iproto and
+ * WAL threads to a Lua stack.
+ */
+static int
+lbox_stat_busy_poll(struct lua_State *L)
+{
+	struct info_handler info;
+	luaT_info_handler_create(&info, L);
+	box_busy_poll_stat(&info);
+	return 1;
+}
+
+/**
+ * Push a table of coio thread pool statistics to a Lua stack.
+ */
+static int
+lbox_stat_coio(struct lua_State *L)
+{
+	struct info_handler info;
+	luaT_info_handler_create(&info, L);
+	box_coio_stat(&info);
+	return 1;
+}
+
+/**
+ * Push a table of WAL statistics to a Lua stack: histograms
+ * of the sizes of the written batches and of the time to
+ * write a batch in the fsync mode.
+ */
+static int
+lbox_stat_wal(struct lua_State *L)
+{
+	struct info_handler info;
+	luaT_info_handler_create(&info, L);
+	wal_stat(&info);
 	return 1;
 }
 
@@ -231,6 +350,10 @@ box_lua_stat_init(struct lua_State *L)
 		{"vinyl", lbox_stat_vinyl},
 		{"reset", lbox_stat_reset},
 		{"sql", lbox_stat_sql},
+		{"latency", lbox_stat_latency},
+		{"busy_poll", lbox_stat_busy_poll},
+		{"coio", lbox_stat_coio},
+		{"wal", lbox_stat_wal},
 		{NULL, NULL}
 	};
 
@@ -242,6 +365,7 @@ box_lua_stat_init(struct lua_State *L)
 	lua_pop(L, 1); /* stat module */
 
 	static const struct luaL_Reg netstatlib [] = {
+		{"thread", lbox_stat_net_thread},
 		{NULL, NULL}
 	};
 
@@ -489,6 +489,7 @@ static const struct index_vtab memtx_bitset_index_vtab = {
 	/* .get = */ generic_index_get,
 	/* .replace = */ memtx_bitset_index_replace,
 	/* .create_iterator = */ memtx_bitset_index_create_iterator,
+	/* .create_iterator_after = */ generic_index_create_iterator_after,
 	/* .create_snapshot_iterator = */
 		generic_index_create_snapshot_iterator,
 	/* .stat = */ generic_index_stat,
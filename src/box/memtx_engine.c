@@ -34,20 +34,26 @@
 #include <small/quota.h>
 #include <small/small.h>
 #include <small/mempool.h>
+#include <msgpuck.h>
 
 #include "fiber.h"
+#include "clock.h"
+#include "tt_pthread.h"
 #include "errinj.h"
 #include "coio_file.h"
 #include "tuple.h"
 #include "txn.h"
 #include "memtx_tree.h"
+#include "assoc.h"
 #include "iproto_constants.h"
 #include "xrow.h"
 #include "xstream.h"
+#include "snap_reader.h"
 #include "bootstrap.h"
 #include "replication.h"
 #include "schema.h"
 #include "gc.h"
+#include "affinity.h"
 
 /* sync snapshot every 16MB */
 #define SNAP_SYNC_INTERVAL	(1 << 24)
@@ -58,6 +64,9 @@ checkpoint_cancel(struct checkpoint *ckpt);
 static void
 replica_join_cancel(struct cord *replica_join_cord);
 
+static void
+memtx_index_extent_refill(struct memtx_engine *memtx);
+
 struct PACKED memtx_tuple {
 	/*
 	 * sic: the header of the tuple is used
@@ -74,8 +83,30 @@ enum {
 	OBJSIZE_MIN = 16,
 	SLAB_SIZE = 16 * 1024 * 1024,
 	MAX_TUPLE_SIZE = 1 * 1024 * 1024,
+	/** Max number of row numbers in a MEMTX_INDEX_ORDER row. */
+	MEMTX_INDEX_ORDER_CHUNK = 16 * 1024,
+	/**
+	 * Index memory a secondary key build is expected to take
+	 * per tuple, to reserve extents for the worker threads.
+	 */
+	MEMTX_BUILD_BYTES_PER_TUPLE = 48,
+	/** Number of extents the tx thread adds on a refill. */
+	MEMTX_BUILD_EXTENT_BATCH = 64,
 };
 
+/**
+ * True if the snapshot stores the order of the index. Only
+ * secondary TREE keys with a key per tuple are stored, which
+ * have as many entries as the primary key.
+ */
+static bool
+memtx_index_order_is_stored(struct index *index)
+{
+	return index->def->iid > 0 && index->def->type == TREE &&
+	       !index->def->key_def->is_multikey &&
+	       !index->def->key_def->for_func_index;
+}
+
 static int
 memtx_end_build_primary_key(struct space *space, void *param)
 {
@@ -126,6 +157,367 @@ memtx_build_secondary_keys(struct space *space, void *param)
 	return 0;
 }
 
+/** Enable secondary keys built by memtx_build_secondary_keys_parallel(). */
+static int
+memtx_enable_secondary_keys(struct space *space, void *param)
+{
+	struct memtx_space *memtx_space = (struct memtx_space *)space;
+	if (space->engine != param || space_index(space, 0) == NULL ||
+	    memtx_space->replace == memtx_space_replace_all_keys)
+		return 0;
+	memtx_space->replace = memtx_space_replace_all_keys;
+	return 0;
+}
+
+/** A secondary key built by memtx_build_secondary_keys_parallel(). */
+struct memtx_build_task {
+	struct space *space;
+	struct index *index;
+	/** Tuples of the primary key, shared by tasks of the space. */
+	struct tuple **tuples;
+	uint32_t tuple_count;
+	/** Set if the task frees @tuples. */
+	bool owns_tuples;
+	/** Time the build took, in seconds. */
+	double time;
+	/** Build error. */
+	struct diag diag;
+};
+
+struct memtx_build_ctx {
+	struct memtx_engine *memtx;
+	/**
+	 * Tasks of the tx thread followed by the tasks the worker
+	 * threads can run, the largest first.
+	 */
+	struct memtx_build_task *tasks;
+	int task_count;
+	int task_capacity;
+	/** Number of tasks which must be run by the tx thread. */
+	int tx_task_count;
+	/** Next task for the workers, protected by @mutex. */
+	int next_task;
+	/** Set on error to stop the workers. */
+	bool is_failed;
+	pthread_mutex_t mutex;
+	/**
+	 * Number of running workers, protected by
+	 * memtx_engine::index_extent_lock.
+	 */
+	int worker_count;
+};
+
+/**
+ * Functional keys are computed by Lua functions and are
+ * allocated by memtx, so they are built by the tx thread.
+ * Other memtx indexes only allocate index extents, which are
+ * shared while the workers run.
+ */
+static bool
+memtx_index_build_is_thread_safe(struct index *index)
+{
+	return !index->def->key_def->for_func_index;
+}
+
+static int
+memtx_add_build_tasks(struct space *space, void *param)
+{
+	struct memtx_build_ctx *ctx = (struct memtx_build_ctx *)param;
+	struct memtx_space *memtx_space = (struct memtx_space *)space;
+	if (space->engine != (struct engine *)ctx->memtx ||
+	    space_index(space, 0) == NULL ||
+	    memtx_space->replace == memtx_space_replace_all_keys ||
+	    space->index_count <= 1)
+		return 0;
+
+	struct index *pk = space->index[0];
+	ssize_t n_tuples = index_size(pk);
+	if (n_tuples < 0)
+		return -1;
+	struct tuple **tuples = NULL;
+	if (n_tuples > 0) {
+		size_t size = n_tuples * sizeof(*tuples);
+		tuples = (struct tuple **)malloc(size);
+		if (tuples == NULL) {
+			diag_set(OutOfMemory, size, "malloc", "tuples");
+			return -1;
+		}
+		struct iterator *it = index_create_iterator(pk, ITER_ALL,
+							    NULL, 0);
+		if (it == NULL) {
+			free(tuples);
+			return -1;
+		}
+		ssize_t count = 0;
+		struct tuple *tuple;
+		int rc;
+		while ((rc = iterator_next(it, &tuple)) == 0 &&
+		       tuple != NULL) {
+			assert(count < n_tuples);
+			tuples[count++] = tuple;
+		}
+		iterator_delete(it);
+		if (rc != 0) {
+			free(tuples);
+			return -1;
+		}
+		assert(count == n_tuples);
+	}
+
+	int count = ctx->task_count + space->index_count - 1;
+	if (count > ctx->task_capacity) {
+		int capacity = MAX(count, ctx->task_capacity * 2);
+		size_t size = capacity * sizeof(*ctx->tasks);
+		struct memtx_build_task *tasks =
+			(struct memtx_build_task *)realloc(ctx->tasks, size);
+		if (tasks == NULL) {
+			diag_set(OutOfMemory, size, "realloc", "tasks");
+			free(tuples);
+			return -1;
+		}
+		ctx->tasks = tasks;
+		ctx->task_capacity = capacity;
+	}
+	for (uint32_t j = 1; j < space->index_count; j++) {
+		struct memtx_build_task *task = &ctx->tasks[ctx->task_count++];
+		task->space = space;
+		task->index = space->index[j];
+		task->tuples = tuples;
+		task->tuple_count = n_tuples;
+		task->owns_tuples = j == 1;
+		task->time = 0;
+		diag_create(&task->diag);
+	}
+	return 0;
+}
+
+/**
+ * Tasks of the tx thread go first, then the largest tasks,
+ * to keep the workers busy till the end.
+ */
+static int
+memtx_build_task_cmp(const void *a, const void *b)
+{
+	const struct memtx_build_task *t1 = (const struct memtx_build_task *)a;
+	const struct memtx_build_task *t2 = (const struct memtx_build_task *)b;
+	bool s1 = memtx_index_build_is_thread_safe(t1->index);
+	bool s2 = memtx_index_build_is_thread_safe(t2->index);
+	if (s1 != s2)
+		return s1 ? 1 : -1;
+	if (t1->tuple_count != t2->tuple_count)
+		return t1->tuple_count > t2->tuple_count ? -1 : 1;
+	return 0;
+}
+
+static int
+memtx_build_task_run(struct memtx_build_task *task)
+{
+	double start = clock_monotonic();
+	struct index *index = task->index;
+	index_begin_build(index);
+	if (index_reserve(index, task->tuple_count) != 0)
+		return -1;
+	for (uint32_t i = 0; i < task->tuple_count; i++) {
+		if (index_build_next(index, task->tuples[i]) != 0)
+			return -1;
+	}
+	index_end_build(index);
+	task->time = clock_monotonic() - start;
+	return 0;
+}
+
+/** Run the task and mark the build failed on error. */
+static int
+memtx_build_ctx_run(struct memtx_build_ctx *ctx,
+		    struct memtx_build_task *task)
+{
+	if (memtx_build_task_run(task) == 0)
+		return 0;
+	diag_move(diag_get(), &task->diag);
+	tt_pthread_mutex_lock(&ctx->mutex);
+	ctx->is_failed = true;
+	tt_pthread_mutex_unlock(&ctx->mutex);
+	return -1;
+}
+
+/** Run the tasks of the workers till there are none left. */
+static void
+memtx_build_ctx_run_tasks(struct memtx_build_ctx *ctx)
+{
+	while (true) {
+		struct memtx_build_task *task = NULL;
+		tt_pthread_mutex_lock(&ctx->mutex);
+		if (!ctx->is_failed && ctx->next_task < ctx->task_count)
+			task = &ctx->tasks[ctx->next_task++];
+		tt_pthread_mutex_unlock(&ctx->mutex);
+		if (task == NULL)
+			break;
+		memtx_build_ctx_run(ctx, task);
+	}
+}
+
+static void *
+memtx_build_worker_f(void *arg)
+{
+	struct memtx_build_ctx *ctx = (struct memtx_build_ctx *)arg;
+	memtx_build_ctx_run_tasks(ctx);
+	struct memtx_engine *memtx = ctx->memtx;
+	tt_pthread_mutex_lock(&memtx->index_extent_lock);
+	ctx->worker_count--;
+	tt_pthread_cond_broadcast(&memtx->index_extent_cond);
+	tt_pthread_mutex_unlock(&memtx->index_extent_lock);
+	return NULL;
+}
+
+/**
+ * Reserve the extents the tasks of the workers are expected
+ * to take, so that they rarely have to wait for a refill.
+ */
+static void
+memtx_build_ctx_reserve(struct memtx_build_ctx *ctx)
+{
+	int64_t size = 0;
+	for (int i = ctx->tx_task_count; i < ctx->task_count; i++)
+		size += (int64_t)ctx->tasks[i].tuple_count *
+			MEMTX_BUILD_BYTES_PER_TUPLE;
+	int64_t num = ctx->memtx->num_reserved_extents +
+		      DIV_ROUND_UP(size, MEMTX_EXTENT_SIZE);
+	/* The rest is allocated on demand. */
+	if (memtx_index_extent_reserve(ctx->memtx, MIN(num, INT32_MAX)) != 0)
+		diag_clear(diag_get());
+}
+
+/**
+ * Run the tasks on the worker threads. The tx thread runs its
+ * own tasks and then refills the reserved extents for the
+ * workers till they are done.
+ */
+static void
+memtx_build_ctx_run_all(struct memtx_build_ctx *ctx)
+{
+	struct memtx_engine *memtx = ctx->memtx;
+	int worker_count = MIN(memtx->recovery_threads,
+			       ctx->task_count - ctx->tx_task_count);
+	struct cord *workers = NULL;
+	if (worker_count > 0) {
+		workers = (struct cord *)calloc(worker_count,
+						sizeof(*workers));
+		if (workers == NULL)
+			worker_count = 0;
+	}
+	int reserved_count = memtx->num_reserved_extents;
+	if (worker_count > 0) {
+		memtx_build_ctx_reserve(ctx);
+		memtx->index_extent_is_exhausted = false;
+		memtx->index_extent_is_shared = true;
+	}
+	int started = 0;
+	for (; started < worker_count; started++) {
+		tt_pthread_mutex_lock(&memtx->index_extent_lock);
+		ctx->worker_count++;
+		tt_pthread_mutex_unlock(&memtx->index_extent_lock);
+		if (cord_start(&workers[started], "index_build",
+			       memtx_build_worker_f, ctx) != 0) {
+			tt_pthread_mutex_lock(&memtx->index_extent_lock);
+			ctx->worker_count--;
+			tt_pthread_mutex_unlock(&memtx->index_extent_lock);
+			diag_log();
+			break;
+		}
+	}
+	say_info("Building %d secondary indexes in %d threads...",
+		 ctx->task_count, MAX(started, 1));
+	for (int i = 0; i < ctx->tx_task_count; i++) {
+		if (memtx_build_ctx_run(ctx, &ctx->tasks[i]) != 0)
+			break;
+	}
+	tt_pthread_mutex_lock(&memtx->index_extent_lock);
+	while (ctx->worker_count > 0) {
+		memtx_index_extent_refill(memtx);
+		tt_pthread_cond_wait(&memtx->index_extent_cond,
+				     &memtx->index_extent_lock);
+	}
+	tt_pthread_mutex_unlock(&memtx->index_extent_lock);
+	for (int i = 0; i < started; i++) {
+		if (cord_join(&workers[i]) != 0)
+			panic_syserror("index build: thread join failed");
+	}
+	memtx->index_extent_is_shared = false;
+	/* Return the extents left unused to the pool. */
+	while (memtx->num_reserved_extents > reserved_count) {
+		void *ext = memtx->reserved_extents;
+		memtx->reserved_extents = *(void **)ext;
+		memtx->num_reserved_extents--;
+		mempool_free(&memtx->index_extent_pool, ext);
+	}
+	/*
+	 * Build what is left if the workers couldn't be started
+	 * or there are none.
+	 */
+	memtx_build_ctx_run_tasks(ctx);
+	free(workers);
+}
+
+/**
+ * Build the secondary keys of all spaces at once, on
+ * memtx_engine::recovery_threads worker threads and the tx
+ * thread.
+ */
+static int
+memtx_build_secondary_keys_parallel(struct memtx_engine *memtx)
+{
+	struct memtx_build_ctx ctx;
+	memset(&ctx, 0, sizeof(ctx));
+	ctx.memtx = memtx;
+	tt_pthread_mutex_init(&ctx.mutex, NULL);
+	int rc = space_foreach(memtx_add_build_tasks, &ctx);
+	if (rc == 0 && ctx.task_count > 0) {
+		qsort(ctx.tasks, ctx.task_count, sizeof(*ctx.tasks),
+		      memtx_build_task_cmp);
+		while (ctx.tx_task_count < ctx.task_count &&
+		       !memtx_index_build_is_thread_safe(
+				ctx.tasks[ctx.tx_task_count].index))
+			ctx.tx_task_count++;
+		ctx.next_task = ctx.tx_task_count;
+		double start = clock_monotonic();
+		memtx_build_ctx_run_all(&ctx);
+		if (!ctx.is_failed) {
+			say_info("Secondary indexes built in %.3f sec",
+				 clock_monotonic() - start);
+		}
+	}
+	for (int i = 0; i < ctx.task_count; i++) {
+		struct memtx_build_task *task = &ctx.tasks[i];
+		if (!diag_is_empty(&task->diag)) {
+			/* Report the first error. */
+			if (rc == 0)
+				diag_move(&task->diag, diag_get());
+			rc = -1;
+		} else if (task->tuple_count > 0 && rc == 0) {
+			say_info("Space '%s', index '%s': built in %.3f sec",
+				 space_name(task->space),
+				 task->index->def->name, task->time);
+		}
+		if (task->owns_tuples)
+			free(task->tuples);
+		diag_destroy(&task->diag);
+	}
+	free(ctx.tasks);
+	tt_pthread_mutex_destroy(&ctx.mutex);
+	if (rc != 0)
+		return -1;
+	return space_foreach(memtx_enable_secondary_keys, memtx);
+}
+
+/** Build the secondary keys of all spaces after recovery. */
+static int
+memtx_engine_build_secondary_keys(struct memtx_engine *memtx)
+{
+	if (memtx->recovery_threads > 0)
+		return memtx_build_secondary_keys_parallel(memtx);
+	return space_foreach(memtx_build_secondary_keys, memtx);
+}
+
 static void
 memtx_engine_shutdown(struct engine *engine)
 {
@@ -139,6 +531,8 @@ memtx_engine_shutdown(struct engine *engine)
 		mempool_destroy(&memtx->rtree_iterator_pool);
 	mempool_destroy(&memtx->index_extent_pool);
 	slab_cache_destroy(&memtx->index_slab_cache);
+	tt_pthread_mutex_destroy(&memtx->index_extent_lock);
+	tt_pthread_cond_destroy(&memtx->index_extent_cond);
 	small_alloc_destroy(&memtx->alloc);
 	slab_cache_destroy(&memtx->slab_cache);
 	tuple_arena_destroy(&memtx->arena);
@@ -150,6 +544,60 @@ static int
 memtx_engine_recover_snapshot_row(struct memtx_engine *memtx,
 				  struct xrow_header *row);
 
+static int
+memtx_engine_recover_index_order(struct memtx_engine *memtx,
+				 struct xrow_header *row);
+
+static int
+memtx_engine_apply_snapshot_request(struct memtx_engine *memtx,
+				    struct request *request);
+
+/**
+ * Recover the snapshot with a pipeline of threads reading and
+ * decoding it, see snap_reader.h. The tx thread only allocates
+ * the tuples and inserts them into the primary keys.
+ */
+static int
+memtx_engine_recover_snapshot_parallel(struct memtx_engine *memtx,
+				       const char *filename,
+				       int64_t signature)
+{
+	struct snap_reader *reader = snap_reader_new(filename, signature,
+						     memtx->recovery_threads);
+	if (reader == NULL)
+		return -1;
+	int rc;
+	struct snap_reader_row *row;
+	uint64_t row_count = 0;
+	while ((rc = snap_reader_next(reader, &row)) == 0) {
+		if (row->header.type == MEMTX_INDEX_ORDER) {
+			rc = memtx_engine_recover_index_order(memtx,
+							      &row->header);
+		} else {
+			rc = memtx_engine_apply_snapshot_request(memtx,
+								 &row->request);
+		}
+		if (rc < 0)
+			break;
+		++row_count;
+		if (row_count % 100000 == 0) {
+			say_info("%.1fM rows processed",
+				 row_count / 1000000.);
+			fiber_yield_timeout(0);
+		}
+	}
+	bool is_eof = snap_reader_is_eof(reader);
+	snap_reader_delete(reader);
+	if (rc < 0)
+		return -1;
+
+	/* See memtx_engine_recover_snapshot(). */
+	if (!is_eof)
+		panic("snapshot `%s' has no EOF marker", filename);
+
+	return 0;
+}
+
 int
 memtx_engine_recover_snapshot(struct memtx_engine *memtx,
 			      const struct vclock *vclock)
@@ -161,6 +609,15 @@ memtx_engine_recover_snapshot(struct memtx_engine *memtx,
 						    signature, NONE);
 
 	say_info("recovering from `%s'", filename);
+	/*
+	 * The pipeline can't skip broken transactions, so
+	 * force_recovery falls back to reading the snapshot
+	 * in the tx thread.
+	 */
+	if (memtx->recovery_threads > 0 && !memtx->force_recovery) {
+		return memtx_engine_recover_snapshot_parallel(memtx, filename,
+							      signature);
+	}
 	struct xlog_cursor cursor;
 	if (xlog_cursor_open(&cursor, filename) < 0)
 		return -1;
@@ -205,16 +662,124 @@ memtx_engine_recover_snapshot_row(struct memtx_engine *memtx,
 				  struct xrow_header *row)
 {
 	assert(row->bodycnt == 1); /* always 1 for read */
+	if (row->type == MEMTX_INDEX_ORDER)
+		return memtx_engine_recover_index_order(memtx, row);
 	if (row->type != IPROTO_INSERT) {
 		diag_set(ClientError, ER_UNKNOWN_REQUEST_TYPE,
 			 (uint32_t) row->type);
 		return -1;
 	}
-	int rc;
 	struct request request;
 	if (xrow_decode_dml(row, &request, dml_request_key_map(row->type)) != 0)
 		return -1;
-	struct space *space = space_cache_find(request.space_id);
+	return memtx_engine_apply_snapshot_request(memtx, &request);
+}
+
+/** A chunk of the order of a secondary key. */
+struct memtx_index_order {
+	uint32_t space_id;
+	uint32_t index_id;
+	/** Number of tuples in the key. */
+	uint32_t count;
+	/** Position of the first entry of the chunk. */
+	uint32_t offset;
+	/** Big-endian uint32 row numbers. */
+	const char *data;
+	uint32_t size;
+};
+
+static int
+memtx_index_order_decode(struct memtx_index_order *order,
+			 struct xrow_header *row)
+{
+	memset(order, 0, sizeof(*order));
+	const char *pos = (const char *)row->body[0].iov_base;
+	const char *end = pos + row->body[0].iov_len;
+	if (mp_check(&pos, end) != 0)
+		goto error;
+	pos = (const char *)row->body[0].iov_base;
+	if (mp_typeof(*pos) != MP_MAP)
+		goto error;
+	uint32_t map_size = mp_decode_map(&pos);
+	for (uint32_t i = 0; i < map_size; i++) {
+		if (mp_typeof(*pos) != MP_UINT)
+			goto error;
+		uint64_t key = mp_decode_uint(&pos);
+		if (key == MEMTX_INDEX_ORDER_DATA) {
+			if (mp_typeof(*pos) != MP_BIN)
+				goto error;
+			uint32_t size = mp_decode_binl(&pos);
+			if (size % sizeof(uint32_t) != 0)
+				goto error;
+			order->data = pos;
+			order->size = size / sizeof(uint32_t);
+			pos += size;
+			continue;
+		}
+		if (mp_typeof(*pos) != MP_UINT) {
+			mp_next(&pos);
+			continue;
+		}
+		uint64_t value = mp_decode_uint(&pos);
+		if (value > UINT32_MAX)
+			goto error;
+		switch (key) {
+		case MEMTX_INDEX_ORDER_SPACE_ID:
+			order->space_id = value;
+			break;
+		case MEMTX_INDEX_ORDER_INDEX_ID:
+			order->index_id = value;
+			break;
+		case MEMTX_INDEX_ORDER_COUNT:
+			order->count = value;
+			break;
+		case MEMTX_INDEX_ORDER_OFFSET:
+			order->offset = value;
+			break;
+		}
+	}
+	if (order->data == NULL)
+		goto error;
+	return 0;
+error:
+	diag_set(ClientError, ER_INVALID_MSGPACK, "index order");
+	return -1;
+}
+
+/**
+ * Pass the order of a secondary key stored in the snapshot to
+ * the key, to be used when the key is built.
+ */
+static int
+memtx_engine_recover_index_order(struct memtx_engine *memtx,
+				 struct xrow_header *row)
+{
+	struct memtx_index_order order;
+	if (memtx_index_order_decode(&order, row) != 0)
+		return -1;
+	/* Keys are built as the rows are loaded in this case. */
+	if (memtx->state != MEMTX_INITIAL_RECOVERY)
+		return 0;
+	struct space *space = space_cache_find(order.space_id);
+	if (space == NULL)
+		return -1;
+	struct memtx_space *memtx_space = (struct memtx_space *)space;
+	struct index *index = space_index(space, order.index_id);
+	if (space->engine != (struct engine *)memtx || index == NULL ||
+	    memtx_space->replace != memtx_space_replace_build_next ||
+	    !memtx_index_order_is_stored(index))
+		return 0;
+	return memtx_tree_index_add_build_order(index, order.count,
+						order.offset, order.data,
+						order.size);
+}
+
+static int
+memtx_engine_apply_snapshot_request(struct memtx_engine *memtx,
+				    struct request *request)
+{
+	int rc;
+	struct space *space = space_cache_find(request->space_id);
 	if (space == NULL)
 		return -1;
 	/* memtx snapshot must contain only memtx spaces */
@@ -222,16 +787,36 @@ memtx_engine_recover_snapshot_row(struct memtx_engine *memtx,
 		diag_set(ClientError, ER_CROSS_ENGINE_TRANSACTION);
 		return -1;
 	}
+	struct tuple *unused;
+	struct memtx_space *memtx_space = (struct memtx_space *)space;
+	if (memtx_space->replace == memtx_space_replace_build_next &&
+	    rlist_empty(&space->before_replace) &&
+	    rlist_empty(&space->on_replace) && space->sequence == NULL) {
+		/*
+		 * Bulk load of the primary key of a space nobody
+		 * watches: a failed insert has nothing to roll
+		 * back, so skip the transaction.
+		 */
+		struct tuple *tuple = memtx_tuple_new(space->format,
+						      request->tuple,
+						      request->tuple_end);
+		if (tuple == NULL)
+			return -1;
+		tuple_ref(tuple);
+		rc = memtx_space_replace_build_next(space, NULL, tuple,
+						    DUP_INSERT, &unused);
+		tuple_unref(tuple);
+		return rc;
+	}
 	struct txn *txn = txn_begin();
 	if (txn == NULL)
 		return -1;
 	if (txn_begin_stmt(txn, space) != 0)
 		goto rollback;
 	/* no access checks here - applier always works with admin privs */
-	struct tuple *unused;
-	if (space_execute_dml(space, txn, &request, &unused) != 0)
+	if (space_execute_dml(space, txn, request, &unused) != 0)
 		goto rollback_stmt;
-	if (txn_commit_stmt(txn, &request) != 0)
+	if (txn_commit_stmt(txn, request) != 0)
 		goto rollback;
 	rc = txn_commit(txn);
 	/*
@@ -298,7 +883,7 @@ memtx_engine_begin_final_recovery(struct engine *engine)
 		 * unique keys.
 		 */
 		memtx->state = MEMTX_OK;
-		if (space_foreach(memtx_build_secondary_keys, memtx) != 0)
+		if (memtx_engine_build_secondary_keys(memtx) != 0)
 			return -1;
 	}
 	return 0;
@@ -317,7 +902,7 @@ memtx_engine_end_recovery(struct engine *engine)
 	if (memtx->state != MEMTX_OK) {
 		assert(memtx->state == MEMTX_FINAL_RECOVERY);
 		memtx->state = MEMTX_OK;
-		if (space_foreach(memtx_build_secondary_keys, memtx) != 0)
+		if (memtx_engine_build_secondary_keys(memtx) != 0)
 			return -1;
 	}
 	return 0;
@@ -459,10 +1044,19 @@ checkpoint_write_tuple(struct xlog *l, uint32_t space_id, uint32_t group_id,
 	return checkpoint_write_row(l, &row);
 }
 
+/** A secondary key whose order is stored in the snapshot. */
+struct checkpoint_index_order {
+	uint32_t index_id;
+	struct snapshot_iterator *iterator;
+};
+
 struct checkpoint_entry {
 	uint32_t space_id;
 	uint32_t group_id;
 	struct snapshot_iterator *iterator;
+	/** Read views of the secondary keys to store the order of. */
+	struct checkpoint_index_order *orders;
+	uint32_t order_count;
 	struct rlist link;
 };
 
@@ -482,6 +1076,8 @@ struct checkpoint {
 	 * checkpoint already exists.
 	 */
 	bool touch;
+	/** Store the order of secondary TREE keys. */
+	bool write_index_order;
 };
 
 static struct checkpoint *
@@ -502,6 +1098,7 @@ checkpoint_new(const char *snap_dirname, uint64_t snap_io_rate_limit)
 	xdir_create(&ckpt->dir, snap_dirname, SNAP, &INSTANCE_UUID, &opts);
 	vclock_create(&ckpt->vclock);
 	ckpt->touch = false;
+	ckpt->write_index_order = false;
 	return ckpt;
 }
 
@@ -511,6 +1108,12 @@ checkpoint_delete(struct checkpoint *ckpt)
 	struct checkpoint_entry *entry, *tmp;
 	rlist_foreach_entry_safe(entry, &ckpt->entries, link, tmp) {
 		entry->iterator->free(entry->iterator);
+		for (uint32_t i = 0; i < entry->order_count; i++) {
+			struct snapshot_iterator *it =
+				entry->orders[i].iterator;
+			it->free(it);
+		}
+		free(entry->orders);
 		free(entry);
 	}
 	xdir_destroy(&ckpt->dir);
@@ -565,13 +1168,184 @@ checkpoint_add_space(struct space *sp, void *data)
 
 	entry->space_id = space_id(sp);
 	entry->group_id = space_group_id(sp);
+	entry->orders = NULL;
+	entry->order_count = 0;
 	entry->iterator = index_create_snapshot_iterator(pk);
 	if (entry->iterator == NULL)
 		return -1;
 
+	/*
+	 * Rows of the snapshot are numbered in the primary key
+	 * order, which a hash index doesn't have.
+	 */
+	if (!ckpt->write_index_order || pk->def->type != TREE ||
+	    sp->index_count <= 1)
+		return 0;
+	size_t size = (sp->index_count - 1) * sizeof(*entry->orders);
+	entry->orders = (struct checkpoint_index_order *)malloc(size);
+	if (entry->orders == NULL) {
+		diag_set(OutOfMemory, size, "malloc",
+			 "struct checkpoint_index_order");
+		return -1;
+	}
+	for (uint32_t i = 1; i < sp->index_count; i++) {
+		struct index *index = sp->index[i];
+		if (!memtx_index_order_is_stored(index))
+			continue;
+		struct snapshot_iterator *it =
+			index_create_snapshot_iterator(index);
+		if (it == NULL)
+			return -1;
+		struct checkpoint_index_order *order =
+			&entry->orders[entry->order_count++];
+		order->index_id = index->def->iid;
+		order->iterator = it;
+	}
 	return 0;
 };
 
+static int
+checkpoint_write_index_order_row(struct xlog *l,
+				 struct checkpoint_entry *entry,
+				 uint32_t index_id, uint32_t count,
+				 uint32_t offset, const uint32_t *order,
+				 uint32_t size)
+{
+	size_t body_size = mp_sizeof_map(5) +
+			   mp_sizeof_uint(MEMTX_INDEX_ORDER_SPACE_ID) +
+			   mp_sizeof_uint(entry->space_id) +
+			   mp_sizeof_uint(MEMTX_INDEX_ORDER_INDEX_ID) +
+			   mp_sizeof_uint(index_id) +
+			   mp_sizeof_uint(MEMTX_INDEX_ORDER_COUNT) +
+			   mp_sizeof_uint(count) +
+			   mp_sizeof_uint(MEMTX_INDEX_ORDER_OFFSET) +
+			   mp_sizeof_uint(offset) +
+			   mp_sizeof_uint(MEMTX_INDEX_ORDER_DATA) +
+			   mp_sizeof_bin(size * sizeof(uint32_t));
+	char *body = region_alloc(&fiber()->gc, body_size);
+	if (body == NULL) {
+		diag_set(OutOfMemory, body_size, "region", "index order");
+		return -1;
+	}
+	char *pos = mp_encode_map(body, 5);
+	pos = mp_encode_uint(pos, MEMTX_INDEX_ORDER_SPACE_ID);
+	pos = mp_encode_uint(pos, entry->space_id);
+	pos = mp_encode_uint(pos, MEMTX_INDEX_ORDER_INDEX_ID);
+	pos = mp_encode_uint(pos, index_id);
+	pos = mp_encode_uint(pos, MEMTX_INDEX_ORDER_COUNT);
+	pos = mp_encode_uint(pos, count);
+	pos = mp_encode_uint(pos, MEMTX_INDEX_ORDER_OFFSET);
+	pos = mp_encode_uint(pos, offset);
+	pos = mp_encode_uint(pos, MEMTX_INDEX_ORDER_DATA);
+	pos = mp_encode_binl(pos, size * sizeof(uint32_t));
+	for (uint32_t i = 0; i < size; i++)
+		pos = mp_store_u32(pos, order[i]);
+	assert(pos == body + body_size);
+
+	struct xrow_header row;
+	memset(&row, 0, sizeof(struct xrow_header));
+	row.type = MEMTX_INDEX_ORDER;
+	row.group_id = entry->group_id;
+	row.bodycnt = 1;
+	row.body[0].iov_base = body;
+	row.body[0].iov_len = body_size;
+	return checkpoint_write_row(l, &row);
+}
+
+/**
+ * Write the order of a secondary key: the numbers of the rows
+ * of the space, found by tuple data in @a positions, in the
+ * order of the key.
+ */
+static int
+checkpoint_write_index_order(struct xlog *l, struct checkpoint_entry *entry,
+			     struct checkpoint_index_order *order,
+			     struct mh_i64ptr_t *positions, uint32_t count)
+{
+	size_t size = MEMTX_INDEX_ORDER_CHUNK * sizeof(uint32_t);
+	uint32_t *chunk = (uint32_t *)malloc(size);
+	if (chunk == NULL) {
+		diag_set(OutOfMemory, size, "malloc", "index order");
+		return -1;
+	}
+	int rc;
+	uint32_t offset = 0;
+	uint32_t chunk_size = 0;
+	const char *data;
+	uint32_t data_size;
+	struct snapshot_iterator *it = order->iterator;
+	while ((rc = it->next(it, &data, &data_size)) == 0 && data != NULL) {
+		mh_int_t k = mh_i64ptr_find(positions, (uintptr_t)data, NULL);
+		assert(k != mh_end(positions));
+		chunk[chunk_size++] =
+			(uintptr_t)mh_i64ptr_node(positions, k)->val;
+		if (chunk_size < MEMTX_INDEX_ORDER_CHUNK)
+			continue;
+		rc = checkpoint_write_index_order_row(l, entry,
+				order->index_id, count, offset,
+				chunk, chunk_size);
+		if (rc != 0)
+			break;
+		offset += chunk_size;
+		chunk_size = 0;
+	}
+	if (rc == 0 && chunk_size > 0) {
+		rc = checkpoint_write_index_order_row(l, entry,
+				order->index_id, count, offset,
+				chunk, chunk_size);
+	}
+	free(chunk);
+	return rc;
+}
+
+/** Write the tuples of a space and the order of its keys. */
+static int
+checkpoint_write_space(struct xlog *l, struct checkpoint_entry *entry)
+{
+	struct mh_i64ptr_t *positions = NULL;
+	if (entry->order_count > 0) {
+		positions = mh_i64ptr_new();
+		if (positions == NULL) {
+			diag_set(OutOfMemory, sizeof(*positions),
+				 "malloc", "struct mh_i64ptr_t");
+			return -1;
+		}
+	}
+	int rc;
+	uint32_t size;
+	const char *data;
+	uint32_t count = 0;
+	struct snapshot_iterator *it = entry->iterator;
+	while ((rc = it->next(it, &data, &size)) == 0 && data != NULL) {
+		rc = checkpoint_write_tuple(l, entry->space_id,
+					    entry->group_id, data, size);
+		if (rc != 0)
+			break;
+		if (positions == NULL) {
+			count++;
+			continue;
+		}
+		struct mh_i64ptr_node_t node = {
+			(uintptr_t)data, (void *)(uintptr_t)count++
+		};
+		if (mh_i64ptr_put(positions, &node, NULL,
+				  NULL) == mh_end(positions)) {
+			diag_set(OutOfMemory, 0, "mh_i64ptr_put",
+				 "mh_i64ptr_node_t");
+			rc = -1;
+			break;
+		}
+	}
+	for (uint32_t i = 0; rc == 0 && count > 0 &&
+	     i < entry->order_count; i++) {
+		rc = checkpoint_write_index_order(l, entry, &entry->orders[i],
+						  positions, count);
+	}
+	if (positions != NULL)
+		mh_i64ptr_delete(positions);
+	return rc;
+}
+
 static int
 checkpoint_f(va_list ap)
 {
@@ -595,16 +1369,7 @@ checkpoint_f(va_list ap)
 	ERROR_INJECT_SLEEP(ERRINJ_SNAP_WRITE_DELAY);
 	struct checkpoint_entry *entry;
 	rlist_foreach_entry(entry, &ckpt->entries, link) {
-		int rc;
-		uint32_t size;
-		const char *data;
-		struct snapshot_iterator *it = entry->iterator;
-		while ((rc = it->next(it, &data, &size)) == 0 && data != NULL) {
-			if (checkpoint_write_tuple(&snap, entry->space_id,
-					entry->group_id, data, size) != 0)
-				goto fail;
-		}
-		if (rc != 0)
+		if (checkpoint_write_space(&snap, entry) != 0)
 			goto fail;
 	}
 	if (xlog_flush(&snap) < 0)
@@ -629,6 +1394,7 @@ memtx_engine_begin_checkpoint(struct engine *engine)
 	if (memtx->checkpoint == NULL)
 		return -1;
 
+	memtx->checkpoint->write_index_order = memtx->snap_index_order;
 	if (space_foreach(checkpoint_add_space, memtx->checkpoint) != 0) {
 		checkpoint_delete(memtx->checkpoint);
 		memtx->checkpoint = NULL;
@@ -1034,6 +1800,8 @@ memtx_engine_new(const char *snap_dirname, bool force_recovery,
 	quota_init(&memtx->quota, tuple_arena_max_size);
 	tuple_arena_create(&memtx->arena, &memtx->quota, tuple_arena_max_size,
 			   SLAB_SIZE, dontdump, "memtx");
+	memtx->numa_node = -1;
+	memtx_engine_set_numa_node(memtx, affinity_numa_node(CORD_CLASS_TX));
 	slab_cache_create(&memtx->slab_cache, &memtx->arena);
 	small_alloc_create(&memtx->alloc, &memtx->slab_cache,
 			   objsize_min, alloc_factor);
@@ -1049,6 +1817,13 @@ memtx_engine_new(const char *snap_dirname, bool force_recovery,
 
 	memtx->state = MEMTX_INITIALIZED;
 	memtx->max_tuple_size = MAX_TUPLE_SIZE;
+	memtx->recovery_threads = 0;
+	memtx->snap_index_order = false;
+	memtx->index_extent_is_shared = false;
+	tt_pthread_mutex_init(&memtx->index_extent_lock, NULL);
+	tt_pthread_cond_init(&memtx->index_extent_cond, NULL);
+	memtx->index_extent_is_wanted = false;
+	memtx->index_extent_is_exhausted = false;
 	memtx->force_recovery = force_recovery;
 
 	memtx->replica_join_cord = NULL;
@@ -1090,12 +1865,39 @@ memtx_engine_set_memory(struct memtx_engine *memtx, size_t size)
 	return 0;
 }
 
+void
+memtx_engine_set_numa_node(struct memtx_engine *memtx, int node)
+{
+	if (node < 0 || node == memtx->numa_node)
+		return;
+	if (affinity_bind_memory(memtx->arena.arena, memtx->arena.prealloc,
+				 node) != 0) {
+		diag_log();
+		say_warn("memtx arena is not bound to NUMA node %d", node);
+		return;
+	}
+	say_info("memtx arena is bound to NUMA node %d", node);
+	memtx->numa_node = node;
+}
+
 void
 memtx_engine_set_max_tuple_size(struct memtx_engine *memtx, size_t max_size)
 {
 	memtx->max_tuple_size = max_size;
 }
 
+void
+memtx_engine_set_recovery_threads(struct memtx_engine *memtx, int count)
+{
+	memtx->recovery_threads = count;
+}
+
+void
+memtx_engine_set_snap_index_order(struct memtx_engine *memtx, bool value)
+{
+	memtx->snap_index_order = value;
+}
+
 void
 memtx_enter_delayed_free_mode(struct memtx_engine *memtx)
 {
@@ -1224,6 +2026,92 @@ struct tuple_format_vtab memtx_tuple_format_vtab = {
 	memtx_tuple_chunk_new,
 };
 
+/** Add an extent to the reserved list. */
+static inline void
+memtx_index_extent_push(struct memtx_engine *memtx, void *ext)
+{
+	*(void **)ext = memtx->reserved_extents;
+	memtx->reserved_extents = ext;
+	memtx->num_reserved_extents++;
+}
+
+/**
+ * Refill the reserved list if a worker thread waits for it.
+ * Is called by the tx thread with index_extent_lock held.
+ */
+static void
+memtx_index_extent_refill(struct memtx_engine *memtx)
+{
+	if (!memtx->index_extent_is_wanted)
+		return;
+	memtx->index_extent_is_wanted = false;
+	for (int i = 0; i < MEMTX_BUILD_EXTENT_BATCH; i++) {
+		void *ext = mempool_alloc(&memtx->index_extent_pool);
+		if (ext == NULL) {
+			memtx->index_extent_is_exhausted = true;
+			break;
+		}
+		memtx_index_extent_push(memtx, ext);
+	}
+	tt_pthread_cond_broadcast(&memtx->index_extent_cond);
+}
+
+/**
+ * Make sure there are at least @a num reserved extents while
+ * secondary keys are built by worker threads. The tx thread
+ * allocates them from the pool, a worker waits for the tx
+ * thread to do it. Is called with index_extent_lock held.
+ */
+static int
+memtx_index_extent_wait_shared(struct memtx_engine *memtx, int num)
+{
+	while (memtx->num_reserved_extents < num &&
+	       !memtx->index_extent_is_exhausted) {
+		if (cord_is_main()) {
+			void *ext = mempool_alloc(&memtx->index_extent_pool);
+			if (ext == NULL) {
+				memtx->index_extent_is_exhausted = true;
+				break;
+			}
+			memtx_index_extent_push(memtx, ext);
+			continue;
+		}
+		memtx->index_extent_is_wanted = true;
+		tt_pthread_cond_broadcast(&memtx->index_extent_cond);
+		tt_pthread_cond_wait(&memtx->index_extent_cond,
+				     &memtx->index_extent_lock);
+	}
+	if (cord_is_main())
+		memtx_index_extent_refill(memtx);
+	if (memtx->num_reserved_extents < num) {
+		diag_set(OutOfMemory, MEMTX_EXTENT_SIZE,
+			 "mempool", "new slab");
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * Allocate an index extent while secondary keys are built by
+ * worker threads. The garbage collector isn't run, and the
+ * extents are taken from the reserved list, since a
+ * reservation made by one thread can't be kept from the
+ * others.
+ */
+static void *
+memtx_index_extent_alloc_shared(struct memtx_engine *memtx)
+{
+	void *ret = NULL;
+	tt_pthread_mutex_lock(&memtx->index_extent_lock);
+	if (memtx_index_extent_wait_shared(memtx, 1) == 0) {
+		ret = memtx->reserved_extents;
+		memtx->reserved_extents = *(void **)ret;
+		memtx->num_reserved_extents--;
+	}
+	tt_pthread_mutex_unlock(&memtx->index_extent_lock);
+	return ret;
+}
+
 /**
  * Allocate a block of size MEMTX_EXTENT_SIZE for memtx index
  */
@@ -1231,6 +2119,8 @@ void *
 memtx_index_extent_alloc(void *ctx)
 {
 	struct memtx_engine *memtx = (struct memtx_engine *)ctx;
+	if (memtx->index_extent_is_shared)
+		return memtx_index_extent_alloc_shared(memtx);
 	if (memtx->reserved_extents) {
 		assert(memtx->num_reserved_extents > 0);
 		memtx->num_reserved_extents--;
@@ -1264,6 +2154,13 @@ void
 memtx_index_extent_free(void *ctx, void *extent)
 {
 	struct memtx_engine *memtx = (struct memtx_engine *)ctx;
+	if (memtx->index_extent_is_shared) {
+		/* Only the tx thread may return it to the pool. */
+		tt_pthread_mutex_lock(&memtx->index_extent_lock);
+		memtx_index_extent_push(memtx, extent);
+		tt_pthread_mutex_unlock(&memtx->index_extent_lock);
+		return;
+	}
 	return mempool_free(&memtx->index_extent_pool, extent);
 }
 
@@ -1281,6 +2178,12 @@ memtx_index_extent_reserve(struct memtx_engine *memtx, int num)
 		return -1;
 	});
 	struct mempool *pool = &memtx->index_extent_pool;
+	if (memtx->index_extent_is_shared) {
+		tt_pthread_mutex_lock(&memtx->index_extent_lock);
+		int rc = memtx_index_extent_wait_shared(memtx, num);
+		tt_pthread_mutex_unlock(&memtx->index_extent_lock);
+		return rc;
+	}
 	while (memtx->num_reserved_extents < num) {
 		void *ext;
 		while ((ext = mempool_alloc(pool)) == NULL) {
@@ -1294,9 +2197,7 @@ memtx_index_extent_reserve(struct memtx_engine *memtx, int num)
 				 "mempool", "new slab");
 			return -1;
 		}
-		*(void **)ext = memtx->reserved_extents;
-		memtx->reserved_extents = ext;
-		memtx->num_reserved_extents++;
+		memtx_index_extent_push(memtx, ext);
 	}
 	return 0;
 }
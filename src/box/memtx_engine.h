@@ -30,6 +30,7 @@
  * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
  * SUCH DAMAGE.
  */
+#include <pthread.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
@@ -133,6 +134,11 @@ struct memtx_engine {
 	 * is reflected in box.slab.info(), @sa lua/slab.c.
 	 */
 	struct slab_arena arena;
+	/**
+	 * NUMA node the arena memory is bound to, -1 if the
+	 * default policy of the process is used.
+	 */
+	int numa_node;
 	/** Slab cache for allocating tuples. */
 	struct slab_cache slab_cache;
 	/** Tuple allocator. */
@@ -152,6 +158,32 @@ struct memtx_engine {
 	void *reserved_extents;
 	/** Maximal allowed tuple size, box.cfg.memtx_max_tuple_size. */
 	size_t max_tuple_size;
+	/**
+	 * Number of threads decoding the snapshot and building
+	 * secondary keys on recovery, box.cfg.memtx_recovery_threads.
+	 * Zero means recovery is done by the tx thread alone.
+	 */
+	int recovery_threads;
+	/**
+	 * Store the order of secondary TREE keys in snapshots,
+	 * box.cfg.memtx_snap_index_order.
+	 */
+	bool snap_index_order;
+	/**
+	 * Set while secondary keys are built by worker threads.
+	 * The index slab cache belongs to the tx thread, so the
+	 * workers take extents only from the reserved list, which
+	 * is refilled by the tx thread on their demand. The list
+	 * and the fields below are protected by index_extent_lock.
+	 */
+	bool index_extent_is_shared;
+	pthread_mutex_t index_extent_lock;
+	/** Signalled when the reserved list or the demand changes. */
+	pthread_cond_t index_extent_cond;
+	/** Set by a worker waiting for the list to be refilled. */
+	bool index_extent_is_wanted;
+	/** Set if the tx thread failed to refill the list. */
+	bool index_extent_is_exhausted;
 	/** Incremented with each next snapshot. */
 	uint32_t snapshot_version;
 	/**
@@ -225,9 +257,24 @@ memtx_engine_set_snap_io_rate_limit(struct memtx_engine *memtx, double limit);
 int
 memtx_engine_set_memory(struct memtx_engine *memtx, size_t size);
 
+/**
+ * Bind the arena to NUMA node @a node and move the memory
+ * already in use there. Does nothing if @a node is negative.
+ * A failure is logged and is not an error: the placement does
+ * not affect correctness.
+ */
+void
+memtx_engine_set_numa_node(struct memtx_engine *memtx, int node);
+
 void
 memtx_engine_set_max_tuple_size(struct memtx_engine *memtx, size_t max_size);
 
+void
+memtx_engine_set_recovery_threads(struct memtx_engine *memtx, int count);
+
+void
+memtx_engine_set_snap_index_order(struct memtx_engine *memtx, bool value);
+
 /**
  * Enter tuple delayed free mode: tuple allocated before the call
  * won't be freed until memtx_leave_delayed_free_mode() is called.
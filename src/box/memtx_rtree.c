@@ -345,6 +345,7 @@ static const struct index_vtab memtx_rtree_index_vtab = {
 	/* .get = */ memtx_rtree_index_get,
 	/* .replace = */ memtx_rtree_index_replace,
 	/* .create_iterator = */ memtx_rtree_index_create_iterator,
+	/* .create_iterator_after = */ generic_index_create_iterator_after,
 	/* .create_snapshot_iterator = */
 		generic_index_create_snapshot_iterator,
 	/* .stat = */ generic_index_stat,
@@ -39,6 +39,7 @@
 #include "tuple.h"
 #include <third_party/qsort_arg.h>
 #include <small/mempool.h>
+#include <msgpuck.h>
 
 /**
  * Struct that is used as a key in BPS tree definition.
@@ -109,6 +110,13 @@ struct memtx_tree_index {
 	struct memtx_tree tree;
 	struct memtx_tree_data *build_array;
 	size_t build_array_size, build_array_alloc_size;
+	/**
+	 * Positions of the primary key tuples in the index order,
+	 * read from the snapshot, or NULL.
+	 * @sa memtx_tree_index_add_build_order().
+	 */
+	uint32_t *build_order;
+	uint32_t build_order_size;
 	struct memtx_gc_task gc_task;
 	struct memtx_tree_iterator gc_iterator;
 };
@@ -138,6 +146,11 @@ struct tree_iterator {
 	enum iterator_type type;
 	struct memtx_tree_key_data key_data;
 	struct memtx_tree_data current;
+	/**
+	 * Position to start the iteration after, see
+	 * index_tuple_position(), or NULL.
+	 */
+	const char *after;
 	/** Memory pool the iterator was allocated from. */
 	struct mempool *pool;
 };
@@ -332,6 +345,52 @@ tree_iterator_set_next_method(struct tree_iterator *it)
 	}
 }
 
+/**
+ * Position the iterator at the tuple next to it->after in the
+ * iteration order. The position is a full key of the tree
+ * comparison definition, so it identifies a single tuple even
+ * in a non-unique index. The position was checked to match
+ * the search key, but for the equality iterators the tuple
+ * next to it must be checked as the search stops there.
+ * Returns -1 if there are no more tuples to return.
+ */
+static int
+tree_iterator_start_after(struct tree_iterator *it, struct memtx_tree *tree)
+{
+	struct key_def *cmp_def = memtx_tree_cmp_def(tree);
+	struct memtx_tree_key_data after_data;
+	after_data.key = it->after;
+	after_data.part_count = mp_decode_array(&after_data.key);
+	/*
+	 * A unique index is ordered by its own parts only,
+	 * the primary key parts are redundant for it.
+	 */
+	after_data.part_count = MIN(after_data.part_count,
+				    cmp_def->part_count);
+	after_data.hint = key_hint(after_data.key, after_data.part_count,
+				   cmp_def);
+	bool exact;
+	if (iterator_type_is_reverse(it->type)) {
+		it->tree_iterator = memtx_tree_lower_bound(tree, &after_data,
+							   &exact);
+		memtx_tree_iterator_prev(tree, &it->tree_iterator);
+	} else {
+		it->tree_iterator = memtx_tree_upper_bound(tree, &after_data,
+							   &exact);
+	}
+	if (it->type != ITER_EQ && it->type != ITER_REQ)
+		return 0;
+	struct memtx_tree_data *res =
+		memtx_tree_iterator_get_elem(tree, &it->tree_iterator);
+	if (res == NULL ||
+	    tuple_compare_with_key(res->tuple, res->hint, it->key_data.key,
+				   it->key_data.part_count,
+				   it->key_data.hint,
+				   it->base.index->def->key_def) != 0)
+		return -1;
+	return 0;
+}
+
 static int
 tree_iterator_start(struct iterator *iterator, struct tuple **ret)
 {
@@ -344,7 +403,10 @@ tree_iterator_start(struct iterator *iterator, struct tuple **ret)
 	enum iterator_type type = it->type;
 	bool exact = false;
 	assert(it->current.tuple == NULL);
-	if (it->key_data.key == 0) {
+	if (it->after != NULL) {
+		if (tree_iterator_start_after(it, tree) != 0)
+			return 0;
+	} else if (it->key_data.key == 0) {
 		if (iterator_type_is_reverse(it->type))
 			it->tree_iterator = memtx_tree_iterator_last(tree);
 		else
@@ -400,6 +462,7 @@ memtx_tree_index_free(struct memtx_tree_index *index)
 {
 	memtx_tree_destroy(&index->tree);
 	free(index->build_array);
+	free(index->build_order);
 	free(index);
 }
 
@@ -1011,9 +1074,24 @@ memtx_tree_index_create_iterator(struct index *base, enum iterator_type type,
 	it->key_data.hint = key_hint(key, part_count, cmp_def);
 	it->tree_iterator = memtx_tree_invalid_iterator();
 	it->current.tuple = NULL;
+	it->after = NULL;
 	return (struct iterator *)it;
 }
 
+static struct iterator *
+memtx_tree_index_create_iterator_after(struct index *base,
+				       enum iterator_type type,
+				       const char *key, uint32_t part_count,
+				       const char *pos)
+{
+	struct iterator *it = memtx_tree_index_create_iterator(base, type,
+							       key,
+							       part_count);
+	if (it != NULL)
+		tree_iterator(it)->after = pos;
+	return it;
+}
+
 static void
 memtx_tree_index_begin_build(struct index *base)
 {
@@ -1174,13 +1252,93 @@ memtx_tree_index_build_array_deduplicate(struct memtx_tree_index *index,
 	index->build_array_size = w_idx + 1;
 }
 
+int
+memtx_tree_index_add_build_order(struct index *base, uint32_t count,
+				 uint32_t offset, const char *data,
+				 uint32_t size)
+{
+	struct memtx_tree_index *index = (struct memtx_tree_index *)base;
+	if (offset == 0) {
+		free(index->build_order);
+		index->build_order_size = 0;
+		index->build_order = (uint32_t *)malloc(count *
+							sizeof(uint32_t));
+		if (index->build_order == NULL && count > 0) {
+			diag_set(OutOfMemory, count * sizeof(uint32_t),
+				 "malloc", "index order");
+			return -1;
+		}
+	}
+	if (offset != index->build_order_size || offset > count ||
+	    size > count - offset || (index->build_order == NULL && size > 0)) {
+		diag_set(ClientError, ER_INVALID_MSGPACK, "index order");
+		return -1;
+	}
+	for (uint32_t i = 0; i < size; i++)
+		index->build_order[offset + i] = mp_load_u32(&data);
+	index->build_order_size += size;
+	return 0;
+}
+
+/**
+ * Arrange build_array in the order read from the snapshot.
+ * The order is used only if it is a permutation which sorts
+ * the array, which takes a linear pass instead of a sort.
+ * It doesn't hold if the space was changed after the
+ * snapshot, and the array is sorted then.
+ */
+static bool
+memtx_tree_index_apply_build_order(struct memtx_tree_index *index)
+{
+	struct key_def *cmp_def = memtx_tree_cmp_def(&index->tree);
+	uint32_t *order = index->build_order;
+	uint32_t size = index->build_order_size;
+	index->build_order = NULL;
+	index->build_order_size = 0;
+	if (order == NULL)
+		return false;
+	struct memtx_tree_data *array = NULL;
+	if (size != index->build_array_size || size == 0)
+		goto out;
+	array = (struct memtx_tree_data *)malloc(size * sizeof(*array));
+	if (array == NULL)
+		goto out;
+	for (uint32_t i = 0; i < size; i++) {
+		if (order[i] >= size)
+			goto out;
+		array[i] = index->build_array[order[i]];
+		/*
+		 * Keys are unique in terms of cmp_def, so the order
+		 * is a permutation if it is strictly ascending.
+		 */
+		if (i > 0 && memtx_tree_qcompare(&array[i - 1], &array[i],
+						 cmp_def) >= 0)
+			goto out;
+	}
+	free(index->build_array);
+	index->build_array = array;
+	index->build_array_alloc_size = size;
+	free(order);
+	return true;
+out:
+	if (array != NULL)
+		say_warn("index '%s' order from the snapshot is out of "
+			 "date, sorting", index->base.def->name);
+	free(array);
+	free(order);
+	return false;
+}
+
 static void
 memtx_tree_index_end_build(struct index *base)
 {
 	struct memtx_tree_index *index = (struct memtx_tree_index *)base;
 	struct key_def *cmp_def = memtx_tree_cmp_def(&index->tree);
-	qsort_arg(index->build_array, index->build_array_size,
-		  sizeof(index->build_array[0]), memtx_tree_qcompare, cmp_def);
+	if (!memtx_tree_index_apply_build_order(index)) {
+		qsort_arg(index->build_array, index->build_array_size,
+			  sizeof(index->build_array[0]),
+			  memtx_tree_qcompare, cmp_def);
+	}
 	if (cmp_def->is_multikey) {
 		/*
 		 * Multikey index may have equal(in terms of
@@ -1287,6 +1445,7 @@ static const struct index_vtab memtx_tree_index_vtab = {
 	/* .get = */ memtx_tree_index_get,
 	/* .replace = */ memtx_tree_index_replace,
 	/* .create_iterator = */ memtx_tree_index_create_iterator,
+	/* .create_iterator_after = */ memtx_tree_index_create_iterator_after,
 	/* .create_snapshot_iterator = */
 		memtx_tree_index_create_snapshot_iterator,
 	/* .stat = */ generic_index_stat,
@@ -1317,6 +1476,7 @@ static const struct index_vtab memtx_tree_index_multikey_vtab = {
 	/* .get = */ memtx_tree_index_get,
 	/* .replace = */ memtx_tree_index_replace_multikey,
 	/* .create_iterator = */ memtx_tree_index_create_iterator,
+	/* .create_iterator_after = */ generic_index_create_iterator_after,
 	/* .create_snapshot_iterator = */
 		memtx_tree_index_create_snapshot_iterator,
 	/* .stat = */ generic_index_stat,
@@ -1347,6 +1507,7 @@ static const struct index_vtab memtx_tree_func_index_vtab = {
 	/* .get = */ memtx_tree_index_get,
 	/* .replace = */ memtx_tree_func_index_replace,
 	/* .create_iterator = */ memtx_tree_index_create_iterator,
+	/* .create_iterator_after = */ generic_index_create_iterator_after,
 	/* .create_snapshot_iterator = */
 		memtx_tree_index_create_snapshot_iterator,
 	/* .stat = */ generic_index_stat,
@@ -1383,6 +1544,7 @@ static const struct index_vtab memtx_tree_disabled_index_vtab = {
 	/* .get = */ generic_index_get,
 	/* .replace = */ disabled_index_replace,
 	/* .create_iterator = */ generic_index_create_iterator,
+	/* .create_iterator_after = */ generic_index_create_iterator_after,
 	/* .create_snapshot_iterator = */
 		generic_index_create_snapshot_iterator,
 	/* .stat = */ generic_index_stat,
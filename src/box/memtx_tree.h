@@ -42,6 +42,20 @@ struct memtx_engine;
 struct index *
 memtx_tree_index_new(struct memtx_engine *memtx, struct index_def *def);
 
+/**
+ * Add a chunk of the order of the tree index @a index, read
+ * from the snapshot: @a size big-endian uint32 positions of
+ * primary key tuples, starting from position @a offset of
+ * @a count. The next build of the index uses the order instead
+ * of sorting the tuples if it still holds.
+ * @retval  0 Success.
+ * @retval -1 Error, diag is set.
+ */
+int
+memtx_tree_index_add_build_order(struct index *index, uint32_t count,
+				 uint32_t offset, const char *data,
+				 uint32_t size);
+
 #if defined(__cplusplus)
 } /* extern "C" */
 #endif /* defined(__cplusplus) */
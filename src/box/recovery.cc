@@ -42,6 +42,7 @@
 #include "session.h"
 #include "coio_file.h"
 #include "error.h"
+#include "tt_static.h"
 
 /*
  * Recovery subsystem
@@ -80,7 +81,8 @@
  * Throws an exception in  case of error.
  */
 struct recovery *
-recovery_new(const char *wal_dirname, bool force_recovery,
+recovery_new(const char *wal_dirname, const char **stripe_dirnames,
+	     int stripe_dir_count, bool force_recovery,
 	     const struct vclock *vclock)
 {
 	struct recovery *r = (struct recovery *)
@@ -92,12 +94,22 @@ recovery_new(const char *wal_dirname, bool force_recovery,
 	}
 
 	auto guard = make_scoped_guard([=]{
+		for (int i = 0; i < r->stripe_dir_count; i++)
+			xdir_destroy(&r->stripe_dir[i]);
+		xdir_destroy(&r->wal_dir);
 		free(r);
 	});
 
 	xdir_create(&r->wal_dir, wal_dirname, XLOG, &INSTANCE_UUID,
 		    &xlog_opts_default);
 	r->wal_dir.force_recovery = force_recovery;
+	assert(stripe_dir_count < XLOG_STRIPES_MAX);
+	for (int i = 0; i < stripe_dir_count; i++) {
+		xdir_create(&r->stripe_dir[i], stripe_dirnames[i], XLOG,
+			    &INSTANCE_UUID, &xlog_opts_default);
+		r->stripe_dir[i].force_recovery = force_recovery;
+		r->stripe_dir_count++;
+	}
 
 	vclock_copy(&r->vclock, vclock);
 
@@ -109,6 +121,8 @@ recovery_new(const char *wal_dirname, bool force_recovery,
 	 * details.
 	 */
 	xdir_check_xc(&r->wal_dir);
+	for (int i = 0; i < r->stripe_dir_count; i++)
+		xdir_check_xc(&r->stripe_dir[i]);
 
 	r->watcher = NULL;
 	rlist_create(&r->on_close_log);
@@ -117,12 +131,129 @@ recovery_new(const char *wal_dirname, bool force_recovery,
 	return r;
 }
 
+/**
+ * Open the cursors of the other stripes of the WAL file
+ * @a cursor is open for, if the file is striped.
+ */
+static int
+recovery_open_stripes(struct recovery *r, struct xlog_cursor *cursor,
+		      struct xlog_cursor *stripes)
+{
+	const struct xlog_meta *meta = &cursor->meta;
+	if (meta->stripe_count == 0)
+		return 0;
+	if (meta->stripe != 0 ||
+	    (int)meta->stripe_count > r->stripe_dir_count + 1) {
+		diag_set(XlogError, "%s: the file is stripe %u of %u, "
+			 "but %d WAL directories are configured",
+			 cursor->name, (unsigned)meta->stripe,
+			 (unsigned)meta->stripe_count,
+			 r->stripe_dir_count + 1);
+		return -1;
+	}
+	int64_t signature = vclock_sum(&meta->vclock);
+	uint32_t i;
+	for (i = 1; i < meta->stripe_count; i++) {
+		struct xlog_cursor *stripe = &stripes[i - 1];
+		if (xdir_open_cursor(&r->stripe_dir[i - 1], signature,
+				     stripe) != 0)
+			break;
+		if (stripe->meta.stripe != i ||
+		    stripe->meta.stripe_count != meta->stripe_count) {
+			diag_set(XlogError, "%s: the file is not stripe "
+				 "%u of %u", stripe->name, (unsigned)i,
+				 (unsigned)meta->stripe_count);
+			xlog_cursor_close(stripe, false);
+			break;
+		}
+	}
+	if (i == meta->stripe_count)
+		return 0;
+	while (--i > 0)
+		xlog_cursor_close(&stripes[i - 1], false);
+	return -1;
+}
+
+static void
+recovery_close_stripes(struct xlog_cursor *stripes)
+{
+	for (int i = 0; i < XLOG_STRIPES_MAX - 1; i++) {
+		if (xlog_cursor_is_open(&stripes[i]))
+			xlog_cursor_close(&stripes[i], false);
+	}
+}
+
+/**
+ * The cursor to read the next row of the WAL file @a cursor
+ * is open for: @a cursor itself or the cursor of the stripe
+ * the row was written to, selected by the @a vclock of the
+ * file before the row.
+ */
+static struct xlog_cursor *
+recovery_next_cursor(struct xlog_cursor *cursor, struct xlog_cursor *stripes,
+		     const struct vclock *vclock)
+{
+	uint32_t count = cursor->meta.stripe_count;
+	if (count == 0)
+		return cursor;
+	uint32_t i = xlog_stripe(vclock_sum(vclock), count);
+	return i == 0 ? cursor : &stripes[i - 1];
+}
+
+/**
+ * Read the next row of a WAL file, merging the stripes of the
+ * file in the order the rows were written. @a vclock follows
+ * the rows read. Returns the same as xlog_cursor_next().
+ */
+static int
+recovery_cursor_next(struct xlog_cursor *cursor, struct xlog_cursor *stripes,
+		     struct vclock *vclock, struct xrow_header *row,
+		     bool force_recovery)
+{
+	if (cursor->meta.stripe_count == 0)
+		return xlog_cursor_next(cursor, row, force_recovery);
+	int rc = xlog_cursor_next(recovery_next_cursor(cursor, stripes,
+						       vclock),
+				  row, force_recovery);
+	/* The WAL writer follows the rows the same way. */
+	if (rc == 0 && row->lsn > vclock_get(vclock, row->replica_id))
+		vclock_follow_xrow(vclock, row);
+	return rc;
+}
+
+/**
+ * True if the current WAL file has been read to its end,
+ * i.e. up to the EOF marker of the stripe holding the row
+ * which would be the next one.
+ */
+static inline bool
+recovery_log_is_eof(struct recovery *r)
+{
+	return xlog_cursor_is_eof(recovery_next_cursor(&r->cursor,
+						       r->stripe_cursor,
+						       &r->stripe_vclock));
+}
+
 void
 recovery_scan(struct recovery *r, struct vclock *end_vclock,
 	      struct vclock *gc_vclock)
 {
 	xdir_scan_xc(&r->wal_dir);
 
+	/*
+	 * The stripes of a file are looked up by their index in
+	 * wal_stripe_dirs, so a directory can't be removed from
+	 * the option while there are files striped over it.
+	 */
+	uint32_t stripe_count = r->wal_dir.max_stripe_count;
+	if ((int)stripe_count > r->stripe_dir_count + 1) {
+		tnt_raise(ClientError, ER_CFG, "wal_stripe_dirs",
+			  tt_sprintf("the WAL files in '%s' are striped over "
+				     "%u directories, but %d are configured",
+				     r->wal_dir.dirname, (unsigned)stripe_count,
+				     r->stripe_dir_count + 1));
+	}
+
 	if (xdir_last_vclock(&r->wal_dir, end_vclock) < 0 ||
 	    vclock_compare(end_vclock, &r->vclock) < 0) {
 		/* No xlogs after last checkpoint. */
@@ -138,9 +269,17 @@ recovery_scan(struct recovery *r, struct vclock *end_vclock,
 	struct xlog_cursor cursor;
 	if (xdir_open_cursor(&r->wal_dir, vclock_sum(end_vclock), &cursor) != 0)
 		return;
+	if (recovery_open_stripes(r, &cursor, r->stripe_cursor) != 0) {
+		xlog_cursor_close(&cursor, false);
+		return;
+	}
+	struct vclock vclock;
+	vclock_copy(&vclock, &cursor.meta.vclock);
 	struct xrow_header row;
-	while (xlog_cursor_next(&cursor, &row, true) == 0)
+	while (recovery_cursor_next(&cursor, r->stripe_cursor, &vclock,
+				    &row, true) == 0)
 		vclock_follow_xrow(end_vclock, &row);
+	recovery_close_stripes(r->stripe_cursor);
 	xlog_cursor_close(&cursor, false);
 }
 
@@ -149,12 +288,13 @@ recovery_close_log(struct recovery *r)
 {
 	if (!xlog_cursor_is_open(&r->cursor))
 		return;
-	if (xlog_cursor_is_eof(&r->cursor)) {
+	if (recovery_log_is_eof(r)) {
 		say_info("done `%s'", r->cursor.name);
 	} else {
 		say_warn("file `%s` wasn't correctly closed",
 			 r->cursor.name);
 	}
+	recovery_close_stripes(r->stripe_cursor);
 	xlog_cursor_close(&r->cursor, false);
 	trigger_run_xc(&r->on_close_log, NULL);
 }
@@ -169,6 +309,11 @@ recovery_open_log(struct recovery *r, const struct vclock *vclock)
 	recovery_close_log(r);
 
 	xdir_open_cursor_xc(&r->wal_dir, vclock_sum(vclock), &r->cursor);
+	if (recovery_open_stripes(r, &r->cursor, r->stripe_cursor) != 0) {
+		xlog_cursor_close(&r->cursor, false);
+		diag_raise();
+	}
+	vclock_copy(&r->stripe_vclock, &r->cursor.meta.vclock);
 
 	if (state == XLOG_CURSOR_NEW &&
 	    vclock_compare(vclock, &r->vclock) > 0) {
@@ -220,11 +365,14 @@ recovery_delete(struct recovery *r)
 
 	trigger_destroy(&r->on_close_log);
 	xdir_destroy(&r->wal_dir);
+	for (int i = 0; i < r->stripe_dir_count; i++)
+		xdir_destroy(&r->stripe_dir[i]);
 	if (xlog_cursor_is_open(&r->cursor)) {
 		/*
 		 * Possible if shutting down a replication
 		 * relay or if error during startup.
 		 */
+		recovery_close_stripes(r->stripe_cursor);
 		xlog_cursor_close(&r->cursor, false);
 	}
 	free(r);
@@ -243,15 +391,18 @@ recover_xlog(struct recovery *r, struct xstream *stream,
 {
 	struct xrow_header row;
 	uint64_t row_count = 0;
-	while (xlog_cursor_next_xc(&r->cursor, &row,
-				   r->wal_dir.force_recovery) == 0) {
+	int rc;
+	while ((rc = recovery_cursor_next(&r->cursor, r->stripe_cursor,
+					  &r->stripe_vclock, &row,
+					  r->wal_dir.force_recovery)) == 0) {
 		/*
 		 * Read the next row from xlog file.
 		 *
-		 * xlog_cursor_next_xc() returns 1 when
+		 * recovery_cursor_next() returns 1 when
 		 * it can not read more rows. This doesn't mean
 		 * the file is fully read: it's fully read only
-		 * when EOF marker has been read, see i.eof_read
+		 * when EOF marker has been read, see
+		 * recovery_log_is_eof().
 		 */
 		if (stop_vclock != NULL &&
 		    r->vclock.signature >= stop_vclock->signature)
@@ -289,6 +440,8 @@ recover_xlog(struct recovery *r, struct xstream *stream,
 			diag_log();
 		}
 	}
+	if (rc < 0)
+		diag_raise();
 }
 
 /**
@@ -313,7 +466,7 @@ recover_remaining_wals(struct recovery *r, struct xstream *stream,
 
 	if (xlog_cursor_is_open(&r->cursor)) {
 		/* If there's a WAL open, recover from it first. */
-		assert(!xlog_cursor_is_eof(&r->cursor));
+		assert(!recovery_log_is_eof(r));
 		clock = vclockset_search(&r->wal_dir.index,
 					 &r->cursor.meta.vclock);
 		if (clock != NULL)
@@ -334,7 +487,7 @@ recover_remaining_wals(struct recovery *r, struct xstream *stream,
 			break;
 		}
 
-		if (xlog_cursor_is_eof(&r->cursor) &&
+		if (recovery_log_is_eof(r) &&
 		    vclock_sum(&r->cursor.meta.vclock) >= vclock_sum(clock)) {
 			/*
 			 * If we reached EOF while reading last xlog,
@@ -351,7 +504,7 @@ recover_current_wal:
 		recover_xlog(r, stream, stop_vclock);
 	}
 
-	if (xlog_cursor_is_eof(&r->cursor))
+	if (recovery_log_is_eof(r))
 		recovery_close_log(r);
 
 	if (stop_vclock != NULL && vclock_compare(&r->vclock, stop_vclock) != 0)
@@ -492,8 +645,18 @@ hot_standby_f(va_list ap)
 			 */
 		} while (end > start && !xlog_cursor_is_open(&r->cursor));
 
-		subscription.set_log_path(xlog_cursor_is_open(&r->cursor) ?
-					  r->cursor.name : NULL);
+		/*
+		 * Watch the file the next row is going to be
+		 * written to: a stripe of the current WAL file
+		 * if it is striped.
+		 */
+		const char *path = NULL;
+		if (xlog_cursor_is_open(&r->cursor)) {
+			path = recovery_next_cursor(&r->cursor,
+						    r->stripe_cursor,
+						    &r->stripe_vclock)->name;
+		}
+		subscription.set_log_path(path);
 
 		bool timed_out = false;
 		if (subscription.events == 0) {
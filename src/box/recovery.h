@@ -50,6 +50,22 @@ struct recovery {
 	/** The WAL cursor we're currently reading/writing from/to. */
 	struct xlog_cursor cursor;
 	struct xdir wal_dir;
+	/**
+	 * Directories of the stripes of a striped WAL but the
+	 * first one, which is wal_dir, see xlog_stripe().
+	 */
+	struct xdir stripe_dir[XLOG_STRIPES_MAX - 1];
+	int stripe_dir_count;
+	/**
+	 * Cursors of the stripes of the current WAL file but
+	 * the first one, which is @a cursor, if it is striped.
+	 */
+	struct xlog_cursor stripe_cursor[XLOG_STRIPES_MAX - 1];
+	/**
+	 * The vclock of the current WAL file before the next
+	 * row, selects the stripe to read the row from.
+	 */
+	struct vclock stripe_vclock;
 	/**
 	 * This fiber is used in local hot standby mode.
 	 * It looks for changes in the wal_dir and applies
@@ -61,7 +77,8 @@ struct recovery {
 };
 
 struct recovery *
-recovery_new(const char *wal_dirname, bool force_recovery,
+recovery_new(const char *wal_dirname, const char **stripe_dirnames,
+	     int stripe_dir_count, bool force_recovery,
 	     const struct vclock *vclock);
 
 void
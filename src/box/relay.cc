@@ -41,6 +41,7 @@
 
 #include "coio.h"
 #include "coio_task.h"
+#include "box.h"
 #include "engine.h"
 #include "gc.h"
 #include "iproto_constants.h"
@@ -361,8 +362,10 @@ relay_final_join(int fd, uint64_t sync, struct vclock *start_vclock,
 		relay_delete(relay);
 	});
 
-	relay->r = recovery_new(cfg_gets("wal_dir"), false,
-			       start_vclock);
+	const char *stripe_dirs[XLOG_STRIPES_MAX - 1];
+	int stripe_dir_count = box_wal_stripe_dirs(stripe_dirs);
+	relay->r = recovery_new(cfg_gets("wal_dir"), stripe_dirs,
+				stripe_dir_count, false, start_vclock);
 	vclock_copy(&relay->stop_vclock, stop_vclock);
 
 	int rc = cord_costart(&relay->cord, "final_join",
@@ -708,8 +711,10 @@ relay_subscribe(struct replica *replica, int fd, uint64_t sync,
 	});
 
 	vclock_copy(&relay->local_vclock_at_subscribe, &replicaset.vclock);
-	relay->r = recovery_new(cfg_gets("wal_dir"), false,
-			        replica_clock);
+	const char *stripe_dirs[XLOG_STRIPES_MAX - 1];
+	int stripe_dir_count = box_wal_stripe_dirs(stripe_dirs);
+	relay->r = recovery_new(cfg_gets("wal_dir"), stripe_dirs,
+				stripe_dir_count, false, replica_clock);
 	vclock_copy(&relay->tx.vclock, replica_clock);
 	relay->version_id = replica_version_id;
 
@@ -299,6 +299,7 @@ static const struct index_vtab session_settings_index_vtab = {
 	/* .get = */ session_settings_index_get,
 	/* .replace = */ generic_index_replace,
 	/* .create_iterator = */ session_settings_index_create_iterator,
+	/* .create_iterator_after = */ generic_index_create_iterator_after,
 	/* .create_snapshot_iterator = */
 		generic_index_create_snapshot_iterator,
 	/* .stat = */ generic_index_stat,
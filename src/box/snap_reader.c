@@ -0,0 +1,477 @@
+/*
+ * Copyright 2010-2020, Tarantool AUTHORS, please see AUTHORS file.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include "snap_reader.h"
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zstd.h>
+
+#include "trivia/util.h"
+#include "tt_pthread.h"
+#include "fiber.h"
+#include "fiber_cond.h"
+#include "diag.h"
+#include "error.h"
+#include "errcode.h"
+#include "iproto_constants.h"
+#include "xlog.h"
+
+enum {
+	/** Number of transactions read ahead per decoder. */
+	SNAP_READER_BATCHES_PER_THREAD = 4,
+};
+
+/** A transaction of the snapshot. */
+struct snap_reader_batch {
+	/** The transaction as it is stored in the file. */
+	char *raw;
+	size_t raw_size;
+	size_t raw_capacity;
+	/** Decompressed rows of the transaction. */
+	char *data;
+	size_t data_capacity;
+	/** Decoded rows, refer to @data. */
+	struct snap_reader_row *rows;
+	int row_count;
+	int row_capacity;
+	/** Set when the batch is decoded. */
+	bool is_decoded;
+	/**
+	 * Decoding error. The rows before the failed one are
+	 * valid and are returned before the error.
+	 */
+	struct diag diag;
+};
+
+struct snap_reader {
+	/** Name of the snapshot file. */
+	char filename[PATH_MAX];
+	/** LSN of all rows of the snapshot. */
+	int64_t signature;
+	/** Ring of batches, indexed by counter % batch_count. */
+	struct snap_reader_batch *batches;
+	int batch_count;
+	/** Protects the counters and flags below. */
+	pthread_mutex_t mutex;
+	/** Signalled when a batch is released or on shutdown. */
+	pthread_cond_t read_cond;
+	/** Signalled when a batch is read or the reading is over. */
+	pthread_cond_t decode_cond;
+	/**
+	 * The thread which created the reader and gets the rows.
+	 * The other threads wake it up with apply_async when a
+	 * batch is decoded or the reading is over, and it waits
+	 * on apply_cond, so that its event loop keeps running.
+	 */
+	ev_loop *loop;
+	struct ev_async apply_async;
+	struct fiber_cond apply_cond;
+	/** Number of batches read, taken for decoding, released. */
+	int64_t read_count;
+	int64_t decode_count;
+	int64_t apply_count;
+	/** Set when the reader thread is done with the file. */
+	bool is_read_done;
+	/** Set if the EOF marker has been read. */
+	bool is_eof;
+	/** Set to stop the threads. */
+	bool is_shutdown;
+	/** Error of the reader thread. */
+	struct diag diag;
+	/** The batch the rows are returned from, tx thread only. */
+	struct snap_reader_batch *batch;
+	int row_idx;
+	/** The reader thread. */
+	struct cord reader_cord;
+	bool is_reader_started;
+	/** Decoder threads. */
+	struct cord *decoders;
+	int decoder_count;
+};
+
+/**
+ * Read the file transaction by transaction into the batches
+ * of the ring, as long as there are free batches.
+ */
+static void *
+snap_reader_read_f(void *arg)
+{
+	struct snap_reader *reader = (struct snap_reader *) arg;
+	struct xlog_cursor cursor;
+	bool is_open = false;
+	int rc = xlog_cursor_open(&cursor, reader->filename);
+	if (rc == 0)
+		is_open = true;
+	while (rc == 0) {
+		tt_pthread_mutex_lock(&reader->mutex);
+		while (!reader->is_shutdown &&
+		       reader->read_count - reader->apply_count >=
+		       reader->batch_count)
+			tt_pthread_cond_wait(&reader->read_cond,
+					     &reader->mutex);
+		bool is_shutdown = reader->is_shutdown;
+		struct snap_reader_batch *batch =
+			&reader->batches[reader->read_count %
+					 reader->batch_count];
+		tt_pthread_mutex_unlock(&reader->mutex);
+		if (is_shutdown)
+			break;
+		const char *data;
+		size_t size;
+		rc = xlog_cursor_next_tx_raw(&cursor, &data, &size);
+		if (rc != 0)
+			break;
+		if (size > batch->raw_capacity) {
+			char *raw = (char *) realloc(batch->raw, size);
+			if (raw == NULL) {
+				diag_set(OutOfMemory, size, "realloc",
+					 "snapshot transaction");
+				rc = -1;
+				break;
+			}
+			batch->raw = raw;
+			batch->raw_capacity = size;
+		}
+		memcpy(batch->raw, data, size);
+		batch->raw_size = size;
+		tt_pthread_mutex_lock(&reader->mutex);
+		reader->read_count++;
+		tt_pthread_cond_signal(&reader->decode_cond);
+		tt_pthread_mutex_unlock(&reader->mutex);
+	}
+	tt_pthread_mutex_lock(&reader->mutex);
+	if (rc < 0)
+		diag_move(diag_get(), &reader->diag);
+	if (is_open)
+		reader->is_eof = xlog_cursor_is_eof(&cursor);
+	reader->is_read_done = true;
+	tt_pthread_cond_broadcast(&reader->decode_cond);
+	ev_async_send(reader->loop, &reader->apply_async);
+	tt_pthread_mutex_unlock(&reader->mutex);
+	if (is_open)
+		xlog_cursor_close(&cursor, false);
+	return NULL;
+}
+
+/** Append a row to the batch, return NULL on OOM. */
+static struct snap_reader_row *
+snap_reader_batch_add_row(struct snap_reader_batch *batch)
+{
+	if (batch->row_count == batch->row_capacity) {
+		int capacity = MAX(batch->row_capacity * 2, 64);
+		size_t size = capacity * sizeof(*batch->rows);
+		struct snap_reader_row *rows =
+			(struct snap_reader_row *) realloc(batch->rows, size);
+		if (rows == NULL) {
+			diag_set(OutOfMemory, size, "realloc",
+				 "snapshot rows");
+			return NULL;
+		}
+		batch->rows = rows;
+		batch->row_capacity = capacity;
+	}
+	return &batch->rows[batch->row_count++];
+}
+
+/** Decompress the rows of a transaction and decode them. */
+static int
+snap_reader_decode(struct snap_reader *reader,
+		   struct snap_reader_batch *batch, ZSTD_DStream *zdctx)
+{
+	batch->row_count = 0;
+	const char *data = batch->raw;
+	struct xlog_tx_cursor tx_cursor;
+	ssize_t to_load = xlog_tx_cursor_create(&tx_cursor, &data,
+						data + batch->raw_size, zdctx);
+	if (to_load < 0)
+		return -1;
+	/* The reader buffers whole transactions. */
+	assert(to_load == 0);
+	/*
+	 * The rows buffer belongs to the slab cache of this
+	 * thread, so copy the rows out of it.
+	 */
+	size_t size = ibuf_used(&tx_cursor.rows);
+	if (size > batch->data_capacity) {
+		char *buf = (char *) realloc(batch->data, size);
+		if (buf == NULL) {
+			diag_set(OutOfMemory, size, "realloc",
+				 "snapshot rows");
+			xlog_tx_cursor_destroy(&tx_cursor);
+			return -1;
+		}
+		batch->data = buf;
+		batch->data_capacity = size;
+	}
+	memcpy(batch->data, tx_cursor.rows.rpos, size);
+	xlog_tx_cursor_destroy(&tx_cursor);
+
+	int rc = 0;
+	const char *pos = batch->data;
+	const char *end = batch->data + size;
+	while (pos < end) {
+		struct snap_reader_row *row = snap_reader_batch_add_row(batch);
+		if (row == NULL) {
+			rc = -1;
+			break;
+		}
+		if (xrow_header_decode(&row->header, &pos, end, false) != 0) {
+			diag_set(XlogError, "can't parse row");
+			batch->row_count--;
+			rc = -1;
+			break;
+		}
+		row->header.lsn = reader->signature;
+	}
+	/*
+	 * Requests refer to the headers, so decode them when
+	 * the row array doesn't grow anymore. A failure to
+	 * decode a request precedes a failure to decode a row
+	 * in the file order, so it overrides the error.
+	 */
+	for (int i = 0; i < batch->row_count; i++) {
+		struct snap_reader_row *row = &batch->rows[i];
+		/* The index order is decoded by the caller. */
+		if (row->header.type == MEMTX_INDEX_ORDER)
+			continue;
+		if (row->header.type != IPROTO_INSERT) {
+			diag_set(ClientError, ER_UNKNOWN_REQUEST_TYPE,
+				 (uint32_t) row->header.type);
+		} else if (xrow_decode_dml(&row->header, &row->request,
+				dml_request_key_map(IPROTO_INSERT)) == 0) {
+			continue;
+		}
+		batch->row_count = i;
+		rc = -1;
+		break;
+	}
+	return rc;
+}
+
+/** Decode the read batches, in parallel with other decoders. */
+static void *
+snap_reader_decode_f(void *arg)
+{
+	struct snap_reader *reader = (struct snap_reader *) arg;
+	ZSTD_DStream *zdctx = ZSTD_createDStream();
+	if (zdctx == NULL)
+		panic("failed to create a zstd decompression context");
+	tt_pthread_mutex_lock(&reader->mutex);
+	while (true) {
+		while (!reader->is_shutdown && !reader->is_read_done &&
+		       reader->decode_count == reader->read_count)
+			tt_pthread_cond_wait(&reader->decode_cond,
+					     &reader->mutex);
+		if (reader->is_shutdown ||
+		    reader->decode_count == reader->read_count)
+			break;
+		struct snap_reader_batch *batch =
+			&reader->batches[reader->decode_count++ %
+					 reader->batch_count];
+		tt_pthread_mutex_unlock(&reader->mutex);
+		if (snap_reader_decode(reader, batch, zdctx) != 0)
+			diag_move(diag_get(), &batch->diag);
+		tt_pthread_mutex_lock(&reader->mutex);
+		batch->is_decoded = true;
+		ev_async_send(reader->loop, &reader->apply_async);
+	}
+	tt_pthread_mutex_unlock(&reader->mutex);
+	ZSTD_freeDStream(zdctx);
+	return NULL;
+}
+
+static void
+snap_reader_apply_async_cb(ev_loop *loop, struct ev_async *watcher,
+			   int events)
+{
+	(void) loop;
+	(void) events;
+	struct snap_reader *reader = (struct snap_reader *) watcher->data;
+	fiber_cond_broadcast(&reader->apply_cond);
+}
+
+struct snap_reader *
+snap_reader_new(const char *filename, int64_t signature, int thread_count)
+{
+	assert(thread_count > 0 && thread_count <= SNAP_READER_THREADS_MAX);
+	struct snap_reader *reader =
+		(struct snap_reader *) calloc(1, sizeof(*reader));
+	if (reader == NULL) {
+		diag_set(OutOfMemory, sizeof(*reader), "calloc",
+			 "struct snap_reader");
+		return NULL;
+	}
+	snprintf(reader->filename, sizeof(reader->filename), "%s", filename);
+	reader->signature = signature;
+	tt_pthread_mutex_init(&reader->mutex, NULL);
+	tt_pthread_cond_init(&reader->read_cond, NULL);
+	tt_pthread_cond_init(&reader->decode_cond, NULL);
+	reader->loop = loop();
+	ev_async_init(&reader->apply_async, snap_reader_apply_async_cb);
+	reader->apply_async.data = reader;
+	ev_async_start(reader->loop, &reader->apply_async);
+	fiber_cond_create(&reader->apply_cond);
+	diag_create(&reader->diag);
+
+	reader->batch_count = thread_count * SNAP_READER_BATCHES_PER_THREAD;
+	reader->batches = (struct snap_reader_batch *)
+		calloc(reader->batch_count, sizeof(*reader->batches));
+	reader->decoders = (struct cord *)
+		calloc(thread_count, sizeof(*reader->decoders));
+	if (reader->batches == NULL || reader->decoders == NULL) {
+		diag_set(OutOfMemory, reader->batch_count *
+			 sizeof(*reader->batches), "calloc",
+			 "snapshot reader batches");
+		reader->batch_count = 0;
+		goto fail;
+	}
+	for (int i = 0; i < reader->batch_count; i++)
+		diag_create(&reader->batches[i].diag);
+
+	if (cord_start(&reader->reader_cord, "snap_read",
+		       snap_reader_read_f, reader) != 0)
+		goto fail;
+	reader->is_reader_started = true;
+	for (int i = 0; i < thread_count; i++) {
+		if (cord_start(&reader->decoders[i], "snap_decode",
+			       snap_reader_decode_f, reader) != 0)
+			goto fail;
+		reader->decoder_count++;
+	}
+	return reader;
+fail:
+	snap_reader_delete(reader);
+	return NULL;
+}
+
+void
+snap_reader_delete(struct snap_reader *reader)
+{
+	tt_pthread_mutex_lock(&reader->mutex);
+	reader->is_shutdown = true;
+	tt_pthread_cond_broadcast(&reader->read_cond);
+	tt_pthread_cond_broadcast(&reader->decode_cond);
+	tt_pthread_mutex_unlock(&reader->mutex);
+	if (reader->is_reader_started &&
+	    cord_join(&reader->reader_cord) != 0)
+		panic_syserror("snapshot reader: thread join failed");
+	for (int i = 0; i < reader->decoder_count; i++) {
+		if (cord_join(&reader->decoders[i]) != 0)
+			panic_syserror("snapshot reader: thread join failed");
+	}
+	for (int i = 0; i < reader->batch_count; i++) {
+		struct snap_reader_batch *batch = &reader->batches[i];
+		free(batch->raw);
+		free(batch->data);
+		free(batch->rows);
+		diag_destroy(&batch->diag);
+	}
+	free(reader->batches);
+	free(reader->decoders);
+	diag_destroy(&reader->diag);
+	/* The threads are joined, nothing can send the async. */
+	ev_async_stop(reader->loop, &reader->apply_async);
+	fiber_cond_destroy(&reader->apply_cond);
+	tt_pthread_cond_destroy(&reader->decode_cond);
+	tt_pthread_cond_destroy(&reader->read_cond);
+	tt_pthread_mutex_destroy(&reader->mutex);
+	free(reader);
+}
+
+/** Return the current batch to the reader. */
+static void
+snap_reader_release_batch(struct snap_reader *reader)
+{
+	struct snap_reader_batch *batch = reader->batch;
+	assert(batch != NULL);
+	tt_pthread_mutex_lock(&reader->mutex);
+	batch->is_decoded = false;
+	reader->apply_count++;
+	tt_pthread_cond_signal(&reader->read_cond);
+	tt_pthread_mutex_unlock(&reader->mutex);
+	reader->batch = NULL;
+	reader->row_idx = 0;
+}
+
+int
+snap_reader_next(struct snap_reader *reader, struct snap_reader_row **row)
+{
+	struct snap_reader_batch *batch = reader->batch;
+	while (batch == NULL || reader->row_idx == batch->row_count) {
+		if (batch != NULL) {
+			if (!diag_is_empty(&batch->diag)) {
+				diag_move(&batch->diag, diag_get());
+				return -1;
+			}
+			snap_reader_release_batch(reader);
+		}
+		tt_pthread_mutex_lock(&reader->mutex);
+		while (true) {
+			batch = &reader->batches[reader->apply_count %
+						 reader->batch_count];
+			if (reader->apply_count < reader->read_count ?
+			    batch->is_decoded : reader->is_read_done)
+				break;
+			tt_pthread_mutex_unlock(&reader->mutex);
+			/*
+			 * A wakeup sent before the wait is not lost:
+			 * the async is handled by the event loop only
+			 * when the fiber yields.
+			 */
+			if (fiber_cond_wait(&reader->apply_cond) != 0)
+				return -1;
+			tt_pthread_mutex_lock(&reader->mutex);
+		}
+		bool is_done = reader->apply_count == reader->read_count;
+		tt_pthread_mutex_unlock(&reader->mutex);
+		if (is_done) {
+			if (!diag_is_empty(&reader->diag)) {
+				diag_move(&reader->diag, diag_get());
+				return -1;
+			}
+			return 1;
+		}
+		reader->batch = batch;
+	}
+	*row = &batch->rows[reader->row_idx++];
+	return 0;
+}
+
+bool
+snap_reader_is_eof(struct snap_reader *reader)
+{
+	tt_pthread_mutex_lock(&reader->mutex);
+	bool is_eof = reader->is_eof;
+	tt_pthread_mutex_unlock(&reader->mutex);
+	return is_eof;
+}
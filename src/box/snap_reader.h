@@ -0,0 +1,103 @@
+#ifndef TARANTOOL_BOX_SNAP_READER_H_INCLUDED
+#define TARANTOOL_BOX_SNAP_READER_H_INCLUDED
+/*
+ * Copyright 2010-2020, Tarantool AUTHORS, please see AUTHORS file.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "xrow.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif /* defined(__cplusplus) */
+
+/**
+ * A pipeline of threads reading a snapshot file. A reader
+ * thread reads the transactions of the file, as they are,
+ * and decoder threads check, decompress and decode them in
+ * parallel. The decoded rows are returned to the caller in
+ * the file order. At most SNAP_READER_BATCHES_PER_THREAD
+ * transactions per decoder are read ahead of the caller.
+ */
+
+enum {
+	/** Max number of decoder threads. */
+	SNAP_READER_THREADS_MAX = 64,
+};
+
+/** A decoded row of the snapshot. */
+struct snap_reader_row {
+	struct xrow_header header;
+	/**
+	 * The INSERT request of the row, refers to @header.
+	 * Not set for MEMTX_INDEX_ORDER rows.
+	 */
+	struct request request;
+};
+
+struct snap_reader;
+
+/**
+ * Open the snapshot file @a filename and start reading it
+ * with @a thread_count decoder threads. The LSN of all rows
+ * is set to @a signature.
+ * @retval NULL Error, diag is set.
+ */
+struct snap_reader *
+snap_reader_new(const char *filename, int64_t signature, int thread_count);
+
+/** Stop the threads and free the reader. */
+void
+snap_reader_delete(struct snap_reader *reader);
+
+/**
+ * Get the next row of the file. The row is valid until the
+ * next call. Must be called in the thread which created the
+ * reader. Yields while the next row is not decoded yet.
+ * @retval  0 Success.
+ * @retval  1 The end of the file.
+ * @retval -1 Error, diag is set.
+ */
+int
+snap_reader_next(struct snap_reader *reader, struct snap_reader_row **row);
+
+/**
+ * True if the EOF marker has been read. Valid when
+ * snap_reader_next() has returned 1.
+ */
+bool
+snap_reader_is_eof(struct snap_reader *reader);
+
+#if defined(__cplusplus)
+} /* extern "C" */
+#endif /* defined(__cplusplus) */
+
+#endif /* TARANTOOL_BOX_SNAP_READER_H_INCLUDED */
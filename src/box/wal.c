@@ -32,10 +32,17 @@
 
 #include "vclock.h"
 #include "fiber.h"
+#include "tt_pthread.h"
+#include "clock.h"
 #include "fio.h"
 #include "errinj.h"
 #include "error.h"
 #include "exception.h"
+#include "histogram.h"
+#include "info/info.h"
+#include "coio_pool.h"
+
+#include <dirent.h>
 
 #include "xlog.h"
 #include "xrow.h"
@@ -54,8 +61,13 @@ enum {
 	 * latency. 1 MB seems to be a well balanced choice.
 	 */
 	WAL_FALLOCATE_LEN = 1024 * 1024,
+	/** Size of a write filling a preallocated file with zeros. */
+	WAL_PREALLOC_CHUNK = 1024 * 1024,
 };
 
+/** Suffix of a preallocated file, see struct wal_prealloc. */
+#define WAL_PREALLOC_SUFFIX ".spare"
+
 const char *wal_mode_STRS[] = { "none", "write", "fsync", NULL };
 
 int wal_dir_lock = -1;
@@ -72,6 +84,59 @@ wal_write_none_async(struct journal *, struct journal_entry *);
 static int
 wal_write_none(struct journal *, struct journal_entry *);
 
+/**
+ * In the fsync mode a batch written to a striped WAL is
+ * synced in parallel: the WAL thread hands the files to
+ * the syncer threads, one per stripe, and waits for them.
+ */
+struct wal_stripe_sync {
+	pthread_mutex_t mutex;
+	/** Signalled when a round of syncs starts or on shutdown. */
+	pthread_cond_t start_cond;
+	/** Signalled when all syncs of the round are done. */
+	pthread_cond_t done_cond;
+	/** Number of the current round. */
+	uint64_t round;
+	/** Number of syncs of the round which are not done. */
+	int pending;
+	/** Set on shutdown, the syncer threads exit. */
+	bool is_shutdown;
+	struct wal_stripe_syncer {
+		struct cord cord;
+		/** The last round the thread has taken part in. */
+		uint64_t round;
+		/** The file to sync in the round. */
+		int fd;
+		/** errno of the sync, 0 on success. */
+		int error;
+	} syncers[XLOG_STRIPES_MAX - 1];
+	/** Number of started syncer threads. */
+	int syncer_count;
+};
+
+/**
+ * A pool of files filled with zeros to create new WAL files
+ * from, see xdir_recycle_xlog(). The files are prepared in
+ * the background by coio jobs, either from scratch or from
+ * the WAL files removed by garbage collection, and stored in
+ * the WAL directory as <id>.spare. Since the blocks of such
+ * a file are allocated and written, syncing a write to it
+ * doesn't have to update file metadata.
+ */
+struct wal_prealloc {
+	/** Number of files to keep, 0 if the pool is disabled. */
+	int count;
+	/** Ids of the ready files. */
+	int64_t ready[WAL_PREALLOC_COUNT_MAX];
+	int ready_count;
+	/** Number of files being prepared. */
+	int pending;
+	/** Id of the next file. */
+	int64_t next_id;
+	/** Set when the files of the previous run are found. */
+	bool is_started;
+};
+
 /*
  * WAL writer - maintain a Write Ahead Log for every change
  * in the data state.
@@ -148,6 +213,32 @@ struct wal_writer
 	bool checkpoint_triggered;
 	/** The current WAL file. */
 	struct xlog current_wal;
+	/**
+	 * Number of stripes of the WAL, 1 if it is not striped.
+	 * The stripe 0 is wal_dir and current_wal, the others
+	 * are stripe_dir and stripe_wal, see xlog_stripe().
+	 */
+	int stripe_count;
+	struct xdir stripe_dir[XLOG_STRIPES_MAX - 1];
+	struct xlog stripe_wal[XLOG_STRIPES_MAX - 1];
+	struct wal_stripe_sync stripe_sync;
+	/** Preallocated files, not used with a striped WAL. */
+	struct wal_prealloc prealloc;
+	/**
+	 * Group commit of the fsync mode: the longest time to
+	 * wait for more entries before writing a batch, and the
+	 * size of a batch to stop waiting at, see
+	 * wal_group_commit().
+	 */
+	double group_commit_window;
+	int64_t group_commit_size;
+	/** Sizes of the written batches, in bytes. */
+	struct histogram *batch_size_hist;
+	/**
+	 * Time to write a batch in the fsync mode, when the
+	 * writes are synchronous, in microseconds.
+	 */
+	struct histogram *fsync_latency_hist;
 	/**
 	 * Used if there was a WAL I/O error and we need to
 	 * keep adding all incoming requests to the rollback
@@ -197,6 +288,20 @@ wal_mode()
 static void
 wal_write_to_disk(struct cmsg *msg);
 
+/** Directory of the stripe @a i of the WAL. */
+static inline struct xdir *
+wal_stripe_dir(struct wal_writer *writer, int i)
+{
+	return i == 0 ? &writer->wal_dir : &writer->stripe_dir[i - 1];
+}
+
+/** The current file of the stripe @a i of the WAL. */
+static inline struct xlog *
+wal_stripe_wal(struct wal_writer *writer, int i)
+{
+	return i == 0 ? &writer->current_wal : &writer->stripe_wal[i - 1];
+}
+
 static void
 tx_schedule_commit(struct cmsg *msg);
 
@@ -350,7 +455,8 @@ tx_notify_checkpoint(struct cmsg *msg)
 static void
 wal_writer_create(struct wal_writer *writer, enum wal_mode wal_mode,
 		  void (*wall_async_cb)(struct journal_entry *entry),
-		  const char *wal_dirname,
+		  const char *wal_dirname, const char **stripe_dirnames,
+		  int stripe_dir_count, int prealloc_count,
 		  int64_t wal_max_size, const struct tt_uuid *instance_uuid,
 		  wal_on_garbage_collection_f on_garbage_collection,
 		  wal_on_checkpoint_threshold_f on_checkpoint_threshold)
@@ -370,8 +476,44 @@ wal_writer_create(struct wal_writer *writer, enum wal_mode wal_mode,
 	opts.sync_is_async = true;
 	xdir_create(&writer->wal_dir, wal_dirname, XLOG, instance_uuid, &opts);
 	xlog_clear(&writer->current_wal);
-	if (wal_mode == WAL_FSYNC)
+	assert(stripe_dir_count < XLOG_STRIPES_MAX);
+	assert(stripe_dir_count == 0 || wal_mode == WAL_FSYNC);
+	writer->stripe_count = 1 + stripe_dir_count;
+	for (int i = 1; i < writer->stripe_count; i++) {
+		xdir_create(wal_stripe_dir(writer, i), stripe_dirnames[i - 1],
+			    XLOG, instance_uuid, &opts);
+		xlog_clear(wal_stripe_wal(writer, i));
+	}
+	if (writer->stripe_count > 1) {
+		/*
+		 * The files of a striped WAL are not opened with
+		 * O_SYNC: a batch is synced after it is written to
+		 * all stripes, see wal_write_stripes().
+		 */
+		for (int i = 0; i < writer->stripe_count; i++) {
+			struct xdir *dir = wal_stripe_dir(writer, i);
+			dir->stripe_count = writer->stripe_count;
+			dir->stripe = i;
+		}
+	} else if (wal_mode == WAL_FSYNC) {
 		writer->wal_dir.open_wflags |= O_SYNC;
+	}
+	struct wal_stripe_sync *sync = &writer->stripe_sync;
+	tt_pthread_mutex_init(&sync->mutex, NULL);
+	tt_pthread_cond_init(&sync->start_cond, NULL);
+	tt_pthread_cond_init(&sync->done_cond, NULL);
+	sync->round = 0;
+	sync->pending = 0;
+	sync->is_shutdown = false;
+	sync->syncer_count = 0;
+
+	assert(prealloc_count == 0 || stripe_dir_count == 0);
+	struct wal_prealloc *prealloc = &writer->prealloc;
+	prealloc->count = wal_mode != WAL_NONE ? prealloc_count : 0;
+	prealloc->ready_count = 0;
+	prealloc->pending = 0;
+	prealloc->next_id = 0;
+	prealloc->is_started = false;
 
 	stailq_create(&writer->rollback);
 	cmsg_init(&writer->in_rollback, NULL);
@@ -380,6 +522,11 @@ wal_writer_create(struct wal_writer *writer, enum wal_mode wal_mode,
 	writer->checkpoint_threshold = INT64_MAX;
 	writer->checkpoint_triggered = false;
 
+	writer->group_commit_window = 0;
+	writer->group_commit_size = 0;
+	writer->batch_size_hist = NULL;
+	writer->fsync_latency_hist = NULL;
+
 	vclock_create(&writer->vclock);
 	vclock_create(&writer->checkpoint_vclock);
 	rlist_create(&writer->watchers);
@@ -395,13 +542,127 @@ wal_writer_create(struct wal_writer *writer, enum wal_mode wal_mode,
 static void
 wal_writer_destroy(struct wal_writer *writer)
 {
-	xdir_destroy(&writer->wal_dir);
+	for (int i = 0; i < writer->stripe_count; i++)
+		xdir_destroy(wal_stripe_dir(writer, i));
+	struct wal_stripe_sync *sync = &writer->stripe_sync;
+	tt_pthread_cond_destroy(&sync->done_cond);
+	tt_pthread_cond_destroy(&sync->start_cond);
+	tt_pthread_mutex_destroy(&sync->mutex);
+	if (writer->batch_size_hist != NULL)
+		histogram_delete(writer->batch_size_hist);
+	if (writer->fsync_latency_hist != NULL)
+		histogram_delete(writer->fsync_latency_hist);
+}
+
+static void *
+wal_stripe_syncer_f(void *arg)
+{
+	struct wal_stripe_syncer *syncer = (struct wal_stripe_syncer *) arg;
+	struct wal_stripe_sync *sync = &wal_writer_singleton.stripe_sync;
+	tt_pthread_mutex_lock(&sync->mutex);
+	while (true) {
+		while (!sync->is_shutdown && syncer->round == sync->round)
+			tt_pthread_cond_wait(&sync->start_cond, &sync->mutex);
+		if (sync->is_shutdown)
+			break;
+		syncer->round = sync->round;
+		int fd = syncer->fd;
+		tt_pthread_mutex_unlock(&sync->mutex);
+		int error = fdatasync(fd) == 0 ? 0 : errno;
+		tt_pthread_mutex_lock(&sync->mutex);
+		syncer->error = error;
+		if (--sync->pending == 0)
+			tt_pthread_cond_signal(&sync->done_cond);
+	}
+	tt_pthread_mutex_unlock(&sync->mutex);
+	return NULL;
+}
+
+/** Start a syncer thread per stripe but one. */
+static int
+wal_stripe_sync_start(struct wal_writer *writer)
+{
+	struct wal_stripe_sync *sync = &writer->stripe_sync;
+	for (int i = 0; i < writer->stripe_count - 1; i++) {
+		struct wal_stripe_syncer *syncer = &sync->syncers[i];
+		syncer->round = sync->round;
+		syncer->fd = -1;
+		syncer->error = 0;
+		if (cord_start(&syncer->cord, "wal_sync",
+			       wal_stripe_syncer_f, syncer) != 0)
+			return -1;
+		sync->syncer_count++;
+	}
+	return 0;
+}
+
+static void
+wal_stripe_sync_stop(struct wal_writer *writer)
+{
+	struct wal_stripe_sync *sync = &writer->stripe_sync;
+	tt_pthread_mutex_lock(&sync->mutex);
+	sync->is_shutdown = true;
+	tt_pthread_cond_broadcast(&sync->start_cond);
+	tt_pthread_mutex_unlock(&sync->mutex);
+	for (int i = 0; i < sync->syncer_count; i++) {
+		if (cord_join(&sync->syncers[i].cord) != 0)
+			panic_syserror("WAL writer: thread join failed");
+	}
+	sync->syncer_count = 0;
+}
+
+/**
+ * Sync the current files of all stripes but @a skip, in
+ * parallel, and wait for the syncs to finish.
+ */
+static int
+wal_sync_stripes(struct wal_writer *writer, int skip)
+{
+	struct wal_stripe_sync *sync = &writer->stripe_sync;
+	assert(sync->syncer_count == writer->stripe_count - 1);
+	tt_pthread_mutex_lock(&sync->mutex);
+	for (int i = 0, j = 0; i < writer->stripe_count; i++) {
+		if (i != skip)
+			sync->syncers[j++].fd = wal_stripe_wal(writer, i)->fd;
+	}
+	sync->pending = sync->syncer_count;
+	sync->round++;
+	tt_pthread_cond_broadcast(&sync->start_cond);
+	while (sync->pending > 0)
+		tt_pthread_cond_wait(&sync->done_cond, &sync->mutex);
+	tt_pthread_mutex_unlock(&sync->mutex);
+	for (int i = 0, j = 0; i < writer->stripe_count; i++) {
+		if (i == skip)
+			continue;
+		int error = sync->syncers[j++].error;
+		if (error != 0) {
+			errno = error;
+			diag_set(SystemError, "%s: fdatasync() failed",
+				 wal_stripe_wal(writer, i)->filename);
+			return -1;
+		}
+	}
+	return 0;
 }
 
 /** WAL writer thread routine. */
 static int
 wal_writer_f(va_list ap);
 
+static int
+wal_prealloc_start_f(struct cbus_call_msg *msg);
+
+/** Close the current files of all stripes of the WAL. */
+static void
+wal_close_stripes(struct wal_writer *writer)
+{
+	for (int i = 0; i < writer->stripe_count; i++) {
+		struct xlog *l = wal_stripe_wal(writer, i);
+		if (xlog_is_open(l))
+			xlog_close(l, false);
+	}
+}
+
 static int
 wal_open_f(struct cbus_call_msg *msg)
 {
@@ -471,18 +732,102 @@ wal_open(struct wal_writer *writer)
 	return 0;
 }
 
+/**
+ * Remove the last WAL file if it was created from a
+ * preallocated file: such a file is written in place, so
+ * it can't be appended to. The file has no rows, since it
+ * is named after the recovered vclock, and is created anew
+ * on the first write.
+ */
+static int
+wal_remove_preallocated(struct wal_writer *writer)
+{
+	char path[PATH_MAX];
+	snprintf(path, sizeof(path), "%s",
+		 xdir_format_filename(&writer->wal_dir,
+				      vclock_sum(&writer->vclock), NONE));
+	struct xlog_cursor cursor;
+	if (xlog_cursor_open(&cursor, path) != 0) {
+		/* No file or a broken one, see wal_open(). */
+		diag_clear(diag_get());
+		return 0;
+	}
+	bool is_preallocated = cursor.meta.is_preallocated;
+	xlog_cursor_close(&cursor, false);
+	if (!is_preallocated)
+		return 0;
+	if (unlink(path) != 0) {
+		diag_set(SystemError, "failed to unlink %s", path);
+		return -1;
+	}
+	say_info("removed %s", path);
+	return 0;
+}
+
+/**
+ * Remove the files of a striped WAL which begin at the
+ * current vclock. Recovery has read all rows of the WAL,
+ * so the files have no rows but the rows of a batch which
+ * wasn't written to all stripes. Appending to such files
+ * would put the new rows after them and break the order
+ * of the stripes, so they are created anew on the first
+ * write.
+ */
+static int
+wal_remove_stripes(struct wal_writer *writer)
+{
+	for (int i = 0; i < writer->stripe_count; i++) {
+		const char *path = xdir_format_filename(
+				wal_stripe_dir(writer, i),
+				vclock_sum(&writer->vclock), NONE);
+		if (unlink(path) == 0) {
+			say_info("removed %s", path);
+		} else if (errno != ENOENT) {
+			diag_set(SystemError, "failed to unlink %s", path);
+			return -1;
+		}
+	}
+	return 0;
+}
+
 int
 wal_init(enum wal_mode wal_mode, void (*wall_async_cb)(struct journal_entry *entry),
-	 const char *wal_dirname, int64_t wal_max_size, const struct tt_uuid *instance_uuid,
+	 const char *wal_dirname, const char **stripe_dirnames,
+	 int stripe_dir_count, int prealloc_count, int64_t wal_max_size,
+	 const struct tt_uuid *instance_uuid,
 	 wal_on_garbage_collection_f on_garbage_collection,
 	 wal_on_checkpoint_threshold_f on_checkpoint_threshold)
 {
 	/* Initialize the state. */
 	struct wal_writer *writer = &wal_writer_singleton;
 	wal_writer_create(writer, wal_mode, wall_async_cb, wal_dirname,
+			  stripe_dirnames, stripe_dir_count, prealloc_count,
 			  wal_max_size, instance_uuid, on_garbage_collection,
 			  on_checkpoint_threshold);
 
+	static const int64_t batch_size_buckets[] = {
+		256, 512, 1024, 2048, 4096, 8192, 16384, 32768, 65536,
+		131072, 262144, 524288, 1048576, 2097152, 4194304,
+		8388608, 16777216,
+	};
+	static const int64_t fsync_latency_buckets[] = {
+		10, 20, 50, 100, 200, 500, 1000, 2000, 5000, 10000,
+		20000, 50000, 100000, 200000, 500000, 1000000,
+	};
+	writer->batch_size_hist = histogram_new(batch_size_buckets,
+						lengthof(batch_size_buckets));
+	writer->fsync_latency_hist = histogram_new(fsync_latency_buckets,
+					lengthof(fsync_latency_buckets));
+	if (writer->batch_size_hist == NULL ||
+	    writer->fsync_latency_hist == NULL) {
+		diag_set(OutOfMemory, sizeof(struct histogram), "malloc",
+			 "struct histogram");
+		return -1;
+	}
+
+	if (writer->stripe_count > 1 && wal_stripe_sync_start(writer) != 0)
+		return -1;
+
 	/* Start WAL thread. */
 	if (cord_costart(&writer->cord, "wal", wal_writer_f, NULL) != 0)
 		return -1;
@@ -501,18 +846,43 @@ wal_enable(void)
 	/* Initialize the writer vclock from the recovery state. */
 	vclock_copy(&writer->vclock, &replicaset.vclock);
 
+	/*
+	 * A striped WAL is not reopened: all stripes rotate
+	 * together, so drop the stripes of the last segment
+	 * instead, they are written anew from the same vclock.
+	 */
+	if (writer->stripe_count > 1 && wal_remove_stripes(writer) != 0)
+		return -1;
+	if (writer->stripe_count == 1 && wal_remove_preallocated(writer) != 0)
+		return -1;
 	/*
 	 * Scan the WAL directory to build an index of all
 	 * existing WAL files. Required for garbage collection,
 	 * see wal_collect_garbage().
 	 */
-	if (xdir_scan(&writer->wal_dir))
-		return -1;
+	for (int i = 0; i < writer->stripe_count; i++) {
+		if (xdir_scan(wal_stripe_dir(writer, i)))
+			return -1;
+	}
 
 	/* Open the most recent WAL file. */
-	if (wal_open(writer) != 0)
+	if (writer->stripe_count == 1 && wal_open(writer) != 0)
 		return -1;
 
+	/*
+	 * Prepare the preallocated files in the WAL thread,
+	 * which owns the pool. The WAL directory may be shared
+	 * with the master in the hot standby mode, so it is
+	 * not touched until recovery is over.
+	 */
+	if (writer->prealloc.count > 0) {
+		struct cbus_call_msg msg;
+		if (cbus_call(&writer->wal_pipe, &writer->tx_prio_pipe, &msg,
+			      wal_prealloc_start_f, NULL,
+			      TIMEOUT_INFINITY) != 0)
+			return -1;
+	}
+
 	/* Enable journalling. */
 	journal_set(&writer->base);
 	return 0;
@@ -530,6 +900,7 @@ wal_free(void)
 		panic_syserror("WAL writer: thread join failed");
 	}
 
+	wal_stripe_sync_stop(writer);
 	wal_writer_destroy(writer);
 }
 
@@ -602,7 +973,7 @@ wal_begin_checkpoint_f(struct cbus_call_msg *data)
 	    vclock_sum(&writer->current_wal.meta.vclock) !=
 	    vclock_sum(&writer->vclock)) {
 
-		xlog_close(&writer->current_wal, false);
+		wal_close_stripes(writer);
 		/*
 		 * The next WAL will be created on the first write.
 		 */
@@ -709,6 +1080,320 @@ wal_set_checkpoint_threshold(int64_t threshold)
 	fiber_set_cancellable(cancellable);
 }
 
+struct wal_set_busy_poll_msg {
+	struct cbus_call_msg base;
+	double max_time;
+};
+
+static int
+wal_set_busy_poll_f(struct cbus_call_msg *data)
+{
+	struct wal_set_busy_poll_msg *msg;
+	msg = (struct wal_set_busy_poll_msg *)data;
+	busy_poll_set_max_time(&cord()->busy_poll, msg->max_time);
+	return 0;
+}
+
+void
+wal_set_busy_poll(double max_time)
+{
+	struct wal_writer *writer = &wal_writer_singleton;
+	if (writer->wal_mode == WAL_NONE)
+		return;
+	struct wal_set_busy_poll_msg msg;
+	msg.max_time = max_time;
+	bool cancellable = fiber_set_cancellable(false);
+	cbus_call(&writer->wal_pipe, &writer->tx_prio_pipe,
+		  &msg.base, wal_set_busy_poll_f, NULL, TIMEOUT_INFINITY);
+	fiber_set_cancellable(cancellable);
+}
+
+const struct busy_poll *
+wal_busy_poll(void)
+{
+	return &wal_writer_singleton.cord.busy_poll;
+}
+
+struct wal_set_group_commit_msg {
+	struct cbus_call_msg base;
+	double window;
+	int64_t size;
+};
+
+static int
+wal_set_group_commit_f(struct cbus_call_msg *data)
+{
+	struct wal_writer *writer = &wal_writer_singleton;
+	struct wal_set_group_commit_msg *msg;
+	msg = (struct wal_set_group_commit_msg *)data;
+	writer->group_commit_window = msg->window;
+	writer->group_commit_size = msg->size;
+	return 0;
+}
+
+void
+wal_set_group_commit(double window, int64_t size)
+{
+	struct wal_writer *writer = &wal_writer_singleton;
+	if (writer->wal_mode == WAL_NONE)
+		return;
+	struct wal_set_group_commit_msg msg;
+	msg.window = window;
+	msg.size = size;
+	bool cancellable = fiber_set_cancellable(false);
+	cbus_call(&writer->wal_pipe, &writer->tx_prio_pipe,
+		  &msg.base, wal_set_group_commit_f, NULL, TIMEOUT_INFINITY);
+	fiber_set_cancellable(cancellable);
+}
+
+static void
+wal_histogram_info(struct info_handler *h, const char *name,
+		   struct histogram *hist)
+{
+	char buf[1024];
+	info_table_begin(h, name);
+	info_append_int(h, "count", hist->total);
+	info_append_int(h, "p50", histogram_percentile(hist, 50));
+	info_append_int(h, "p99", histogram_percentile(hist, 99));
+	info_append_int(h, "p999", histogram_percentile(hist, 99.9));
+	histogram_snprint(buf, sizeof(buf), hist);
+	info_append_str(h, "histogram", buf);
+	info_table_end(h);
+}
+
+void
+wal_stat(struct info_handler *h)
+{
+	/*
+	 * The histograms are updated by the WAL thread. The
+	 * dirty read is fine for statistics.
+	 */
+	struct wal_writer *writer = &wal_writer_singleton;
+	info_begin(h);
+	wal_histogram_info(h, "batch_size", writer->batch_size_hist);
+	wal_histogram_info(h, "fsync_latency", writer->fsync_latency_hist);
+	info_end(h);
+}
+
+static int
+wal_reset_stat_f(struct cbus_call_msg *msg)
+{
+	(void)msg;
+	struct wal_writer *writer = &wal_writer_singleton;
+	histogram_reset(writer->batch_size_hist);
+	histogram_reset(writer->fsync_latency_hist);
+	return 0;
+}
+
+void
+wal_reset_stat(void)
+{
+	struct wal_writer *writer = &wal_writer_singleton;
+	/* Nothing is collected without writes. */
+	if (writer->wal_mode == WAL_NONE)
+		return;
+	/* The histograms are updated by the WAL thread. */
+	struct cbus_call_msg msg;
+	bool cancellable = fiber_set_cancellable(false);
+	cbus_call(&writer->wal_pipe, &writer->tx_prio_pipe, &msg,
+		  wal_reset_stat_f, NULL, TIMEOUT_INFINITY);
+	fiber_set_cancellable(cancellable);
+}
+
+/** Path of the preallocated file @a id. */
+static const char *
+wal_prealloc_path(struct wal_writer *writer, int64_t id, bool inprogress)
+{
+	return tt_snprintf(PATH_MAX, "%s/%020lld" WAL_PREALLOC_SUFFIX "%s",
+			   writer->wal_dir.dirname, (long long)id,
+			   inprogress ? ".inprogress" : "");
+}
+
+/** Preparation of a preallocated file in a coio thread. */
+struct wal_prealloc_job {
+	struct coio_job base;
+	int64_t id;
+	/** Size of the file. */
+	int64_t size;
+	/** A removed WAL file to reuse, empty if none. */
+	char src[PATH_MAX];
+	/** The file being prepared. */
+	char inprogress_path[PATH_MAX];
+	/** The file renamed to when it is ready. */
+	char path[PATH_MAX];
+	int result;
+	int errorno;
+};
+
+static void
+wal_prealloc_job_run(struct coio_job *base)
+{
+	struct wal_prealloc_job *job = (struct wal_prealloc_job *) base;
+	static const char zeros[WAL_PREALLOC_CHUNK];
+	int fd = -1;
+	job->result = -1;
+	if (job->src[0] != '\0' && rename(job->src, job->inprogress_path) != 0)
+		goto out;
+	fd = open(job->inprogress_path, O_WRONLY | O_CREAT, 0644);
+	if (fd < 0)
+		goto out;
+	/*
+	 * Every block of the file must be written: a reader
+	 * stops at zeros, and the writer avoids block allocation
+	 * on sync. The blocks of a reused file are overwritten
+	 * in place.
+	 */
+	if (ftruncate(fd, job->size) != 0)
+		goto out;
+	for (int64_t offset = 0; offset < job->size;
+	     offset += WAL_PREALLOC_CHUNK) {
+		size_t len = MIN(job->size - offset, WAL_PREALLOC_CHUNK);
+		if (fio_pwriten(fd, zeros, len, offset) != 0)
+			goto out;
+	}
+	if (fdatasync(fd) != 0 ||
+	    rename(job->inprogress_path, job->path) != 0)
+		goto out;
+	job->result = 0;
+out:
+	job->errorno = errno;
+	if (fd >= 0)
+		close(fd);
+}
+
+static void
+wal_prealloc_job_complete(struct coio_job *base)
+{
+	struct wal_prealloc_job *job = (struct wal_prealloc_job *) base;
+	struct wal_prealloc *prealloc = &wal_writer_singleton.prealloc;
+	assert(prealloc->pending > 0);
+	prealloc->pending--;
+	if (job->result == 0) {
+		assert(prealloc->ready_count < prealloc->count);
+		prealloc->ready[prealloc->ready_count++] = job->id;
+	} else {
+		errno = job->errorno;
+		say_syserror("failed to preallocate %s", job->path);
+		if (job->src[0] != '\0')
+			unlink(job->src);
+		unlink(job->inprogress_path);
+	}
+	free(job);
+}
+
+/** True if the pool lacks files, ready or being prepared. */
+static inline bool
+wal_prealloc_is_short(struct wal_writer *writer)
+{
+	struct wal_prealloc *prealloc = &writer->prealloc;
+	return prealloc->is_started &&
+	       prealloc->ready_count + prealloc->pending < prealloc->count;
+}
+
+/**
+ * Start preparing a preallocated file in the background,
+ * from the removed WAL file @a src if it is not NULL.
+ */
+static void
+wal_prealloc_submit(struct wal_writer *writer, const char *src)
+{
+	struct wal_prealloc *prealloc = &writer->prealloc;
+	struct wal_prealloc_job *job = malloc(sizeof(*job));
+	if (job == NULL) {
+		say_error("failed to allocate a WAL preallocation job");
+		if (src != NULL)
+			unlink(src);
+		return;
+	}
+	job->id = prealloc->next_id++;
+	job->size = writer->wal_max_size;
+	snprintf(job->src, sizeof(job->src), "%s", src != NULL ? src : "");
+	snprintf(job->inprogress_path, sizeof(job->inprogress_path), "%s",
+		 wal_prealloc_path(writer, job->id, true));
+	snprintf(job->path, sizeof(job->path), "%s",
+		 wal_prealloc_path(writer, job->id, false));
+	coio_job_create(&job->base, COIO_PRIO_LOW, wal_prealloc_job_run,
+			wal_prealloc_job_complete);
+	coio_pool_submit(&job->base);
+	prealloc->pending++;
+}
+
+/** Start preparing files until the pool has enough of them. */
+static void
+wal_prealloc_refill(struct wal_writer *writer)
+{
+	while (wal_prealloc_is_short(writer))
+		wal_prealloc_submit(writer, NULL);
+}
+
+/**
+ * Find the preallocated files left by the previous run,
+ * remove the ones which were not ready or are not needed
+ * any more, and fill the pool up.
+ */
+static int
+wal_prealloc_start_f(struct cbus_call_msg *msg)
+{
+	(void)msg;
+	struct wal_writer *writer = &wal_writer_singleton;
+	struct wal_prealloc *prealloc = &writer->prealloc;
+	const char *dirname = writer->wal_dir.dirname;
+	DIR *dh = opendir(dirname);
+	if (dh == NULL) {
+		diag_set(SystemError, "error reading directory '%s'", dirname);
+		return -1;
+	}
+	struct dirent *dent;
+	while ((dent = readdir(dh)) != NULL) {
+		char *ext;
+		long long id = strtoll(dent->d_name, &ext, 10);
+		if (ext == dent->d_name ||
+		    strncmp(ext, WAL_PREALLOC_SUFFIX,
+			    strlen(WAL_PREALLOC_SUFFIX)) != 0)
+			continue;
+		prealloc->next_id = MAX(prealloc->next_id, id + 1);
+		if (strcmp(ext, WAL_PREALLOC_SUFFIX) == 0 &&
+		    prealloc->ready_count < prealloc->count) {
+			prealloc->ready[prealloc->ready_count++] = id;
+			continue;
+		}
+		char path[PATH_MAX];
+		snprintf(path, sizeof(path), "%s/%s", dirname, dent->d_name);
+		if (unlink(path) < 0)
+			say_syserror("error while removing %s", path);
+		else
+			say_info("removed %s", path);
+	}
+	closedir(dh);
+	prealloc->is_started = true;
+	wal_prealloc_refill(writer);
+	return 0;
+}
+
+/**
+ * Create a new file of the stripe @a i at the current vclock,
+ * from a preallocated file if there is a ready one.
+ */
+static int
+wal_create_xlog(struct wal_writer *writer, int i, struct xlog *l)
+{
+	struct xdir *dir = wal_stripe_dir(writer, i);
+	struct wal_prealloc *prealloc = &writer->prealloc;
+	if (prealloc->ready_count > 0) {
+		int64_t id = prealloc->ready[--prealloc->ready_count];
+		char path[PATH_MAX];
+		snprintf(path, sizeof(path), "%s",
+			 wal_prealloc_path(writer, id, false));
+		int rc = xdir_recycle_xlog(dir, l, path, &writer->vclock);
+		wal_prealloc_refill(writer);
+		if (rc == 0)
+			return 0;
+		/* A broken spare file must not stop writes. */
+		diag_log();
+	}
+	return xdir_create_xlog(dir, l, &writer->vclock);
+}
+
 struct wal_gc_msg
 {
 	struct cbus_call_msg base;
@@ -736,8 +1421,27 @@ wal_collect_garbage_f(struct cbus_call_msg *data)
 		 */
 		vclock = vclockset_psearch(&writer->wal_dir.index, vclock);
 	}
-	if (vclock != NULL)
-		xdir_collect_garbage(&writer->wal_dir, vclock_sum(vclock),
+	if (vclock == NULL)
+		return 0;
+	int64_t signature = vclock_sum(vclock);
+	/*
+	 * Reuse the files to be removed for the pool of
+	 * preallocated files: their blocks are allocated.
+	 */
+	struct vclock *first;
+	while (wal_prealloc_is_short(writer) &&
+	       (first = vclockset_first(&writer->wal_dir.index)) != NULL &&
+	       vclock_sum(first) < signature) {
+		const char *path = xdir_format_filename(&writer->wal_dir,
+							vclock_sum(first),
+							NONE);
+		say_info("reusing %s", path);
+		wal_prealloc_submit(writer, path);
+		vclockset_remove(&writer->wal_dir.index, first);
+		free(first);
+	}
+	for (int i = 0; i < writer->stripe_count; i++)
+		xdir_collect_garbage(wal_stripe_dir(writer, i), signature,
 				     XDIR_GC_ASYNC);
 
 	return 0;
@@ -781,29 +1485,49 @@ wal_opt_rotate(struct wal_writer *writer)
 	 * EOF in the old WAL before switching to the new
 	 * one.
 	 */
-	if (xlog_is_open(&writer->current_wal) &&
-	    writer->current_wal.offset >= writer->wal_max_size) {
+	if (xlog_is_open(&writer->current_wal)) {
+		bool is_full = false;
+		for (int i = 0; i < writer->stripe_count; i++) {
+			if (wal_stripe_wal(writer, i)->offset >=
+			    writer->wal_max_size)
+				is_full = true;
+		}
 		/*
 		 * We can not handle xlog_close()
 		 * failure in any reasonable way.
 		 * A warning is written to the error log.
 		 */
-		xlog_close(&writer->current_wal, false);
+		if (is_full)
+			wal_close_stripes(writer);
 	}
 
 	if (xlog_is_open(&writer->current_wal))
 		return 0;
 
-	if (xdir_create_xlog(&writer->wal_dir, &writer->current_wal,
-			     &writer->vclock) != 0) {
+	/*
+	 * All stripes are rotated together, so that a WAL file
+	 * has the same name and meta in every stripe directory.
+	 */
+	for (int i = 0; i < writer->stripe_count; i++) {
+		struct xlog *l = wal_stripe_wal(writer, i);
+		if (wal_create_xlog(writer, i, l) == 0)
+			continue;
 		diag_log();
+		while (--i >= 0) {
+			l = wal_stripe_wal(writer, i);
+			if (unlink(l->filename) != 0)
+				say_syserror("failed to unlink %s",
+					     l->filename);
+			xlog_close(l, false);
+		}
 		return -1;
 	}
 	/*
 	 * Keep track of the new WAL vclock. Required for garbage
 	 * collection, see wal_collect_garbage().
 	 */
-	xdir_add_vclock(&writer->wal_dir, &writer->vclock);
+	for (int i = 0; i < writer->stripe_count; i++)
+		xdir_add_vclock(wal_stripe_dir(writer, i), &writer->vclock);
 
 	wal_notify_watchers(writer, WAL_EVENT_ROTATE);
 	return 0;
@@ -820,7 +1544,6 @@ static int
 wal_fallocate(struct wal_writer *writer, size_t len)
 {
 	bool warn_no_space = true, notify_gc = false;
-	struct xlog *l = &writer->current_wal;
 	struct errinj *errinj = errinj(ERRINJ_WAL_FALLOCATE, ERRINJ_INT);
 	int rc = 0;
 
@@ -839,9 +1562,18 @@ wal_fallocate(struct wal_writer *writer, size_t len)
 
 retry:
 	if (errinj == NULL || errinj->iparam == 0) {
-		if (l->allocated >= len)
-			goto out;
-		if (xlog_fallocate(l, MAX(len, WAL_FALLOCATE_LEN)) == 0)
+		/*
+		 * Rows are spread evenly over the stripes, but
+		 * a batch may go to one of them as a whole.
+		 */
+		int i;
+		for (i = 0; i < writer->stripe_count; i++) {
+			struct xlog *l = wal_stripe_wal(writer, i);
+			if (l->allocated < len &&
+			    xlog_fallocate(l, MAX(len, WAL_FALLOCATE_LEN)) != 0)
+				break;
+		}
+		if (i == writer->stripe_count)
 			goto out;
 	} else {
 		errinj->iparam--;
@@ -858,7 +1590,10 @@ retry:
 		warn_no_space = false;
 	}
 
-	xdir_collect_garbage(&writer->wal_dir, gc_lsn, XDIR_GC_REMOVE_ONE);
+	for (int i = 0; i < writer->stripe_count; i++) {
+		xdir_collect_garbage(wal_stripe_dir(writer, i), gc_lsn,
+				     XDIR_GC_REMOVE_ONE);
+	}
 	notify_gc = true;
 	goto retry;
 error:
@@ -983,6 +1718,87 @@ wal_assign_lsn(struct vclock *vclock_diff, struct vclock *base,
 	}
 }
 
+/**
+ * Write a batch to a striped WAL. The batch is written as a
+ * whole or not at all: if a write to a stripe fails, the
+ * stripes which have been written are truncated back.
+ *
+ * The stripe of the first row of the batch is written last,
+ * after the other stripes are synced. A reader can't get to
+ * the other rows of the batch before it reads the first one,
+ * see xlog_stripe(), so neither a relay nor recovery after a
+ * crash reads a part of the batch. Hence a striped WAL is
+ * only allowed in the fsync mode.
+ *
+ * @retval >= 0 the number of bytes written.
+ * @retval -1 error, nothing is written.
+ */
+static ssize_t
+wal_write_stripes(struct wal_writer *writer, struct wal_msg *wal_msg,
+		  struct vclock *vclock_diff)
+{
+	assert(writer->wal_mode == WAL_FSYNC);
+	int count = writer->stripe_count;
+	ssize_t written = 0;
+	off_t offset[XLOG_STRIPES_MAX];
+	int64_t rows[XLOG_STRIPES_MAX];
+	for (int i = 0; i < count; i++) {
+		struct xlog *l = wal_stripe_wal(writer, i);
+		offset[i] = l->offset;
+		rows[i] = l->rows;
+		xlog_tx_begin(l);
+	}
+	/* The vclock of the WAL before the next row. */
+	struct vclock vclock;
+	vclock_copy(&vclock, &writer->vclock);
+	int first = xlog_stripe(vclock_sum(&vclock), count);
+	struct journal_entry *entry;
+	stailq_foreach_entry(entry, &wal_msg->commit, fifo) {
+		wal_assign_lsn(vclock_diff, &writer->vclock,
+			       entry->rows, entry->rows + entry->n_rows);
+		entry->res = vclock_sum(vclock_diff) +
+			     vclock_sum(&writer->vclock);
+		struct xrow_header **row = entry->rows;
+		for (; row < entry->rows + entry->n_rows; row++) {
+			struct xrow_header *r = *row;
+			r->tm = ev_now(loop());
+			int i = xlog_stripe(vclock_sum(&vclock), count);
+			if (xlog_write_row(wal_stripe_wal(writer, i), r) < 0)
+				goto rollback;
+			/* Recovery follows the rows the same way. */
+			if (r->lsn > vclock_get(&vclock, r->replica_id))
+				vclock_follow_xrow(&vclock, r);
+		}
+	}
+	for (int k = 1; k <= count; k++) {
+		int i = (first + k) % count;
+		struct xlog *l = wal_stripe_wal(writer, i);
+		if (i == first && wal_sync_stripes(writer, first) != 0)
+			goto rollback;
+		ssize_t rc = xlog_tx_commit(l);
+		if (rc < 0)
+			goto rollback;
+		written += rc;
+		rc = xlog_flush(l);
+		if (rc < 0)
+			goto rollback;
+		written += rc;
+	}
+	if (fdatasync(wal_stripe_wal(writer, first)->fd) != 0) {
+		diag_set(SystemError, "%s: fdatasync() failed",
+			 wal_stripe_wal(writer, first)->filename);
+		goto rollback;
+	}
+	return written;
+rollback:
+	for (int i = 0; i < count; i++) {
+		struct xlog *l = wal_stripe_wal(writer, i);
+		xlog_tx_rollback(l);
+		xlog_truncate(l, offset[i], rows[i]);
+	}
+	return -1;
+}
+
 static void
 wal_write_to_disk(struct cmsg *msg)
 {
@@ -1000,6 +1816,12 @@ wal_write_to_disk(struct cmsg *msg)
 
 	ERROR_INJECT_SLEEP(ERRINJ_WAL_DELAY);
 
+	if (stailq_empty(&wal_msg->commit)) {
+		/* The entries were merged into the previous batch. */
+		vclock_copy(&wal_msg->vclock, &writer->vclock);
+		return;
+	}
+
 	if (writer->in_rollback.route != NULL) {
 		/* We're rolling back a failed write. */
 		stailq_concat(&wal_msg->rollback, &wal_msg->commit);
@@ -1050,6 +1872,14 @@ wal_write_to_disk(struct cmsg *msg)
 	int rc;
 	struct journal_entry *entry;
 	struct stailq_entry *last_committed = NULL;
+	int64_t checkpoint_wal_size = writer->checkpoint_wal_size;
+	double start = clock_monotonic();
+	if (writer->stripe_count > 1) {
+		rc = wal_write_stripes(writer, wal_msg, &vclock_diff);
+		if (rc < 0)
+			goto done;
+		goto written;
+	}
 	stailq_foreach_entry(entry, &wal_msg->commit, fifo) {
 		wal_assign_lsn(&vclock_diff, &writer->vclock,
 			       entry->rows, entry->rows + entry->n_rows);
@@ -1068,11 +1898,18 @@ wal_write_to_disk(struct cmsg *msg)
 	rc = xlog_flush(l);
 	if (rc < 0)
 		goto done;
-
+written:
 	writer->checkpoint_wal_size += rc;
 	last_committed = stailq_last(&wal_msg->commit);
 	vclock_merge(&writer->vclock, &vclock_diff);
 
+	histogram_collect(writer->batch_size_hist,
+			  writer->checkpoint_wal_size - checkpoint_wal_size);
+	if (writer->wal_mode == WAL_FSYNC) {
+		histogram_collect(writer->fsync_latency_hist,
+				  (clock_monotonic() - start) * 1e6);
+	}
+
 	/*
 	 * Notify TX if the checkpoint threshold has been exceeded.
 	 * Use malloc() for allocating the notification message and
@@ -1131,6 +1968,75 @@ done:
 	ERROR_INJECT_SLEEP(ERRINJ_RELAY_FASTER_THAN_TX);
 }
 
+/**
+ * Group commit of the fsync mode: if the write requests
+ * fetched to @a output make a batch smaller than
+ * group_commit_size, wait up to group_commit_window for more
+ * of them, and merge them all into the first one, to write
+ * and sync them at once. The emptied requests go back to tx
+ * as they are. Any other message ends the wait, so as not to
+ * delay it, and the requests after it are not merged, so as
+ * to keep the order of the messages.
+ */
+static void
+wal_group_commit(struct wal_writer *writer, struct cbus_endpoint *endpoint,
+		 struct stailq *output)
+{
+	if (writer->wal_mode != WAL_FSYNC || writer->group_commit_window <= 0)
+		return;
+	double deadline = clock_monotonic() + writer->group_commit_window;
+	struct wal_msg *batch = NULL;
+	struct stailq_entry *last = NULL;
+	while (true) {
+		struct stailq_entry *next = last != NULL ? stailq_next(last) :
+					    stailq_first(output);
+		for (; next != NULL; next = stailq_next(next)) {
+			struct wal_msg *msg = wal_msg(container_of(next,
+							struct cmsg, fifo));
+			if (msg == NULL)
+				return;
+			last = next;
+			if (batch == NULL) {
+				batch = msg;
+				continue;
+			}
+			stailq_concat(&batch->commit, &msg->commit);
+			batch->approx_len += msg->approx_len;
+			msg->approx_len = 0;
+		}
+		if (batch == NULL ||
+		    (int64_t)batch->approx_len >= writer->group_commit_size)
+			return;
+		/* New messages wake the fiber up before the timeout. */
+		double timeout = deadline - clock_monotonic();
+		if (timeout <= 0 || fiber_yield_timeout(timeout) ||
+		    fiber_is_cancelled())
+			return;
+		cbus_endpoint_fetch(endpoint, output);
+	}
+}
+
+/**
+ * Process the messages sent to the WAL thread, like
+ * cbus_loop(), gathering the write requests in groups.
+ */
+static void
+wal_writer_loop(struct wal_writer *writer, struct cbus_endpoint *endpoint)
+{
+	while (true) {
+		struct stailq output;
+		stailq_create(&output);
+		cbus_endpoint_fetch(endpoint, &output);
+		wal_group_commit(writer, endpoint, &output);
+		struct cmsg *msg, *msg_next;
+		stailq_foreach_entry_safe(msg, msg_next, &output, fifo)
+			cmsg_deliver(msg);
+		if (fiber_is_cancelled())
+			break;
+		fiber_yield();
+	}
+}
+
 /** WAL writer main loop.  */
 static int
 wal_writer_f(va_list ap)
@@ -1138,7 +2044,7 @@ wal_writer_f(va_list ap)
 	(void) ap;
 	struct wal_writer *writer = &wal_writer_singleton;
 
-	/** Initialize eio in this thread */
+	/** Let this thread submit coio jobs. */
 	coio_enable();
 
 	struct cbus_endpoint endpoint;
@@ -1150,7 +2056,7 @@ wal_writer_f(va_list ap)
 	 */
 	cpipe_create(&writer->tx_prio_pipe, "tx_prio");
 
-	cbus_loop(&endpoint);
+	wal_writer_loop(writer, &endpoint);
 
 	/*
 	 * Create a new empty WAL on shutdown so that we don't
@@ -1161,16 +2067,17 @@ wal_writer_f(va_list ap)
 	    (!xlog_is_open(&writer->current_wal) ||
 	     vclock_compare(&writer->vclock,
 			    &writer->current_wal.meta.vclock) > 0)) {
-		struct xlog l;
-		if (xdir_create_xlog(&writer->wal_dir, &l,
-				     &writer->vclock) == 0)
-			xlog_close(&l, false);
-		else
-			diag_log();
+		for (int i = 0; i < writer->stripe_count; i++) {
+			struct xlog l;
+			if (xdir_create_xlog(wal_stripe_dir(writer, i), &l,
+					     &writer->vclock) == 0)
+				xlog_close(&l, false);
+			else
+				diag_log();
+		}
 	}
 
-	if (xlog_is_open(&writer->current_wal))
-		xlog_close(&writer->current_wal, false);
+	wal_close_stripes(writer);
 
 	if (xlog_is_open(&vy_log_writer.xlog))
 		xlog_close(&vy_log_writer.xlog, false);
@@ -1245,6 +2152,7 @@ wal_write(struct journal *journal, struct journal_entry *entry)
 	 * We can reuse async WAL engine transparently
 	 * to the caller.
 	 */
+	double start = clock_monotonic();
 	if (wal_write_async(journal, entry) != 0)
 		return -1;
 
@@ -1252,6 +2160,9 @@ wal_write(struct journal *journal, struct journal_entry *entry)
 	fiber_yield();
 	fiber_set_cancellable(cancellable);
 
+	/* Account the wait in the iproto latency stats. */
+	fiber()->storage.net.wal_time += clock_monotonic() - start;
+
 	return 0;
 }
 
@@ -1476,8 +2387,12 @@ wal_notify_watchers(struct wal_writer *writer, unsigned events)
 void
 wal_atfork()
 {
-	if (xlog_is_open(&wal_writer_singleton.current_wal))
-		xlog_atfork(&wal_writer_singleton.current_wal);
+	struct wal_writer *writer = &wal_writer_singleton;
+	for (int i = 0; i < writer->stripe_count; i++) {
+		struct xlog *l = wal_stripe_wal(writer, i);
+		if (xlog_is_open(l))
+			xlog_atfork(l);
+	}
 	if (xlog_is_open(&vy_log_writer.xlog))
 		xlog_atfork(&vy_log_writer.xlog);
 }
@@ -40,6 +40,7 @@
 struct fiber;
 struct wal_writer;
 struct tt_uuid;
+struct info_handler;
 
 enum wal_mode { WAL_NONE = 0, WAL_WRITE, WAL_FSYNC, WAL_MODE_MAX };
 
@@ -50,6 +51,8 @@ enum {
 	 * loop for the whole recovery stage.
 	 */
 	WAL_ROWS_PER_YIELD = 32000,
+	/** Max number of preallocated WAL files. */
+	WAL_PREALLOC_COUNT_MAX = 64,
 };
 
 /** String constants for the supported modes. */
@@ -79,10 +82,19 @@ typedef void (*wal_on_checkpoint_threshold_f)(void);
 
 /**
  * Start WAL thread and initialize WAL writer.
+ *
+ * If @a stripe_dir_count is not 0, the WAL is striped over
+ * @a wal_dirname and @a stripe_dirnames, see xlog_stripe().
+ * A striped WAL requires @a wal_mode to be WAL_FSYNC.
+ * If @a prealloc_count is not 0, new WAL files are created
+ * from a pool of that many preallocated files, which is
+ * refilled in the background.
  */
 int
 wal_init(enum wal_mode wal_mode, void (*wall_async_cb)(struct journal_entry *entry),
-	 const char *wal_dirname, int64_t wal_max_size, const struct tt_uuid *instance_uuid,
+	 const char *wal_dirname, const char **stripe_dirnames,
+	 int stripe_dir_count, int prealloc_count, int64_t wal_max_size,
+	 const struct tt_uuid *instance_uuid,
 	 wal_on_garbage_collection_f on_garbage_collection,
 	 wal_on_checkpoint_threshold_f on_checkpoint_threshold);
 
@@ -230,6 +242,38 @@ wal_commit_checkpoint(struct wal_checkpoint *checkpoint);
 void
 wal_set_checkpoint_threshold(int64_t threshold);
 
+/**
+ * Set the max time the event loop of the WAL thread spins
+ * before blocking, 0 disables busy polling.
+ */
+void
+wal_set_busy_poll(double max_time);
+
+/** Busy polling state of the WAL thread. */
+const struct busy_poll *
+wal_busy_poll(void);
+
+/**
+ * Set the group commit policy of the fsync mode: the WAL
+ * thread waits up to @a window seconds for more entries
+ * until a batch of @a size bytes is gathered, and writes
+ * and syncs them at once. 0 @a window disables the wait.
+ */
+void
+wal_set_group_commit(double window, int64_t size);
+
+/**
+ * Dump histograms of the sizes of the written batches, in
+ * bytes, and of the time to write a batch in the fsync
+ * mode, in microseconds.
+ */
+void
+wal_stat(struct info_handler *h);
+
+/** Reset the WAL statistics. */
+void
+wal_reset_stat(void);
+
 /**
  * Remove WAL files that are not needed by consumers reading
  * rows at @vclock or newer.
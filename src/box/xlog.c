@@ -32,15 +32,17 @@
 #include <dirent.h>
 #include <fcntl.h>
 #include <ctype.h>
+#include <unistd.h>
+#include <utime.h>
 
 #include "fiber.h"
 #include "exception.h"
 #include "crc32.h"
 #include "fio.h"
-#include "third_party/tarantool_eio.h"
 #include <msgpuck.h>
 
 #include "coio_file.h"
+#include "coio_pool.h"
 #include "tt_static.h"
 #include "error.h"
 #include "xrow.h"
@@ -113,6 +115,8 @@ enum {
 #define VCLOCK_KEY "VClock"
 #define VERSION_KEY "Version"
 #define PREV_VCLOCK_KEY "PrevVClock"
+#define STRIPE_KEY "Stripe"
+#define PREALLOCATED_KEY "Preallocated"
 
 static const char v13[] = "0.13";
 static const char v12[] = "0.12";
@@ -133,6 +137,9 @@ xlog_meta_create(struct xlog_meta *meta, const char *filetype,
 		vclock_copy(&meta->prev_vclock, prev_vclock);
 	else
 		vclock_clear(&meta->prev_vclock);
+	meta->stripe_count = 0;
+	meta->stripe = 0;
+	meta->is_preallocated = false;
 }
 
 /**
@@ -166,6 +173,14 @@ xlog_meta_format(const struct xlog_meta *meta, char *buf, int size)
 		SNPRINT(total, snprintf, buf, size, PREV_VCLOCK_KEY ": %s\n",
 			vclock_to_string(&meta->prev_vclock));
 	}
+	if (meta->stripe_count > 0) {
+		SNPRINT(total, snprintf, buf, size, STRIPE_KEY ": %u/%u\n",
+			(unsigned)meta->stripe, (unsigned)meta->stripe_count);
+	}
+	if (meta->is_preallocated) {
+		SNPRINT(total, snprintf, buf, size,
+			PREALLOCATED_KEY ": true\n");
+	}
 	SNPRINT(total, snprintf, buf, size, "\n");
 	assert(total > 0);
 	return total;
@@ -194,6 +209,31 @@ parse_vclock(const char *val, const char *val_end, struct vclock *vclock)
 	return 0;
 }
 
+/**
+ * Parse stripe of a WAL from xlog meta.
+ */
+static int
+parse_stripe(const char *val, const char *val_end, uint32_t *stripe,
+	     uint32_t *stripe_count)
+{
+	char str[32];
+	if (val_end - val >= (ptrdiff_t) sizeof(str))
+		goto error;
+	memcpy(str, val, val_end - val);
+	str[val_end - val] = '\0';
+	unsigned index, count;
+	int n;
+	if (sscanf(str, "%u/%u%n", &index, &count, &n) != 2 ||
+	    str[n] != '\0' || count > XLOG_STRIPES_MAX || index >= count)
+		goto error;
+	*stripe = index;
+	*stripe_count = count;
+	return 0;
+error:
+	diag_set(XlogError, "can't parse stripe");
+	return -1;
+}
+
 static inline bool
 xlog_meta_key_equal(const char *key, const char *key_end, const char *str)
 {
@@ -307,6 +347,24 @@ xlog_meta_parse(struct xlog_meta *meta, const char **data,
 			 */
 			if (parse_vclock(val, val_end, &meta->prev_vclock) != 0)
 				return -1;
+		} else if (xlog_meta_key_equal(key, key_end, STRIPE_KEY)) {
+			/*
+			 * Stripe: <index>/<count>
+			 */
+			if (parse_stripe(val, val_end, &meta->stripe,
+					 &meta->stripe_count) != 0)
+				return -1;
+		} else if (xlog_meta_key_equal(key, key_end,
+					       PREALLOCATED_KEY)) {
+			/*
+			 * Preallocated: true
+			 */
+			if (val_end - val != 4 || memcmp(val, "true", 4) != 0) {
+				diag_set(XlogError, "can't parse preallocated "
+					 "flag");
+				return -1;
+			}
+			meta->is_preallocated = true;
 		} else if (xlog_meta_key_equal(key, key_end, VERSION_KEY)) {
 			/* Ignore Version: for now */
 		} else {
@@ -429,6 +487,8 @@ xdir_index_file(struct xdir *dir, int64_t signature)
 	}
 
 	vclock_copy(vclock, &meta->vclock);
+	dir->max_stripe_count = MAX(dir->max_stripe_count,
+				    meta->stripe_count);
 	xlog_cursor_close(&cursor, false);
 	vclockset_insert(&dir->index, vclock);
 	return 0;
@@ -667,11 +727,44 @@ xdir_say_gc(int result, int errorno, const char *filename)
 	}
 }
 
-static int
-xdir_complete_gc(eio_req *req)
+/** Removal of a file in a coio thread. */
+struct xdir_gc_job {
+	struct coio_job base;
+	int result;
+	int errorno;
+	char filename[0];
+};
+
+static void
+xdir_gc_job_run(struct coio_job *base)
 {
-	xdir_say_gc(req->result, req->errorno, EIO_PATH(req));
-	return 0;
+	struct xdir_gc_job *job = (struct xdir_gc_job *) base;
+	job->result = unlink(job->filename);
+	job->errorno = errno;
+}
+
+static void
+xdir_gc_job_complete(struct coio_job *base)
+{
+	struct xdir_gc_job *job = (struct xdir_gc_job *) base;
+	xdir_say_gc(job->result, job->errorno, job->filename);
+	free(job);
+}
+
+/** Remove a file in background, synchronously on OOM. */
+static void
+xdir_unlink_async(const char *filename)
+{
+	size_t size = sizeof(struct xdir_gc_job) + strlen(filename) + 1;
+	struct xdir_gc_job *job = (struct xdir_gc_job *) malloc(size);
+	if (job == NULL) {
+		xdir_say_gc(unlink(filename), errno, filename);
+		return;
+	}
+	strcpy(job->filename, filename);
+	coio_job_create(&job->base, COIO_PRIO_LOW, xdir_gc_job_run,
+			xdir_gc_job_complete);
+	coio_pool_submit(&job->base);
 }
 
 void
@@ -683,7 +776,7 @@ xdir_collect_garbage(struct xdir *dir, int64_t signature, unsigned flags)
 		const char *filename =
 			xdir_format_filename(dir, vclock_sum(vclock), NONE);
 		if (flags & XDIR_GC_ASYNC)
-			eio_unlink(filename, 0, xdir_complete_gc, NULL);
+			xdir_unlink_async(filename);
 		else
 			xdir_say_gc(unlink(filename), errno, filename);
 		vclockset_remove(&dir->index, vclock);
@@ -796,6 +889,7 @@ xlog_destroy(struct xlog *xlog)
 	obuf_destroy(&xlog->obuf);
 	obuf_destroy(&xlog->zbuf);
 	ZSTD_freeCCtx(xlog->zctx);
+	free(xlog->dbuf);
 	TRASH(xlog);
 	xlog->fd = -1;
 }
@@ -959,16 +1053,12 @@ xdir_touch_xlog(struct xdir *dir, const struct vclock *vclock)
 	return 0;
 }
 
-/**
- * In case of error, writes a message to the error log
- * and sets errno.
- */
-int
-xdir_create_xlog(struct xdir *dir, struct xlog *xlog,
-		 const struct vclock *vclock)
+/** Create the meta of a new file of the directory. */
+static void
+xdir_create_xlog_meta(struct xdir *dir, const struct vclock *vclock,
+		      struct xlog_meta *meta)
 {
-	int64_t signature = vclock_sum(vclock);
-	assert(signature >= 0);
+	assert(vclock_sum(vclock) >= 0);
 	assert(!tt_uuid_is_nil(dir->instance_uuid));
 
 	/*
@@ -979,9 +1069,23 @@ xdir_create_xlog(struct xdir *dir, struct xlog *xlog,
 	if (dir->type == XLOG && !vclockset_empty(&dir->index))
 		prev_vclock = vclockset_last(&dir->index);
 
-	struct xlog_meta meta;
-	xlog_meta_create(&meta, dir->filetype, dir->instance_uuid,
+	xlog_meta_create(meta, dir->filetype, dir->instance_uuid,
 			 vclock, prev_vclock);
+	meta->stripe_count = dir->stripe_count;
+	meta->stripe = dir->stripe;
+}
+
+/**
+ * In case of error, writes a message to the error log
+ * and sets errno.
+ */
+int
+xdir_create_xlog(struct xdir *dir, struct xlog *xlog,
+		 const struct vclock *vclock)
+{
+	int64_t signature = vclock_sum(vclock);
+	struct xlog_meta meta;
+	xdir_create_xlog_meta(dir, vclock, &meta);
 
 	const char *filename = xdir_format_filename(dir, signature, NONE);
 	if (xlog_create(xlog, filename, dir->open_wflags, &meta,
@@ -999,6 +1103,92 @@ xdir_create_xlog(struct xdir *dir, struct xlog *xlog,
 	return 0;
 }
 
+static ssize_t
+xlog_writev(struct xlog *log, struct iovec *iov, int iovcnt);
+
+int
+xdir_recycle_xlog(struct xdir *dir, struct xlog *xlog, const char *path,
+		  const struct vclock *vclock)
+{
+	char meta_buf[XLOG_META_LEN_MAX];
+	struct iovec iov;
+	struct stat st;
+	int flags;
+	int meta_len;
+	int64_t signature = vclock_sum(vclock);
+	const char *name = xdir_format_filename(dir, signature, NONE);
+
+	if (access(name, F_OK) == 0) {
+		errno = EEXIST;
+		diag_set(SystemError, "file '%s' already exists", name);
+		goto err;
+	}
+	if (xlog_init(xlog, &dir->opts) != 0)
+		goto err;
+
+	xdir_create_xlog_meta(dir, vclock, &xlog->meta);
+	xlog->meta.is_preallocated = true;
+	xlog->is_inprogress = true;
+	snprintf(xlog->filename, PATH_MAX, "%s%s", name, inprogress_suffix);
+	if (rename(path, xlog->filename) != 0) {
+		diag_set(SystemError, "failed to rename '%s' file", path);
+		goto err_rename;
+	}
+	flags = O_RDWR | dir->open_wflags;
+#ifdef O_DIRECT
+	xlog->fd = open(xlog->filename, flags | O_DIRECT);
+	if (xlog->fd >= 0)
+		xlog->is_direct = true;
+	else if (errno == EINVAL)
+		xlog->fd = open(xlog->filename, flags);
+#else
+	xlog->fd = open(xlog->filename, flags);
+#endif
+	if (xlog->fd < 0) {
+		say_syserror("open, [%s]", xlog->filename);
+		diag_set(SystemError, "failed to open file '%s'",
+			 xlog->filename);
+		goto err_open;
+	}
+	if (fstat(xlog->fd, &st) != 0) {
+		diag_set(SystemError, "failed to stat file '%s'",
+			 xlog->filename);
+		goto err_write;
+	}
+
+	meta_len = xlog_meta_format(&xlog->meta, meta_buf, sizeof(meta_buf));
+	if (meta_len < 0)
+		goto err_write;
+	assert(meta_len < (int)sizeof(meta_buf));
+	iov.iov_base = meta_buf;
+	iov.iov_len = meta_len;
+	if (xlog_writev(xlog, &iov, 1) < 0)
+		goto err_write;
+
+	xlog->offset = meta_len;
+	if (st.st_size > meta_len)
+		xlog->allocated = st.st_size - meta_len;
+
+	if (dir->suffix != INPROGRESS && xlog_rename(xlog) != 0) {
+		int save_errno = errno;
+		xlog_close(xlog, false);
+		errno = save_errno;
+		return -1;
+	}
+	return 0;
+err_write:
+	close(xlog->fd);
+err_open:
+	unlink(xlog->filename);
+	xlog_destroy(xlog);
+	return -1;
+err_rename:
+	xlog_destroy(xlog);
+err:
+	unlink(path);
+	return -1;
+}
+
 ssize_t
 xlog_fallocate(struct xlog *log, size_t len)
 {
@@ -1034,6 +1224,102 @@ xlog_fallocate(struct xlog *log, size_t len)
 #endif /* HAVE_FALLOCATE */
 }
 
+/**
+ * Grow the aligned buffer of an O_DIRECT log to hold at least
+ * @a size bytes, keeping the data of the last partially
+ * written block.
+ */
+static int
+xlog_reserve_direct(struct xlog *log, size_t size)
+{
+	if (size <= log->dbuf_size)
+		return 0;
+	size_t new_size = MAX(log->dbuf_size * 2, size);
+	void *dbuf;
+	if (posix_memalign(&dbuf, XLOG_DIRECT_ALIGN, new_size) != 0) {
+		diag_set(OutOfMemory, new_size, "posix_memalign",
+			 "xlog direct buffer");
+		return -1;
+	}
+	if (log->dbuf != NULL) {
+		memcpy(dbuf, log->dbuf, log->offset % XLOG_DIRECT_ALIGN);
+		free(log->dbuf);
+	}
+	log->dbuf = (char *)dbuf;
+	log->dbuf_size = new_size;
+	return 0;
+}
+
+/**
+ * Write @a iov at the current offset of an O_DIRECT log: the
+ * data is appended to the last partially written block in the
+ * aligned buffer and padded with zeros to a whole block, so
+ * that the blocks can be written in place.
+ *
+ * @retval -1 error
+ * @retval >= 0 the number of bytes written
+ */
+static ssize_t
+xlog_write_direct(struct xlog *log, const struct iovec *iov, int iovcnt)
+{
+	size_t tail = log->offset % XLOG_DIRECT_ALIGN;
+	size_t len = tail;
+	for (int i = 0; i < iovcnt; i++)
+		len += iov[i].iov_len;
+	size_t size = (len + XLOG_DIRECT_ALIGN - 1) &
+		      ~((size_t)XLOG_DIRECT_ALIGN - 1);
+	if (xlog_reserve_direct(log, size) != 0)
+		return -1;
+	char *pos = log->dbuf + tail;
+	for (int i = 0; i < iovcnt; i++) {
+		memcpy(pos, iov[i].iov_base, iov[i].iov_len);
+		pos += iov[i].iov_len;
+	}
+	memset(pos, 0, size - len);
+	if (fio_pwriten(log->fd, log->dbuf, size, log->offset - tail) != 0) {
+		diag_set(SystemError, "failed to write to '%s' file",
+			 log->filename);
+		return -1;
+	}
+	/* Keep the last partially written block for the next write. */
+	size_t new_tail = len % XLOG_DIRECT_ALIGN;
+	memmove(log->dbuf, log->dbuf + len - new_tail, new_tail);
+	return len - tail;
+}
+
+/**
+ * Overwrite the blocks of a failed O_DIRECT write with zeros,
+ * keeping the data written before the current offset.
+ */
+static void
+xlog_erase_direct(struct xlog *log)
+{
+	size_t tail = log->offset % XLOG_DIRECT_ALIGN;
+	memset(log->dbuf + tail, 0, log->dbuf_size - tail);
+	if (fio_pwriten(log->fd, log->dbuf, log->dbuf_size,
+			log->offset - tail) != 0)
+		panic_syserror("failed to erase xlog after write error");
+}
+
+/**
+ * Write @a iov at the current offset of the log.
+ *
+ * @retval -1 error
+ * @retval >= 0 the number of bytes written
+ */
+static ssize_t
+xlog_writev(struct xlog *log, struct iovec *iov, int iovcnt)
+{
+	if (log->is_direct)
+		return xlog_write_direct(log, iov, iovcnt);
+	ssize_t written = fio_writevn(log->fd, iov, iovcnt);
+	if (written < 0) {
+		diag_set(SystemError, "failed to write to '%s' file",
+			 log->filename);
+	}
+	return written;
+}
+
 /**
  * Write a sequence of uncompressed xrow objects.
  *
@@ -1084,12 +1370,8 @@ xlog_tx_write_plain(struct xlog *log)
 		return -1;
 	});
 
-	ssize_t written = fio_writevn(log->fd, log->obuf.iov, log->obuf.pos + 1);
-	if (written < 0) {
-		diag_set(SystemError, "failed to write to '%s' file",
-			 log->filename);
+	if (xlog_writev(log, log->obuf.iov, log->obuf.pos + 1) < 0)
 		return -1;
-	}
 	return obuf_size(&log->obuf);
 }
 
@@ -1174,13 +1456,9 @@ xlog_tx_write_zstd(struct xlog *log)
 	});
 
 	ssize_t written;
-	written = fio_writevn(log->fd, log->zbuf.iov,
-			      log->zbuf.pos + 1);
-	if (written < 0) {
-		diag_set(SystemError, "failed to write to '%s' file",
-			 log->filename);
+	written = xlog_writev(log, log->zbuf.iov, log->zbuf.pos + 1);
+	if (written < 0)
 		goto error;
-	}
 	obuf_reset(&log->zbuf);
 	return written;
 error:
@@ -1218,9 +1496,15 @@ xlog_tx_write(struct xlog *log)
 	/*
 	 * Simplify recovery after a temporary write failure:
 	 * truncate the file to the best known good write
-	 * position.
+	 * position. A preallocated file written in place is
+	 * not truncated, but zeroed after the position instead.
 	 */
 	if (written < 0) {
+		if (log->is_direct) {
+			if (log->dbuf != NULL)
+				xlog_erase_direct(log);
+			return -1;
+		}
 		if (lseek(log->fd, log->offset, SEEK_SET) < 0 ||
 		    ftruncate(log->fd, log->offset) != 0)
 			panic_syserror("failed to truncate xlog after write error");
@@ -1390,30 +1674,73 @@ xlog_flush(struct xlog *log)
 	return xlog_tx_write(log);
 }
 
-static int
-sync_cb(eio_req *req)
+void
+xlog_truncate(struct xlog *log, off_t offset, int64_t rows)
 {
-	int fd = (intptr_t) req->data;
-	if (req->result) {
-		errno = req->errorno;
+	assert(log->is_autocommit && obuf_size(&log->obuf) == 0);
+	assert(offset <= log->offset);
+	if (offset == log->offset)
+		return;
+	if (lseek(log->fd, offset, SEEK_SET) < 0 ||
+	    ftruncate(log->fd, offset) != 0)
+		panic_syserror("failed to truncate xlog after write error");
+	log->offset = offset;
+	log->allocated = 0;
+	log->rows = rows;
+	if (log->synced_size > (uint64_t)offset)
+		log->synced_size = offset;
+}
+
+/** fsync() of a dup of an xlog descriptor in a coio thread. */
+struct xlog_sync_job {
+	struct coio_job base;
+	int fd;
+	int result;
+	int errorno;
+};
+
+static void
+xlog_sync_job_run(struct coio_job *base)
+{
+	struct xlog_sync_job *job = (struct xlog_sync_job *) base;
+	job->result = fsync(job->fd);
+	job->errorno = errno;
+}
+
+static void
+xlog_sync_job_complete(struct coio_job *base)
+{
+	struct xlog_sync_job *job = (struct xlog_sync_job *) base;
+	if (job->result) {
+		errno = job->errorno;
 		say_syserror("%s: fsync() failed",
-			     fio_filename(fd));
+			     fio_filename(job->fd));
 		errno = 0;
 	}
-	close(fd);
-	return 0;
+	close(job->fd);
+	free(job);
 }
 
 int
 xlog_sync(struct xlog *l)
 {
 	if (l->opts.sync_is_async) {
-		int fd = dup(l->fd);
-		if (fd == -1) {
+		struct xlog_sync_job *job =
+			(struct xlog_sync_job *) malloc(sizeof(*job));
+		if (job == NULL) {
+			say_error("%s: failed to allocate an fsync job",
+				  l->filename);
+			return -1;
+		}
+		job->fd = dup(l->fd);
+		if (job->fd == -1) {
 			say_syserror("%s: dup() failed", l->filename);
+			free(job);
 			return -1;
 		}
-		eio_fsync(fd, 0, sync_cb, (void *) (intptr_t) fd);
+		coio_job_create(&job->base, COIO_PRIO_LOW, xlog_sync_job_run,
+				xlog_sync_job_complete);
+		coio_pool_submit(&job->base);
 	} else if (fsync(l->fd) < 0) {
 		say_syserror("%s: fsync failed", l->filename);
 		return -1;
@@ -1430,11 +1757,31 @@ xlog_write_eof(struct xlog *l)
 	});
 
 	/*
-	 * Free disk space preallocated with xlog_fallocate().
+	 * The eof marker is not a whole block, so switch an
+	 * O_DIRECT log back to buffered writes. The file
+	 * pointer was not moved by the direct writes.
+	 */
+#ifdef O_DIRECT
+	if (l->is_direct) {
+		int flags = fcntl(l->fd, F_GETFL);
+		if (flags < 0 ||
+		    fcntl(l->fd, F_SETFL, flags & ~O_DIRECT) < 0 ||
+		    lseek(l->fd, l->offset, SEEK_SET) < 0) {
+			diag_set(SystemError, "failed to reset O_DIRECT");
+			return -1;
+		}
+		l->is_direct = false;
+	}
+#endif
+
+	/*
+	 * Free disk space preallocated with xlog_fallocate()
+	 * or with the zeros of a preallocated file.
 	 * Don't write the eof marker if this fails, otherwise
 	 * we'll get "data after eof marker" error on recovery.
 	 */
-	if (l->allocated > 0 && ftruncate(l->fd, l->offset) < 0) {
+	if ((l->allocated > 0 || l->meta.is_preallocated) &&
+	    ftruncate(l->fd, l->offset) < 0) {
 		diag_set(SystemError, "ftruncate() failed");
 		return -1;
 	}
@@ -1540,6 +1887,18 @@ xlog_cursor_ensure(struct xlog_cursor *cursor, size_t count)
 	return ibuf_used(&cursor->rbuf) >= count ? 0: 1;
 }
 
+/**
+ * Drop the read buffer and continue reading the file from
+ * @a pos.
+ */
+static void
+xlog_cursor_rewind(struct xlog_cursor *cursor, off_t pos)
+{
+	assert(cursor->fd >= 0);
+	ibuf_reset(&cursor->rbuf);
+	cursor->read_offset = pos;
+}
+
 /**
  * Decompress zstd-compressed buf into cursor row block
  *
@@ -1843,6 +2202,63 @@ xlog_cursor_find_tx_magic(struct xlog_cursor *i)
 	return 0;
 }
 
+/**
+ * A eof marker is read, check that there is no more data
+ * in the file.
+ */
+static int
+xlog_cursor_check_eof(struct xlog_cursor *i)
+{
+	int rc = xlog_cursor_ensure(i, sizeof(log_magic_t) + sizeof(char));
+	if (rc < 0)
+		return -1;
+	if (rc == 0) {
+		diag_set(XlogError, "%s: has some data after "
+			  "eof marker at %lld", i->name,
+			  xlog_cursor_pos(i));
+		return -1;
+	}
+	i->state = XLOG_CURSOR_EOF;
+	return 1;
+}
+
+/**
+ * Check if a broken transaction at @a tx_pos of a preallocated
+ * file is the one being written or torn by a crash, i.e. it is
+ * the last data of the file. The writer moves block by block,
+ * so the rest of the block after such a transaction must be
+ * zeros. Otherwise the transaction is damaged in the middle of
+ * the file.
+ */
+static bool
+xlog_cursor_tx_is_torn(struct xlog_cursor *i, off_t tx_pos)
+{
+	char buf[XLOG_DIRECT_ALIGN];
+	off_t tx_end = tx_pos + XLOG_FIXHEADER_SIZE;
+	ssize_t rc = fio_pread(i->fd, buf, XLOG_FIXHEADER_SIZE, tx_pos);
+	if (rc == XLOG_FIXHEADER_SIZE) {
+		/* Keep the error of the transaction in the diag. */
+		struct diag diag;
+		diag_create(&diag);
+		diag_move(diag_get(), &diag);
+		struct xlog_fixheader fixheader;
+		const char *pos = buf;
+		if (xlog_fixheader_decode(&fixheader, &pos, buf + rc) == 0)
+			tx_end += fixheader.len;
+		diag_move(&diag, diag_get());
+	}
+	off_t block_end = (tx_end / XLOG_DIRECT_ALIGN + 1) *
+			  XLOG_DIRECT_ALIGN;
+	rc = fio_pread(i->fd, buf, block_end - tx_end, tx_end);
+	if (rc < 0)
+		return false;
+	for (ssize_t k = 0; k < rc; k++) {
+		if (buf[k] != 0)
+			return false;
+	}
+	return true;
+}
+
 int
 xlog_cursor_next_tx(struct xlog_cursor *i)
 {
@@ -1857,7 +2273,16 @@ xlog_cursor_next_tx(struct xlog_cursor *i)
 		return 1;
 	if (load_u32(i->rbuf.rpos) == eof_marker) {
 		/* eof marker found */
-		goto eof_found;
+		return xlog_cursor_check_eof(i);
+	}
+	off_t tx_pos = xlog_cursor_pos(i);
+	if (i->meta.is_preallocated && load_u32(i->rbuf.rpos) == 0) {
+		/*
+		 * Zeros of a preallocated file: the end of the
+		 * data written so far, re-read it next time.
+		 */
+		xlog_cursor_rewind(i, tx_pos);
+		return 1;
 	}
 
 	ssize_t to_load;
@@ -1871,28 +2296,67 @@ xlog_cursor_next_tx(struct xlog_cursor *i)
 		if (rc > 0)
 			return 1;
 	}
-	if (to_load < 0)
-		return -1;
+	if (to_load < 0) {
+		struct error *e = diag_last_error(diag_get());
+		if (!i->meta.is_preallocated || i->fd < 0 ||
+		    !type_assignable(&type_XlogError, e->type) ||
+		    !xlog_cursor_tx_is_torn(i, tx_pos))
+			return -1;
+		/*
+		 * A preallocated file is written in place, so
+		 * a transaction which is being written or was
+		 * torn by a crash is followed by zeros rather
+		 * than by the end of file. Treat it as the end
+		 * of the data written so far.
+		 */
+		diag_clear(diag_get());
+		xlog_cursor_rewind(i, tx_pos);
+		return 1;
+	}
 
 	i->state = XLOG_CURSOR_TX;
 	return 0;
-eof_found:
-	/*
-	 * A eof marker is read, check that there is no
-	 * more data in the file.
-	 */
-	rc = xlog_cursor_ensure(i, sizeof(log_magic_t) + sizeof(char));
+}
+
+int
+xlog_cursor_next_tx_raw(struct xlog_cursor *i, const char **data,
+			size_t *size)
+{
+	assert(xlog_cursor_is_open(i));
+	assert(i->state != XLOG_CURSOR_TX);
 
+	/* load at least magic to check eof */
+	int rc = xlog_cursor_ensure(i, sizeof(log_magic_t));
 	if (rc < 0)
 		return -1;
-	if (rc == 0) {
-		diag_set(XlogError, "%s: has some data after "
-			  "eof marker at %lld", i->name,
-			  xlog_cursor_pos(i));
-		return -1;
+	if (rc > 0)
+		return 1;
+	if (load_u32(i->rbuf.rpos) == eof_marker)
+		return xlog_cursor_check_eof(i);
+
+	while (true) {
+		struct xlog_fixheader fixheader;
+		const char *pos = i->rbuf.rpos;
+		ssize_t to_load = xlog_fixheader_decode(&fixheader, &pos,
+							 i->rbuf.wpos);
+		if (to_load < 0)
+			return -1;
+		if (to_load == 0 &&
+		    i->rbuf.wpos - pos >= (ptrdiff_t)fixheader.len) {
+			*data = i->rbuf.rpos;
+			*size = pos + fixheader.len - i->rbuf.rpos;
+			i->rbuf.rpos += *size;
+			return 0;
+		}
+		if (to_load == 0)
+			to_load = fixheader.len - (i->rbuf.wpos - pos);
+		/* not enough data in read buffer */
+		rc = xlog_cursor_ensure(i, ibuf_used(&i->rbuf) + to_load);
+		if (rc < 0)
+			return -1;
+		if (rc > 0)
+			return 1;
 	}
-	i->state = XLOG_CURSOR_EOF;
-	return 1;
 }
 
 int
@@ -165,6 +165,18 @@ struct xdir {
 	char dirname[PATH_MAX+1];
 	/** Snapshots or xlogs */
 	enum xdir_type type;
+	/**
+	 * Stripe of a WAL the files created in the directory
+	 * belong to, written to their meta. Zero count if the
+	 * WAL is not striped.
+	 */
+	uint32_t stripe_count;
+	uint32_t stripe;
+	/**
+	 * The greatest number of stripes of the files indexed
+	 * by xdir_scan(), 0 if none of them is striped.
+	 */
+	uint32_t max_stripe_count;
 };
 
 /**
@@ -311,8 +323,44 @@ struct xlog_meta {
 	 * directory for missing WALs.
 	 */
 	struct vclock prev_vclock;
+	/**
+	 * Text file header: number of files a WAL is striped
+	 * over, 0 if it is not striped, and the index of this
+	 * file among them, see xlog_stripe().
+	 */
+	uint32_t stripe_count;
+	uint32_t stripe;
+	/**
+	 * Text file header: set if the file was preallocated
+	 * and filled with zeros before the data was written to
+	 * it. The end of the data is the first zero magic, and
+	 * a torn transaction before it is an unfinished write,
+	 * not a corruption, see xdir_recycle_xlog().
+	 */
+	bool is_preallocated;
+};
+
+enum {
+	/** Maximal number of stripes of a WAL. */
+	XLOG_STRIPES_MAX = 8,
 };
 
+/**
+ * A WAL can be striped over several directories: every
+ * directory has a file per WAL file, created with the same
+ * name at the same time, and each row of the WAL goes to
+ * one of them. The stripe of a row is chosen by the vclock
+ * signature the WAL has before the row, so a reader which
+ * follows the rows it reads in a vclock knows which file to
+ * read the next row from, and merges the stripes in the
+ * order the rows were written.
+ */
+static inline uint32_t
+xlog_stripe(int64_t signature, uint32_t stripe_count)
+{
+	return signature % stripe_count;
+}
+
 /**
  * Initialize xlog meta struct.
  *
@@ -393,6 +441,20 @@ struct xlog {
 	uint64_t synced_size;
 	/** Time when xlog wast synced last time */
 	double sync_time;
+	/**
+	 * Set if the file is written with O_DIRECT. Every write
+	 * goes through the aligned buffer @dbuf, which starts
+	 * with the data of the last partially written block,
+	 * and is padded with zeros to a whole block.
+	 */
+	bool is_direct;
+	char *dbuf;
+	size_t dbuf_size;
+};
+
+enum {
+	/** Alignment of O_DIRECT writes, in bytes. */
+	XLOG_DIRECT_ALIGN = 4096,
 };
 
 /**
@@ -426,6 +488,20 @@ int
 xdir_create_xlog(struct xdir *dir, struct xlog *xlog,
 		 const struct vclock *vclock);
 
+/**
+ * Create a new file like xdir_create_xlog(), but from the
+ * preallocated file @a path filled with zeros: the file is
+ * renamed and written in place, with O_DIRECT if the file
+ * system supports it. Its size doesn't change on writes, so
+ * syncing them doesn't have to update file metadata.
+ *
+ * @retval 0 if OK
+ * @retval -1 if error, @a path is removed
+ */
+int
+xdir_recycle_xlog(struct xdir *dir, struct xlog *xlog, const char *path,
+		  const struct vclock *vclock);
+
 /**
  * Create new xlog writer based on fd.
  * @param fd            file descriptor
@@ -530,6 +606,16 @@ xlog_tx_rollback(struct xlog *log);
 ssize_t
 xlog_flush(struct xlog *log);
 
+/**
+ * Truncate the log to @a offset, which must be the offset of
+ * a transaction, and set the number of rows in the log to
+ * @a rows. Is used to undo a write spread over several logs,
+ * after a part of it has failed. Panics on failure, like a
+ * failed write does.
+ */
+void
+xlog_truncate(struct xlog *log, off_t offset, int64_t rows);
+
 
 /**
  * Sync a log file. The exact action is defined
@@ -742,6 +828,22 @@ xlog_cursor_close(struct xlog_cursor *cursor, bool reuse_fd);
 int
 xlog_cursor_next_tx(struct xlog_cursor *cursor);
 
+/**
+ * Read next tx from xlog without decoding it, to decode it
+ * elsewhere with xlog_tx_cursor_create(). The tx, including
+ * its fixheader, is left in the read buffer of the cursor,
+ * valid until the cursor is used next time.
+ * @param cursor cursor
+ * @param[out] data the tx
+ * @param[out] size the size of the tx
+ * @retval 0 succes
+ * @retval 1 eof
+ * retval -1 error, check diag
+ */
+int
+xlog_cursor_next_tx_raw(struct xlog_cursor *cursor, const char **data,
+			size_t *size);
+
 /**
  * Fetch next xrow from current xlog tx
  *
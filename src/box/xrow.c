@@ -542,18 +542,45 @@ iproto_prepare_header(struct obuf *buf, struct obuf_svp *svp, size_t size)
 void
 iproto_reply_select(struct obuf *buf, struct obuf_svp *svp, uint64_t sync,
 		    uint32_t schema_version, uint32_t count)
+{
+	iproto_reply_select_spliced(buf, svp, sync, schema_version, count, 0,
+				    false);
+}
+
+void
+iproto_reply_select_spliced(struct obuf *buf, struct obuf_svp *svp,
+			    uint64_t sync, uint32_t schema_version,
+			    uint32_t count, size_t spliced_size,
+			    bool has_position)
 {
 	char *pos = (char *) obuf_svp_to_ptr(buf, svp);
 	iproto_header_encode(pos, IPROTO_OK, sync, schema_version,
-			        obuf_size(buf) - svp->used -
-				IPROTO_HEADER_LEN);
+			     obuf_size(buf) - svp->used - IPROTO_HEADER_LEN +
+			     spliced_size);
 
 	struct iproto_body_bin body = iproto_body_bin;
+	if (has_position)
+		body.m_body = 0x82;
 	body.v_data_len = mp_bswap_u32(count);
 
 	memcpy(pos + IPROTO_HEADER_LEN, &body, sizeof(body));
 }
 
+int
+iproto_reply_select_position(struct obuf *buf, const char *position,
+			     uint32_t size)
+{
+	size_t len = mp_sizeof_uint(IPROTO_POSITION) + mp_sizeof_str(size);
+	char *data = (char *) obuf_alloc(buf, len);
+	if (data == NULL) {
+		diag_set(OutOfMemory, len, "obuf_alloc", "data");
+		return -1;
+	}
+	data = mp_encode_uint(data, IPROTO_POSITION);
+	mp_encode_str(data, position, size);
+	return 0;
+}
+
 int
 xrow_decode_sql(const struct xrow_header *row, struct sql_request *request)
 {
@@ -635,38 +662,27 @@ iproto_reply_chunk(struct obuf *buf, struct obuf_svp *svp, uint64_t sync,
 	memcpy(pos + IPROTO_HEADER_LEN, &body, sizeof(body));
 }
 
-int
-xrow_decode_dml(struct xrow_header *row, struct request *request,
-		uint64_t key_map)
+/**
+ * Decode members of a DML request body map, which must be
+ * already checked with mp_check_map(). Keys which are not
+ * DML body keys are skipped.
+ * @param[in, out] pos The map, advanced past its end.
+ * @param end End of the buffer the map is located in.
+ * @param[out] request Request to fill, must be zeroed.
+ * @param[in, out] key_map Mandatory keys. A bit of each found
+ *        key is cleared.
+ */
+static int
+xrow_decode_dml_body(const char **pos, const char *end,
+		     struct request *request, uint64_t *key_map)
 {
-	memset(request, 0, sizeof(*request));
-	request->header = row;
-	request->type = row->type;
-
-	const char *start = NULL;
-	const char *end = NULL;
-
-	if (row->bodycnt == 0)
-		goto done;
-
-	assert(row->bodycnt == 1);
-	const char *data = start = (const char *) row->body[0].iov_base;
-	end = data + row->body[0].iov_len;
-	assert((end - data) > 0);
-
-	if (mp_typeof(*data) != MP_MAP || mp_check_map(data, end) > 0) {
-error:
-		xrow_on_decode_err(row->body[0].iov_base, end, ER_INVALID_MSGPACK,
-				   "packet body");
-		return -1;
-	}
-
+	const char *data = *pos;
 	uint32_t size = mp_decode_map(&data);
 	for (uint32_t i = 0; i < size; i++) {
 		if (! iproto_dml_body_has_key(data, end)) {
 			if (mp_check(&data, end) != 0 ||
 			    mp_check(&data, end) != 0)
-				goto error;
+				return -1;
 			continue;
 		}
 		uint64_t key = mp_decode_uint(&data);
@@ -674,8 +690,8 @@ error:
 		if (mp_check(&data, end) ||
 		    key >= IPROTO_KEY_MAX ||
 		    iproto_key_type[key] != mp_typeof(*value))
-			goto error;
-		key_map &= ~iproto_key_bit(key);
+			return -1;
+		*key_map &= ~iproto_key_bit(key);
 		switch (key) {
 		case IPROTO_SPACE_ID:
 			request->space_id = mp_decode_uint(&value);
@@ -711,10 +727,53 @@ error:
 			request->tuple_meta = value;
 			request->tuple_meta_end = data;
 			break;
+		case IPROTO_FIELDS:
+			request->fields = value;
+			request->fields_end = data;
+			break;
+		case IPROTO_FETCH_POSITION:
+			request->fetch_position = mp_decode_bool(&value);
+			break;
+		case IPROTO_AFTER_POSITION: {
+			uint32_t len;
+			request->after_position = mp_decode_str(&value, &len);
+			request->after_position_end =
+				request->after_position + len;
+			break;
+		}
 		default:
 			break;
 		}
 	}
+	*pos = data;
+	return 0;
+}
+
+int
+xrow_decode_dml(struct xrow_header *row, struct request *request,
+		uint64_t key_map)
+{
+	memset(request, 0, sizeof(*request));
+	request->header = row;
+	request->type = row->type;
+
+	const char *start = NULL;
+	const char *end = NULL;
+
+	if (row->bodycnt == 0)
+		goto done;
+
+	assert(row->bodycnt == 1);
+	const char *data = start = (const char *) row->body[0].iov_base;
+	end = data + row->body[0].iov_len;
+	assert((end - data) > 0);
+
+	if (mp_typeof(*data) != MP_MAP || mp_check_map(data, end) > 0 ||
+	    xrow_decode_dml_body(&data, end, request, &key_map) != 0) {
+		xrow_on_decode_err(row->body[0].iov_base, end, ER_INVALID_MSGPACK,
+				   "packet body");
+		return -1;
+	}
 	if (data != end) {
 		xrow_on_decode_err(row->body[0].iov_base, end, ER_INVALID_MSGPACK,
 				   "packet end");
@@ -730,6 +789,132 @@ done:
 	return 0;
 }
 
+int
+xrow_decode_batch(const struct xrow_header *row,
+		  struct batch_request *request)
+{
+	if (row->bodycnt == 0) {
+		diag_set(ClientError, ER_INVALID_MSGPACK,
+			 "missing request body");
+		return -1;
+	}
+
+	assert(row->bodycnt == 1);
+	const char *data = (const char *) row->body[0].iov_base;
+	const char *end = data + row->body[0].iov_len;
+	assert((end - data) > 0);
+
+	if (mp_typeof(*data) != MP_MAP || mp_check_map(data, end) > 0) {
+error:
+		xrow_on_decode_err(row->body[0].iov_base, end, ER_INVALID_MSGPACK,
+				   "packet body");
+		return -1;
+	}
+
+	memset(request, 0, sizeof(*request));
+
+	uint32_t map_size = mp_decode_map(&data);
+	for (uint32_t i = 0; i < map_size; ++i) {
+		if ((end - data) < 1 || mp_typeof(*data) != MP_UINT)
+			goto error;
+
+		uint64_t key = mp_decode_uint(&data);
+		const char *value = data;
+		if (mp_check(&data, end) != 0)
+			goto error;
+
+		switch (key) {
+		case IPROTO_STATEMENTS:
+			if (mp_typeof(*value) != MP_ARRAY)
+				goto error;
+			request->stmt_count = mp_decode_array(&value);
+			request->stmts = value;
+			request->stmts_end = data;
+			break;
+		default:
+			continue; /* unknown key */
+		}
+	}
+	if (data != end) {
+		xrow_on_decode_err(row->body[0].iov_base, end, ER_INVALID_MSGPACK,
+				   "packet end");
+		return -1;
+	}
+	if (request->stmts == NULL) {
+		xrow_on_decode_err(row->body[0].iov_base, end,
+				   ER_MISSING_REQUEST_FIELD,
+				   iproto_key_name(IPROTO_STATEMENTS));
+		return -1;
+	}
+	return 0;
+}
+
+int
+xrow_decode_batch_stmt(const char **pos, const char *end,
+		       struct request *request)
+{
+	const char *start = *pos;
+	const char *data = start;
+	if (data >= end || mp_typeof(*data) != MP_MAP ||
+	    mp_check_map(data, end) > 0) {
+error:
+		xrow_on_decode_err(start, end, ER_INVALID_MSGPACK,
+				   "batch statement");
+		return -1;
+	}
+	/*
+	 * The statement type defines the mandatory keys, so
+	 * find it before decoding the rest of the map.
+	 */
+	uint64_t type = IPROTO_OK;
+	uint32_t map_size = mp_decode_map(&data);
+	for (uint32_t i = 0; i < map_size; ++i) {
+		const char *key = data;
+		if (mp_check(&data, end) != 0)
+			goto error;
+		const char *value = data;
+		if (mp_check(&data, end) != 0)
+			goto error;
+		if (mp_typeof(*key) == MP_UINT &&
+		    mp_decode_uint(&key) == IPROTO_REQUEST_TYPE) {
+			if (mp_typeof(*value) != MP_UINT)
+				goto error;
+			type = mp_decode_uint(&value);
+		}
+	}
+	switch (type) {
+	case IPROTO_OK:
+		xrow_on_decode_err(start, end, ER_MISSING_REQUEST_FIELD,
+				   iproto_key_name(IPROTO_REQUEST_TYPE));
+		return -1;
+	case IPROTO_INSERT:
+	case IPROTO_REPLACE:
+	case IPROTO_UPDATE:
+	case IPROTO_DELETE:
+	case IPROTO_UPSERT:
+		break;
+	default:
+		diag_set(ClientError, ER_UNKNOWN_REQUEST_TYPE,
+			 (uint32_t) type);
+		return -1;
+	}
+
+	memset(request, 0, sizeof(*request));
+	request->type = type;
+	uint64_t key_map = dml_request_key_map(type);
+	data = start;
+	if (xrow_decode_dml_body(&data, end, request, &key_map) != 0)
+		goto error;
+	if (key_map) {
+		enum iproto_key key = (enum iproto_key) bit_ctz_u64(key_map);
+		xrow_on_decode_err(start, end, ER_MISSING_REQUEST_FIELD,
+				   iproto_key_name(key));
+		return -1;
+	}
+	*pos = data;
+	return 0;
+}
+
 static int
 request_snprint(char *buf, int size, const struct request *request)
 {
@@ -1004,6 +1189,61 @@ error:
 	return 0;
 }
 
+int
+xrow_decode_compress(const struct xrow_header *row,
+		     struct compress_request *request)
+{
+	if (row->bodycnt == 0) {
+		diag_set(ClientError, ER_INVALID_MSGPACK,
+			 "missing request body");
+		return -1;
+	}
+
+	assert(row->bodycnt == 1);
+	const char *data = (const char *) row->body[0].iov_base;
+	const char *end = data + row->body[0].iov_len;
+	assert((end - data) > 0);
+
+	if (mp_typeof(*data) != MP_MAP || mp_check_map(data, end) > 0) {
+error:
+		xrow_on_decode_err(row->body[0].iov_base, end,
+				   ER_INVALID_MSGPACK, "packet body");
+		return -1;
+	}
+
+	memset(request, 0, sizeof(*request));
+
+	uint32_t map_size = mp_decode_map(&data);
+	for (uint32_t i = 0; i < map_size; ++i) {
+		if ((end - data) < 1 || mp_typeof(*data) != MP_UINT)
+			goto error;
+
+		uint64_t key = mp_decode_uint(&data);
+		const char *value = data;
+		if (mp_check(&data, end) != 0)
+			goto error;
+
+		if (key != IPROTO_COMPRESSION)
+			continue; /* unknown key */
+		if (mp_typeof(*value) != MP_STR)
+			goto error;
+		request->algorithm = mp_decode_str(&value,
+						   &request->algorithm_len);
+	}
+	if (data != end) {
+		xrow_on_decode_err(row->body[0].iov_base, end,
+				   ER_INVALID_MSGPACK, "packet end");
+		return -1;
+	}
+	if (request->algorithm == NULL) {
+		xrow_on_decode_err(row->body[0].iov_base, end,
+				   ER_MISSING_REQUEST_FIELD,
+				   iproto_key_name(IPROTO_COMPRESSION));
+		return -1;
+	}
+	return 0;
+}
+
 int
 xrow_encode_auth(struct xrow_header *packet, const char *salt, size_t salt_len,
 		 const char *login, size_t login_len,
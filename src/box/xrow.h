@@ -172,6 +172,14 @@ struct request {
 	/** Tuple metadata. */
 	const char *tuple_meta;
 	const char *tuple_meta_end;
+	/** SELECT projection, NULL if whole tuples are selected. */
+	const char *fields;
+	const char *fields_end;
+	/** SELECT resume position, NULL to start from the key. */
+	const char *after_position;
+	const char *after_position_end;
+	/** Return the position of the last SELECT result tuple. */
+	bool fetch_position;
 	/** Base field offset for UPDATE/UPSERT, e.g. 0 for C and 1 for Lua. */
 	int index_base;
 };
@@ -194,6 +202,45 @@ int
 xrow_decode_dml(struct xrow_header *xrow, struct request *request,
 		uint64_t key_map);
 
+/**
+ * BATCH request: DML statements executed in one transaction.
+ */
+struct batch_request {
+	/** Statements, MessagePack maps, one after another. */
+	const char *stmts;
+	const char *stmts_end;
+	/** Number of statements. */
+	uint32_t stmt_count;
+};
+
+/**
+ * Decode BATCH request from a given MessagePack map. Only the
+ * outer structure is checked, the statements are decoded one
+ * by one with xrow_decode_batch_stmt().
+ * @param row Request header.
+ * @param[out] request Request to decode to.
+ * @retval 0 on success
+ * @retval -1 on error
+ */
+int
+xrow_decode_batch(const struct xrow_header *row,
+		  struct batch_request *request);
+
+/**
+ * Decode a single statement of a BATCH request. A statement
+ * is a DML request body map with one more key,
+ * IPROTO_REQUEST_TYPE. Only INSERT, REPLACE, UPDATE, DELETE
+ * and UPSERT are allowed. The decoded request has no header.
+ * @param[in, out] pos The statement, advanced past its end.
+ * @param end End of the statement list.
+ * @param[out] request DML request to decode to.
+ * @retval 0 on success
+ * @retval -1 on error
+ */
+int
+xrow_decode_batch_stmt(const char **pos, const char *end,
+		       struct request *request);
+
 /**
  * Encode the request fields to iovec using region_alloc().
  * @param request request to encode
@@ -253,6 +300,26 @@ struct auth_request {
 int
 xrow_decode_auth(const struct xrow_header *row, struct auth_request *request);
 
+/**
+ * COMPRESS request
+ */
+struct compress_request {
+	/** Compression algorithm name, not null-terminated. */
+	const char *algorithm;
+	uint32_t algorithm_len;
+};
+
+/**
+ * Decode COMPRESS request from MessagePack.
+ * @param row request header.
+ * @param[out] request Request to decode.
+ * @retval  0 on success
+ * @retval -1 on error
+ */
+int
+xrow_decode_compress(const struct xrow_header *row,
+		     struct compress_request *request);
+
 /**
  * Encode AUTH command.
  * @param[out] Row.
@@ -517,6 +584,28 @@ void
 iproto_reply_select(struct obuf *buf, struct obuf_svp *svp, uint64_t sync,
 		    uint32_t schema_version, uint32_t count);
 
+/**
+ * Same as iproto_reply_select(), but account @a spliced_size
+ * bytes of tuple data which are not stored in @a buf and will
+ * be written to the socket directly from the tuples. Set
+ * @a has_position if IPROTO_POSITION follows the tuples.
+ */
+void
+iproto_reply_select_spliced(struct obuf *buf, struct obuf_svp *svp,
+			    uint64_t sync, uint32_t schema_version,
+			    uint32_t count, size_t spliced_size,
+			    bool has_position);
+
+/**
+ * Append IPROTO_POSITION to a select result set after its
+ * tuples.
+ * @retval  0 Success.
+ * @retval -1 Memory error.
+ */
+int
+iproto_reply_select_position(struct obuf *buf, const char *position,
+			     uint32_t size);
+
 /**
  * Encode iproto header with IPROTO_OK response code.
  * @param out Encode to.
@@ -89,8 +89,14 @@ latency_collect(struct latency *latency, double value)
 	histogram_collect(latency->histogram, value_usec);
 }
 
+void
+latency_merge(struct latency *dst, const struct latency *src)
+{
+	histogram_merge(dst->histogram, src->histogram);
+}
+
 double
-latency_get(struct latency *latency, int pct)
+latency_get(struct latency *latency, double pct)
 {
 	int64_t value_usec = histogram_percentile(latency->histogram, pct);
 	return (double)value_usec / USEC_PER_SEC;
@@ -31,6 +31,10 @@
  * SUCH DAMAGE.
  */
 
+#if defined(__cplusplus)
+extern "C" {
+#endif /* defined(__cplusplus) */
+
 struct histogram;
 
 /**
@@ -70,11 +74,22 @@ latency_reset(struct latency *latency);
 void
 latency_collect(struct latency *latency, double value);
 
+/**
+ * Add all observations of @src to @dst.
+ */
+void
+latency_merge(struct latency *dst, const struct latency *src);
+
 /**
  * Get accumulated latency value, in seconds.
- * Returns @pct-th percentile of all observations.
+ * Returns @pct-th percentile of all observations,
+ * @pct may be fractional, e.g. 99.9.
  */
 double
-latency_get(struct latency *latency, int pct);
+latency_get(struct latency *latency, double pct);
+
+#if defined(__cplusplus)
+} /* extern "C" */
+#endif /* defined(__cplusplus) */
 
 #endif /* TARANTOOL_LATENCY_H_INCLUDED */
@@ -0,0 +1,339 @@
+/*
+ * Copyright 2010-2020, Tarantool AUTHORS, please see AUTHORS file.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include "affinity.h"
+
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "trivia/config.h"
+#if defined(HAVE_MBIND)
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#endif
+
+#include "trivia/util.h"
+#include "fiber.h"
+#include "diag.h"
+#include "say.h"
+
+const char *cord_class_strs[] = {
+	"tx", "net", "wal", "relay", "vinyl", "coio",
+};
+
+static_assert(lengthof(cord_class_strs) == cord_class_MAX,
+	      "each cord class must have a name");
+
+enum cord_class
+cord_class_by_name(const char *name)
+{
+	if (strcmp(name, "main") == 0)
+		return CORD_CLASS_TX;
+	if (strcmp(name, "iproto") == 0)
+		return CORD_CLASS_NET;
+	if (strcmp(name, "wal") == 0)
+		return CORD_CLASS_WAL;
+	if (strncmp(name, "relay/", strlen("relay/")) == 0 ||
+	    strcmp(name, "subscribe") == 0 ||
+	    strcmp(name, "final_join") == 0 ||
+	    strcmp(name, "initial_join") == 0)
+		return CORD_CLASS_RELAY;
+	if (strncmp(name, "vinyl.", strlen("vinyl.")) == 0)
+		return CORD_CLASS_VINYL;
+	if (strcmp(name, "coio") == 0)
+		return CORD_CLASS_COIO;
+	return cord_class_MAX;
+}
+
+#if defined(HAVE_PTHREAD_SETAFFINITY_NP)
+
+#include <sched.h>
+
+static struct {
+	/** Protects the lists, cords register from any thread. */
+	pthread_mutex_t mutex;
+	/** Cords of each class, linked by cord->in_affinity. */
+	struct rlist cords[cord_class_MAX];
+	/** CPUs of each class, empty if the class is not bound. */
+	cpu_set_t cpus[cord_class_MAX];
+	/** CPUs the process was started with. */
+	cpu_set_t all;
+	bool is_initialized;
+} affinity = {
+	.mutex = PTHREAD_MUTEX_INITIALIZER,
+};
+
+/**
+ * Initialize the registry. The first cord registered is the
+ * main one, so the CPUs the process may run on are taken from
+ * it before any binding.
+ */
+static void
+affinity_init_locked(void)
+{
+	if (affinity.is_initialized)
+		return;
+	for (int i = 0; i < cord_class_MAX; i++) {
+		rlist_create(&affinity.cords[i]);
+		CPU_ZERO(&affinity.cpus[i]);
+	}
+	if (sched_getaffinity(0, sizeof(affinity.all), &affinity.all) != 0) {
+		say_syserror("sched_getaffinity");
+		CPU_ZERO(&affinity.all);
+		for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+			CPU_SET(cpu, &affinity.all);
+	}
+	affinity.is_initialized = true;
+}
+
+static int
+affinity_parse(const char *cpus, cpu_set_t *set)
+{
+	CPU_ZERO(set);
+	const char *p = cpus;
+	while (*p != '\0') {
+		char *end;
+		if (!isdigit((unsigned char)*p))
+			goto error;
+		long first = strtol(p, &end, 10);
+		long last = first;
+		p = end;
+		if (*p == '-') {
+			p++;
+			if (!isdigit((unsigned char)*p))
+				goto error;
+			last = strtol(p, &end, 10);
+			p = end;
+		}
+		if (first > last || last >= CPU_SETSIZE)
+			goto error;
+		for (long cpu = first; cpu <= last; cpu++)
+			CPU_SET(cpu, set);
+		if (*p == ',' && *(p + 1) != '\0')
+			p++;
+		else if (*p != '\0')
+			goto error;
+	}
+	return 0;
+error:
+	diag_set(IllegalParams, "invalid CPU list '%s'", cpus);
+	return -1;
+}
+
+/** Bind a cord to the CPUs of its class or to all CPUs. */
+static void
+affinity_apply_locked(struct cord *cord, enum cord_class cls)
+{
+	const cpu_set_t *set = &affinity.all;
+	if (cls < cord_class_MAX && CPU_COUNT(&affinity.cpus[cls]) > 0)
+		set = &affinity.cpus[cls];
+	int rc = pthread_setaffinity_np(cord->id, sizeof(*set), set);
+	if (rc != 0) {
+		say_warn("failed to set CPU affinity of %s: %s",
+			 cord->name, strerror(rc));
+	}
+}
+
+int
+affinity_check(const char *cpus)
+{
+	cpu_set_t set, allowed;
+	if (affinity_parse(cpus, &set) != 0)
+		return -1;
+	tt_pthread_mutex_lock(&affinity.mutex);
+	affinity_init_locked();
+	CPU_AND(&allowed, &set, &affinity.all);
+	tt_pthread_mutex_unlock(&affinity.mutex);
+	for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+		if (CPU_ISSET(cpu, &set) && !CPU_ISSET(cpu, &allowed)) {
+			diag_set(IllegalParams, "CPU %d is not available",
+				 cpu);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+int
+affinity_set(enum cord_class cls, const char *cpus)
+{
+	assert(cls < cord_class_MAX);
+	if (cpus == NULL)
+		cpus = "";
+	cpu_set_t set;
+	if (affinity_check(cpus) != 0 || affinity_parse(cpus, &set) != 0)
+		return -1;
+	tt_pthread_mutex_lock(&affinity.mutex);
+	if (CPU_EQUAL(&set, &affinity.cpus[cls])) {
+		tt_pthread_mutex_unlock(&affinity.mutex);
+		return 0;
+	}
+	affinity.cpus[cls] = set;
+	struct cord *cord;
+	rlist_foreach_entry(cord, &affinity.cords[cls], in_affinity)
+		affinity_apply_locked(cord, cls);
+	tt_pthread_mutex_unlock(&affinity.mutex);
+	if (*cpus != '\0') {
+		say_info("%s threads are bound to CPUs %s",
+			 cord_class_strs[cls], cpus);
+	} else {
+		say_info("%s threads are unbound", cord_class_strs[cls]);
+	}
+	return 0;
+}
+
+void
+affinity_cord_update(struct cord *cord)
+{
+	enum cord_class cls = cord_class_by_name(cord->name);
+	tt_pthread_mutex_lock(&affinity.mutex);
+	affinity_init_locked();
+	rlist_del(&cord->in_affinity);
+	if (cls < cord_class_MAX)
+		rlist_add_tail(&affinity.cords[cls], &cord->in_affinity);
+	/*
+	 * A thread inherits the CPUs of its creator, so bind
+	 * it even if its class is not bound.
+	 */
+	affinity_apply_locked(cord, cls);
+	tt_pthread_mutex_unlock(&affinity.mutex);
+}
+
+void
+affinity_cord_remove(struct cord *cord)
+{
+	tt_pthread_mutex_lock(&affinity.mutex);
+	rlist_del(&cord->in_affinity);
+	tt_pthread_mutex_unlock(&affinity.mutex);
+}
+
+int
+affinity_numa_node(enum cord_class cls)
+{
+	assert(cls < cord_class_MAX);
+	int first = -1;
+	tt_pthread_mutex_lock(&affinity.mutex);
+	for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+		if (CPU_ISSET(cpu, &affinity.cpus[cls])) {
+			first = cpu;
+			break;
+		}
+	}
+	tt_pthread_mutex_unlock(&affinity.mutex);
+	if (first < 0)
+		return -1;
+	/* The node of a CPU is a nodeN link in its sysfs directory. */
+	char path[PATH_MAX];
+	snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d", first);
+	DIR *dir = opendir(path);
+	if (dir == NULL)
+		return -1;
+	int node = -1;
+	struct dirent *entry;
+	while ((entry = readdir(dir)) != NULL) {
+		if (sscanf(entry->d_name, "node%d", &node) == 1)
+			break;
+		node = -1;
+	}
+	closedir(dir);
+	return node;
+}
+
+#else /* !defined(HAVE_PTHREAD_SETAFFINITY_NP) */
+
+int
+affinity_check(const char *cpus)
+{
+	if (*cpus == '\0')
+		return 0;
+	diag_set(IllegalParams, "CPU affinity is not supported");
+	return -1;
+}
+
+int
+affinity_set(enum cord_class cls, const char *cpus)
+{
+	(void)cls;
+	return cpus == NULL ? 0 : affinity_check(cpus);
+}
+
+void
+affinity_cord_update(struct cord *cord)
+{
+	(void)cord;
+}
+
+void
+affinity_cord_remove(struct cord *cord)
+{
+	(void)cord;
+}
+
+int
+affinity_numa_node(enum cord_class cls)
+{
+	(void)cls;
+	return -1;
+}
+
+#endif /* defined(HAVE_PTHREAD_SETAFFINITY_NP) */
+
+int
+affinity_bind_memory(void *addr, size_t size, int node)
+{
+#if defined(HAVE_MBIND)
+	unsigned long nodemask = 0;
+	if (node < 0 || node >= (int)(sizeof(nodemask) * CHAR_BIT)) {
+		diag_set(IllegalParams, "invalid NUMA node %d", node);
+		return -1;
+	}
+	nodemask |= 1UL << node;
+	/* The kernel reads one bit less than maxnode. */
+	unsigned long maxnode = sizeof(nodemask) * CHAR_BIT + 1;
+	if (syscall(SYS_mbind, addr, size, MPOL_PREFERRED, &nodemask,
+		    maxnode, MPOL_MF_MOVE) != 0) {
+		diag_set(SystemError, "failed to bind memory to NUMA node %d",
+			 node);
+		return -1;
+	}
+	return 0;
+#else
+	(void)addr;
+	(void)size;
+	(void)node;
+	diag_set(IllegalParams, "NUMA memory policy is not supported");
+	return -1;
+#endif
+}
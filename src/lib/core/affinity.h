@@ -0,0 +1,128 @@
+#ifndef TARANTOOL_LIB_CORE_AFFINITY_H_INCLUDED
+#define TARANTOOL_LIB_CORE_AFFINITY_H_INCLUDED
+/*
+ * Copyright 2010-2020, Tarantool AUTHORS, please see AUTHORS file.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include <stddef.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif /* defined(__cplusplus) */
+
+/**
+ * Pinning of threads to CPUs.
+ *
+ * Cords are divided into classes by their names, and the
+ * threads of each class can be bound to a set of CPUs. A cord
+ * registers itself when it is named, so the set applies both
+ * to the cords which are running when it is changed and to the
+ * ones started later. The cords of a class without a set and
+ * the cords not belonging to any class run on all CPUs the
+ * process was started with, rather than on the CPUs of the
+ * thread which created them.
+ */
+
+struct cord;
+
+enum cord_class {
+	/** The main thread. */
+	CORD_CLASS_TX,
+	/** Network threads. */
+	CORD_CLASS_NET,
+	/** The WAL writer. */
+	CORD_CLASS_WAL,
+	/** Relays and initial join threads. */
+	CORD_CLASS_RELAY,
+	/** Vinyl readers, dumpers and compactors. */
+	CORD_CLASS_VINYL,
+	/** Threads of the coio thread pool. */
+	CORD_CLASS_COIO,
+	cord_class_MAX,
+};
+
+extern const char *cord_class_strs[];
+
+/** Find the class of the cord named @a name. */
+enum cord_class
+cord_class_by_name(const char *name);
+
+/**
+ * Check that @a cpus is a valid CPU list, e.g. "0-3,8", and
+ * that the process may run on all the CPUs of the list.
+ * @retval  0 Success.
+ * @retval -1 Error, diag is set.
+ */
+int
+affinity_check(const char *cpus);
+
+/**
+ * Bind the cords of class @a cls to the CPU list @a cpus.
+ * NULL or an empty list unbinds them.
+ * @retval  0 Success.
+ * @retval -1 Error, diag is set.
+ */
+int
+affinity_set(enum cord_class cls, const char *cpus);
+
+/**
+ * Register the current thread's cord under its current name
+ * and bind it to the CPUs of its class. Is called whenever
+ * the cord is renamed.
+ */
+void
+affinity_cord_update(struct cord *cord);
+
+/** Unregister a cord which is being destroyed. */
+void
+affinity_cord_remove(struct cord *cord);
+
+/**
+ * NUMA node of the first CPU the cords of class @a cls are
+ * bound to, -1 if the class is not bound or the node is
+ * unknown.
+ */
+int
+affinity_numa_node(enum cord_class cls);
+
+/**
+ * Prefer NUMA node @a node for the memory pages of the range
+ * and move the pages which are already allocated elsewhere.
+ * @a addr must be page aligned.
+ * @retval  0 Success.
+ * @retval -1 Error, diag is set.
+ */
+int
+affinity_bind_memory(void *addr, size_t size, int node);
+
+#if defined(__cplusplus)
+} /* extern "C" */
+#endif /* defined(__cplusplus) */
+
+#endif /* TARANTOOL_LIB_CORE_AFFINITY_H_INCLUDED */
@@ -80,6 +80,8 @@ get_proc_name(unw_cursor_t *unw_cur, unw_word_t *offset, bool skip_cache)
 	static __thread char proc_name[BACKTRACE_NAME_MAX];
 	unw_word_t ip;
 	unw_get_reg(unw_cur, UNW_REG_IP, &ip);
+	/* Is left intact if the procedure is not found. */
+	proc_name[0] = '\0';
 
 	if (skip_cache) {
 		unw_get_proc_name(unw_cur, proc_name, sizeof(proc_name),
@@ -433,6 +435,56 @@ out:
 	free(demangle_buf);
 }
 
+int
+backtrace_collect(void **ips, int count)
+{
+	unw_context_t unw_ctx;
+	unw_cursor_t unw_cur;
+	unw_getcontext(&unw_ctx);
+	unw_init_local(&unw_cur, &unw_ctx);
+	int frame_no = 0;
+	unw_word_t ip;
+	while (frame_no < count && unw_step(&unw_cur) > 0) {
+		if (unw_is_signal_frame(&unw_cur) > 0) {
+			/* Drop the frames of the signal handler. */
+			frame_no = 0;
+			continue;
+		}
+		unw_get_reg(&unw_cur, UNW_REG_IP, &ip);
+		ips[frame_no++] = (void *)ip;
+	}
+	return frame_no;
+}
+
+const char *
+backtrace_proc_name(void *ip)
+{
+	static __thread char *demangle_buf = NULL;
+	static __thread size_t demangle_buf_len = 0;
+	unw_context_t unw_ctx;
+	unw_cursor_t unw_cur;
+	unw_word_t offset;
+	unw_getcontext(&unw_ctx);
+	unw_init_local(&unw_cur, &unw_ctx);
+	/*
+	 * The cursor is only used to look up the procedure
+	 * info, so it is enough to point it at the address.
+	 */
+	if (unw_set_reg(&unw_cur, UNW_REG_IP, (unw_word_t)ip) != 0)
+		return NULL;
+	const char *proc = get_proc_name(&unw_cur, &offset, false);
+	if (*proc == '\0')
+		return NULL;
+	int demangle_status;
+	char *cxxname = abi::__cxa_demangle(proc, demangle_buf,
+					    &demangle_buf_len,
+					    &demangle_status);
+	if (cxxname == NULL)
+		return proc;
+	demangle_buf = cxxname;
+	return cxxname;
+}
+
 void
 print_backtrace()
 {
@@ -52,6 +52,26 @@ backtrace_foreach(backtrace_cb cb, coro_context *coro_ctx, void *cb_ctx);
 void
 backtrace_proc_cache_clear();
 
+/**
+ * Collect addresses of up to @a count frames of the current
+ * stack to @a ips, innermost first. If the stack contains a
+ * signal frame, only the frames of the interrupted code are
+ * collected. Does not allocate memory and may be called from
+ * a signal handler.
+ * @return the number of collected frames.
+ */
+int
+backtrace_collect(void **ips, int count);
+
+/**
+ * Find a name of the function an address collected by
+ * backtrace_collect() belongs to. C++ names are demangled.
+ * @return a name in a thread-local buffer or NULL if the
+ *         function is unknown.
+ */
+const char *
+backtrace_proc_name(void *ip);
+
 #endif /* ENABLE_BACKTRACE */
 
 #if defined(__cplusplus)
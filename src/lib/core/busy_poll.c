@@ -0,0 +1,138 @@
+/*
+ * Copyright 2010-2020, Tarantool AUTHORS, please see AUTHORS file.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include "busy_poll.h"
+
+#include "trivia/util.h"
+
+/** Adapt the spin limit to a wait of @a wait_time seconds. */
+static void
+busy_poll_adapt(struct busy_poll *poll, double wait_time)
+{
+	if (wait_time > poll->max_time) {
+		poll->spin_limit /= 2;
+		if (poll->spin_limit < BUSY_POLL_GROW_START)
+			poll->spin_limit = 0;
+	} else if (poll->spin_limit < poll->max_time) {
+		poll->spin_limit = MAX(poll->spin_limit * 2,
+				       BUSY_POLL_GROW_START);
+		poll->spin_limit = MIN(poll->spin_limit, poll->max_time);
+	}
+}
+
+static void
+busy_poll_prepare_cb(struct ev_loop *loop, struct ev_prepare *watcher,
+		     int events)
+{
+	(void) loop;
+	(void) events;
+	struct busy_poll *poll = (struct busy_poll *) watcher->data;
+	if (poll->wait_start != 0)
+		return;
+	poll->wait_start = ev_monotonic_time();
+	if (poll->spin_limit > 0)
+		ev_idle_start(poll->loop, &poll->idle);
+}
+
+static void
+busy_poll_check_cb(struct ev_loop *loop, struct ev_check *watcher,
+		   int events)
+{
+	(void) events;
+	struct busy_poll *poll = (struct busy_poll *) watcher->data;
+	if (poll->wait_start == 0)
+		return;
+	if (ev_is_active(&poll->idle)) {
+		/* Nothing has happened, go on spinning. */
+		if (ev_is_pending(&poll->idle))
+			return;
+		poll->hit_count++;
+		poll->spin_time += ev_monotonic_now(loop) - poll->wait_start;
+		ev_idle_stop(loop, &poll->idle);
+	} else {
+		busy_poll_adapt(poll, ev_monotonic_now(loop) -
+				poll->wait_start);
+	}
+	poll->wait_start = 0;
+}
+
+static void
+busy_poll_idle_cb(struct ev_loop *loop, struct ev_idle *watcher, int events)
+{
+	(void) events;
+	struct busy_poll *poll = (struct busy_poll *) watcher->data;
+	double spin_time = ev_monotonic_time() - poll->wait_start;
+	if (spin_time < poll->spin_limit)
+		return;
+	/* Block in the next poll. */
+	poll->miss_count++;
+	poll->spin_time += spin_time;
+	ev_idle_stop(loop, &poll->idle);
+}
+
+void
+busy_poll_create(struct busy_poll *poll, struct ev_loop *loop)
+{
+	poll->max_time = 0;
+	poll->spin_limit = 0;
+	poll->wait_start = 0;
+	poll->spin_time = 0;
+	poll->hit_count = 0;
+	poll->miss_count = 0;
+	poll->loop = loop;
+	ev_prepare_init(&poll->prepare, busy_poll_prepare_cb);
+	poll->prepare.data = poll;
+	ev_check_init(&poll->check, busy_poll_check_cb);
+	poll->check.data = poll;
+	ev_idle_init(&poll->idle, busy_poll_idle_cb);
+	poll->idle.data = poll;
+}
+
+void
+busy_poll_destroy(struct busy_poll *poll)
+{
+	busy_poll_set_max_time(poll, 0);
+}
+
+void
+busy_poll_set_max_time(struct busy_poll *poll, double max_time)
+{
+	poll->max_time = max_time;
+	poll->spin_limit = max_time;
+	if (max_time > 0) {
+		ev_prepare_start(poll->loop, &poll->prepare);
+		ev_check_start(poll->loop, &poll->check);
+		return;
+	}
+	ev_prepare_stop(poll->loop, &poll->prepare);
+	ev_check_stop(poll->loop, &poll->check);
+	ev_idle_stop(poll->loop, &poll->idle);
+	poll->wait_start = 0;
+}
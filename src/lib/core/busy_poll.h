@@ -0,0 +1,103 @@
+#ifndef TARANTOOL_LIB_CORE_BUSY_POLL_H_INCLUDED
+#define TARANTOOL_LIB_CORE_BUSY_POLL_H_INCLUDED
+/*
+ * Copyright 2010-2020, Tarantool AUTHORS, please see AUTHORS file.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include <stdint.h>
+#include "tarantool_ev.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif /* defined(__cplusplus) */
+
+/**
+ * Adaptive busy polling of an event loop.
+ *
+ * When there are no events, the loop does not block in poll
+ * right away, but keeps polling without a timeout for up to
+ * a spin limit. An event which arrives meanwhile, be it a
+ * socket becoming ready or an ev_async sent by a cbus
+ * producer, is handled without the latency of putting the
+ * thread to sleep and waking it up.
+ *
+ * The spin limit adapts to the load the way KVM halt polling
+ * does: if the loop has blocked after a spin and the event
+ * has come within the max spin time, the limit is doubled, so
+ * that the next event is likely caught by spinning. If the
+ * wait has been longer than the max spin time, spinning is
+ * a waste of CPU and the limit is halved.
+ */
+
+/** The first nonzero spin limit when it grows, in seconds. */
+#define BUSY_POLL_GROW_START 1e-5
+
+struct busy_poll {
+	/** Max time to spin, in seconds, 0 if disabled. */
+	double max_time;
+	/** Current spin limit, at most max_time. */
+	double spin_limit;
+	/**
+	 * Time the loop started waiting for events, 0 if it is
+	 * handling them.
+	 */
+	double wait_start;
+	/** Total time spent spinning, in seconds. */
+	double spin_time;
+	/** Number of spins ended by an event. */
+	uint64_t hit_count;
+	/** Number of spins which timed out and blocked. */
+	uint64_t miss_count;
+	/** Starts the wait before poll. */
+	struct ev_prepare prepare;
+	/** Ends the wait after poll. */
+	struct ev_check check;
+	/** Keeps poll nonblocking while the loop spins. */
+	struct ev_idle idle;
+	struct ev_loop *loop;
+};
+
+void
+busy_poll_create(struct busy_poll *poll, struct ev_loop *loop);
+
+void
+busy_poll_destroy(struct busy_poll *poll);
+
+/**
+ * Set the max time to spin, 0 disables busy polling. Must be
+ * called from the thread of the loop.
+ */
+void
+busy_poll_set_max_time(struct busy_poll *poll, double max_time);
+
+#if defined(__cplusplus)
+} /* extern "C" */
+#endif /* defined(__cplusplus) */
+
+#endif /* TARANTOOL_LIB_CORE_BUSY_POLL_H_INCLUDED */
@@ -31,6 +31,7 @@
 #include "cbus.h"
 
 #include <limits.h>
+#include <pmatomic.h>
 #include "fiber.h"
 #include "trigger.h"
 
@@ -74,6 +75,163 @@ cbus_find_endpoint_locked(struct cbus *bus, const char *name)
 	return NULL;
 }
 
+/* {{{ Endpoint queue */
+
+/*
+ * The endpoint queue is the intrusive MPSC queue by Dmitry
+ * Vyukov. A producer appends a whole batch of messages with
+ * one atomic exchange of the tail and then links the batch to
+ * the previous tail. In between the batch is not reachable
+ * from the head. The window is short, but the producer may be
+ * preempted in it, so the consumer doesn't wait for the link.
+ * It stops fetching and asks the producer to notify it once
+ * the batch is linked, see cbus_endpoint_fetch().
+ */
+
+static void
+cbus_endpoint_queue_create(struct cbus_endpoint *endpoint)
+{
+	endpoint->stub.next = NULL;
+	endpoint->head = &endpoint->stub;
+	endpoint->tail = &endpoint->stub;
+	endpoint->is_waiting = false;
+}
+
+/**
+ * Append a chain of entries from @a first to @a last to the
+ * queue. Returns the previous tail of the queue.
+ */
+static struct stailq_entry *
+cbus_endpoint_queue_link(struct cbus_endpoint *endpoint,
+			 struct stailq_entry *first, struct stailq_entry *last)
+{
+	assert(last->next == NULL);
+	struct stailq_entry *prev =
+		pm_atomic_exchange_explicit(&endpoint->tail, last,
+					    pm_memory_order_acq_rel);
+	/* Ordered with the load of is_waiting, see below. */
+	pm_atomic_store_explicit(&prev->next, first,
+				 pm_memory_order_seq_cst);
+	return prev;
+}
+
+/**
+ * Append a chain of entries from @a first to @a last, with
+ * last->next == NULL, to the queue. Returns true if the consumer
+ * may be waiting for the messages: the queue was empty, or the
+ * consumer has found a batch not linked yet and asked for a
+ * notification.
+ */
+static bool
+cbus_endpoint_queue_push(struct cbus_endpoint *endpoint,
+			 struct stailq_entry *first, struct stailq_entry *last)
+{
+	if (cbus_endpoint_queue_link(endpoint, first, last) ==
+	    &endpoint->stub)
+		return true;
+	return pm_atomic_load_explicit(&endpoint->is_waiting,
+				       pm_memory_order_seq_cst) &&
+	       pm_atomic_exchange_explicit(&endpoint->is_waiting, false,
+					   pm_memory_order_acq_rel);
+}
+
+/** Append all entries of @a list to the queue. */
+static bool
+cbus_endpoint_queue_concat(struct cbus_endpoint *endpoint,
+			   struct stailq *list)
+{
+	assert(!stailq_empty(list));
+	bool was_empty = cbus_endpoint_queue_push(endpoint,
+						  stailq_first(list),
+						  stailq_last(list));
+	stailq_create(list);
+	return was_empty;
+}
+
+/**
+ * Pop an entry from the queue. Returns NULL if the queue is
+ * empty or the next entry is not linked yet. Must be called by
+ * the consumer.
+ */
+static struct stailq_entry *
+cbus_endpoint_queue_pop(struct cbus_endpoint *endpoint)
+{
+	struct stailq_entry *stub = &endpoint->stub;
+	struct stailq_entry *head = endpoint->head;
+	struct stailq_entry *next =
+		pm_atomic_load_explicit(&head->next, pm_memory_order_acquire);
+	if (head == stub) {
+		if (next == NULL)
+			return NULL;
+		head = next;
+		next = pm_atomic_load_explicit(&head->next,
+					       pm_memory_order_acquire);
+	}
+	if (next == NULL) {
+		/*
+		 * The head may be the last entry. It can't be
+		 * popped until something is linked after it, so
+		 * push the stub after it in this case.
+		 */
+		if (head == pm_atomic_load_explicit(&endpoint->tail,
+						    pm_memory_order_acquire)) {
+			stub->next = NULL;
+			cbus_endpoint_queue_link(endpoint, stub, stub);
+		}
+		next = pm_atomic_load_explicit(&head->next,
+					       pm_memory_order_acquire);
+		if (next == NULL) {
+			/* A producer is linking a batch after the head. */
+			endpoint->head = head;
+			return NULL;
+		}
+	}
+	endpoint->head = next;
+	return head;
+}
+
+/**
+ * True if the queue is empty. Must be called by the consumer.
+ */
+static bool
+cbus_endpoint_queue_is_empty(struct cbus_endpoint *endpoint)
+{
+	return endpoint->head == &endpoint->stub &&
+	       pm_atomic_load_explicit(&endpoint->stub.next,
+				       pm_memory_order_acquire) == NULL;
+}
+
+void
+cbus_endpoint_fetch(struct cbus_endpoint *endpoint, struct stailq *output)
+{
+	struct stailq_entry *entry;
+	while (true) {
+		while ((entry = cbus_endpoint_queue_pop(endpoint)) != NULL)
+			stailq_add_tail(output, entry);
+		/*
+		 * The producer of a batch appended to an empty
+		 * queue notifies the consumer anyway.
+		 */
+		if (cbus_endpoint_queue_is_empty(endpoint))
+			break;
+		/*
+		 * A producer is linking a batch after the head.
+		 * Ask it to notify the consumer when it is done,
+		 * unless the batch has been linked meanwhile. The
+		 * producer stores the link before it loads the
+		 * flag, so either it sees the flag or the link is
+		 * seen here.
+		 */
+		pm_atomic_store_explicit(&endpoint->is_waiting, true,
+					 pm_memory_order_seq_cst);
+		if (pm_atomic_load_explicit(&endpoint->head->next,
+					    pm_memory_order_seq_cst) == NULL)
+			break;
+	}
+}
+
+/* }}} Endpoint queue */
+
 static struct cbus_endpoint *
 cbus_find_endpoint(struct cbus *bus, const char *name)
 {
@@ -156,18 +314,18 @@ cpipe_destroy(struct cpipe *pipe)
 	 * delivered.
 	 */
 	tt_pthread_mutex_lock(&endpoint->mutex);
+	/* Add the pipe shutdown message as the last one. */
+	stailq_add_tail_entry(&pipe->input, poison, msg.fifo);
 	/* Flush input */
-	stailq_concat(&endpoint->output, &pipe->input);
+	cbus_endpoint_queue_concat(endpoint, &pipe->input);
 	pipe->n_input = 0;
-	/* Add the pipe shutdown message as the last one. */
-	stailq_add_tail_entry(&endpoint->output, poison, msg.fifo);
 	/* Count statistics */
 	rmean_collect(cbus.stats, CBUS_STAT_EVENTS, 1);
 	/*
 	 * Keep the lock for the duration of ev_async_send():
-	 * this will avoid a race condition between
-	 * ev_async_send() and execution of the poison
-	 * message, after which the endpoint may disappear.
+	 * cbus_endpoint_destroy() takes it after execution of
+	 * the poison message, so the endpoint can't disappear
+	 * before ev_async_send() is done with it.
 	 */
 	ev_async_send(endpoint->consumer, &endpoint->async);
 	tt_pthread_mutex_unlock(&endpoint->mutex);
@@ -227,7 +385,7 @@ cbus_endpoint_create(struct cbus_endpoint *endpoint, const char *name,
 	endpoint->n_pipes = 0;
 	fiber_cond_create(&endpoint->cond);
 	tt_pthread_mutex_init(&endpoint->mutex, NULL);
-	stailq_create(&endpoint->output);
+	cbus_endpoint_queue_create(endpoint);
 	ev_async_init(&endpoint->async,
 		      (void (*)(ev_loop *, struct ev_async *, int)) fetch_cb);
 	endpoint->async.data = fetch_data;
@@ -261,14 +419,15 @@ cbus_endpoint_destroy(struct cbus_endpoint *endpoint,
 	while (true) {
 		if (process_cb)
 			process_cb(endpoint);
-		if (endpoint->n_pipes == 0 && stailq_empty(&endpoint->output))
+		if (endpoint->n_pipes == 0 &&
+		    cbus_endpoint_queue_is_empty(endpoint))
 			break;
 		 fiber_cond_wait(&endpoint->cond);
 	}
 
 	/*
-	 * Pipe flush func can still lock mutex, so just lock and unlock
-	 * it.
+	 * cpipe_destroy() can still hold the mutex, so just lock
+	 * and unlock it.
 	 */
 	tt_pthread_mutex_lock(&endpoint->mutex);
 	tt_pthread_mutex_unlock(&endpoint->mutex);
@@ -304,11 +463,8 @@ cpipe_flush_cb(ev_loop *loop, struct ev_async *watcher, int events)
 	int old_cancel_state;
 	tt_pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &old_cancel_state);
 
-	tt_pthread_mutex_lock(&endpoint->mutex);
-	output_was_empty = stailq_empty(&endpoint->output);
 	/** Flush input */
-	stailq_concat(&endpoint->output, &pipe->input);
-	tt_pthread_mutex_unlock(&endpoint->mutex);
+	output_was_empty = cbus_endpoint_queue_concat(endpoint, &pipe->input);
 
 	pipe->n_input = 0;
 	if (output_was_empty) {
@@ -118,7 +118,8 @@ struct cpipe {
 	/**
 	 * When pushing messages, keep the staged input size under
 	 * this limit (speeds up message delivery and reduces
-	 * latency, while still keeping the bus mutex cold enough).
+	 * latency, while still keeping the endpoint queue tail
+	 * cold enough).
 	 */
 	int max_input;
 	/**
@@ -166,7 +167,7 @@ cpipe_destroy(struct cpipe *pipe);
  * Otherwise, the messages flushed once per event loop iteration.
  *
  * @todo: collect bus stats per second and adjust max_input once
- * a second to keep the mutex cold regardless of the message load,
+ * a second to keep the queue tail cold regardless of the message load,
  * while still keeping the latency low if there are few
  * long-to-process messages.
  */
@@ -258,12 +259,33 @@ struct cbus_endpoint {
 	char name[FIBER_NAME_MAX];
 	/** Member of cbus->endpoints */
 	struct rlist in_cbus;
-	/** The lock around the pipe. */
+	/**
+	 * The lock held by cpipe_destroy() while it delivers the
+	 * last messages of the pipe, so that the endpoint is not
+	 * destroyed under its feet. Message delivery does not
+	 * take it.
+	 */
 	pthread_mutex_t mutex;
-	/** A queue with incoming messages. */
-	struct stailq output;
+	/**
+	 * Incoming messages, a lock-free multi-producer single
+	 * consumer queue of cmsg::fifo entries. Producers append
+	 * to the tail with an atomic exchange, the consumer cord
+	 * pops from the head, which only it touches. The stub
+	 * entry is there to never let the queue become empty, so
+	 * that the producers don't have to touch the head.
+	 */
+	struct stailq_entry *head;
+	struct stailq_entry stub;
+	/** The tail of the queue, shared by producers. */
+	alignas(CACHELINE_SIZE) struct stailq_entry *tail;
+	/**
+	 * Set by the consumer when it has found a batch which
+	 * is not linked to the queue yet, so that the producer
+	 * of the batch notifies it, see cbus_endpoint_fetch().
+	 */
+	bool is_waiting;
 	/** Consumer cord loop */
-	ev_loop *consumer;
+	alignas(CACHELINE_SIZE) ev_loop *consumer;
 	/** Async to notify the consumer */
 	ev_async async;
 	/** Count of connected pipes */
@@ -273,15 +295,11 @@ struct cbus_endpoint {
 };
 
 /**
- * Fetch incomming messages to output
+ * Fetch incomming messages to output. Must be called by the
+ * consumer cord.
  */
-static inline void
-cbus_endpoint_fetch(struct cbus_endpoint *endpoint, struct stailq *output)
-{
-	tt_pthread_mutex_lock(&endpoint->mutex);
-	stailq_concat(output, &endpoint->output);
-	tt_pthread_mutex_unlock(&endpoint->mutex);
-}
+void
+cbus_endpoint_fetch(struct cbus_endpoint *endpoint, struct stailq *output);
 
 /** Initialize the global singleton bus. */
 void
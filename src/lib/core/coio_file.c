@@ -34,21 +34,64 @@
 #include "say.h"
 #include "fio.h"
 #include "errinj.h"
+#include "third_party/tarantool_eio.h" /* eio_sendfile_sync() */
 #include <stdio.h>
 #include <stdlib.h>
 #include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/time.h>
 
 /**
- * A context of libeio request for any
- * coio task.
+ * A context of a coio pool job for any
+ * file task.
  */
 struct coio_file_task {
+	struct coio_job base; /* must be first */
 	ssize_t result;
 	int errorno;
 	struct fiber *fiber;
 	bool done;
 
 	union {
+		struct {
+			const char *pathname;
+			int flags;
+			mode_t mode;
+		} open;
+
+		struct {
+			int fd;
+		} close;
+
+		struct {
+			const char *pathname;
+			mode_t mode;
+		} path;
+
+		struct {
+			const char *oldpath;
+			const char *newpath;
+		} rename;
+
+		struct {
+			int fd;
+			const char *pathname;
+			off_t length;
+		} truncate;
+
+		struct {
+			const char *pathname;
+			uid_t owner;
+			gid_t group;
+		} chown;
+
+		struct {
+			const char *pathname;
+			double atime;
+			double mtime;
+		} utime;
+
 		struct {
 			int fd;
 			struct stat *buf;
@@ -76,12 +119,14 @@ struct coio_file_task {
 			int fd;
 			const void *buf;
 			size_t count;
+			off_t offset;
 		} write;
 
 		struct {
 			int fd;
 			void *buf;
 			size_t count;
+			off_t offset;
 		} read;
 
 		struct {
@@ -111,31 +156,34 @@ struct coio_file_task {
 	memset(&name, 0, sizeof(name));		\
 	name.fiber = fiber();			\
 
-/** A callback invoked by eio when a task is complete. */
-static int
-coio_complete(eio_req *req)
+/** Convert a coio pool job to the file task it is embedded in. */
+static inline struct coio_file_task *
+coio_file_task(struct coio_job *job)
 {
-	struct coio_file_task *eio = (struct coio_file_task *)req->data;
+	return (struct coio_file_task *) job;
+}
 
-	eio->errorno = req->errorno;
+/** A callback invoked by the coio pool when a task is complete. */
+static void
+coio_complete(struct coio_job *job)
+{
+	struct coio_file_task *eio = coio_file_task(job);
 	eio->done = true;
-	eio->result = req->result;
-
 	fiber_wakeup(eio->fiber);
-	return 0;
 }
 
 /**
- * Synchronously (from cooperative multitasking point of view)
- * wait for task completion.
+ * Submit the task to the coio pool and synchronously (from
+ * cooperative multitasking point of view) wait for its
+ * completion. Metadata operations are submitted with a high
+ * priority, bulk data transfer and syncs with a low one, so
+ * that the former do not wait behind the latter.
  */
 static ssize_t
-coio_wait_done(eio_req *req, struct coio_file_task *eio)
+coio_execute(struct coio_file_task *eio, enum coio_prio prio, coio_job_f run)
 {
-	if (!req) {
-		errno = ENOMEM;
-		return -1;
-	}
+	coio_job_create(&eio->base, prio, run, coio_complete);
+	coio_pool_submit(&eio->base);
 
 	while (!eio->done)
 		fiber_yield();
@@ -144,39 +192,81 @@ coio_wait_done(eio_req *req, struct coio_file_task *eio)
 	return eio->result;
 }
 
+/** Store the result of a syscall and the errno it has set. */
+#define COIO_FILE_RESULT(eio, expr) do {			\
+	(eio)->result = (expr);					\
+	(eio)->errorno = errno;					\
+} while (0)
+
+static void
+coio_do_open(struct coio_job *job)
+{
+	struct coio_file_task *eio = coio_file_task(job);
+	COIO_FILE_RESULT(eio, open(eio->open.pathname, eio->open.flags,
+				   eio->open.mode));
+}
+
 int
 coio_file_open(const char *path, int flags, mode_t mode)
 {
 	INIT_COEIO_FILE(eio);
-	eio_req *req = eio_open(path, flags, mode, 0,
-				coio_complete, &eio);
-	return coio_wait_done(req, &eio);
+	eio.open.pathname = path;
+	eio.open.flags = flags;
+	eio.open.mode = mode;
+	return coio_execute(&eio, COIO_PRIO_HIGH, coio_do_open);
+}
+
+static void
+coio_do_close(struct coio_job *job)
+{
+	struct coio_file_task *eio = coio_file_task(job);
+	COIO_FILE_RESULT(eio, close(eio->close.fd));
 }
 
 int
 coio_file_close(int fd)
 {
 	INIT_COEIO_FILE(eio);
-	eio_req *req = eio_close(fd, 0, coio_complete, &eio);
-	return coio_wait_done(req, &eio);
+	eio.close.fd = fd;
+	return coio_execute(&eio, COIO_PRIO_HIGH, coio_do_close);
+}
+
+static void
+coio_do_pwrite(struct coio_job *job)
+{
+	struct coio_file_task *eio = coio_file_task(job);
+	COIO_FILE_RESULT(eio, pwrite(eio->write.fd, eio->write.buf,
+				     eio->write.count, eio->write.offset));
 }
 
 ssize_t
 coio_pwrite(int fd, const void *buf, size_t count, off_t offset)
 {
 	INIT_COEIO_FILE(eio);
-	eio_req *req = eio_write(fd, (void *) buf, count, offset,
-				 0, coio_complete, &eio);
-	return coio_wait_done(req, &eio);
+	eio.write.fd = fd;
+	eio.write.buf = buf;
+	eio.write.count = count;
+	eio.write.offset = offset;
+	return coio_execute(&eio, COIO_PRIO_LOW, coio_do_pwrite);
+}
+
+static void
+coio_do_pread(struct coio_job *job)
+{
+	struct coio_file_task *eio = coio_file_task(job);
+	COIO_FILE_RESULT(eio, pread(eio->read.fd, eio->read.buf,
+				    eio->read.count, eio->read.offset));
 }
 
 ssize_t
 coio_pread(int fd, void *buf, size_t count, off_t offset)
 {
 	INIT_COEIO_FILE(eio);
-	eio_req *req = eio_read(fd, buf, count,
-				offset, 0, coio_complete, &eio);
-	return coio_wait_done(req, &eio);
+	eio.read.fd = fd;
+	eio.read.buf = buf;
+	eio.read.count = count;
+	eio.read.offset = offset;
+	return coio_execute(&eio, COIO_PRIO_LOW, coio_do_pread);
 }
 
 ssize_t
@@ -198,11 +288,11 @@ coio_preadn(int fd, void *buf, size_t count, off_t offset)
 }
 
 static void
-coio_do_write(eio_req *req)
+coio_do_write(struct coio_job *job)
 {
-	struct coio_file_task *eio = (struct coio_file_task *)req->data;
-	req->result = write(eio->write.fd, eio->write.buf, eio->write.count);
-	eio->errorno = errno;
+	struct coio_file_task *eio = coio_file_task(job);
+	COIO_FILE_RESULT(eio, write(eio->write.fd, eio->write.buf,
+				    eio->write.count));
 }
 
 ssize_t
@@ -212,17 +302,15 @@ coio_write(int fd, const void *buf, size_t count)
 	eio.write.buf = buf;
 	eio.write.count = count;
 	eio.write.fd = fd;
-	eio_req *req = eio_custom(coio_do_write, 0,
-				  coio_complete, &eio);
-	return coio_wait_done(req, &eio);
+	return coio_execute(&eio, COIO_PRIO_LOW, coio_do_write);
 }
 
 static void
-coio_do_read(eio_req *req)
+coio_do_read(struct coio_job *job)
 {
-	struct coio_file_task *eio = (struct coio_file_task *)req->data;
-	req->result = read(eio->read.fd, eio->read.buf, eio->read.count);
-	req->errorno = errno;
+	struct coio_file_task *eio = coio_file_task(job);
+	COIO_FILE_RESULT(eio, read(eio->read.fd, eio->read.buf,
+				   eio->read.count));
 }
 
 ssize_t
@@ -232,19 +320,16 @@ coio_read(int fd, void *buf, size_t count)
 	eio.read.buf = buf;
 	eio.read.count = count;
 	eio.read.fd = fd;
-	eio_req *req = eio_custom(coio_do_read, 0,
-				  coio_complete, &eio);
-	return coio_wait_done(req, &eio);
+	return coio_execute(&eio, COIO_PRIO_LOW, coio_do_read);
 }
 
 
 static void
-coio_do_lseek(eio_req *req)
+coio_do_lseek(struct coio_job *job)
 {
-	struct coio_file_task *eio = (struct coio_file_task *)req->data;
-	req->result =
-		lseek(eio->lseek.fd, eio->lseek.offset, eio->lseek.whence);
-	req->errorno = errno;
+	struct coio_file_task *eio = coio_file_task(job);
+	COIO_FILE_RESULT(eio, lseek(eio->lseek.fd, eio->lseek.offset,
+				    eio->lseek.whence));
 }
 
 off_t
@@ -256,17 +341,14 @@ coio_lseek(int fd, off_t offset, int whence)
 	eio.lseek.offset = offset;
 	eio.lseek.fd = fd;
 
-	eio_req *req = eio_custom(coio_do_lseek, 0,
-				  coio_complete, &eio);
-	return coio_wait_done(req, &eio);
+	return coio_execute(&eio, COIO_PRIO_HIGH, coio_do_lseek);
 }
 
 static void
-coio_do_lstat(eio_req *req)
+coio_do_lstat(struct coio_job *job)
 {
-	struct coio_file_task *eio = (struct coio_file_task *)req->data;
-	req->result = lstat(eio->lstat.pathname, eio->lstat.buf);
-	req->errorno = errno;
+	struct coio_file_task *eio = coio_file_task(job);
+	COIO_FILE_RESULT(eio, lstat(eio->lstat.pathname, eio->lstat.buf));
 }
 
 int
@@ -275,17 +357,14 @@ coio_lstat(const char *pathname, struct stat *buf)
 	INIT_COEIO_FILE(eio);
 	eio.lstat.pathname = pathname;
 	eio.lstat.buf = buf;
-	eio_req *req = eio_custom(coio_do_lstat, 0,
-				  coio_complete, &eio);
-	return coio_wait_done(req, &eio);
+	return coio_execute(&eio, COIO_PRIO_HIGH, coio_do_lstat);
 }
 
 static void
-coio_do_stat(eio_req *req)
+coio_do_stat(struct coio_job *job)
 {
-	struct coio_file_task *eio = (struct coio_file_task *)req->data;
-	req->result = stat(eio->lstat.pathname, eio->lstat.buf);
-	req->errorno = errno;
+	struct coio_file_task *eio = coio_file_task(job);
+	COIO_FILE_RESULT(eio, stat(eio->lstat.pathname, eio->lstat.buf));
 }
 
 int
@@ -294,17 +373,14 @@ coio_stat(const char *pathname, struct stat *buf)
 	INIT_COEIO_FILE(eio);
 	eio.lstat.pathname = pathname;
 	eio.lstat.buf = buf;
-	eio_req *req = eio_custom(coio_do_stat, 0,
-				  coio_complete, &eio);
-	return coio_wait_done(req, &eio);
+	return coio_execute(&eio, COIO_PRIO_HIGH, coio_do_stat);
 }
 
 static void
-coio_do_fstat(eio_req *req)
+coio_do_fstat(struct coio_job *job)
 {
-	struct coio_file_task *eio = (struct coio_file_task *)req->data;
-	req->result = fstat(eio->fstat.fd, eio->fstat.buf);
-	req->errorno = errno;
+	struct coio_file_task *eio = coio_file_task(job);
+	COIO_FILE_RESULT(eio, fstat(eio->fstat.fd, eio->fstat.buf));
 }
 
 int
@@ -313,53 +389,81 @@ coio_fstat(int fd, struct stat *stat)
 	INIT_COEIO_FILE(eio);
 	eio.fstat.fd = fd;
 	eio.fstat.buf = stat;
+	return coio_execute(&eio, COIO_PRIO_HIGH, coio_do_fstat);
+}
 
-	eio_req *req = eio_custom(coio_do_fstat, 0,
-				  coio_complete, &eio);
-	return coio_wait_done(req, &eio);
+static void
+coio_do_rename(struct coio_job *job)
+{
+	struct coio_file_task *eio = coio_file_task(job);
+	COIO_FILE_RESULT(eio, rename(eio->rename.oldpath,
+				     eio->rename.newpath));
 }
 
 int
 coio_rename(const char *oldpath, const char *newpath)
 {
 	INIT_COEIO_FILE(eio);
-	eio_req *req = eio_rename(oldpath, newpath, 0,
-				  coio_complete, &eio);
-	return coio_wait_done(req, &eio);
+	eio.rename.oldpath = oldpath;
+	eio.rename.newpath = newpath;
+	return coio_execute(&eio, COIO_PRIO_HIGH, coio_do_rename);
+}
 
+static void
+coio_do_unlink(struct coio_job *job)
+{
+	struct coio_file_task *eio = coio_file_task(job);
+	COIO_FILE_RESULT(eio, unlink(eio->path.pathname));
 }
 
 int
 coio_unlink(const char *pathname)
 {
 	INIT_COEIO_FILE(eio);
-	eio_req *req = eio_unlink(pathname, 0, coio_complete, &eio);
-	return coio_wait_done(req, &eio);
+	eio.path.pathname = pathname;
+	return coio_execute(&eio, COIO_PRIO_HIGH, coio_do_unlink);
+}
+
+static void
+coio_do_ftruncate(struct coio_job *job)
+{
+	struct coio_file_task *eio = coio_file_task(job);
+	COIO_FILE_RESULT(eio, ftruncate(eio->truncate.fd,
+					eio->truncate.length));
 }
 
 int
 coio_ftruncate(int fd, off_t length)
 {
 	INIT_COEIO_FILE(eio);
-	eio_req *req = eio_ftruncate(fd, length, 0, coio_complete, &eio);
-	return coio_wait_done(req, &eio);
+	eio.truncate.fd = fd;
+	eio.truncate.length = length;
+	return coio_execute(&eio, COIO_PRIO_NORMAL, coio_do_ftruncate);
+}
+
+static void
+coio_do_truncate(struct coio_job *job)
+{
+	struct coio_file_task *eio = coio_file_task(job);
+	COIO_FILE_RESULT(eio, truncate(eio->truncate.pathname,
+				       eio->truncate.length));
 }
 
 int
 coio_truncate(const char *path, off_t length)
 {
 	INIT_COEIO_FILE(eio);
-	eio_req *req = eio_truncate(path, length, 0, coio_complete, &eio);
-	return coio_wait_done(req, &eio);
+	eio.truncate.pathname = path;
+	eio.truncate.length = length;
+	return coio_execute(&eio, COIO_PRIO_NORMAL, coio_do_truncate);
 }
 
 static void
-coio_do_glob(eio_req *req)
+coio_do_glob(struct coio_job *job)
 {
-	struct coio_file_task *eio = (struct coio_file_task *)req->data;
-	req->result = glob(eio->glob.pattern,
-			   eio->glob.flags, eio->glob.errfunc, eio->glob.pglob);
-	req->errorno = errno;
+	struct coio_file_task *eio = coio_file_task(job);
+	COIO_FILE_RESULT(eio, glob(eio->glob.pattern, eio->glob.flags,
+				   eio->glob.errfunc, eio->glob.pglob));
 }
 
 int
@@ -372,68 +476,115 @@ coio_glob(const char *pattern, int flags,
 	eio.glob.flags = flags;
 	eio.glob.errfunc = errfunc;
 	eio.glob.pglob = pglob;
-	eio_req *req =
-		eio_custom(coio_do_glob, 0, coio_complete, &eio);
-	return coio_wait_done(req, &eio);
+	return coio_execute(&eio, COIO_PRIO_NORMAL, coio_do_glob);
+}
+
+static void
+coio_do_chown(struct coio_job *job)
+{
+	struct coio_file_task *eio = coio_file_task(job);
+	COIO_FILE_RESULT(eio, chown(eio->chown.pathname, eio->chown.owner,
+				    eio->chown.group));
 }
 
 int
 coio_chown(const char *path, uid_t owner, gid_t group)
 {
 	INIT_COEIO_FILE(eio);
-	eio_req *req =
-		eio_chown(path, owner, group, 0, coio_complete, &eio);
-	return coio_wait_done(req, &eio);
+	eio.chown.pathname = path;
+	eio.chown.owner = owner;
+	eio.chown.group = group;
+	return coio_execute(&eio, COIO_PRIO_HIGH, coio_do_chown);
+}
+
+static void
+coio_do_chmod(struct coio_job *job)
+{
+	struct coio_file_task *eio = coio_file_task(job);
+	COIO_FILE_RESULT(eio, chmod(eio->path.pathname, eio->path.mode));
 }
 
 int
 coio_chmod(const char *path, mode_t mode)
 {
 	INIT_COEIO_FILE(eio);
-	eio_req *req = eio_chmod(path, mode, 0, coio_complete, &eio);
-	return coio_wait_done(req, &eio);
+	eio.path.pathname = path;
+	eio.path.mode = mode;
+	return coio_execute(&eio, COIO_PRIO_HIGH, coio_do_chmod);
+}
+
+static void
+coio_do_mkdir(struct coio_job *job)
+{
+	struct coio_file_task *eio = coio_file_task(job);
+	COIO_FILE_RESULT(eio, mkdir(eio->path.pathname, eio->path.mode));
 }
 
 int
 coio_mkdir(const char *pathname, mode_t mode)
 {
 	INIT_COEIO_FILE(eio);
-	eio_req *req = eio_mkdir(pathname, mode, 0, coio_complete, &eio);
-	return coio_wait_done(req, &eio);
+	eio.path.pathname = pathname;
+	eio.path.mode = mode;
+	return coio_execute(&eio, COIO_PRIO_HIGH, coio_do_mkdir);
+}
+
+static void
+coio_do_rmdir(struct coio_job *job)
+{
+	struct coio_file_task *eio = coio_file_task(job);
+	COIO_FILE_RESULT(eio, rmdir(eio->path.pathname));
 }
 
 int
 coio_rmdir(const char *pathname)
 {
 	INIT_COEIO_FILE(eio);
-	eio_req *req = eio_rmdir(pathname, 0, coio_complete, &eio);
-	return coio_wait_done(req, &eio);
+	eio.path.pathname = pathname;
+	return coio_execute(&eio, COIO_PRIO_HIGH, coio_do_rmdir);
+}
+
+static void
+coio_do_link(struct coio_job *job)
+{
+	struct coio_file_task *eio = coio_file_task(job);
+	COIO_FILE_RESULT(eio, link(eio->rename.oldpath,
+				   eio->rename.newpath));
 }
 
 int
 coio_link(const char *oldpath, const char *newpath)
 {
 	INIT_COEIO_FILE(eio);
-	eio_req *req = eio_link(oldpath, newpath, 0, coio_complete, &eio);
-	return coio_wait_done(req, &eio);
+	eio.rename.oldpath = oldpath;
+	eio.rename.newpath = newpath;
+	return coio_execute(&eio, COIO_PRIO_HIGH, coio_do_link);
+}
+
+static void
+coio_do_symlink(struct coio_job *job)
+{
+	struct coio_file_task *eio = coio_file_task(job);
+	COIO_FILE_RESULT(eio, symlink(eio->rename.oldpath,
+				      eio->rename.newpath));
 }
 
 int
 coio_symlink(const char *target, const char *linkpath)
 {
 	INIT_COEIO_FILE(eio);
-	eio_req *req =
-		eio_symlink(target, linkpath, 0, coio_complete, &eio);
-	return coio_wait_done(req, &eio);
+	eio.rename.oldpath = target;
+	eio.rename.newpath = linkpath;
+	return coio_execute(&eio, COIO_PRIO_HIGH, coio_do_symlink);
 }
 
 static void
-coio_do_readlink(eio_req *req)
+coio_do_readlink(struct coio_job *job)
 {
-	struct coio_file_task *eio = (struct coio_file_task *)req->data;
-	req->result = readlink(eio->readlink.pathname,
-			       eio->readlink.buf, eio->readlink.bufsize);
-	req->errorno = errno;
+	struct coio_file_task *eio = coio_file_task(job);
+	COIO_FILE_RESULT(eio, readlink(eio->readlink.pathname,
+				       eio->readlink.buf,
+				       eio->readlink.bufsize));
 }
 
 int
@@ -443,21 +594,19 @@ coio_readlink(const char *pathname, char *buf, size_t bufsize)
 	eio.readlink.pathname = pathname;
 	eio.readlink.buf = buf;
 	eio.readlink.bufsize = bufsize;
-	eio_req *req = eio_custom(coio_do_readlink, 0,
-				  coio_complete, &eio);
-	return coio_wait_done(req, &eio);
+	return coio_execute(&eio, COIO_PRIO_HIGH, coio_do_readlink);
 }
 
 static void
-coio_do_tempdir(eio_req *req)
+coio_do_tempdir(struct coio_job *job)
 {
-	struct coio_file_task *eio = (struct coio_file_task *)req->data;
+	struct coio_file_task *eio = coio_file_task(job);
 	char *res = mkdtemp(eio->tempdir.tpl);
-	req->errorno = errno;
+	eio->errorno = errno;
 	if (res == NULL) {
-		req->result = -1;
+		eio->result = -1;
 	} else {
-		req->result = 0;
+		eio->result = 0;
 	}
 }
 
@@ -477,39 +626,58 @@ coio_tempdir(char *path, size_t path_len)
 		return -1;
 	}
 	eio.tempdir.tpl = path;
-	eio_req *req =
-		eio_custom(coio_do_tempdir, 0, coio_complete, &eio);
-	return coio_wait_done(req, &eio);
+	return coio_execute(&eio, COIO_PRIO_HIGH, coio_do_tempdir);
+}
+
+static void
+coio_do_sync(struct coio_job *job)
+{
+	struct coio_file_task *eio = coio_file_task(job);
+	sync();
+	eio->result = 0;
 }
 
 int
 coio_sync()
 {
 	INIT_COEIO_FILE(eio);
-	eio_req *req = eio_sync(0, coio_complete, &eio);
-	return coio_wait_done(req, &eio);
+	return coio_execute(&eio, COIO_PRIO_LOW, coio_do_sync);
+}
+
+static void
+coio_do_fsync(struct coio_job *job)
+{
+	struct coio_file_task *eio = coio_file_task(job);
+	COIO_FILE_RESULT(eio, fsync(eio->close.fd));
 }
 
 int
 coio_fsync(int fd)
 {
 	INIT_COEIO_FILE(eio);
-	eio_req *req = eio_fsync(fd, 0, coio_complete, &eio);
-	return coio_wait_done(req, &eio);
+	eio.close.fd = fd;
+	return coio_execute(&eio, COIO_PRIO_LOW, coio_do_fsync);
+}
+
+static void
+coio_do_fdatasync(struct coio_job *job)
+{
+	struct coio_file_task *eio = coio_file_task(job);
+	COIO_FILE_RESULT(eio, fdatasync(eio->close.fd));
 }
 
 int
 coio_fdatasync(int fd)
 {
 	INIT_COEIO_FILE(eio);
-	eio_req *req = eio_fdatasync(fd, 0, coio_complete, &eio);
-	return coio_wait_done(req, &eio);
+	eio.close.fd = fd;
+	return coio_execute(&eio, COIO_PRIO_LOW, coio_do_fdatasync);
 }
 
 static void
-coio_do_readdir(eio_req *req)
+coio_do_readdir(struct coio_job *job)
 {
-	struct coio_file_task *eio = (struct coio_file_task *)req->data;
+	struct coio_file_task *eio = coio_file_task(job);
 	DIR *dirp = opendir(eio->readdir.pathname);
 	if (dirp == NULL)
 		goto error;
@@ -519,7 +687,7 @@ coio_do_readdir(eio_req *req)
 	char *buf = (char *) malloc(capacity);
 	if (buf == NULL)
 		goto mem_error;
-	req->result = 0;
+	eio->result = 0;
 	do {
 		entry = readdir(dirp);
 		if (entry == NULL ||
@@ -541,7 +709,7 @@ coio_do_readdir(eio_req *req)
 		memcpy(&buf[len], entry->d_name, namlen);
 		len += namlen;
 		buf[len++] = '\n';
-		req->result++;
+		eio->result++;
 	} while(entry != NULL);
 
 	if (len > 0)
@@ -557,8 +725,8 @@ mem_error:
 	free(buf);
 	closedir(dirp);
 error:
-	req->result = -1;
-	req->errorno = errno;
+	eio->result = -1;
+	eio->errorno = errno;
 }
 
 int
@@ -567,15 +735,14 @@ coio_readdir(const char *dir_path, char **buf)
 	INIT_COEIO_FILE(eio)
 	eio.readdir.bufp = buf;
 	eio.readdir.pathname = dir_path;
-	eio_req *req = eio_custom(coio_do_readdir, 0, coio_complete, &eio);
-	return coio_wait_done(req, &eio);
+	return coio_execute(&eio, COIO_PRIO_NORMAL, coio_do_readdir);
 }
 
 static void
-coio_do_copyfile(eio_req *req)
+coio_do_copyfile(struct coio_job *job)
 {
 	struct errinj *inj = errinj(ERRINJ_COIO_SENDFILE_CHUNK, ERRINJ_INT);
-	struct coio_file_task *eio = (struct coio_file_task *)req->data;
+	struct coio_file_task *eio = coio_file_task(job);
 	off_t pos, ret, left, chunk;
 	struct stat st;
 	if (stat(eio->copyfile.source, &st) < 0) {
@@ -610,7 +777,7 @@ coio_do_copyfile(eio_req *req)
 		left -= ret;
 	}
 
-	req->result = 0;
+	eio->result = 0;
 	close(source_fd);
 	close(dest_fd);
 	return;
@@ -620,8 +787,8 @@ error_copy:
 error_dest:
 	close(source_fd);
 error:
-	req->errorno = errno;
-	req->result = -1;
+	eio->errorno = errno;
+	eio->result = -1;
 	return;
 }
 
@@ -631,14 +798,27 @@ coio_copyfile(const char *source, const char *dest)
 	INIT_COEIO_FILE(eio)
 	eio.copyfile.source = source;
 	eio.copyfile.dest = dest;
-	eio_req *req = eio_custom(coio_do_copyfile, 0, coio_complete, &eio);
-	return coio_wait_done(req, &eio);
+	return coio_execute(&eio, COIO_PRIO_LOW, coio_do_copyfile);
+}
+
+static void
+coio_do_utime(struct coio_job *job)
+{
+	struct coio_file_task *eio = coio_file_task(job);
+	struct timeval tv[2];
+	tv[0].tv_sec = eio->utime.atime;
+	tv[0].tv_usec = (eio->utime.atime - tv[0].tv_sec) * 1e6;
+	tv[1].tv_sec = eio->utime.mtime;
+	tv[1].tv_usec = (eio->utime.mtime - tv[1].tv_sec) * 1e6;
+	COIO_FILE_RESULT(eio, utimes(eio->utime.pathname, tv));
 }
 
 int
 coio_utime(const char *pathname, double atime, double mtime)
 {
 	INIT_COEIO_FILE(eio);
-	eio_req *req = eio_utime(pathname, atime, mtime, 0, coio_complete, &eio);
-	return coio_wait_done(req, &eio);
+	eio.utime.pathname = pathname;
+	eio.utime.atime = atime;
+	eio.utime.mtime = mtime;
+	return coio_execute(&eio, COIO_PRIO_HIGH, coio_do_utime);
 }
@@ -0,0 +1,408 @@
+/*
+ * Copyright 2010-2020, Tarantool AUTHORS, please see AUTHORS file.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include "coio_pool.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <pmatomic.h>
+
+#include "trivia/util.h"
+#include "tt_pthread.h"
+#include "fiber.h"
+#include "clock.h"
+#include "say.h"
+
+const char *coio_prio_strs[] = { "high", "normal", "low" };
+
+struct coio_worker {
+	/** The thread of the worker. */
+	struct cord cord;
+	/** Index of the worker in the pool. */
+	int id;
+	/** Set while the thread is running, under the pool mutex. */
+	bool is_running;
+	/** Set by the thread before it exits, under the pool mutex. */
+	bool is_exited;
+	/** Protects the lanes. */
+	pthread_mutex_t mutex;
+	/** Queued jobs, a lane per priority. */
+	struct stailq lanes[coio_prio_MAX];
+	/** Number of jobs in each lane, read without the mutex. */
+	int64_t lane_size[coio_prio_MAX];
+	/** Statistics of the executed jobs, in nanoseconds. */
+	uint64_t done[coio_prio_MAX];
+	uint64_t wait_time[coio_prio_MAX];
+	uint64_t exec_time[coio_prio_MAX];
+};
+
+/** The thread which submits jobs and completes them. */
+struct coio_submitter {
+	struct ev_loop *loop;
+	/** Signalled by a worker when @a done becomes not empty. */
+	struct ev_async async;
+	/** Protects @a done. */
+	pthread_mutex_t mutex;
+	/** Executed jobs to complete. */
+	struct stailq done;
+	/** Index of the worker to queue the next job to. */
+	int next_worker;
+};
+
+static __thread struct coio_submitter coio_submitter;
+
+static struct coio_pool {
+	/** Protects the fields which are not atomic. */
+	pthread_mutex_t mutex;
+	/** Idle workers wait on it for jobs. */
+	pthread_cond_t cond;
+	/** Worker slots, allocated on first use and never freed. */
+	struct coio_worker *workers[COIO_POOL_SIZE_MAX];
+	/** Number of allocated slots, the range to steal from. */
+	int worker_count;
+	/** Configured number of workers. */
+	int size;
+	/**
+	 * Number of running workers. Is updated under the pool
+	 * mutex, but is read without it on submit.
+	 */
+	int running;
+	/** Total number of queued jobs. */
+	int64_t pending;
+	/** Number of workers waiting on @a cond. */
+	int idle;
+	/** Set on shutdown, the workers exit. */
+	bool is_shutdown;
+} pool = {
+	.mutex = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER,
+	.size = COIO_POOL_SIZE_DEFAULT,
+};
+
+/** Pop a job from the lane @a prio of @a worker. */
+static struct coio_job *
+coio_worker_pop(struct coio_worker *worker, enum coio_prio prio)
+{
+	if (pm_atomic_load_explicit(&worker->lane_size[prio],
+				    pm_memory_order_relaxed) == 0)
+		return NULL;
+	struct coio_job *job = NULL;
+	tt_pthread_mutex_lock(&worker->mutex);
+	if (!stailq_empty(&worker->lanes[prio])) {
+		job = stailq_shift_entry(&worker->lanes[prio],
+					 struct coio_job, in_queue);
+		pm_atomic_fetch_sub_explicit(&worker->lane_size[prio], 1,
+					     pm_memory_order_relaxed);
+	}
+	tt_pthread_mutex_unlock(&worker->mutex);
+	return job;
+}
+
+/**
+ * Take the job of the highest priority: from the own queue
+ * of the worker or, if its lane is empty, from the same lane
+ * of another worker.
+ */
+static struct coio_job *
+coio_worker_take(struct coio_worker *worker)
+{
+	if (pm_atomic_load_explicit(&pool.pending,
+				    pm_memory_order_seq_cst) == 0)
+		return NULL;
+	int count = pm_atomic_load_explicit(&pool.worker_count,
+					    pm_memory_order_acquire);
+	for (int prio = 0; prio < coio_prio_MAX; prio++) {
+		struct coio_job *job = coio_worker_pop(worker, prio);
+		for (int i = 1; job == NULL && i < count; i++) {
+			struct coio_worker *victim =
+				pool.workers[(worker->id + i) % count];
+			job = coio_worker_pop(victim, prio);
+		}
+		if (job != NULL) {
+			pm_atomic_fetch_sub_explicit(&pool.pending, 1,
+						     pm_memory_order_seq_cst);
+			return job;
+		}
+	}
+	return NULL;
+}
+
+/** Pass an executed job to the thread which has submitted it. */
+static void
+coio_submitter_push(struct coio_submitter *submitter, struct coio_job *job)
+{
+	tt_pthread_mutex_lock(&submitter->mutex);
+	bool was_empty = stailq_empty(&submitter->done);
+	stailq_add_tail_entry(&submitter->done, job, in_queue);
+	tt_pthread_mutex_unlock(&submitter->mutex);
+	if (was_empty)
+		ev_async_send(submitter->loop, &submitter->async);
+}
+
+static void
+coio_worker_run(struct coio_worker *worker, struct coio_job *job)
+{
+	enum coio_prio prio = job->prio;
+	uint64_t start = clock_monotonic64();
+	job->run(job);
+	uint64_t end = clock_monotonic64();
+	pm_atomic_fetch_add_explicit(&worker->done[prio], 1,
+				     pm_memory_order_relaxed);
+	pm_atomic_fetch_add_explicit(&worker->wait_time[prio],
+				     start - job->submit_time,
+				     pm_memory_order_relaxed);
+	pm_atomic_fetch_add_explicit(&worker->exec_time[prio],
+				     end - start, pm_memory_order_relaxed);
+	coio_submitter_push(job->submitter, job);
+}
+
+static bool
+coio_worker_is_empty(struct coio_worker *worker)
+{
+	for (int prio = 0; prio < coio_prio_MAX; prio++) {
+		if (pm_atomic_load_explicit(&worker->lane_size[prio],
+					    pm_memory_order_relaxed) != 0)
+			return false;
+	}
+	return true;
+}
+
+/**
+ * Wait for a job to be queued. Returns false if the worker
+ * must exit: on shutdown or if the pool has shrunk and the
+ * own queue of the worker is empty.
+ */
+static bool
+coio_worker_wait(struct coio_worker *worker)
+{
+	bool keep_running = true;
+	tt_pthread_mutex_lock(&pool.mutex);
+	if (pool.is_shutdown ||
+	    (worker->id >= pool.size && coio_worker_is_empty(worker))) {
+		worker->is_exited = true;
+		pm_atomic_fetch_sub(&pool.running, 1);
+		/* Do not swallow a wakeup meant for a job. */
+		if (pm_atomic_load(&pool.pending) > 0)
+			tt_pthread_cond_signal(&pool.cond);
+		keep_running = false;
+	} else {
+		/*
+		 * The submitter increments pending before it
+		 * checks idle, and the worker increments idle
+		 * before it checks pending, so either the job is
+		 * seen here or the worker is signalled.
+		 */
+		pm_atomic_fetch_add(&pool.idle, 1);
+		if (pm_atomic_load(&pool.pending) == 0)
+			tt_pthread_cond_wait(&pool.cond, &pool.mutex);
+		pm_atomic_fetch_sub(&pool.idle, 1);
+	}
+	tt_pthread_mutex_unlock(&pool.mutex);
+	return keep_running;
+}
+
+static void *
+coio_worker_f(void *arg)
+{
+	struct coio_worker *worker = (struct coio_worker *) arg;
+	do {
+		struct coio_job *job;
+		while ((job = coio_worker_take(worker)) != NULL)
+			coio_worker_run(worker, job);
+	} while (coio_worker_wait(worker));
+	return NULL;
+}
+
+/**
+ * Start the missing workers, join the exited ones.
+ * Is called under the pool mutex.
+ */
+static void
+coio_pool_start_workers(void)
+{
+	for (int i = 0; i < pool.size; i++) {
+		struct coio_worker *worker = pool.workers[i];
+		if (worker == NULL) {
+			worker = (struct coio_worker *)
+				calloc(1, sizeof(*worker));
+			if (worker == NULL) {
+				say_error("failed to allocate a coio worker");
+				break;
+			}
+			worker->id = i;
+			tt_pthread_mutex_init(&worker->mutex, NULL);
+			for (int prio = 0; prio < coio_prio_MAX; prio++)
+				stailq_create(&worker->lanes[prio]);
+			pool.workers[i] = worker;
+			pm_atomic_store_explicit(&pool.worker_count, i + 1,
+						 pm_memory_order_release);
+		}
+		if (worker->is_running && worker->is_exited) {
+			/* The thread has exited or is about to. */
+			if (cord_join(&worker->cord) != 0)
+				diag_log();
+			worker->is_running = false;
+		}
+		if (worker->is_running)
+			continue;
+		worker->is_exited = false;
+		if (cord_start(&worker->cord, "coio", coio_worker_f,
+			       worker) != 0) {
+			diag_log();
+			break;
+		}
+		worker->is_running = true;
+		pm_atomic_fetch_add(&pool.running, 1);
+	}
+}
+
+void
+coio_pool_submit(struct coio_job *job)
+{
+	struct coio_submitter *submitter = &coio_submitter;
+	assert(submitter->loop != NULL);
+	if (pm_atomic_load(&pool.running) < pm_atomic_load(&pool.size)) {
+		tt_pthread_mutex_lock(&pool.mutex);
+		if (!pool.is_shutdown)
+			coio_pool_start_workers();
+		tt_pthread_mutex_unlock(&pool.mutex);
+	}
+	job->submitter = submitter;
+	job->submit_time = clock_monotonic64();
+	if (pm_atomic_load(&pool.running) == 0) {
+		/*
+		 * No worker could be allocated or started, e.g.
+		 * the thread limit is hit. Run the job here rather
+		 * than leave it queued forever, and complete it
+		 * as usual, from the event loop.
+		 */
+		say_warn_ratelimited("no coio workers are running, "
+				     "the job is run in the caller thread");
+		job->run(job);
+		coio_submitter_push(submitter, job);
+		return;
+	}
+
+	int size = MIN(pm_atomic_load(&pool.size),
+		       pm_atomic_load_explicit(&pool.worker_count,
+					       pm_memory_order_acquire));
+	if (submitter->next_worker >= size)
+		submitter->next_worker = 0;
+	struct coio_worker *worker = pool.workers[submitter->next_worker++];
+	tt_pthread_mutex_lock(&worker->mutex);
+	stailq_add_tail_entry(&worker->lanes[job->prio], job, in_queue);
+	pm_atomic_fetch_add_explicit(&worker->lane_size[job->prio], 1,
+				     pm_memory_order_relaxed);
+	tt_pthread_mutex_unlock(&worker->mutex);
+
+	pm_atomic_fetch_add(&pool.pending, 1);
+	if (pm_atomic_load(&pool.idle) > 0) {
+		tt_pthread_mutex_lock(&pool.mutex);
+		tt_pthread_cond_signal(&pool.cond);
+		tt_pthread_mutex_unlock(&pool.mutex);
+	}
+}
+
+static void
+coio_submitter_cb(struct ev_loop *loop, struct ev_async *watcher, int events)
+{
+	(void) loop;
+	(void) events;
+	struct coio_submitter *submitter =
+		(struct coio_submitter *) watcher->data;
+	struct stailq done;
+	stailq_create(&done);
+	tt_pthread_mutex_lock(&submitter->mutex);
+	stailq_concat(&done, &submitter->done);
+	tt_pthread_mutex_unlock(&submitter->mutex);
+	struct coio_job *job, *tmp;
+	stailq_foreach_entry_safe(job, tmp, &done, in_queue)
+		job->complete(job);
+}
+
+void
+coio_pool_enable(void)
+{
+	struct coio_submitter *submitter = &coio_submitter;
+	submitter->loop = loop();
+	tt_pthread_mutex_init(&submitter->mutex, NULL);
+	stailq_create(&submitter->done);
+	submitter->next_worker = 0;
+	ev_async_init(&submitter->async, coio_submitter_cb);
+	submitter->async.data = submitter;
+	ev_async_start(submitter->loop, &submitter->async);
+}
+
+void
+coio_pool_set_size(int size)
+{
+	size = MAX(size, 1);
+	size = MIN(size, (int) COIO_POOL_SIZE_MAX);
+	tt_pthread_mutex_lock(&pool.mutex);
+	pm_atomic_store(&pool.size, size);
+	/* Let the extra workers exit. */
+	tt_pthread_cond_broadcast(&pool.cond);
+	tt_pthread_mutex_unlock(&pool.mutex);
+}
+
+void
+coio_pool_shutdown(void)
+{
+	tt_pthread_mutex_lock(&pool.mutex);
+	pool.is_shutdown = true;
+	tt_pthread_cond_broadcast(&pool.cond);
+	tt_pthread_mutex_unlock(&pool.mutex);
+}
+
+void
+coio_pool_stat(struct coio_pool_stat *stat)
+{
+	memset(stat, 0, sizeof(*stat));
+	stat->size = pm_atomic_load(&pool.size);
+	int count = pm_atomic_load_explicit(&pool.worker_count,
+					    pm_memory_order_acquire);
+	for (int i = 0; i < count; i++) {
+		struct coio_worker *worker = pool.workers[i];
+		for (int prio = 0; prio < coio_prio_MAX; prio++) {
+			stat->lanes[prio].queued += pm_atomic_load_explicit(
+				&worker->lane_size[prio],
+				pm_memory_order_relaxed);
+			stat->lanes[prio].done += pm_atomic_load_explicit(
+				&worker->done[prio], pm_memory_order_relaxed);
+			stat->lanes[prio].wait_time += pm_atomic_load_explicit(
+				&worker->wait_time[prio],
+				pm_memory_order_relaxed) / 1e9;
+			stat->lanes[prio].exec_time += pm_atomic_load_explicit(
+				&worker->exec_time[prio],
+				pm_memory_order_relaxed) / 1e9;
+		}
+	}
+}
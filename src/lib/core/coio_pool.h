@@ -0,0 +1,154 @@
+#ifndef TARANTOOL_LIB_CORE_COIO_POOL_H_INCLUDED
+#define TARANTOOL_LIB_CORE_COIO_POOL_H_INCLUDED
+/*
+ * Copyright 2010-2020, Tarantool AUTHORS, please see AUTHORS file.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include <stdint.h>
+#include "salad/stailq.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif /* defined(__cplusplus) */
+
+/**
+ * A work-stealing pool of threads for blocking calls.
+ *
+ * Every worker has its own queue with a lane per priority.
+ * A submitter spreads its jobs over the queues round robin, and
+ * a worker which runs out of jobs steals them from the others,
+ * so a long job delays only the jobs nobody is free to steal.
+ * A worker takes the jobs of a higher priority first, its own
+ * or stolen. Thus bulk file I/O can not delay name resolution
+ * or metadata operations queued behind it.
+ *
+ * A job is completed in the thread which has submitted it:
+ * every such thread has its own queue of completed jobs, which
+ * is processed by its event loop, see coio_pool_enable().
+ */
+
+enum coio_prio {
+	/** Short latency sensitive calls: metadata, DNS. */
+	COIO_PRIO_HIGH,
+	/** Calls of unknown cost. */
+	COIO_PRIO_NORMAL,
+	/** Bulk data transfer and syncs. */
+	COIO_PRIO_LOW,
+	coio_prio_MAX,
+};
+
+extern const char *coio_prio_strs[];
+
+enum {
+	/** Maximal number of worker threads. */
+	COIO_POOL_SIZE_MAX = 1000,
+	/** Default number of worker threads. */
+	COIO_POOL_SIZE_DEFAULT = 4,
+};
+
+struct coio_job;
+struct coio_submitter;
+
+typedef void (*coio_job_f)(struct coio_job *job);
+
+struct coio_job {
+	/** Called in a worker thread. */
+	coio_job_f run;
+	/** Called in the submitter thread when @a run is done. */
+	coio_job_f complete;
+	enum coio_prio prio;
+	/** The thread to complete the job in. */
+	struct coio_submitter *submitter;
+	/** Time of submission, for statistics. */
+	uint64_t submit_time;
+	/** Link in a worker queue or in a completion queue. */
+	struct stailq_entry in_queue;
+};
+
+static inline void
+coio_job_create(struct coio_job *job, enum coio_prio prio,
+		coio_job_f run, coio_job_f complete)
+{
+	job->run = run;
+	job->complete = complete;
+	job->prio = prio;
+	job->submitter = NULL;
+}
+
+/**
+ * Allow the current thread to submit jobs. Must be called
+ * once per thread, the thread must have an event loop.
+ */
+void
+coio_pool_enable(void);
+
+/**
+ * Queue a job. The workers are started on the first call, so
+ * that the pool does not prevent the process from forking.
+ * If no worker can be started, the job is run by the caller,
+ * and is still completed from the event loop.
+ */
+void
+coio_pool_submit(struct coio_job *job);
+
+/**
+ * Set the number of worker threads, clamped to
+ * [1, COIO_POOL_SIZE_MAX]. Extra threads exit when their
+ * queues are empty.
+ */
+void
+coio_pool_set_size(int size);
+
+/** Stop the workers when they finish the current jobs. */
+void
+coio_pool_shutdown(void);
+
+struct coio_pool_stat {
+	/** Number of worker threads. */
+	int size;
+	struct {
+		/** Number of jobs waiting for a worker. */
+		int64_t queued;
+		/** Number of executed jobs. */
+		uint64_t done;
+		/** Total time the jobs waited for a worker. */
+		double wait_time;
+		/** Total time of execution of the jobs. */
+		double exec_time;
+	} lanes[coio_prio_MAX];
+};
+
+void
+coio_pool_stat(struct coio_pool_stat *stat);
+
+#if defined(__cplusplus)
+} /* extern "C" */
+#endif /* defined(__cplusplus) */
+
+#endif /* TARANTOOL_LIB_CORE_COIO_POOL_H_INCLUDED */
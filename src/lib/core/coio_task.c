@@ -39,165 +39,54 @@
 #include <sys/socket.h>
 
 #include "fiber.h"
-#include "third_party/tarantool_ev.h"
 
 /*
- * Asynchronous IO Tasks (libeio wrapper).
- * ---------------------------------------
+ * Asynchronous IO Tasks (coio_pool wrapper).
+ * ------------------------------------------
  *
- * libeio request processing is designed in edge-trigger
- * manner, when libeio is ready to process some requests it
- * calls coio_poller callback.
- *
- * Due to libeio design, want_poll callback is called while
- * locks are being held, so it's not possible to call any libeio
- * function inside this callback. Thus coio_want_poll raises an
- * async event which will be dealt with normally as part of the
- * main Tarantool event loop.
- *
- * The async event handler, in turn, performs eio_poll(), which
- * will run on_complete callback for all ready eio tasks.
- * In case if some of the requests are not complete by the time
- * eio_poll() has been called, coio_idle watcher is started, which
- * would periodically invoke eio_poll() until all requests are
- * complete.
- *
- * See for details:
- * http://pod.tst.eu/http://cvs.schmorp.de/libeio/eio.pod
-*/
-
-struct coio_manager {
-	ev_loop *loop;
-	ev_idle coio_idle;
-	ev_async coio_async;
-};
-
-static __thread struct coio_manager coio_manager;
-
-static void
-coio_idle_cb(ev_loop *loop, struct ev_idle *w, int events)
-{
-	(void) events;
-	if (eio_poll() != -1) {
-		/* nothing to do */
-		ev_idle_stop(loop, w);
-	}
-}
-
-static void
-coio_async_cb(ev_loop *loop, MAYBE_UNUSED struct ev_async *w,
-	       MAYBE_UNUSED int events)
-{
-	if (eio_poll() == -1) {
-		/* not all tasks are complete. */
-		ev_idle_start(loop, &coio_manager.coio_idle);
-	}
-}
-
-static void
-coio_want_poll_cb(void *ptr)
-{
-	struct coio_manager *manager = ptr;
-	ev_async_send(manager->loop, &manager->coio_async);
-}
-
-static void
-coio_done_poll_cb(void *ptr)
-{
-	(void)ptr;
-}
-
-static int
-coio_on_start(void *data)
-{
-	(void) data;
-	struct cord *cord = (struct cord *)calloc(sizeof(struct cord), 1);
-	if (!cord)
-		return -1;
-	cord_create(cord, "coio");
-	return 0;
-}
-
-static int
-coio_on_stop(void *data)
-{
-	(void) data;
-	cord_destroy(cord());
-	return 0;
-}
-
-void
-coio_init(void)
-{
-	eio_set_thread_on_start(coio_on_start, NULL);
-	eio_set_thread_on_stop(coio_on_stop, NULL);
-}
-
-/**
- * Init coio subsystem.
- *
- * Create idle and async watchers, init eio.
+ * A task is executed by a thread of the coio pool and is
+ * completed by the event loop of the thread which has
+ * submitted it: the waiting fiber is woken up or, if the task
+ * has been detached, the timeout callback frees the task.
  */
+
 void
 coio_enable(void)
 {
-	eio_init(&coio_manager, coio_want_poll_cb, coio_done_poll_cb);
-	coio_manager.loop = loop();
-
-	ev_idle_init(&coio_manager.coio_idle, coio_idle_cb);
-	ev_async_init(&coio_manager.coio_async, coio_async_cb);
-
-	ev_async_start(loop(), &coio_manager.coio_async);
+	coio_pool_enable();
 }
 
 void
 coio_shutdown(void)
 {
-	eio_set_max_parallel(0);
+	coio_pool_shutdown();
 }
 
 static void
-coio_on_feed(eio_req *req)
+coio_on_run(struct coio_job *job)
 {
-	struct coio_task *task = (struct coio_task *) req;
-	req->result = task->task_cb(task);
-	if (req->result)
+	struct coio_task *task = (struct coio_task *) job;
+	task->result = task->task_cb(task);
+	task->errorno = errno;
+	if (task->result)
 		diag_move(diag_get(), &task->diag);
 }
 
 /**
- * A callback invoked by eio_poll when associated
- * eio_request is complete.
+ * Called in the submitter thread when the task is executed.
  */
-static int
-coio_on_finish(eio_req *req)
+static void
+coio_on_complete(struct coio_job *job)
 {
-	struct coio_task *task = (struct coio_task *) req;
+	struct coio_task *task = (struct coio_task *) job;
 	if (task->fiber == NULL) {
-		/*
-		 * Timed out. Resources will be freed by coio_on_destroy.
-		 * NOTE: it is not safe to run timeout_cb handler here.
-		 */
-		return 0;
+		/* Detached or timed out, free the resources. */
+		if (task->timeout_cb != NULL)
+			task->timeout_cb(task);
+		return;
 	}
-
 	task->complete = 1;
-	/* Reset on_timeout hook - resources will be freed by coio_task user */
-	task->base.destroy = NULL;
 	fiber_wakeup(task->fiber);
-	return 0;
-}
-
-/*
- * Free resources on timeout.
- */
-static void
-coio_on_destroy(eio_req *req)
-{
-	struct coio_task *task = (struct coio_task *) req;
-	assert(task->fiber == NULL && task->complete == 0);
-	if (task->timeout_cb != NULL)
-		task->timeout_cb(task);
 }
 
 void
@@ -206,17 +95,13 @@ coio_task_create(struct coio_task *task,
 {
 	assert(func != NULL && on_timeout != NULL);
 
-	/* from eio.c: REQ() definition */
-	memset(&task->base, 0, sizeof(task->base));
-	task->base.type = EIO_CUSTOM;
-	task->base.feed = coio_on_feed;
-	task->base.finish = coio_on_finish;
-	task->base.destroy = coio_on_destroy;
-	/* task->base.pri = 0; */
-
+	coio_job_create(&task->base, COIO_PRIO_NORMAL, coio_on_run,
+			coio_on_complete);
 	task->fiber = fiber();
 	task->task_cb = func;
 	task->timeout_cb = on_timeout;
+	task->result = 0;
+	task->errorno = 0;
 	task->complete = 0;
 	diag_create(&task->diag);
 }
@@ -230,19 +115,19 @@ coio_task_destroy(struct coio_task *task)
 void
 coio_task_post(struct coio_task *task)
 {
-	assert(task->base.type == EIO_CUSTOM);
+	assert(task->base.run == coio_on_run);
 	assert(task->fiber == fiber());
-	eio_submit(&task->base);
+	coio_pool_submit(&task->base);
 	task->fiber = NULL;
 }
 
 int
 coio_task_execute(struct coio_task *task, double timeout)
 {
-	assert(task->base.type == EIO_CUSTOM);
+	assert(task->base.run == coio_on_run);
 	assert(task->fiber == fiber());
 
-	eio_submit(&task->base);
+	coio_pool_submit(&task->base);
 	fiber_yield_timeout(timeout);
 	if (!task->complete) {
 		/* timed out or cancelled. */
@@ -257,42 +142,46 @@ coio_task_execute(struct coio_task *task, double timeout)
 }
 
 static void
-coio_on_call(eio_req *req)
+coio_on_call(struct coio_job *job)
 {
-	struct coio_task *task = (struct coio_task *) req;
-	req->result = task->call_cb(task->ap);
-	if (req->result)
+	struct coio_task *task = (struct coio_task *) job;
+	task->result = task->call_cb(task->ap);
+	task->errorno = errno;
+	if (task->result)
 		diag_move(diag_get(), &task->diag);
 }
 
+static void
+coio_on_call_complete(struct coio_job *job)
+{
+	struct coio_task *task = (struct coio_task *) job;
+	task->complete = 1;
+	fiber_wakeup(task->fiber);
+}
+
 ssize_t
 coio_call(ssize_t (*func)(va_list ap), ...)
 {
 	struct coio_task *task = (struct coio_task *) calloc(1, sizeof(*task));
 	if (task == NULL)
 		return -1; /* errno = ENOMEM */
-	/* from eio.c: REQ() definition */
-	task->base.type = EIO_CUSTOM;
-	task->base.feed = coio_on_call;
-	task->base.finish = coio_on_finish;
-	/* task->base.destroy = NULL; */
-	/* task->base.pri = 0; */
-
+	coio_job_create(&task->base, COIO_PRIO_NORMAL, coio_on_call,
+			coio_on_call_complete);
 	task->fiber = fiber();
 	task->call_cb = func;
 	task->complete = 0;
 	diag_create(&task->diag);
 
 	va_start(task->ap, func);
-	eio_submit(&task->base);
+	coio_pool_submit(&task->base);
 
 	do {
 		fiber_yield();
 	} while (task->complete == 0);
 	va_end(task->ap);
 
-	ssize_t result = task->base.result;
-	int save_errno = errno;
+	ssize_t result = task->result;
+	int save_errno = task->errorno;
 	if (result)
 		diag_move(&task->diag, diag_get());
 	free(task);
@@ -315,7 +204,7 @@ struct async_getaddrinfo_task {
 
 /*
  * Resolver function, run in separate thread by
- * coio (libeio).
+ * the coio pool.
 */
 static int
 getaddrinfo_cb(struct coio_task *ptr)
@@ -371,6 +260,8 @@ coio_getaddrinfo(const char *host, const char *port,
 	}
 
 	coio_task_create(&task->base, getaddrinfo_cb, getaddrinfo_free_cb);
+	/* Do not let bulk file I/O delay name resolution. */
+	task->base.base.prio = COIO_PRIO_HIGH;
 
 	/*
 	 * getaddrinfo() on osx upto osx 10.8 crashes when AI_NUMERICSERV is
@@ -36,7 +36,7 @@
 #include <sys/types.h> /* ssize_t */
 #include <stdarg.h>
 
-#include "third_party/tarantool_eio.h"
+#include "coio_pool.h"
 #include "diag.h"
 
 #if defined(__cplusplus)
@@ -44,25 +44,24 @@ extern "C" {
 #endif /* defined(__cplusplus) */
 
 /**
- * Asynchronous IO Tasks (libeio wrapper)
+ * Asynchronous IO Tasks (coio_pool wrapper)
  *
  * Yield the current fiber until a created task is complete.
  */
 
-void coio_init(void);
 void coio_enable(void);
 void coio_shutdown(void);
 
 struct coio_task;
 
 typedef ssize_t (*coio_call_cb)(va_list ap);
-typedef int (*coio_task_cb)(struct coio_task *task); /* like eio_req */
+typedef int (*coio_task_cb)(struct coio_task *task);
 
 /**
  * A single task context.
  */
 struct coio_task {
-	struct eio_req base; /* eio_task - must be first */
+	struct coio_job base; /* must be first */
 	/**
 	 * The calling fiber. When set to NULL, the task is
 	 * detached - its resources are freed eventually, and such
@@ -80,7 +79,11 @@ struct coio_task {
 			va_list ap;
 		};
 	};
-	/** Callback results. */
+	/** Return value of the callback. */
+	ssize_t result;
+	/** errno set by the callback. */
+	int errorno;
+	/** Set when the task is executed. */
 	int complete;
 	/** Task diag **/
 	struct diag diag;
@@ -90,7 +93,7 @@ struct coio_task {
  * Create coio_task.
  *
  * @param task coio task
- * @param func a callback to execute in EIO thread pool.
+ * @param func a callback to execute in the coio thread pool.
  * @param on_timeout a callback to execute on timeout
  */
 void
@@ -111,7 +114,7 @@ coio_task_destroy(struct coio_task *task);
  * @param task coio task.
  * @param timeout timeout in seconds.
  * @retval 0  the task completed successfully. Check the result
- *            code in task->base.result and free the task.
+ *            code in task->result and free the task.
  * @retval -1 timeout or the waiting fiber was cancelled (check diag);
  *            the caller should not free the task, it
  *            will be freed when it's finished in the timeout
@@ -130,7 +133,7 @@ coio_task_post(struct coio_task *task);
 /** \cond public */
 
 /**
- * Create new eio task with specified function and
+ * Create new coio task with specified function and
  * arguments. Yield and wait until the task is complete.
  *
  * This function doesn't throw exceptions to avoid double error
@@ -256,6 +256,14 @@ evio_service_bind_addr(struct evio_service *service)
 	if (evio_setsockopt_server(fd, service->addr.sa_family,
 				   SOCK_STREAM) != 0)
 		goto error;
+#ifdef SO_REUSEPORT
+	if (service->reuse_port && service->addr.sa_family != AF_UNIX) {
+		int on = 1;
+		if (sio_setsockopt(fd, SOL_SOCKET, SO_REUSEPORT,
+				   &on, sizeof(on)) != 0)
+			goto error;
+	}
+#endif
 
 	if (sio_bind(fd, &service->addr, service->addr_len)) {
 		if (errno != EADDRINUSE)
@@ -401,6 +409,32 @@ evio_service_bind(struct evio_service *service, const char *uri)
 	return -1;
 }
 
+int
+evio_service_attach(struct evio_service *service,
+		    const struct evio_service *src)
+{
+	assert(!ev_is_active(&service->ev));
+	assert(src->ev.fd >= 0);
+	memcpy(service->host, src->host, sizeof(service->host));
+	memcpy(service->serv, src->serv, sizeof(service->serv));
+	service->addrstorage = src->addrstorage;
+	service->addr_len = src->addr_len;
+#ifdef SO_REUSEPORT
+	if (service->reuse_port && src->reuse_port &&
+	    service->addr.sa_family != AF_UNIX)
+		return evio_service_bind_addr(service);
+#endif
+	int fd = dup(src->ev.fd);
+	if (fd < 0) {
+		diag_set(SocketError, sio_socketname(src->ev.fd), "dup");
+		return -1;
+	}
+	say_info("%s: attached to %s", evio_service_name(service),
+		 sio_strfaddr(&service->addr, service->addr_len));
+	ev_io_set(&service->ev, fd, EV_READ);
+	return 0;
+}
+
 /** It's safe to stop a service which is not started yet. */
 void
 evio_service_stop(struct evio_service *service)
@@ -86,6 +86,11 @@ struct evio_service
 		struct sockaddr_storage addrstorage;
 	};
 	socklen_t addr_len;
+	/**
+	 * Let other services bind to the same TCP address, see
+	 * evio_service_attach(). Must be set before binding.
+	 */
+	bool reuse_port;
 
 	/**
 	 * A callback invoked on every accepted client socket.
@@ -109,6 +114,17 @@ evio_service_init(ev_loop *loop, struct evio_service *service, const char *name,
 int
 evio_service_bind(struct evio_service *service, const char *uri);
 
+/**
+ * Bind service to the address another, already bound service
+ * @a src is bound to. Both services accept connections then,
+ * each in its own event loop. For TCP sockets SO_REUSEPORT is
+ * used if available, so the kernel balances connections between
+ * services. Otherwise the listening socket is shared.
+ */
+int
+evio_service_attach(struct evio_service *service,
+		    const struct evio_service *src);
+
 /**
  * Listen on bounded socket
  *
@@ -42,6 +42,7 @@
 #include "memory.h"
 #include "trigger.h"
 #include "errinj.h"
+#include "affinity.h"
 
 #if ENABLE_FIBER_TOP
 #include <x86intrin.h> /* __rdtscp() */
@@ -665,15 +666,11 @@ struct fiber_watcher_data {
 };
 
 static void
-fiber_schedule_timeout(ev_loop *loop,
-		       ev_timer *watcher, int revents)
+fiber_schedule_timeout(struct wheel_timer *timer)
 {
-	(void) loop;
-	(void) revents;
-
 	assert(fiber() == &cord()->sched);
 	struct fiber_watcher_data *state =
-			(struct fiber_watcher_data *) watcher->data;
+			(struct fiber_watcher_data *) timer->data;
 	state->timed_out = true;
 	fiber_wakeup(state->f);
 }
@@ -685,13 +682,12 @@ fiber_schedule_timeout(ev_loop *loop,
 bool
 fiber_yield_timeout(ev_tstamp delay)
 {
-	struct ev_timer timer;
-	ev_timer_init(&timer, fiber_schedule_timeout, delay, 0);
+	struct wheel_timer timer;
 	struct fiber_watcher_data state = { fiber(), false };
-	timer.data = &state;
-	ev_timer_start(loop(), &timer);
+	wheel_timer_create(&timer, fiber_schedule_timeout, &state);
+	timer_wheel_start(&cord()->timer_wheel, &timer, delay);
 	fiber_yield();
-	ev_timer_stop(loop(), &timer);
+	timer_wheel_stop(&cord()->timer_wheel, &timer);
 	return state.timed_out;
 }
 
@@ -1372,6 +1368,7 @@ cord_create(struct cord *cord, const char *name)
 	rlist_create(&cord->alive);
 	rlist_create(&cord->ready);
 	rlist_create(&cord->dead);
+	rlist_create(&cord->in_affinity);
 	cord->fiber_registry = mh_i32ptr_new();
 
 	/* sched fiber is not present in alive/ready/dead list. */
@@ -1393,6 +1390,9 @@ cord_create(struct cord *cord, const char *name)
 
 	ev_idle_init(&cord->idle_event, fiber_schedule_idle);
 
+	timer_wheel_create(&cord->timer_wheel, cord->loop);
+	busy_poll_create(&cord->busy_poll, cord->loop);
+
 #if ENABLE_FIBER_TOP
 	/* fiber.top() currently works only for the main thread. */
 	if (cord_is_main()) {
@@ -1419,6 +1419,9 @@ void
 cord_destroy(struct cord *cord)
 {
 	slab_cache_set_thread(&cord->slabc);
+	timer_wheel_destroy(&cord->timer_wheel);
+	busy_poll_destroy(&cord->busy_poll);
+	affinity_cord_remove(cord);
 	if (cord->loop)
 		ev_loop_destroy(cord->loop);
 	/* Only clean up if initialized. */
@@ -1461,6 +1464,11 @@ void *cord_thread_func(void *p)
 	tt_pthread_cond_signal(&ct_arg->start_cond);
 	tt_pthread_mutex_unlock(&ct_arg->start_mutex);
 	void *res = f(arg);
+	/*
+	 * The cord is destroyed after the thread is joined, so
+	 * unregister it now to not bind a finished thread.
+	 */
+	affinity_cord_remove(cord());
 	/*
 	 * cord()->on_exit initially holds NULL. This field is
 	 * change-once.
@@ -1695,6 +1703,7 @@ void
 cord_set_name(const char *name)
 {
 	snprintf(cord()->name, sizeof(cord()->name), "%s", name);
+	affinity_cord_update(cord());
 	/* Main thread's name will replace process title in ps, skip it */
 	if (cord_is_main())
 		return;
@@ -42,6 +42,8 @@
 #include "small/region.h"
 #include "small/rlist.h"
 #include "salad/stailq.h"
+#include "timer_wheel.h"
+#include "busy_poll.h"
 
 #include <third_party/coro/coro.h>
 
@@ -504,10 +506,12 @@ struct fiber {
 			int ref;
 		} lua;
 		/**
-		 * Iproto sync.
+		 * Iproto sync and time the current request
+		 * has spent waiting for WAL, in seconds.
 		 */
 		struct {
 			uint64_t sync;
+			double wal_time;
 		} net;
 	} storage;
 	/** An object to wait for incoming message or a reader. */
@@ -571,6 +575,12 @@ struct cord {
 	 * is no 1 ms delay in case of zero sleep timeout.
 	 */
 	ev_idle idle_event;
+	/** Timeouts of the fibers of this cord. */
+	struct timer_wheel timer_wheel;
+	/** Busy polling of the event loop, disabled by default. */
+	struct busy_poll busy_poll;
+	/** Link in the list of cords of the same class, affinity.h. */
+	struct rlist in_affinity;
 #if ENABLE_FIBER_TOP
 	/** An event triggered on every event loop iteration start. */
 	ev_check check_event;
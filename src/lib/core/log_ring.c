@@ -0,0 +1,168 @@
+/*
+ * Copyright 2010-2020, Tarantool AUTHORS, please see AUTHORS file.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include "log_ring.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pmatomic.h>
+
+#include "trivia/util.h"
+#include "diag.h"
+
+/** Header of a record. */
+struct log_ring_rec {
+	/**
+	 * Size of the record with the header and the alignment,
+	 * zero until the record is published.
+	 */
+	uint32_t size;
+	/** Length of the message, LOG_RING_PAD for padding. */
+	uint32_t len;
+};
+
+enum {
+	LOG_RING_PAD = UINT32_MAX,
+	LOG_RING_ALIGN = sizeof(struct log_ring_rec),
+};
+
+int
+log_ring_create(struct log_ring *ring, size_t size)
+{
+	size_t ring_size = 4096;
+	while (ring_size < size)
+		ring_size *= 2;
+	ring->data = calloc(1, ring_size);
+	if (ring->data == NULL) {
+		diag_set(OutOfMemory, ring_size, "calloc", "log ring");
+		return -1;
+	}
+	ring->size = ring_size;
+	ring->head = 0;
+	ring->tail = 0;
+	return 0;
+}
+
+void
+log_ring_destroy(struct log_ring *ring)
+{
+	free(ring->data);
+}
+
+size_t
+log_ring_max_len(struct log_ring *ring)
+{
+	/*
+	 * A record of up to half of the ring always fits in an
+	 * empty ring, even with the padding before it.
+	 */
+	return ring->size / 2 - sizeof(struct log_ring_rec);
+}
+
+static inline struct log_ring_rec *
+log_ring_rec(struct log_ring *ring, uint64_t pos)
+{
+	return (struct log_ring_rec *)(ring->data + (pos & (ring->size - 1)));
+}
+
+int
+log_ring_put(struct log_ring *ring, const char *msg, size_t len)
+{
+	assert(len <= log_ring_max_len(ring));
+	uint32_t size = (sizeof(struct log_ring_rec) + len +
+			 LOG_RING_ALIGN - 1) & ~(LOG_RING_ALIGN - 1);
+	uint64_t head = pm_atomic_load_explicit(&ring->head,
+						pm_memory_order_relaxed);
+	uint64_t pad, total;
+	do {
+		uint64_t tail = pm_atomic_load_explicit(&ring->tail,
+						pm_memory_order_acquire);
+		uint64_t to_end = ring->size - (head & (ring->size - 1));
+		pad = to_end < size ? to_end : 0;
+		total = pad + size;
+		if (head + total - tail > ring->size)
+			return -1;
+	} while (!pm_atomic_compare_exchange_weak_explicit(&ring->head,
+				&head, head + total, pm_memory_order_relaxed,
+				pm_memory_order_relaxed));
+	if (pad > 0) {
+		struct log_ring_rec *rec = log_ring_rec(ring, head);
+		rec->len = LOG_RING_PAD;
+		pm_atomic_store_explicit(&rec->size, pad,
+					 pm_memory_order_release);
+		head += pad;
+	}
+	struct log_ring_rec *rec = log_ring_rec(ring, head);
+	memcpy(rec + 1, msg, len);
+	rec->len = len;
+	/*
+	 * Sequential consistency orders the publication before
+	 * the check whether the consumer is sleeping, made by
+	 * the caller.
+	 */
+	pm_atomic_store_explicit(&rec->size, size, pm_memory_order_seq_cst);
+	return 0;
+}
+
+const char *
+log_ring_get(struct log_ring *ring, size_t *len)
+{
+	while (true) {
+		struct log_ring_rec *rec = log_ring_rec(ring, ring->tail);
+		uint32_t size = pm_atomic_load_explicit(&rec->size,
+						pm_memory_order_seq_cst);
+		if (size == 0)
+			return NULL;
+		if (rec->len != LOG_RING_PAD) {
+			*len = rec->len;
+			return (const char *)(rec + 1);
+		}
+		log_ring_next(ring);
+	}
+}
+
+void
+log_ring_next(struct log_ring *ring)
+{
+	struct log_ring_rec *rec = log_ring_rec(ring, ring->tail);
+	uint32_t size = rec->size;
+	assert(size > 0);
+	memset(rec, 0, size);
+	pm_atomic_store_explicit(&ring->tail, ring->tail + size,
+				 pm_memory_order_release);
+}
+
+bool
+log_ring_is_empty(struct log_ring *ring)
+{
+	return pm_atomic_load_explicit(&ring->tail, pm_memory_order_acquire) ==
+	       pm_atomic_load_explicit(&ring->head, pm_memory_order_acquire);
+}
@@ -0,0 +1,115 @@
+#ifndef TARANTOOL_LIB_CORE_LOG_RING_H_INCLUDED
+#define TARANTOOL_LIB_CORE_LOG_RING_H_INCLUDED
+/*
+ * Copyright 2010-2020, Tarantool AUTHORS, please see AUTHORS file.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif /* defined(__cplusplus) */
+
+/**
+ * A lock-free byte ring of variable size records with many
+ * producers and a single consumer.
+ *
+ * A producer reserves space for a record by advancing the head
+ * with a compare-and-swap, copies the record and publishes it
+ * by setting the record size in its header. Records are
+ * consumed in the order of reservation, so a record published
+ * earlier waits for the records reserved before it. A record
+ * never wraps around the end of the ring: the rest of the ring
+ * is filled with padding instead. The consumer zeroes the
+ * consumed space, so an unpublished header always reads zero.
+ */
+struct log_ring {
+	/** Data area, zeroed on creation. */
+	char *data;
+	/** Size of the data area, a power of two. */
+	size_t size;
+	/** Position up to which the space is reserved. */
+	uint64_t head;
+	/** Position up to which the records are consumed. */
+	uint64_t tail;
+};
+
+/**
+ * Create a ring of @a size bytes, rounded up to a power of two.
+ * @retval  0 Success.
+ * @retval -1 Memory error, diag is set.
+ */
+int
+log_ring_create(struct log_ring *ring, size_t size);
+
+void
+log_ring_destroy(struct log_ring *ring);
+
+/**
+ * The maximal length of a record which fits in the ring.
+ */
+size_t
+log_ring_max_len(struct log_ring *ring);
+
+/**
+ * Append a record of @a len bytes. Can be called from any
+ * thread. @a len must not exceed log_ring_max_len().
+ * @retval  0 Success.
+ * @retval -1 The ring is full.
+ */
+int
+log_ring_put(struct log_ring *ring, const char *msg, size_t len);
+
+/**
+ * Get the oldest record. Is called by the consumer only.
+ * Returns NULL if there are no records or the oldest one
+ * is not published yet. The record stays in the ring until
+ * log_ring_next() is called.
+ */
+const char *
+log_ring_get(struct log_ring *ring, size_t *len);
+
+/** Release the record returned by log_ring_get(). */
+void
+log_ring_next(struct log_ring *ring);
+
+/**
+ * True if all the reserved records are consumed. Can be
+ * called from any thread.
+ */
+bool
+log_ring_is_empty(struct log_ring *ring);
+
+#if defined(__cplusplus)
+} /* extern "C" */
+#endif /* defined(__cplusplus) */
+
+#endif /* TARANTOOL_LIB_CORE_LOG_RING_H_INCLUDED */
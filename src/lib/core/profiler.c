@@ -0,0 +1,375 @@
+/*
+ * Copyright 2010-2020, Tarantool AUTHORS, please see AUTHORS file.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include "profiler.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <pmatomic.h>
+
+#include "trivia/config.h"
+#include "trivia/util.h"
+#include "backtrace.h"
+#include "assoc.h"
+#include "diag.h"
+#include "fiber.h"
+#include "say.h"
+
+enum {
+	/** Max length of a folded stack. */
+	PROFILER_LINE_MAX = 8192,
+};
+
+profiler_lua_sample_f profiler_lua_sample_cb = NULL;
+
+static struct {
+	/** Set while the timer is armed. */
+	bool is_running;
+	/** Set when the signal handler is installed. */
+	bool is_installed;
+	/** Number of signal handlers being executed. */
+	uint32_t handler_count;
+	/** Samples of the last run. */
+	struct profiler_sample *samples;
+	uint32_t sample_max;
+	/** Number of taken samples, may exceed sample_max. */
+	uint32_t sample_count;
+} profiler;
+
+#ifdef ENABLE_BACKTRACE
+
+static void
+profiler_signal_cb(int signo, siginfo_t *info, void *context)
+{
+	(void) signo;
+	(void) info;
+	(void) context;
+	int saved_errno = errno;
+	pm_atomic_fetch_add_explicit(&profiler.handler_count, 1,
+				     pm_memory_order_acquire);
+	if (!pm_atomic_load_explicit(&profiler.is_running,
+				     pm_memory_order_acquire))
+		goto out;
+	uint32_t i = pm_atomic_fetch_add_explicit(&profiler.sample_count, 1,
+						  pm_memory_order_relaxed);
+	if (i >= profiler.sample_max)
+		goto out;
+	struct profiler_sample *sample = &profiler.samples[i];
+	sample->depth = backtrace_collect(sample->ips, PROFILER_DEPTH_MAX);
+	/*
+	 * Threads which are not cords, like the ones of the
+	 * coio thread pool, have neither name nor fibers.
+	 */
+	struct cord *cord = cord();
+	if (cord != NULL && cord->fiber != NULL) {
+		strlcpy(sample->cord_name, cord_name(cord),
+			sizeof(sample->cord_name));
+		strlcpy(sample->fiber_name, fiber_name(cord->fiber),
+			sizeof(sample->fiber_name));
+		sample->fid = cord->fiber->fid;
+		if (profiler_lua_sample_cb != NULL && cord_is_main())
+			profiler_lua_sample_cb(sample);
+	}
+	pm_atomic_store_explicit(&sample->is_ready, true,
+				 pm_memory_order_release);
+out:
+	pm_atomic_fetch_sub_explicit(&profiler.handler_count, 1,
+				     pm_memory_order_release);
+	errno = saved_errno;
+}
+
+#endif /* ENABLE_BACKTRACE */
+
+int
+profiler_start(double interval, uint32_t sample_max)
+{
+#ifndef ENABLE_BACKTRACE
+	(void) interval;
+	(void) sample_max;
+	diag_set(IllegalParams, "the profiler requires backtrace support");
+	return -1;
+#else
+	if (profiler.is_running) {
+		diag_set(IllegalParams, "the profiler is already running");
+		return -1;
+	}
+	if (!(interval >= 1e-6)) {
+		diag_set(IllegalParams,
+			 "profiler interval must be at least 1 microsecond");
+		return -1;
+	}
+	if (sample_max == 0) {
+		diag_set(IllegalParams,
+			 "profiler sample count must be positive");
+		return -1;
+	}
+	struct profiler_sample *samples =
+		(struct profiler_sample *) calloc(sample_max, sizeof(*samples));
+	if (samples == NULL) {
+		diag_set(OutOfMemory, sample_max * sizeof(*samples),
+			 "calloc", "profiler samples");
+		return -1;
+	}
+	if (!profiler.is_installed) {
+		/*
+		 * The handler is never uninstalled, since the
+		 * default action of SIGPROF, which may still be
+		 * pending after stop, is to terminate.
+		 */
+		struct sigaction sa;
+		memset(&sa, 0, sizeof(sa));
+		sigemptyset(&sa.sa_mask);
+		sa.sa_flags = SA_RESTART | SA_SIGINFO;
+		sa.sa_sigaction = profiler_signal_cb;
+		if (sigaction(SIGPROF, &sa, NULL) != 0) {
+			diag_set(SystemError, "failed to set SIGPROF handler");
+			free(samples);
+			return -1;
+		}
+		profiler.is_installed = true;
+	}
+	free(profiler.samples);
+	profiler.samples = samples;
+	profiler.sample_max = sample_max;
+	profiler.sample_count = 0;
+	pm_atomic_store_explicit(&profiler.is_running, true,
+				 pm_memory_order_release);
+
+	struct itimerval timer;
+	timer.it_interval.tv_sec = (time_t) interval;
+	timer.it_interval.tv_usec =
+		(suseconds_t) ((interval - (time_t) interval) * 1e6);
+	timer.it_value = timer.it_interval;
+	if (setitimer(ITIMER_PROF, &timer, NULL) != 0) {
+		diag_set(SystemError, "failed to start profiling timer");
+		pm_atomic_store_explicit(&profiler.is_running, false,
+					 pm_memory_order_release);
+		return -1;
+	}
+	say_info("profiler started with interval %.6f", interval);
+	return 0;
+#endif /* ENABLE_BACKTRACE */
+}
+
+void
+profiler_stop(void)
+{
+	if (!profiler.is_running)
+		return;
+	struct itimerval timer;
+	memset(&timer, 0, sizeof(timer));
+	setitimer(ITIMER_PROF, &timer, NULL);
+	pm_atomic_store_explicit(&profiler.is_running, false,
+				 pm_memory_order_release);
+	/*
+	 * Wait for the handlers interrupted in other threads,
+	 * so that the sample buffer can be freed by next start.
+	 */
+	while (pm_atomic_load_explicit(&profiler.handler_count,
+				       pm_memory_order_acquire) != 0)
+		;
+	say_info("profiler stopped, %u samples taken, %u dropped",
+		 profiler_sample_count(), profiler_dropped_count());
+}
+
+bool
+profiler_is_running(void)
+{
+	return profiler.is_running;
+}
+
+uint32_t
+profiler_sample_count(void)
+{
+	uint32_t count = pm_atomic_load_explicit(&profiler.sample_count,
+						 pm_memory_order_relaxed);
+	return MIN(count, profiler.sample_max);
+}
+
+uint32_t
+profiler_dropped_count(void)
+{
+	uint32_t count = pm_atomic_load_explicit(&profiler.sample_count,
+						 pm_memory_order_relaxed);
+	return count - profiler_sample_count();
+}
+
+#ifdef ENABLE_BACKTRACE
+
+/** A folded stack being built. */
+struct profiler_line {
+	char buf[PROFILER_LINE_MAX];
+	size_t len;
+};
+
+/**
+ * Append a frame to a folded stack. Semicolons separate the
+ * frames, so they are replaced in names unless @a is_folded
+ * is set.
+ */
+static void
+profiler_line_append(struct profiler_line *line, const char *frame,
+		     bool is_folded)
+{
+	if (line->len > 0 && line->len < sizeof(line->buf) - 1)
+		line->buf[line->len++] = ';';
+	for (; *frame != '\0' && line->len < sizeof(line->buf) - 1; frame++)
+		line->buf[line->len++] = *frame == ';' && !is_folded ?
+					 ':' : *frame;
+}
+
+static const char *
+profiler_frame_name(void *ip)
+{
+	const char *name = backtrace_proc_name(ip);
+	return name != NULL ? name : "[unknown]";
+}
+
+/**
+ * Fold a sample. The Lua stack is put after the outermost
+ * frame of the LuaJIT VM, which is the one that called the Lua
+ * code, or right after the fiber if the VM is not found.
+ */
+static void
+profiler_fold(struct profiler_sample *sample, struct profiler_line *line)
+{
+	line->len = 0;
+	profiler_line_append(line, *sample->cord_name != '\0' ?
+			     sample->cord_name : "[thread]", false);
+	if (sample->fid != 0)
+		profiler_line_append(line, sample->fiber_name, false);
+	int vm_frame = sample->depth;
+	if (*sample->lua_stack != '\0') {
+		for (int i = sample->depth - 1; i >= 0; i--) {
+			const char *name = profiler_frame_name(sample->ips[i]);
+			if (strncmp(name, "lj_", 3) == 0) {
+				vm_frame = i;
+				break;
+			}
+		}
+		if (vm_frame == sample->depth)
+			profiler_line_append(line, sample->lua_stack, true);
+	}
+	for (int i = sample->depth - 1; i >= 0; i--) {
+		profiler_line_append(line, profiler_frame_name(sample->ips[i]),
+				     false);
+		if (i == vm_frame)
+			profiler_line_append(line, sample->lua_stack, true);
+	}
+	line->buf[line->len] = '\0';
+}
+
+int
+profiler_dump(const char *path)
+{
+	mh_int_t k;
+	struct mh_strnptr_t *stacks = mh_strnptr_new();
+	struct profiler_line *line =
+		(struct profiler_line *) malloc(sizeof(*line));
+	if (stacks == NULL || line == NULL) {
+		diag_set(OutOfMemory, sizeof(*line), "malloc", "line");
+		goto error;
+	}
+	uint32_t sample_count = profiler_sample_count();
+	for (uint32_t i = 0; i < sample_count; i++) {
+		struct profiler_sample *sample = &profiler.samples[i];
+		if (!pm_atomic_load_explicit(&sample->is_ready,
+					     pm_memory_order_acquire))
+			continue;
+		profiler_fold(sample, line);
+		k = mh_strnptr_find_inp(stacks, line->buf, line->len);
+		if (k != mh_end(stacks)) {
+			struct mh_strnptr_node_t *node =
+				mh_strnptr_node(stacks, k);
+			node->val = (void *)((uintptr_t) node->val + 1);
+			continue;
+		}
+		char *str = strdup(line->buf);
+		if (str == NULL) {
+			diag_set(OutOfMemory, line->len, "strdup", "stack");
+			goto error;
+		}
+		struct mh_strnptr_node_t node = {
+			str, line->len, mh_strn_hash(str, line->len),
+			(void *)(uintptr_t) 1
+		};
+		if (mh_strnptr_put(stacks, &node, NULL, NULL) ==
+		    mh_end(stacks)) {
+			free(str);
+			diag_set(OutOfMemory, sizeof(node), "mh_strnptr_put",
+				 "stack");
+			goto error;
+		}
+	}
+	FILE *f = fopen(path, "w");
+	if (f == NULL) {
+		diag_set(SystemError, "failed to open '%s'", path);
+		goto error;
+	}
+	mh_foreach(stacks, k) {
+		struct mh_strnptr_node_t *node = mh_strnptr_node(stacks, k);
+		fprintf(f, "%.*s %u\n", (int) node->len, node->str,
+			(unsigned) (uintptr_t) node->val);
+	}
+	if (fclose(f) != 0) {
+		diag_set(SystemError, "failed to write '%s'", path);
+		goto error;
+	}
+	int stack_count = mh_size(stacks);
+	mh_foreach(stacks, k)
+		free((char *) mh_strnptr_node(stacks, k)->str);
+	mh_strnptr_delete(stacks);
+	free(line);
+	return stack_count;
+error:
+	if (stacks != NULL) {
+		mh_foreach(stacks, k)
+			free((char *) mh_strnptr_node(stacks, k)->str);
+		mh_strnptr_delete(stacks);
+	}
+	free(line);
+	return -1;
+}
+
+#else /* ENABLE_BACKTRACE */
+
+int
+profiler_dump(const char *path)
+{
+	(void) path;
+	diag_set(IllegalParams, "the profiler requires backtrace support");
+	return -1;
+}
+
+#endif /* ENABLE_BACKTRACE */
@@ -0,0 +1,141 @@
+#ifndef TARANTOOL_LIB_CORE_PROFILER_H_INCLUDED
+#define TARANTOOL_LIB_CORE_PROFILER_H_INCLUDED
+/*
+ * Copyright 2010-2020, Tarantool AUTHORS, please see AUTHORS file.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "fiber.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif /* defined(__cplusplus) */
+
+/**
+ * Sampling CPU profiler.
+ *
+ * The process CPU time timer (ITIMER_PROF) sends SIGPROF to
+ * the thread which is running on expiration, so the threads
+ * are sampled in proportion to the CPU time they consume. The
+ * signal handler stores the C stack of the interrupted code
+ * and the current cord and fiber to a sample buffer allocated
+ * on start. Stacks of Lua code are collected by a hook set by
+ * the Lua bindings of the profiler.
+ *
+ * The samples are symbolized and aggregated on dump, which
+ * writes them in the folded stacks format understood by the
+ * flame graph tools: a line per unique stack, the frames
+ * separated with semicolons, the outermost first, followed by
+ * the number of samples.
+ */
+
+enum {
+	/** Max number of C frames in a sample. */
+	PROFILER_DEPTH_MAX = 48,
+	/** Size of the folded Lua stack of a sample. */
+	PROFILER_LUA_STACK_MAX = 256,
+	/** Number of samples the profiler allocates by default. */
+	PROFILER_SAMPLE_MAX_DEFAULT = 32768,
+};
+
+/** Sampling interval used by default, in seconds. */
+#define PROFILER_INTERVAL_DEFAULT 0.01
+
+struct profiler_sample {
+	/** Set when the handler has filled the sample. */
+	bool is_ready;
+	/** Number of frames in @a ips. */
+	int depth;
+	/** Addresses of the C frames, innermost first. */
+	void *ips[PROFILER_DEPTH_MAX];
+	/** Names of the current cord and fiber. */
+	char cord_name[FIBER_NAME_INLINE];
+	char fiber_name[FIBER_NAME_INLINE];
+	/** Id of the current fiber, 0 outside of cords. */
+	uint32_t fid;
+	/** Folded Lua stack, the outermost frame first. */
+	char lua_stack[PROFILER_LUA_STACK_MAX];
+};
+
+/**
+ * Is called from the signal handler for samples taken in the
+ * main cord to request the Lua stack of the sample.
+ */
+typedef void
+(*profiler_lua_sample_f)(struct profiler_sample *sample);
+
+/** Set by the Lua bindings, NULL if there are none. */
+extern profiler_lua_sample_f profiler_lua_sample_cb;
+
+/**
+ * Start sampling with the given @a interval in seconds. Up to
+ * @a sample_max samples are stored, the rest are counted as
+ * dropped. Samples of the previous run are discarded.
+ * @retval  0 Success.
+ * @retval -1 Error, diag is set.
+ */
+int
+profiler_start(double interval, uint32_t sample_max);
+
+/**
+ * Stop sampling. The samples are kept till the next start and
+ * may be dumped.
+ */
+void
+profiler_stop(void);
+
+/** True if the profiler is sampling. */
+bool
+profiler_is_running(void);
+
+/** Number of samples taken by the last run. */
+uint32_t
+profiler_sample_count(void);
+
+/** Number of samples dropped by the last run for lack of space. */
+uint32_t
+profiler_dropped_count(void);
+
+/**
+ * Write the samples taken by the last run to the file @a path
+ * as folded stacks. Can be called while the profiler is
+ * running, the samples taken so far are written then.
+ * @return the number of written stacks, -1 on error, diag is
+ *         set.
+ */
+int
+profiler_dump(const char *path);
+
+#if defined(__cplusplus)
+} /* extern "C" */
+#endif /* defined(__cplusplus) */
+
+#endif /* TARANTOOL_LIB_CORE_PROFILER_H_INCLUDED */
@@ -32,6 +32,7 @@
 #include "fiber.h"
 #include "errinj.h"
 #include "tt_static.h"
+#include "log_ring.h"
 
 #include <errno.h>
 #include <stdarg.h>
@@ -47,6 +48,7 @@
 #include <sys/un.h>
 #include <arpa/inet.h>
 #include <coio_task.h>
+#include <pmatomic.h>
 
 pid_t log_pid = 0;
 int log_level = S_INFO;
@@ -229,9 +231,9 @@ say_format_by_name(const char *format)
 }
 
 static void
-write_to_file(struct log *log, int total);
+write_to_file(struct log *log, const char *msg, int total);
 static void
-write_to_syslog(struct log *log, int total);
+write_to_syslog(struct log *log, const char *msg, int total);
 
 /**
  * Sets O_NONBLOCK flag in case if lognonblock is set.
@@ -716,6 +718,7 @@ fail:
 void
 say_logger_free()
 {
+	say_logger_async_stop();
 	if (log_default == &log_std)
 		log_destroy(&log_std);
 }
@@ -991,13 +994,13 @@ say_default(int level, const char *filename, int line, const char *error,
  * File and pipe logger
  */
 static void
-write_to_file(struct log *log, int total)
+write_to_file(struct log *log, const char *msg, int total)
 {
 	assert(log->type == SAY_LOGGER_FILE ||
 	       log->type == SAY_LOGGER_PIPE ||
 	       log->type == SAY_LOGGER_STDERR);
 	assert(total >= 0);
-	ssize_t r = safe_write(log->fd, buf, total);
+	ssize_t r = safe_write(log->fd, msg, total);
 	(void) r;                               /* silence gcc warning */
 }
 
@@ -1005,11 +1008,11 @@ write_to_file(struct log *log, int total)
  * Syslog logger
  */
 static void
-write_to_syslog(struct log *log, int total)
+write_to_syslog(struct log *log, const char *msg, int total)
 {
 	assert(log->type == SAY_LOGGER_SYSLOG);
 	assert(total >= 0);
-	if (log->fd < 0 || safe_write(log->fd, buf, total) <= 0) {
+	if (log->fd < 0 || safe_write(log->fd, msg, total) <= 0) {
 		/*
 		 * Try to reconnect, if write to syslog has
 		 * failed. Syslog write can fail, if, for example,
@@ -1027,14 +1030,239 @@ write_to_syslog(struct log *log, int total)
 			 * it would block thread. Try to reconnect
 			 * on next vsay().
 			 */
-			ssize_t r = safe_write(log->fd, buf, total);
+			ssize_t r = safe_write(log->fd, msg, total);
 			(void) r;               /* silence gcc warning */
 		}
 	}
 }
 
+/** Write a formatted message to the log output. */
+static void
+log_write(struct log *log, const char *msg, int total)
+{
+	switch (log->type) {
+	case SAY_LOGGER_FILE:
+	case SAY_LOGGER_PIPE:
+	case SAY_LOGGER_STDERR:
+		write_to_file(log, msg, total);
+		break;
+	case SAY_LOGGER_SYSLOG:
+		write_to_syslog(log, msg, total);
+		break;
+	case SAY_LOGGER_BOOT:
+	{
+		ssize_t r = safe_write(STDERR_FILENO, msg, total);
+		(void) r;                       /* silence gcc warning */
+		break;
+	}
+	default:
+		unreachable();
+	}
+}
+
 /** Loggers }}} */
 
+/** {{{ Logger thread */
+
+enum {
+	/** Size of the ring of the logger thread. */
+	SAY_ASYNC_RING_SIZE = 1024 * 1024,
+	/** Microseconds to sleep while the ring is full. */
+	SAY_ASYNC_RETRY_DELAY = 100,
+	/** Times to retry while flushing the ring on panic. */
+	SAY_ASYNC_FLUSH_RETRIES = 10000,
+};
+
+/**
+ * The logger thread. The records of the default logger are
+ * formatted by the calling threads and passed to the logger
+ * thread in a lock-free ring, so a slow log output does not
+ * stall them.
+ */
+static struct {
+	/** The log written by the thread, NULL if not started. */
+	struct log *log;
+	struct log_ring ring;
+	struct cord cord;
+	/** Wakes up the thread when there are new records. */
+	struct ev_async wakeup;
+	/** Drop the records which do not fit in the ring. */
+	bool drop;
+	/** Set if the thread sleeps and must be woken up. */
+	bool is_waiting;
+	bool is_stopping;
+	/** Number of records written by the thread. */
+	uint64_t written;
+	/** Number of times the ring was full. */
+	uint64_t overflows;
+	/** Number of records dropped because the ring was full. */
+	uint64_t dropped;
+	/** Number of dropped records reported to the log. */
+	uint64_t dropped_reported;
+} say_async;
+
+static void
+say_async_wakeup(void)
+{
+	ev_async_send(say_async.cord.loop, &say_async.wakeup);
+}
+
+/** Pass a formatted record to the logger thread. */
+static void
+say_async_put(const char *msg, int total)
+{
+	/* Is what safe_write() would write. */
+	size_t len = MIN(total, SAY_BUF_LEN_MAX - 1);
+	if (log_ring_put(&say_async.ring, msg, len) != 0) {
+		pm_atomic_fetch_add_explicit(&say_async.overflows, 1,
+					     pm_memory_order_relaxed);
+		if (say_async.drop) {
+			pm_atomic_fetch_add_explicit(&say_async.dropped, 1,
+						     pm_memory_order_relaxed);
+			return;
+		}
+		do {
+			say_async_wakeup();
+			usleep(SAY_ASYNC_RETRY_DELAY);
+		} while (log_ring_put(&say_async.ring, msg, len) != 0);
+	}
+	if (pm_atomic_load_explicit(&say_async.is_waiting,
+				    pm_memory_order_seq_cst))
+		say_async_wakeup();
+}
+
+/**
+ * Wait until the logger thread writes the records put to the
+ * ring, not too long: is used on panic.
+ */
+static void
+say_async_flush(void)
+{
+	for (int i = 0; i < SAY_ASYNC_FLUSH_RETRIES &&
+	     !log_ring_is_empty(&say_async.ring); i++) {
+		say_async_wakeup();
+		usleep(SAY_ASYNC_RETRY_DELAY);
+	}
+}
+
+/** Write the records from the ring until it is empty. */
+static void
+say_async_drain(void)
+{
+	struct log_ring *ring = &say_async.ring;
+	const char *msg;
+	size_t len;
+	pm_atomic_store_explicit(&say_async.is_waiting, false,
+				 pm_memory_order_relaxed);
+	while (true) {
+		while ((msg = log_ring_get(ring, &len)) != NULL) {
+			log_write(say_async.log, msg, len);
+			log_ring_next(ring);
+			pm_atomic_store_explicit(&say_async.written,
+						 say_async.written + 1,
+						 pm_memory_order_relaxed);
+		}
+		uint64_t dropped = pm_atomic_load_explicit(&say_async.dropped,
+						pm_memory_order_relaxed);
+		if (dropped > say_async.dropped_reported) {
+			/* Is written synchronously by this thread. */
+			log_say(say_async.log, S_WARN, __FILE__, __LINE__, NULL,
+				"%llu log messages were dropped",
+				(unsigned long long)(dropped -
+					say_async.dropped_reported));
+			say_async.dropped_reported = dropped;
+		}
+		/*
+		 * Producers check the flag after publishing
+		 * a record, so one of them wakes the thread up
+		 * if a record is published after the check below.
+		 */
+		pm_atomic_store_explicit(&say_async.is_waiting, true,
+					 pm_memory_order_seq_cst);
+		if (log_ring_get(ring, &len) == NULL)
+			break;
+		pm_atomic_store_explicit(&say_async.is_waiting, false,
+					 pm_memory_order_relaxed);
+	}
+}
+
+static void
+say_async_wakeup_cb(struct ev_loop *loop, struct ev_async *watcher,
+		    int events)
+{
+	(void)watcher;
+	(void)events;
+	say_async_drain();
+	if (pm_atomic_load_explicit(&say_async.is_stopping,
+				    pm_memory_order_acquire))
+		ev_break(loop, EVBREAK_ALL);
+}
+
+static void *
+say_async_f(void *arg)
+{
+	(void)arg;
+	ev_async_start(loop(), &say_async.wakeup);
+	say_async_drain();
+	ev_run(loop(), 0);
+	ev_async_stop(loop(), &say_async.wakeup);
+	return NULL;
+}
+
+int
+say_logger_async_start(bool drop)
+{
+	assert(say_async.log == NULL);
+	if (log_ring_create(&say_async.ring, SAY_ASYNC_RING_SIZE) != 0)
+		return -1;
+	ev_async_init(&say_async.wakeup, say_async_wakeup_cb);
+	say_async.drop = drop;
+	say_async.is_waiting = false;
+	say_async.is_stopping = false;
+	say_async.log = log_default;
+	if (cord_start(&say_async.cord, "log", say_async_f, NULL) != 0) {
+		say_async.log = NULL;
+		log_ring_destroy(&say_async.ring);
+		return -1;
+	}
+	return 0;
+}
+
+void
+say_logger_async_stop(void)
+{
+	if (say_async.log == NULL)
+		return;
+	pm_atomic_store_explicit(&say_async.is_stopping, true,
+				 pm_memory_order_release);
+	say_async_wakeup();
+	if (cord_join(&say_async.cord) != 0)
+		diag_log();
+	/* Records can be put while the thread is stopping. */
+	const char *msg;
+	size_t len;
+	while ((msg = log_ring_get(&say_async.ring, &len)) != NULL) {
+		log_write(say_async.log, msg, len);
+		log_ring_next(&say_async.ring);
+	}
+	say_async.log = NULL;
+	log_ring_destroy(&say_async.ring);
+}
+
+void
+say_logger_async_stat(struct say_async_stat *stat)
+{
+	stat->is_enabled = say_async.log != NULL;
+	stat->written = pm_atomic_load_explicit(&say_async.written,
+						pm_memory_order_relaxed);
+	stat->overflows = pm_atomic_load_explicit(&say_async.overflows,
+						  pm_memory_order_relaxed);
+	stat->dropped = pm_atomic_load_explicit(&say_async.dropped,
+						pm_memory_order_relaxed);
+}
+
+/** Logger thread }}} */
+
 /*
  * Init string parser(s)
  */
@@ -1203,26 +1431,19 @@ log_vsay(struct log *log, int level, const char *filename, int line,
 	}
 	int total = log->format_func(log, buf, sizeof(buf), level,
 				     filename, line, error, format, ap);
-	switch (log->type) {
-	case SAY_LOGGER_FILE:
-	case SAY_LOGGER_PIPE:
-	case SAY_LOGGER_STDERR:
-		write_to_file(log, total);
-		break;
-	case SAY_LOGGER_SYSLOG:
-		write_to_syslog(log, total);
-		if (level == S_FATAL && log->fd != STDERR_FILENO)
-			(void) safe_write(STDERR_FILENO, buf, total);
-		break;
-	case SAY_LOGGER_BOOT:
-	{
-		ssize_t r = safe_write(STDERR_FILENO, buf, total);
-		(void) r;                       /* silence gcc warning */
-		break;
-	}
-	default:
-		unreachable();
+	if (log == say_async.log && cord() != &say_async.cord) {
+		if (level != S_FATAL) {
+			say_async_put(buf, total);
+			errno = errsv; /* Preserve the errno. */
+			return total;
+		}
+		/* Panic: write after the preceding records. */
+		say_async_flush();
 	}
+	log_write(log, buf, total);
+	if (log->type == SAY_LOGGER_SYSLOG && level == S_FATAL &&
+	    log->fd != STDERR_FILENO)
+		(void) safe_write(STDERR_FILENO, buf, total);
 	errno = errsv; /* Preserve the errno. */
 	return total;
 }
@@ -33,6 +33,7 @@
 #include <trivia/util.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdarg.h>
 #include <errno.h>
 #include <sys/types.h> /* pid_t */
@@ -163,7 +164,7 @@ struct log {
 	/* Application identifier used to group syslog messages. */
 	char *syslog_ident;
 	/**
-	 * Used to wake up the main logger thread from a eio thread.
+	 * Used to wake up the main logger thread from a coio thread.
 	 */
 	ev_async log_async;
 	/**
@@ -270,6 +271,37 @@ say_logger_init(const char *init_str,
 void
 say_logger_free();
 
+/**
+ * Start the logger thread for the default logger. The calling
+ * threads format the messages and pass them to the thread,
+ * which writes them to the log. If the thread does not keep
+ * up, a message is dropped if @a drop is set, otherwise the
+ * caller waits for space.
+ * @retval  0 Success.
+ * @retval -1 Error, diag is set.
+ */
+int
+say_logger_async_start(bool drop);
+
+/** Write the pending messages and stop the logger thread. */
+void
+say_logger_async_stop(void);
+
+struct say_async_stat {
+	/** True if the logger thread is running. */
+	bool is_enabled;
+	/** Number of messages written by the thread. */
+	uint64_t written;
+	/** Number of times the thread did not keep up. */
+	uint64_t overflows;
+	/** Number of dropped messages. */
+	uint64_t dropped;
+};
+
+/** Get statistics of the logger thread. */
+void
+say_logger_async_stat(struct say_async_stat *stat);
+
 CFORMAT(printf, 5, 0) void
 vsay(int level, const char *filename, int line, const char *error,
      const char *format, va_list ap);
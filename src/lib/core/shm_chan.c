@@ -0,0 +1,423 @@
+/*
+ * Copyright 2010-2020, Tarantool AUTHORS, please see AUTHORS file.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include "shm_chan.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <pmatomic.h>
+
+#include "trivia/config.h"
+#include "trivia/util.h"
+#include "diag.h"
+
+#if defined(HAVE_EVENTFD)
+#include <sys/eventfd.h>
+#endif
+
+enum {
+	/** "TSHM", the first bytes of a channel mapping. */
+	SHM_CHAN_MAGIC = 0x5453484d,
+	/** Bounds of the ring size. */
+	SHM_CHAN_RING_SIZE_MIN = 4096,
+	SHM_CHAN_RING_SIZE_MAX = 1 << 30,
+};
+
+static inline size_t
+shm_chan_map_size(uint32_t ring_size)
+{
+	return sizeof(struct shm_chan_hdr) + 2 * (size_t) ring_size;
+}
+
+/** Point the channel at the rings of a side of a mapping. */
+static void
+shm_chan_attach(struct shm_chan *chan, struct shm_chan_hdr *hdr,
+		bool is_server)
+{
+	chan->hdr = hdr;
+	chan->ring_size = hdr->ring_size;
+	chan->map_size = shm_chan_map_size(hdr->ring_size);
+	char *data = (char *) (hdr + 1);
+	int in = is_server ? 0 : 1;
+	chan->in = &hdr->ring[in];
+	chan->out = &hdr->ring[1 - in];
+	chan->in_data = data + in * (size_t) hdr->ring_size;
+	chan->out_data = data + (1 - in) * (size_t) hdr->ring_size;
+	chan->in_head = 0;
+	chan->out_tail = 0;
+	chan->is_broken = false;
+}
+
+/**
+ * Check the positions of a ring, one of which is set by the
+ * peer, and mark the channel broken if they are bogus.
+ */
+static bool
+shm_chan_check_ring(struct shm_chan *chan, uint64_t head, uint64_t tail)
+{
+	if (head <= tail && tail - head <= chan->ring_size)
+		return true;
+	chan->is_broken = true;
+	return false;
+}
+
+/** Wake up a side waiting on the eventfd @a efd. */
+static void
+shm_chan_wakeup(int efd)
+{
+	uint64_t one = 1;
+	ssize_t unused = write(efd, &one, sizeof(one));
+	(void) unused;
+}
+
+/** Reset an eventfd after a wakeup. */
+static void
+shm_chan_clear(int efd)
+{
+	uint64_t value;
+	ssize_t unused = read(efd, &value, sizeof(value));
+	(void) unused;
+}
+
+/**
+ * Wake up the peer if it has announced it waits. The fence
+ * pairs with the one in shm_chan_prepare_wait(): either the
+ * peer sees the new position, or this side sees the flag.
+ */
+static void
+shm_chan_wakeup_waiter(uint32_t *waits, int efd)
+{
+	pm_atomic_thread_fence(pm_memory_order_seq_cst);
+	if (pm_atomic_load_explicit(waits, pm_memory_order_relaxed) == 0)
+		return;
+	pm_atomic_store_explicit(waits, 0, pm_memory_order_relaxed);
+	shm_chan_wakeup(efd);
+}
+
+#if defined(HAVE_MEMFD_CREATE) && defined(HAVE_EVENTFD)
+
+int
+shm_chan_create(struct shm_chan *chan, uint32_t ring_size)
+{
+	memset(chan, 0, sizeof(*chan));
+	chan->read_efd = chan->write_efd = chan->peer_read_efd = -1;
+	ring_size = MAX(ring_size, SHM_CHAN_RING_SIZE_MIN);
+	ring_size = MIN(ring_size, SHM_CHAN_RING_SIZE_MAX);
+	ring_size = 1U << (32 - __builtin_clz(ring_size - 1));
+	size_t map_size = shm_chan_map_size(ring_size);
+	chan->memfd = memfd_create("tarantool_shm", MFD_CLOEXEC);
+	if (chan->memfd < 0) {
+		diag_set(SystemError, "memfd_create");
+		return -1;
+	}
+	if (ftruncate(chan->memfd, map_size) != 0) {
+		diag_set(SystemError, "failed to allocate a shared memory "
+			 "channel of %zu bytes", map_size);
+		goto error;
+	}
+	chan->read_efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	chan->write_efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	/* The client waits for input and space on one eventfd. */
+	chan->peer_read_efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	chan->peer_write_efd = chan->peer_read_efd;
+	if (chan->read_efd < 0 || chan->write_efd < 0 ||
+	    chan->peer_read_efd < 0) {
+		diag_set(SystemError, "eventfd");
+		goto error;
+	}
+	void *map = mmap(NULL, map_size, PROT_READ | PROT_WRITE,
+			 MAP_SHARED, chan->memfd, 0);
+	if (map == MAP_FAILED) {
+		diag_set(SystemError, "failed to map a shared memory channel");
+		goto error;
+	}
+	struct shm_chan_hdr *hdr = (struct shm_chan_hdr *) map;
+	/* The memfd is zero-filled, only the header is set. */
+	hdr->magic = SHM_CHAN_MAGIC;
+	hdr->ring_size = ring_size;
+	shm_chan_attach(chan, hdr, true);
+	return 0;
+error:
+	if (chan->read_efd >= 0)
+		close(chan->read_efd);
+	if (chan->write_efd >= 0)
+		close(chan->write_efd);
+	if (chan->peer_read_efd >= 0)
+		close(chan->peer_read_efd);
+	close(chan->memfd);
+	return -1;
+}
+
+#else /* !defined(HAVE_MEMFD_CREATE) || !defined(HAVE_EVENTFD) */
+
+int
+shm_chan_create(struct shm_chan *chan, uint32_t ring_size)
+{
+	(void) chan;
+	(void) ring_size;
+	errno = ENOTSUP;
+	diag_set(SystemError, "shared memory channels are not supported");
+	return -1;
+}
+
+#endif /* defined(HAVE_MEMFD_CREATE) && defined(HAVE_EVENTFD) */
+
+int
+shm_chan_send(struct shm_chan *chan, int sock)
+{
+	/* The descriptors in the order the client expects. */
+	int fds[SHM_CHAN_FD_COUNT] = {
+		chan->memfd, chan->peer_read_efd,
+		chan->read_efd, chan->write_efd,
+	};
+	char control[CMSG_SPACE(sizeof(fds))];
+	memset(control, 0, sizeof(control));
+	char byte = 0;
+	struct iovec iov = {&byte, 1};
+	struct msghdr msg;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+	struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+	memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+	if (sendmsg(sock, &msg, MSG_NOSIGNAL) != 1) {
+		diag_set(SystemError, "failed to send a shared memory channel");
+		return -1;
+	}
+	close(chan->memfd);
+	chan->memfd = -1;
+	return 0;
+}
+
+int
+shm_chan_recv(struct shm_chan *chan, int sock)
+{
+	memset(chan, 0, sizeof(*chan));
+	int fds[SHM_CHAN_FD_COUNT];
+	char control[CMSG_SPACE(sizeof(fds))];
+	char byte;
+	struct iovec iov = {&byte, 1};
+	struct msghdr msg;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+	int flags = 0;
+#if defined(MSG_CMSG_CLOEXEC)
+	flags |= MSG_CMSG_CLOEXEC;
+#endif
+	ssize_t rc = recvmsg(sock, &msg, flags);
+	if (rc < 0) {
+		diag_set(SystemError, "failed to receive a shared memory "
+			 "channel");
+		return -1;
+	}
+	struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+	if (rc == 0 || cmsg == NULL || cmsg->cmsg_level != SOL_SOCKET ||
+	    cmsg->cmsg_type != SCM_RIGHTS) {
+		errno = rc == 0 ? ECONNRESET : EPROTO;
+		diag_set(SystemError, "failed to receive a shared memory "
+			 "channel");
+		return -1;
+	}
+	int count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+	memcpy(fds, CMSG_DATA(cmsg), MIN(count, SHM_CHAN_FD_COUNT) *
+	       sizeof(int));
+	if (count != SHM_CHAN_FD_COUNT) {
+		for (int i = 0; i < MIN(count, SHM_CHAN_FD_COUNT); i++)
+			close(fds[i]);
+		errno = EPROTO;
+		diag_set(SystemError, "failed to receive a shared memory "
+			 "channel");
+		return -1;
+	}
+	int memfd = fds[0];
+	chan->read_efd = chan->write_efd = fds[1];
+	chan->peer_read_efd = fds[2];
+	chan->peer_write_efd = fds[3];
+	chan->memfd = -1;
+	struct stat st;
+	if (fstat(memfd, &st) != 0 ||
+	    (size_t) st.st_size < sizeof(struct shm_chan_hdr)) {
+		errno = EPROTO;
+		goto error;
+	}
+	void *map = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE,
+			 MAP_SHARED, memfd, 0);
+	if (map == MAP_FAILED)
+		goto error;
+	struct shm_chan_hdr *hdr = (struct shm_chan_hdr *) map;
+	uint32_t ring_size = hdr->ring_size;
+	if (hdr->magic != SHM_CHAN_MAGIC || ring_size == 0 ||
+	    (ring_size & (ring_size - 1)) != 0 ||
+	    (size_t) st.st_size != shm_chan_map_size(ring_size)) {
+		munmap(map, st.st_size);
+		errno = EPROTO;
+		goto error;
+	}
+	shm_chan_attach(chan, hdr, false);
+	close(memfd);
+	return 0;
+error:
+	diag_set(SystemError, "failed to map a shared memory channel");
+	for (int i = 0; i < SHM_CHAN_FD_COUNT; i++)
+		close(fds[i]);
+	return -1;
+}
+
+void
+shm_chan_destroy(struct shm_chan *chan)
+{
+	pm_atomic_store_explicit(&chan->hdr->is_closed, 1,
+				 pm_memory_order_release);
+	shm_chan_wakeup(chan->peer_read_efd);
+	close(chan->peer_read_efd);
+	if (chan->peer_write_efd != chan->peer_read_efd) {
+		shm_chan_wakeup(chan->peer_write_efd);
+		close(chan->peer_write_efd);
+	}
+	close(chan->read_efd);
+	if (chan->write_efd != chan->read_efd)
+		close(chan->write_efd);
+	if (chan->memfd >= 0)
+		close(chan->memfd);
+	munmap(chan->hdr, chan->map_size);
+}
+
+bool
+shm_chan_is_closed(struct shm_chan *chan)
+{
+	if (chan->is_broken)
+		return true;
+	return pm_atomic_load_explicit(&chan->hdr->is_closed,
+				       pm_memory_order_acquire) != 0;
+}
+
+size_t
+shm_chan_read(struct shm_chan *chan, void *buf, size_t size)
+{
+	if (chan->is_broken)
+		return 0;
+	struct shm_ring *ring = chan->in;
+	uint64_t head = chan->in_head;
+	uint64_t tail = pm_atomic_load_explicit(&ring->tail,
+						pm_memory_order_acquire);
+	if (!shm_chan_check_ring(chan, head, tail))
+		return 0;
+	size = MIN(size, tail - head);
+	if (size == 0)
+		return 0;
+	size_t pos = head & (chan->ring_size - 1);
+	size_t chunk = MIN(size, chan->ring_size - pos);
+	memcpy(buf, chan->in_data + pos, chunk);
+	memcpy((char *) buf + chunk, chan->in_data, size - chunk);
+	chan->in_head = head + size;
+	pm_atomic_store_explicit(&ring->head, chan->in_head,
+				 pm_memory_order_release);
+	shm_chan_wakeup_waiter(&ring->writer_waits, chan->peer_write_efd);
+	return size;
+}
+
+size_t
+shm_chan_writev(struct shm_chan *chan, const struct iovec *iov, int iovcnt)
+{
+	if (chan->is_broken)
+		return 0;
+	struct shm_ring *ring = chan->out;
+	uint64_t tail = chan->out_tail;
+	uint64_t head = pm_atomic_load_explicit(&ring->head,
+						pm_memory_order_acquire);
+	if (!shm_chan_check_ring(chan, head, tail))
+		return 0;
+	size_t space = chan->ring_size - (tail - head);
+	size_t total = 0;
+	for (int i = 0; i < iovcnt && space > 0; i++) {
+		const char *data = (const char *) iov[i].iov_base;
+		size_t size = MIN(iov[i].iov_len, space);
+		size_t pos = (tail + total) & (chan->ring_size - 1);
+		size_t chunk = MIN(size, chan->ring_size - pos);
+		memcpy(chan->out_data + pos, data, chunk);
+		memcpy(chan->out_data, data + chunk, size - chunk);
+		space -= size;
+		total += size;
+	}
+	if (total == 0)
+		return 0;
+	chan->out_tail = tail + total;
+	pm_atomic_store_explicit(&ring->tail, chan->out_tail,
+				 pm_memory_order_release);
+	shm_chan_wakeup_waiter(&ring->reader_waits, chan->peer_read_efd);
+	return total;
+}
+
+bool
+shm_chan_prepare_wait(struct shm_chan *chan, bool read, bool write)
+{
+	/*
+	 * Reset the eventfds before the flags are set, so that
+	 * a wakeup caused by the flags is never lost.
+	 */
+	if (read)
+		shm_chan_clear(chan->read_efd);
+	if (write && (!read || chan->write_efd != chan->read_efd))
+		shm_chan_clear(chan->write_efd);
+	if (read) {
+		pm_atomic_store_explicit(&chan->in->reader_waits, 1,
+					 pm_memory_order_relaxed);
+	}
+	if (write) {
+		pm_atomic_store_explicit(&chan->out->writer_waits, 1,
+					 pm_memory_order_relaxed);
+	}
+	pm_atomic_thread_fence(pm_memory_order_seq_cst);
+	/*
+	 * A broken channel is not waited for, the caller gets
+	 * it from the next read or write.
+	 */
+	if (read && pm_atomic_load_explicit(&chan->in->tail,
+			pm_memory_order_acquire) != chan->in_head)
+		return false;
+	if (write && chan->out_tail - pm_atomic_load_explicit(
+			&chan->out->head, pm_memory_order_acquire) !=
+		     chan->ring_size)
+		return false;
+	return !chan->is_broken;
+}
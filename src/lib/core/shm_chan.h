@@ -0,0 +1,221 @@
+#ifndef TARANTOOL_LIB_CORE_SHM_CHAN_H_INCLUDED
+#define TARANTOOL_LIB_CORE_SHM_CHAN_H_INCLUDED
+/*
+ * Copyright 2010-2020, Tarantool AUTHORS, please see AUTHORS file.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/uio.h>
+
+#include "trivia/config.h"
+#include "trivia/util.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif /* defined(__cplusplus) */
+
+/**
+ * A bidirectional byte stream between two processes of the
+ * same host, a replacement of a socket for local clients.
+ *
+ * The channel is a memfd mapping with two single producer,
+ * single consumer rings, one per direction. A side waits on
+ * an eventfd for data in the ring it reads from or for space
+ * in the ring it writes to. The server has an eventfd per
+ * ring, to watch them separately, the client has one for
+ * both. The peer writes to an eventfd only if the side has
+ * announced it is going to wait, so while both sides are
+ * busy the data is passed without any syscalls.
+ *
+ * The channel is created by the server, which passes its
+ * file descriptors to the client over a Unix socket. The
+ * socket is kept open to let the sides notice a crash of
+ * the peer.
+ *
+ * The mapping is writable by the peer, so nothing read from
+ * it is trusted: a side keeps its own ring positions to
+ * itself and checks the positions of the peer on every
+ * access. A channel with bogus positions is broken and is
+ * treated as closed.
+ */
+
+enum {
+	/** Number of descriptors passed to the client. */
+	SHM_CHAN_FD_COUNT = 4,
+};
+
+/**
+ * Control block of a ring. The producer and the consumer
+ * positions are on separate cache lines, so that the sides
+ * do not invalidate each other's cache on every access.
+ */
+struct shm_ring {
+	/** Number of bytes ever written, moved by the producer. */
+	alignas(CACHELINE_SIZE) uint64_t tail;
+	/** Number of bytes ever read, moved by the consumer. */
+	alignas(CACHELINE_SIZE) uint64_t head;
+	/** Set by the consumer before it waits for data. */
+	alignas(CACHELINE_SIZE) uint32_t reader_waits;
+	/** Set by the producer before it waits for space. */
+	uint32_t writer_waits;
+};
+
+/**
+ * The shared mapping. The data of the rings follows the
+ * header: ring[0] carries the client output, ring[1] the
+ * server output.
+ */
+struct shm_chan_hdr {
+	uint32_t magic;
+	uint32_t ring_size;
+	/** Set by the side which closes the channel. */
+	uint32_t is_closed;
+	struct shm_ring ring[2];
+};
+
+struct shm_chan {
+	/** The shared mapping. */
+	struct shm_chan_hdr *hdr;
+	size_t map_size;
+	/** The ring to read from and the ring to write to. */
+	struct shm_ring *in;
+	struct shm_ring *out;
+	/** Data areas of the rings. */
+	char *in_data;
+	char *out_data;
+	/** Size of a ring, a power of two. */
+	uint32_t ring_size;
+	/**
+	 * Positions moved by this side: the head of the input
+	 * ring and the tail of the output ring. The copies in
+	 * the mapping are only published to the peer.
+	 */
+	uint64_t in_head;
+	uint64_t out_tail;
+	/** Set if the peer has put bogus positions to the rings. */
+	bool is_broken;
+	/** Eventfds this side waits on for input and for space. */
+	int read_efd;
+	int write_efd;
+	/** Eventfds the peer waits on for input and for space. */
+	int peer_read_efd;
+	int peer_write_efd;
+	/** The memfd, open on the server until it is sent. */
+	int memfd;
+};
+
+/**
+ * Create a channel with rings of @a ring_size bytes, rounded
+ * up to a power of two. Is called by the server.
+ * @retval  0 Success.
+ * @retval -1 Error, diag is set.
+ */
+int
+shm_chan_create(struct shm_chan *chan, uint32_t ring_size);
+
+/**
+ * Pass the channel to the client over the Unix socket @a sock.
+ * The memfd is closed on success.
+ * @retval  0 Success.
+ * @retval -1 Error, diag is set.
+ */
+int
+shm_chan_send(struct shm_chan *chan, int sock);
+
+/**
+ * Receive a channel sent by shm_chan_send() from the Unix
+ * socket @a sock and map it. Is called by the client.
+ * @retval  0 Success.
+ * @retval -1 Error, diag is set. errno is EAGAIN or
+ *            EWOULDBLOCK if nothing is received yet from a
+ *            nonblocking socket.
+ */
+int
+shm_chan_recv(struct shm_chan *chan, int sock);
+
+/**
+ * Mark the channel closed, wake up the peer and release the
+ * resources of this side.
+ */
+void
+shm_chan_destroy(struct shm_chan *chan);
+
+/** True if the peer has closed or broken the channel. */
+bool
+shm_chan_is_closed(struct shm_chan *chan);
+
+/** True if the peer has put bogus positions to the rings. */
+static inline bool
+shm_chan_is_broken(const struct shm_chan *chan)
+{
+	return chan->is_broken;
+}
+
+/**
+ * Read up to @a size bytes available in the input ring.
+ * Returns the number of bytes read, 0 if the ring is empty
+ * or the channel is broken.
+ */
+size_t
+shm_chan_read(struct shm_chan *chan, void *buf, size_t size);
+
+/**
+ * Write as much of @a iov as fits in the output ring.
+ * Returns the number of bytes written, 0 if the ring is full
+ * or the channel is broken.
+ */
+size_t
+shm_chan_writev(struct shm_chan *chan, const struct iovec *iov, int iovcnt);
+
+static inline size_t
+shm_chan_write(struct shm_chan *chan, const void *buf, size_t size)
+{
+	struct iovec iov = {(void *) buf, size};
+	return shm_chan_writev(chan, &iov, 1);
+}
+
+/**
+ * Announce that the side is going to wait for input, if
+ * @a read is set, and for space in the output ring, if
+ * @a write is set, and reset the corresponding eventfds.
+ * Returns false if the input or the space has appeared
+ * meanwhile, and the side must read or write instead of
+ * waiting. Otherwise the eventfds become readable when it
+ * appears.
+ */
+bool
+shm_chan_prepare_wait(struct shm_chan *chan, bool read, bool write);
+
+#if defined(__cplusplus)
+} /* extern "C" */
+#endif /* defined(__cplusplus) */
+
+#endif /* TARANTOOL_LIB_CORE_SHM_CHAN_H_INCLUDED */
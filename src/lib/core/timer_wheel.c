@@ -0,0 +1,264 @@
+/*
+ * Copyright 2010-2020, Tarantool AUTHORS, please see AUTHORS file.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include "timer_wheel.h"
+
+#include <assert.h>
+#include <math.h>
+
+#include "bit/bit.h"
+#include "trivia/util.h"
+
+static void
+timer_wheel_cb(struct ev_loop *loop, struct ev_timer *watcher, int events);
+
+/** Current time of the loop, in whole ticks. */
+static inline uint64_t
+timer_wheel_now(struct timer_wheel *wheel)
+{
+	return (uint64_t) (ev_monotonic_now(wheel->loop) / TIMER_WHEEL_TICK);
+}
+
+void
+timer_wheel_create(struct timer_wheel *wheel, struct ev_loop *loop)
+{
+	wheel->loop = loop;
+	wheel->count = 0;
+	wheel->watcher_tick = UINT64_MAX;
+	for (int level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+		wheel->bitmap[level] = 0;
+		for (int slot = 0; slot < TIMER_WHEEL_SLOTS; slot++)
+			rlist_create(&wheel->slots[level][slot]);
+	}
+	rlist_create(&wheel->expired);
+	ev_timer_init(&wheel->watcher, timer_wheel_cb, 0, 0);
+	wheel->watcher.data = wheel;
+	wheel->tick = loop != NULL ? timer_wheel_now(wheel) : 0;
+}
+
+void
+timer_wheel_destroy(struct timer_wheel *wheel)
+{
+	if (wheel->loop != NULL)
+		ev_timer_stop(wheel->loop, &wheel->watcher);
+}
+
+/** Set the watcher to fire when the time reaches @a tick. */
+static void
+timer_wheel_schedule(struct timer_wheel *wheel, uint64_t tick)
+{
+	wheel->watcher_tick = tick;
+	/*
+	 * Fire a bit after the tick starts, so that the rounding
+	 * of the time can't make the tick look not reached yet.
+	 */
+	double delay = (tick + 0.001) * TIMER_WHEEL_TICK -
+		       ev_monotonic_now(wheel->loop);
+	ev_timer_stop(wheel->loop, &wheel->watcher);
+	ev_timer_set(&wheel->watcher, delay > 0 ? delay : 0, 0);
+	ev_timer_start(wheel->loop, &wheel->watcher);
+}
+
+/** Link a timer to the slot matching its expiration time. */
+static void
+timer_wheel_insert(struct timer_wheel *wheel, struct wheel_timer *timer)
+{
+	uint64_t expires = MAX(timer->expires, wheel->tick);
+	uint64_t delta = expires - wheel->tick;
+	int level = 0;
+	if (delta >= TIMER_WHEEL_SLOTS) {
+		level = (63 - bit_clz_u64(delta)) / TIMER_WHEEL_BITS;
+		if (level >= TIMER_WHEEL_LEVELS) {
+			/*
+			 * Out of range, put the timer to the
+			 * farthest slot, it is rearmed when the slot
+			 * is cascaded.
+			 */
+			level = TIMER_WHEEL_LEVELS - 1;
+			expires = wheel->tick + (1ULL << (TIMER_WHEEL_BITS *
+						TIMER_WHEEL_LEVELS)) - 1;
+		}
+	}
+	unsigned slot = (expires >> (level * TIMER_WHEEL_BITS)) &
+			TIMER_WHEEL_MASK;
+	timer->level = level;
+	timer->slot = slot;
+	rlist_add_tail(&wheel->slots[level][slot], &timer->in_slot);
+	wheel->bitmap[level] |= 1ULL << slot;
+}
+
+/**
+ * Find the tick when the wheel has to do anything: fire the
+ * timers of a slot of the lowest level or cascade a slot of an
+ * upper level. A slot of level L is processed at the first tick
+ * of its range, i.e. when the lower L * TIMER_WHEEL_BITS bits
+ * of the tick are zero.
+ */
+static uint64_t
+timer_wheel_next_tick(struct timer_wheel *wheel)
+{
+	uint64_t next = UINT64_MAX;
+	for (int level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+		uint64_t bitmap = wheel->bitmap[level];
+		if (bitmap == 0)
+			continue;
+		int shift = level * TIMER_WHEEL_BITS;
+		/* The first slot of the level not processed yet. */
+		uint64_t base = (wheel->tick + (1ULL << shift) - 1) >> shift;
+		unsigned idx = base & TIMER_WHEEL_MASK;
+		/* Make the bit of that slot the lowest one. */
+		if (idx != 0) {
+			bitmap = (bitmap >> idx) |
+				 (bitmap << (TIMER_WHEEL_SLOTS - idx));
+		}
+		uint64_t tick = (base + bit_ctz_u64(bitmap)) << shift;
+		next = MIN(next, tick);
+	}
+	return next;
+}
+
+/** Unlink all timers of a slot and return them in @a list. */
+static void
+timer_wheel_take_slot(struct timer_wheel *wheel, int level, unsigned slot,
+		      struct rlist *list)
+{
+	rlist_create(list);
+	rlist_swap(list, &wheel->slots[level][slot]);
+	wheel->bitmap[level] &= ~(1ULL << slot);
+}
+
+/** Fire all timers of the list. */
+static void
+timer_wheel_fire(struct timer_wheel *wheel, struct rlist *list)
+{
+	while (!rlist_empty(list)) {
+		struct wheel_timer *timer =
+			rlist_shift_entry(list, struct wheel_timer, in_slot);
+		wheel->count--;
+		timer->cb(timer);
+	}
+}
+
+/** Cascade the slots due at @a tick and fire the expired timers. */
+static void
+timer_wheel_process(struct timer_wheel *wheel, uint64_t tick)
+{
+	struct rlist list;
+	wheel->tick = tick;
+	for (int level = 1; level < TIMER_WHEEL_LEVELS; level++) {
+		int shift = level * TIMER_WHEEL_BITS;
+		if ((tick & ((1ULL << shift) - 1)) != 0)
+			break;
+		timer_wheel_take_slot(wheel, level,
+				      (tick >> shift) & TIMER_WHEEL_MASK,
+				      &list);
+		struct wheel_timer *timer, *tmp;
+		rlist_foreach_entry_safe(timer, &list, in_slot, tmp) {
+			rlist_del_entry(timer, in_slot);
+			timer_wheel_insert(wheel, timer);
+		}
+	}
+	timer_wheel_take_slot(wheel, 0, tick & TIMER_WHEEL_MASK, &list);
+	wheel->tick = tick + 1;
+	timer_wheel_fire(wheel, &list);
+}
+
+static void
+timer_wheel_cb(struct ev_loop *loop, struct ev_timer *watcher, int events)
+{
+	(void) loop;
+	(void) events;
+	struct timer_wheel *wheel = (struct timer_wheel *) watcher->data;
+	wheel->watcher_tick = UINT64_MAX;
+
+	struct rlist list;
+	rlist_create(&list);
+	rlist_swap(&list, &wheel->expired);
+	timer_wheel_fire(wheel, &list);
+
+	uint64_t now = timer_wheel_now(wheel);
+	while (true) {
+		uint64_t tick = timer_wheel_next_tick(wheel);
+		if (tick > now)
+			break;
+		timer_wheel_process(wheel, tick);
+	}
+	/* Nothing is left to do up to now, skip it. */
+	wheel->tick = MAX(wheel->tick, now + 1);
+
+	if (!rlist_empty(&wheel->expired)) {
+		timer_wheel_schedule(wheel, 0);
+	} else if (wheel->count > 0) {
+		timer_wheel_schedule(wheel, timer_wheel_next_tick(wheel));
+	}
+}
+
+void
+timer_wheel_start(struct timer_wheel *wheel, struct wheel_timer *timer,
+		  double delay)
+{
+	assert(wheel->loop != NULL);
+	assert(!wheel_timer_is_active(timer));
+	if (wheel->count++ == 0) {
+		/* The wheel is empty, catch up with the time. */
+		wheel->tick = MAX(wheel->tick, timer_wheel_now(wheel));
+	}
+	if (delay <= 0) {
+		timer->level = TIMER_WHEEL_LEVELS;
+		rlist_add_tail(&wheel->expired, &timer->in_slot);
+		if (wheel->watcher_tick != 0)
+			timer_wheel_schedule(wheel, 0);
+		return;
+	}
+	double expires = ceil((ev_monotonic_now(wheel->loop) + delay) /
+			      TIMER_WHEEL_TICK);
+	/* Keep huge timeouts, like TIMEOUT_INFINITY, in range. */
+	timer->expires = expires < (double) (UINT64_MAX >> 1) ?
+			 (uint64_t) expires : UINT64_MAX >> 1;
+	timer_wheel_insert(wheel, timer);
+	if (timer->expires < wheel->watcher_tick)
+		timer_wheel_schedule(wheel, timer->expires);
+}
+
+void
+timer_wheel_stop(struct timer_wheel *wheel, struct wheel_timer *timer)
+{
+	if (!wheel_timer_is_active(timer))
+		return;
+	rlist_del_entry(timer, in_slot);
+	if (timer->level < TIMER_WHEEL_LEVELS &&
+	    rlist_empty(&wheel->slots[timer->level][timer->slot]))
+		wheel->bitmap[timer->level] &= ~(1ULL << timer->slot);
+	assert(wheel->count > 0);
+	if (--wheel->count == 0) {
+		ev_timer_stop(wheel->loop, &wheel->watcher);
+		wheel->watcher_tick = UINT64_MAX;
+	}
+}
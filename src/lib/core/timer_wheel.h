@@ -0,0 +1,153 @@
+#ifndef TARANTOOL_LIB_CORE_TIMER_WHEEL_H_INCLUDED
+#define TARANTOOL_LIB_CORE_TIMER_WHEEL_H_INCLUDED
+/*
+ * Copyright 2010-2020, Tarantool AUTHORS, please see AUTHORS file.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <small/rlist.h>
+#include "tarantool_ev.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif /* defined(__cplusplus) */
+
+/**
+ * A hierarchical timing wheel for timeouts of the fibers of a
+ * cord.
+ *
+ * Timers are bucketed into slots of TIMER_WHEEL_LEVELS wheels,
+ * each next wheel having TIMER_WHEEL_SLOTS times coarser slots
+ * than the previous one. Arming and cancelling a timer is a list
+ * insertion and deletion. When the time reaches a slot of an
+ * upper level, its timers are cascaded down to the lower levels.
+ * A bitmap of non-empty slots per level lets the wheel skip
+ * empty slots, so a single ev_timer is armed exactly for the
+ * next slot to process, rather than ticking periodically.
+ *
+ * The resolution is TIMER_WHEEL_TICK. A timer never fires
+ * earlier than it is set to, but may fire up to a tick later.
+ */
+
+/** Resolution of the wheel, in seconds. */
+#define TIMER_WHEEL_TICK 0.001
+
+enum {
+	/** log2 of the number of slots in a level. */
+	TIMER_WHEEL_BITS = 6,
+	TIMER_WHEEL_SLOTS = 1 << TIMER_WHEEL_BITS,
+	TIMER_WHEEL_MASK = TIMER_WHEEL_SLOTS - 1,
+	/**
+	 * Number of levels. Together they cover 2^36 ticks, i.e.
+	 * about two years, longer timers are rearmed on cascade.
+	 */
+	TIMER_WHEEL_LEVELS = 6,
+};
+
+struct wheel_timer;
+
+typedef void
+(*wheel_timer_f)(struct wheel_timer *timer);
+
+struct wheel_timer {
+	/** Link in a slot of the wheel, empty if inactive. */
+	struct rlist in_slot;
+	/** Expiration time, in ticks. */
+	uint64_t expires;
+	/** Level and slot the timer is linked to. */
+	uint8_t level;
+	uint8_t slot;
+	/** Called by the wheel when the timer expires. */
+	wheel_timer_f cb;
+	void *data;
+};
+
+static inline void
+wheel_timer_create(struct wheel_timer *timer, wheel_timer_f cb, void *data)
+{
+	rlist_create(&timer->in_slot);
+	timer->cb = cb;
+	timer->data = data;
+}
+
+/** True if the timer is armed and has not fired yet. */
+static inline bool
+wheel_timer_is_active(const struct wheel_timer *timer)
+{
+	return !rlist_empty((struct rlist *) &timer->in_slot);
+}
+
+struct timer_wheel {
+	/** The next tick to process. */
+	uint64_t tick;
+	/** The tick the watcher fires at, UINT64_MAX if stopped. */
+	uint64_t watcher_tick;
+	/** Number of armed timers. */
+	uint32_t count;
+	/** Bitmaps of non-empty slots, a bitmap per level. */
+	uint64_t bitmap[TIMER_WHEEL_LEVELS];
+	/** Slots of the levels. */
+	struct rlist slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+	/** Timers with zero timeout, fire on the next iteration. */
+	struct rlist expired;
+	/** Fires when it is time to process the next slot. */
+	struct ev_timer watcher;
+	struct ev_loop *loop;
+};
+
+/** Create a wheel driven by the event @a loop. */
+void
+timer_wheel_create(struct timer_wheel *wheel, struct ev_loop *loop);
+
+/**
+ * Destroy the wheel. Timers that are still armed are
+ * abandoned and never fire.
+ */
+void
+timer_wheel_destroy(struct timer_wheel *wheel);
+
+/**
+ * Arm an inactive timer to fire in @a delay seconds. A timer
+ * with zero or negative delay fires on the next event loop
+ * iteration.
+ */
+void
+timer_wheel_start(struct timer_wheel *wheel, struct wheel_timer *timer,
+		  double delay);
+
+/** Disarm a timer. Does nothing if the timer is inactive. */
+void
+timer_wheel_stop(struct timer_wheel *wheel, struct wheel_timer *timer);
+
+#if defined(__cplusplus)
+} /* extern "C" */
+#endif /* defined(__cplusplus) */
+
+#endif /* TARANTOOL_LIB_CORE_TIMER_WHEEL_H_INCLUDED */
@@ -0,0 +1,401 @@
+/*
+ * Copyright 2010-2020, Tarantool AUTHORS, please see AUTHORS file.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include "uring.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "trivia/config.h"
+#include "trivia/util.h"
+#include "diag.h"
+#include "fiber.h"
+#include "say.h"
+
+#if defined(HAVE_IO_URING)
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include <pmatomic.h>
+
+static inline int
+sys_io_uring_setup(unsigned entries, struct io_uring_params *p)
+{
+	return syscall(__NR_io_uring_setup, entries, p);
+}
+
+static inline int
+sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete,
+		   unsigned flags)
+{
+	return syscall(__NR_io_uring_enter, fd, to_submit, min_complete,
+		       flags, NULL, 0);
+}
+
+static void
+uring_prepare_cb(struct ev_loop *loop, struct ev_prepare *watcher,
+		 int events);
+
+static void
+uring_idle_cb(struct ev_loop *loop, struct ev_idle *watcher, int events);
+
+static void
+uring_unmap(struct uring *ring)
+{
+	if (ring->sq_ring != NULL)
+		munmap(ring->sq_ring, ring->sq_ring_size);
+	if (ring->cq_ring != NULL)
+		munmap(ring->cq_ring, ring->cq_ring_size);
+	if (ring->sqes != NULL)
+		munmap(ring->sqes, ring->sqes_size);
+}
+
+static void *
+uring_mmap(int fd, size_t size, off_t offset)
+{
+	void *ptr = mmap(NULL, size, PROT_READ | PROT_WRITE,
+			 MAP_SHARED | MAP_POPULATE, fd, offset);
+	if (ptr == MAP_FAILED) {
+		diag_set(SystemError, "failed to map io_uring");
+		return NULL;
+	}
+	return ptr;
+}
+
+int
+uring_create(struct uring *ring, unsigned entries, struct ev_loop *loop)
+{
+	memset(ring, 0, sizeof(*ring));
+	struct io_uring_params p;
+	memset(&p, 0, sizeof(p));
+	ring->fd = sys_io_uring_setup(entries, &p);
+	if (ring->fd < 0) {
+		diag_set(SystemError, "io_uring_setup");
+		return -1;
+	}
+	/*
+	 * Completions must never be dropped, and the arguments
+	 * of an operation must be consumed on submission, so
+	 * that the iovecs can be reused right away.
+	 */
+	unsigned features = IORING_FEAT_NODROP | IORING_FEAT_SUBMIT_STABLE;
+	if ((p.features & features) != features) {
+		errno = ENOTSUP;
+		diag_set(SystemError, "io_uring is too old");
+		goto error;
+	}
+	ring->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	ring->sq_ring = uring_mmap(ring->fd, ring->sq_ring_size,
+				   IORING_OFF_SQ_RING);
+	if (ring->sq_ring == NULL)
+		goto error;
+	ring->cq_ring_size = p.cq_off.cqes +
+			     p.cq_entries * sizeof(struct io_uring_cqe);
+	ring->cq_ring = uring_mmap(ring->fd, ring->cq_ring_size,
+				   IORING_OFF_CQ_RING);
+	if (ring->cq_ring == NULL)
+		goto error;
+	ring->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+	ring->sqes = uring_mmap(ring->fd, ring->sqes_size, IORING_OFF_SQES);
+	if (ring->sqes == NULL)
+		goto error;
+
+	char *sq = (char *) ring->sq_ring;
+	ring->sq_head = (unsigned *) (sq + p.sq_off.head);
+	ring->sq_tail = (unsigned *) (sq + p.sq_off.tail);
+	ring->sq_mask = (unsigned *) (sq + p.sq_off.ring_mask);
+	ring->sq_array = (unsigned *) (sq + p.sq_off.array);
+	ring->sq_entries = p.sq_entries;
+	char *cq = (char *) ring->cq_ring;
+	ring->cq_head = (unsigned *) (cq + p.cq_off.head);
+	ring->cq_tail = (unsigned *) (cq + p.cq_off.tail);
+	ring->cq_mask = (unsigned *) (cq + p.cq_off.ring_mask);
+	ring->cqes = cq + p.cq_off.cqes;
+	ring->sq_queued = ring->sq_submitted = *ring->sq_tail;
+
+	region_create(&ring->region, &cord()->slabc);
+	ring->loop = loop;
+	ev_prepare_init(&ring->prepare, uring_prepare_cb);
+	ring->prepare.data = ring;
+	ev_prepare_start(loop, &ring->prepare);
+	ev_idle_init(&ring->idle, uring_idle_cb);
+	ring->idle.data = ring;
+	return 0;
+error:
+	uring_unmap(ring);
+	close(ring->fd);
+	return -1;
+}
+
+void
+uring_destroy(struct uring *ring)
+{
+	assert(ring->in_flight == 0);
+	ev_prepare_stop(ring->loop, &ring->prepare);
+	ev_idle_stop(ring->loop, &ring->idle);
+	region_destroy(&ring->region);
+	uring_unmap(ring);
+	close(ring->fd);
+}
+
+/** Get a free submission queue entry or NULL if it is full. */
+static struct io_uring_sqe *
+uring_get_sqe(struct uring *ring, struct uring_op *op, int opcode,
+	      int fd, uring_op_f cb)
+{
+	assert(!uring_op_is_busy(op));
+	unsigned head = pm_atomic_load_explicit(ring->sq_head,
+						pm_memory_order_acquire);
+	if (ring->sq_queued - head >= ring->sq_entries)
+		return NULL;
+	unsigned idx = ring->sq_queued & *ring->sq_mask;
+	struct io_uring_sqe *sqe = (struct io_uring_sqe *) ring->sqes + idx;
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode = opcode;
+	sqe->fd = fd;
+	sqe->user_data = (uintptr_t) op;
+	ring->sq_array[idx] = idx;
+	ring->sq_queued++;
+	memset(&op->msg, 0, sizeof(op->msg));
+	op->cb = cb;
+	op->sqe = sqe;
+	return sqe;
+}
+
+int
+uring_recv(struct uring *ring, struct uring_op *op, int fd,
+	   void *buf, size_t len, uring_op_f cb)
+{
+	struct io_uring_sqe *sqe = uring_get_sqe(ring, op, IORING_OP_RECVMSG,
+						 fd, cb);
+	if (sqe == NULL)
+		return -1;
+	op->iov.iov_base = buf;
+	op->iov.iov_len = len;
+	op->msg.msg_iov = &op->iov;
+	op->msg.msg_iovlen = 1;
+	sqe->addr = (uintptr_t) &op->msg;
+	sqe->msg_flags = MSG_DONTWAIT;
+	return 0;
+}
+
+int
+uring_sendmsg(struct uring *ring, struct uring_op *op, int fd,
+	      const struct iovec *iov, int iovcnt, uring_op_f cb)
+{
+	size_t size = iovcnt * sizeof(*iov);
+	struct iovec *copy = (struct iovec *) region_alloc(&ring->region,
+							   size);
+	if (copy == NULL)
+		return -1;
+	struct io_uring_sqe *sqe = uring_get_sqe(ring, op, IORING_OP_SENDMSG,
+						 fd, cb);
+	if (sqe == NULL)
+		return -1;
+	memcpy(copy, iov, size);
+	op->msg.msg_iov = copy;
+	op->msg.msg_iovlen = iovcnt;
+	sqe->addr = (uintptr_t) &op->msg;
+	sqe->msg_flags = MSG_DONTWAIT | MSG_NOSIGNAL;
+	return 0;
+}
+
+void
+uring_op_cancel(struct uring_op *op)
+{
+	if (op->sqe != NULL) {
+		/* Not submitted yet, turn it into a no-op. */
+		struct io_uring_sqe *sqe = (struct io_uring_sqe *) op->sqe;
+		memset(sqe, 0, sizeof(*sqe));
+		sqe->opcode = IORING_OP_NOP;
+		sqe->fd = -1;
+		op->sqe = NULL;
+	}
+	op->cb = NULL;
+}
+
+/** Call the callbacks of the completed operations. */
+static void
+uring_reap(struct uring *ring)
+{
+	struct io_uring_cqe *cqes = (struct io_uring_cqe *) ring->cqes;
+	unsigned head = *ring->cq_head;
+	unsigned tail = pm_atomic_load_explicit(ring->cq_tail,
+						pm_memory_order_acquire);
+	while (head != tail) {
+		struct io_uring_cqe *cqe = &cqes[head & *ring->cq_mask];
+		struct uring_op *op =
+			(struct uring_op *) (uintptr_t) cqe->user_data;
+		int res = cqe->res;
+		head++;
+		pm_atomic_store_explicit(ring->cq_head, head,
+					 pm_memory_order_release);
+		assert(ring->in_flight > 0);
+		ring->in_flight--;
+		if (op == NULL || op->cb == NULL)
+			continue;
+		uring_op_f cb = op->cb;
+		op->cb = NULL;
+		cb(op, res);
+	}
+}
+
+void
+uring_flush(struct uring *ring)
+{
+	struct io_uring_sqe *sqes = (struct io_uring_sqe *) ring->sqes;
+	/*
+	 * Submit only what is queued now: callbacks of the
+	 * completed operations may queue more, which waits for
+	 * the next flush.
+	 */
+	unsigned tail = ring->sq_queued;
+	pm_atomic_store_explicit(ring->sq_tail, tail,
+				 pm_memory_order_release);
+	while (ring->sq_submitted != tail || ring->in_flight > 0) {
+		unsigned to_submit = tail - ring->sq_submitted;
+		int rc = sys_io_uring_enter(ring->fd, to_submit,
+					    ring->in_flight + to_submit,
+					    IORING_ENTER_GETEVENTS);
+		if (rc < 0) {
+			/*
+			 * The completion queue is full or a signal
+			 * has arrived, reap and retry. Other errors
+			 * mean the ring is misused.
+			 */
+			if (errno != EINTR && errno != EAGAIN &&
+			    errno != EBUSY)
+				panic_syserror("io_uring_enter");
+			uring_reap(ring);
+			continue;
+		}
+		/* The consumed entries can not be cancelled anymore. */
+		for (int i = 0; i < rc; i++) {
+			struct io_uring_sqe *sqe =
+				&sqes[ring->sq_submitted++ & *ring->sq_mask];
+			struct uring_op *op =
+				(struct uring_op *) (uintptr_t) sqe->user_data;
+			if (op != NULL && op->sqe == sqe)
+				op->sqe = NULL;
+		}
+		ring->in_flight += rc;
+		if (ring->sq_submitted == ring->sq_queued)
+			region_reset(&ring->region);
+		uring_reap(ring);
+	}
+}
+
+static void
+uring_prepare_cb(struct ev_loop *loop, struct ev_prepare *watcher,
+		 int events)
+{
+	(void) events;
+	struct uring *ring = (struct uring *) watcher->data;
+	if (ring->sq_queued == ring->sq_submitted)
+		return;
+	uring_flush(ring);
+	/*
+	 * The callbacks could queue more operations or feed
+	 * events, which must not wait for poll to return.
+	 */
+	ev_idle_start(loop, &ring->idle);
+}
+
+static void
+uring_idle_cb(struct ev_loop *loop, struct ev_idle *watcher, int events)
+{
+	(void) events;
+	ev_idle_stop(loop, watcher);
+}
+
+#else /* !defined(HAVE_IO_URING) */
+
+int
+uring_create(struct uring *ring, unsigned entries, struct ev_loop *loop)
+{
+	(void) ring;
+	(void) entries;
+	(void) loop;
+	errno = ENOTSUP;
+	diag_set(SystemError, "io_uring is not supported");
+	return -1;
+}
+
+void
+uring_destroy(struct uring *ring)
+{
+	(void) ring;
+	unreachable();
+}
+
+int
+uring_recv(struct uring *ring, struct uring_op *op, int fd,
+	   void *buf, size_t len, uring_op_f cb)
+{
+	(void) ring;
+	(void) op;
+	(void) fd;
+	(void) buf;
+	(void) len;
+	(void) cb;
+	return -1;
+}
+
+int
+uring_sendmsg(struct uring *ring, struct uring_op *op, int fd,
+	      const struct iovec *iov, int iovcnt, uring_op_f cb)
+{
+	(void) ring;
+	(void) op;
+	(void) fd;
+	(void) iov;
+	(void) iovcnt;
+	(void) cb;
+	return -1;
+}
+
+void
+uring_op_cancel(struct uring_op *op)
+{
+	op->cb = NULL;
+	op->sqe = NULL;
+}
+
+void
+uring_flush(struct uring *ring)
+{
+	(void) ring;
+}
+
+#endif /* defined(HAVE_IO_URING) */
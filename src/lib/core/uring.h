@@ -0,0 +1,184 @@
+#ifndef TARANTOOL_LIB_CORE_URING_H_INCLUDED
+#define TARANTOOL_LIB_CORE_URING_H_INCLUDED
+/*
+ * Copyright 2010-2020, Tarantool AUTHORS, please see AUTHORS file.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/socket.h>
+#include <small/region.h>
+#include "tarantool_ev.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif /* defined(__cplusplus) */
+
+/**
+ * Batched socket I/O with Linux io_uring.
+ *
+ * The ring does not replace the event loop: readiness of the
+ * sockets is still watched by libev. Instead of a syscall per
+ * read or write, the operations queued during an event loop
+ * iteration are submitted with a single io_uring_enter()
+ * before the loop polls for events. All operations are
+ * nonblocking (MSG_DONTWAIT), so the kernel completes them
+ * right away, and their callbacks are invoked before the
+ * submitting io_uring_enter() returns to the loop. Thus the
+ * buffers of an operation must only stay valid until the end
+ * of the current event loop iteration.
+ */
+
+struct uring_op;
+
+/**
+ * Completion callback of an operation. @a res is the result
+ * of the operation as returned by the kernel: the number of
+ * transferred bytes or a negated errno.
+ */
+typedef void
+(*uring_op_f)(struct uring_op *op, int res);
+
+/** A socket read or write queued to the ring. */
+struct uring_op {
+	/** Completion callback, NULL if the op is not in progress. */
+	uring_op_f cb;
+	/** Submission queue entry, NULL when it is submitted. */
+	void *sqe;
+	/** Arguments of the operation, read by the kernel. */
+	struct msghdr msg;
+	struct iovec iov;
+};
+
+static inline void
+uring_op_create(struct uring_op *op)
+{
+	op->cb = NULL;
+	op->sqe = NULL;
+}
+
+/** True if the op is queued or submitted and not completed. */
+static inline bool
+uring_op_is_busy(const struct uring_op *op)
+{
+	return op->cb != NULL;
+}
+
+struct uring {
+	/** The ring file descriptor. */
+	int fd;
+	/** Submission queue ring, mapped from the kernel. */
+	void *sq_ring;
+	size_t sq_ring_size;
+	unsigned *sq_head;
+	unsigned *sq_tail;
+	unsigned *sq_mask;
+	unsigned *sq_array;
+	unsigned sq_entries;
+	/** Submission queue entries, mapped from the kernel. */
+	void *sqes;
+	size_t sqes_size;
+	/** Completion queue ring, mapped from the kernel. */
+	void *cq_ring;
+	size_t cq_ring_size;
+	unsigned *cq_head;
+	unsigned *cq_tail;
+	unsigned *cq_mask;
+	void *cqes;
+	/** Tail of the queued entries, published on flush. */
+	unsigned sq_queued;
+	/** Head of the entries which are not submitted yet. */
+	unsigned sq_submitted;
+	/** Number of submitted and not completed operations. */
+	unsigned in_flight;
+	/** Copies of the iovecs of the queued writes. */
+	struct region region;
+	/** Submits the queued operations before poll. */
+	struct ev_prepare prepare;
+	/** Makes poll nonblocking if a flush left work behind. */
+	struct ev_idle idle;
+	struct ev_loop *loop;
+};
+
+/**
+ * Create a ring of @a entries submission queue entries and
+ * attach it to the event @a loop.
+ * @retval  0 Success.
+ * @retval -1 io_uring is not supported or failed, diag is set.
+ */
+int
+uring_create(struct uring *ring, unsigned entries, struct ev_loop *loop);
+
+/**
+ * Destroy the ring. There must be no busy operations, cancel
+ * them first.
+ */
+void
+uring_destroy(struct uring *ring);
+
+/**
+ * Queue a nonblocking recv() of up to @a len bytes to @a buf.
+ * @retval  0 Success, @a cb is called on completion.
+ * @retval -1 The ring is full, do the read synchronously.
+ */
+int
+uring_recv(struct uring *ring, struct uring_op *op, int fd,
+	   void *buf, size_t len, uring_op_f cb);
+
+/**
+ * Queue a nonblocking sendmsg() of @a iov. The iovec array
+ * is copied, the data it points to is not.
+ * @retval  0 Success, @a cb is called on completion.
+ * @retval -1 The ring is full, do the write synchronously.
+ */
+int
+uring_sendmsg(struct uring *ring, struct uring_op *op, int fd,
+	      const struct iovec *iov, int iovcnt, uring_op_f cb);
+
+/**
+ * Cancel an operation: it is not submitted if it is still
+ * queued, and its callback is not called. Works for idle
+ * operations too.
+ */
+void
+uring_op_cancel(struct uring_op *op);
+
+/**
+ * Submit the queued operations and call the callbacks of the
+ * completed ones. Is called automatically before the event
+ * loop polls for events.
+ */
+void
+uring_flush(struct uring *ring);
+
+#if defined(__cplusplus)
+} /* extern "C" */
+#endif /* defined(__cplusplus) */
+
+#endif /* TARANTOOL_LIB_CORE_URING_H_INCLUDED */
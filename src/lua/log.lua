@@ -22,6 +22,16 @@ ffi.cdef[[
     void
     say_set_log_format(enum say_format format);
 
+    struct say_async_stat {
+        bool is_enabled;
+        uint64_t written;
+        uint64_t overflows;
+        uint64_t dropped;
+    };
+
+    void
+    say_logger_async_stat(struct say_async_stat *stat);
+
 
     extern sayfunc_t _say;
     extern struct ev_loop;
@@ -144,6 +154,18 @@ local function log_pid()
     return tonumber(ffi.C.log_pid)
 end
 
+local async_stat = ffi.new('struct say_async_stat')
+
+local function log_stat()
+    ffi.C.say_logger_async_stat(async_stat)
+    return {
+        async = async_stat.is_enabled,
+        written = tonumber(async_stat.written),
+        overflows = tonumber(async_stat.overflows),
+        dropped = tonumber(async_stat.dropped),
+    }
+end
+
 local compat_warning_said = false
 local compat_v16 = {
     logger_pid = function()
@@ -165,6 +187,7 @@ return setmetatable({
     pid = log_pid;
     level = log_level;
     log_format = log_format;
+    stat = log_stat;
 }, {
     __index = compat_v16;
 })
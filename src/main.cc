@@ -572,6 +572,16 @@ load_cfg()
 	if (background)
 		daemonize();
 
+	/*
+	 * The logger thread is started after daemonising,
+	 * since threads do not survive fork().
+	 */
+	if (cfg_getb("log_async") == 1 &&
+	    say_logger_async_start(cfg_getb("log_async_drop") == 1) != 0) {
+		diag_log();
+		panic("failed to start the logger thread");
+	}
+
 	/*
 	 * after (optional) daemonising to avoid confusing messages with
 	 * different pids
@@ -636,7 +646,7 @@ tarantool_free(void)
 	if (!cord_is_main())
 		return;
 
-	/* Shutdown worker pool. Waits until threads terminate. */
+	/* Stop the worker pool threads. */
 	coio_shutdown();
 
 	box_free();
@@ -820,7 +830,6 @@ main(int argc, char **argv)
 
 	fiber_init(fiber_cxx_invoke);
 	popen_init();
-	coio_init();
 	coio_enable();
 	signal_init();
 	cbus_init();
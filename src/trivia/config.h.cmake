@@ -170,6 +170,10 @@
 #cmakedefine HAVE_FALLOCATE 1
 #cmakedefine HAVE_MREMAP 1
 #cmakedefine HAVE_SYNC_FILE_RANGE 1
+#cmakedefine HAVE_IO_URING 1
+#cmakedefine HAVE_MEMFD_CREATE 1
+#cmakedefine HAVE_EVENTFD 1
+#cmakedefine HAVE_MBIND 1
 
 #cmakedefine HAVE_MSG_NOSIGNAL 1
 #cmakedefine HAVE_SO_NOSIGPIPE 1
@@ -194,6 +198,8 @@
 
 #cmakedefine HAVE_PTHREAD_GET_STACKSIZE_NP 1
 #cmakedefine HAVE_PTHREAD_GET_STACKADDR_NP 1
+/** pthread_setaffinity_np(pthread_self(), size, cpu_set) - Glibc */
+#cmakedefine HAVE_PTHREAD_SETAFFINITY_NP 1
 
 #cmakedefine HAVE_SETPROCTITLE 1
 #cmakedefine HAVE_SETPROGNAME 1
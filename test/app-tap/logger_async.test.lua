@@ -0,0 +1,52 @@
+#!/usr/bin/env tarantool
+
+local test = require('tap').test('log_async')
+test:plan(6)
+
+local log = require('log')
+local fiber = require('fiber')
+
+local filename = 'logger_async.log'
+box.cfg{
+    log = filename,
+    log_async = true,
+    memtx_memory = 107374182,
+}
+
+local stat = log.stat()
+test:ok(stat.async, 'the logger thread is running')
+
+local file = io.open(filename)
+while file:read() do
+end
+
+-- Messages are written by the logger thread in order.
+local count = 100
+local written = log.stat().written
+for i = 1, count do
+    log.info('message %d', i)
+end
+while log.stat().written < written + count do
+    fiber.sleep(0.001)
+end
+local is_ordered = true
+for i = 1, count do
+    local line = file:read()
+    if line == nil or line:match('I>%s+(.*)') ~= 'message ' .. i then
+        is_ordered = false
+    end
+end
+test:ok(is_ordered, 'messages are in order')
+
+stat = log.stat()
+test:is(stat.overflows, 0, 'no overflows')
+test:is(stat.dropped, 0, 'no drops')
+
+local ok, err = pcall(box.cfg, {log_async = false})
+test:ok(not ok, 'log_async is not dynamic')
+test:like(tostring(err), "Can't set option 'log_async' dynamically",
+          'error message')
+
+file:close()
+test:check()
+os.exit()
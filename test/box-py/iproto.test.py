@@ -426,6 +426,55 @@ print "Retcode: ", resp['body'][IPROTO_DATA]
 
 c.close()
 
+#
+# BATCH request: several DML statements in one transaction.
+#
+IPROTO_STATEMENTS = 0x2c
+REQUEST_TYPE_BATCH = 14
+
+c = Connection('localhost', server.iproto.port)
+c.connect()
+s = c._socket
+
+header = { IPROTO_CODE: REQUEST_TYPE_BATCH, IPROTO_SYNC: 200 }
+body = { IPROTO_STATEMENTS: [
+    { IPROTO_CODE: REQUEST_TYPE_INSERT, IPROTO_SPACE_ID: 568,
+      IPROTO_TUPLE: [2, 0] },
+    { IPROTO_CODE: REQUEST_TYPE_REPLACE, IPROTO_SPACE_ID: 568,
+      IPROTO_TUPLE: [3, 0] },
+    { IPROTO_CODE: REQUEST_TYPE_DELETE, IPROTO_SPACE_ID: 568,
+      IPROTO_KEY: [1] },
+    { IPROTO_CODE: REQUEST_TYPE_DELETE, IPROTO_SPACE_ID: 568,
+      IPROTO_KEY: [100] } ] }
+resp = test_request(header, body)
+print 'sync=%d, %s' % (resp['header'][IPROTO_SYNC], resp['body'])
+
+# A failed statement rolls back the whole batch.
+header[IPROTO_SYNC] = 201
+body = { IPROTO_STATEMENTS: [
+    { IPROTO_CODE: REQUEST_TYPE_INSERT, IPROTO_SPACE_ID: 568,
+      IPROTO_TUPLE: [4, 0] },
+    { IPROTO_CODE: REQUEST_TYPE_INSERT, IPROTO_SPACE_ID: 568,
+      IPROTO_TUPLE: [2, 1] } ] }
+resp = test_request(header, body)
+print 'sync=%d, %s' % (resp['header'][IPROTO_SYNC], resp['body'])
+admin("space:count()")
+
+# Only DML statements are allowed.
+header[IPROTO_SYNC] = 202
+body = { IPROTO_STATEMENTS: [
+    { IPROTO_CODE: REQUEST_TYPE_SELECT, IPROTO_SPACE_ID: 568,
+      IPROTO_KEY: [] } ] }
+resp = test_request(header, body)
+print 'sync=%d, %s' % (resp['header'][IPROTO_SYNC], resp['body'])
+
+header[IPROTO_SYNC] = 203
+body = { IPROTO_STATEMENTS: [ { IPROTO_SPACE_ID: 568 } ] }
+resp = test_request(header, body)
+print 'sync=%d, %s' % (resp['header'][IPROTO_SYNC], resp['body'])
+
+c.close()
+
 admin("box.schema.user.revoke('guest', 'read,write,execute', 'universe')")
 
 admin("space:drop()")
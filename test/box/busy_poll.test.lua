@@ -0,0 +1,36 @@
+fiber = require('fiber')
+net = require('net.box')
+
+--
+-- busy_poll: the event loops of the tx, iproto and WAL threads
+-- spin for up to the given time before blocking.
+--
+box.cfg.busy_poll
+box.cfg{busy_poll = -1}
+box.cfg{busy_poll = 2}
+box.cfg{busy_poll = 0.0001}
+box.cfg.busy_poll
+
+box.schema.user.grant('guest', 'read,write,execute', 'universe')
+s = box.schema.space.create('test')
+_ = s:create_index('pk')
+c = net.connect(box.cfg.listen)
+for i = 1, 100 do c.space.test:replace{i} end
+c:close()
+fiber.sleep(0.01)
+
+stat = box.stat.busy_poll()
+stat.tx.spin_time > 0, stat.tx.hits + stat.tx.misses > 0
+stat.net.spin_time > 0, stat.net.hits + stat.net.misses > 0
+stat.wal.spin_time > 0, stat.wal.hits + stat.wal.misses > 0
+stat.tx.spin_limit <= box.cfg.busy_poll
+
+-- Disabled busy polling does not spin.
+box.cfg{busy_poll = 0}
+stat = box.stat.busy_poll()
+fiber.sleep(0.01)
+box.stat.busy_poll().tx.spin_time == stat.tx.spin_time
+box.stat.busy_poll().tx.spin_limit
+
+s:drop()
+box.schema.user.revoke('guest', 'read,write,execute', 'universe')
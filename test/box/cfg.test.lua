@@ -137,6 +137,27 @@ box.cfg{net_msg_max = 2}
 box.cfg{net_msg_max = old + 1000}
 box.cfg{net_msg_max = old}
 
+--
+-- iproto_threads can be set only at startup, network
+-- statistics is reported per thread as well.
+--
+box.cfg{iproto_threads = 2}
+#box.stat.net.thread()
+box.stat.net.thread()[1].CONNECTIONS.current == box.stat.net.CONNECTIONS.current
+
+--
+-- iproto_uring can be set only at startup too.
+--
+box.cfg{iproto_uring = true}
+
+--
+-- Buffers of idle connections are released after
+-- iproto_buffer_idle_timeout, 0 disables it.
+--
+box.cfg{iproto_buffer_idle_timeout = -1}
+box.cfg{iproto_buffer_idle_timeout = 0}
+box.cfg{iproto_buffer_idle_timeout = 60}
+
 test_run:cmd("clear filter")
 
 --
@@ -0,0 +1,60 @@
+test_run = require('test_run').new()
+fio = require('fio')
+fiber = require('fiber')
+socket = require('socket')
+
+--
+-- The coio thread pool executes blocking calls in a lane per
+-- priority: metadata operations and name resolution in the
+-- high one, bulk file I/O and syncs in the low one.
+--
+stat = box.stat.coio()
+stat.threads == box.cfg.worker_pool_threads
+stat.high ~= nil, stat.normal ~= nil, stat.low ~= nil
+
+dir = fio.tempdir()
+path = fio.pathjoin(dir, 'file')
+fh = fio.open(path, {'O_CREAT', 'O_RDWR'}, tonumber('644', 8))
+for i = 1, 10 do fh:write('data') end
+fh:fsync()
+fh:close()
+new = box.stat.coio()
+new.high.done - stat.high.done >= 2
+new.low.done - stat.low.done >= 11
+new.low.exec_time > stat.low.exec_time
+new.low.wait_time >= stat.low.wait_time
+
+stat = box.stat.coio()
+_ = socket.getaddrinfo('localhost', 80)
+box.stat.coio().high.done > stat.high.done
+
+-- Concurrent jobs are all executed.
+ch = fiber.channel(10)
+test_run:cmd("setopt delimiter ';'")
+for i = 1, 10 do
+    fiber.create(function()
+        local f = fio.open(path, {'O_RDONLY'})
+        local ok = true
+        for j = 1, 10 do
+            ok = ok and f:pread(4, (j - 1) * 4) == 'data'
+        end
+        f:close()
+        ch:put(ok)
+    end)
+end;
+test_run:cmd("setopt delimiter ''");
+ok = true
+for i = 1, 10 do ok = ch:get() and ok end
+ok
+stat = box.stat.coio()
+stat.high.queued, stat.normal.queued, stat.low.queued
+
+-- The pool is resized on the fly.
+box.cfg{worker_pool_threads = 1}
+box.stat.coio().threads
+fio.stat(path).size
+box.cfg{worker_pool_threads = 4}
+box.stat.coio().threads
+
+fio.unlink(path)
+fio.rmdir(dir)
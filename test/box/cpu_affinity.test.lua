@@ -0,0 +1,32 @@
+ffi = require('ffi')
+fiber = require('fiber')
+ffi.cdef[[int sched_getcpu(void);]]
+
+--
+-- cpu_affinity_<class>: bind the threads of a class to CPUs.
+--
+box.cfg.cpu_affinity_tx
+box.cfg{cpu_affinity_tx = 'a'}
+box.cfg{cpu_affinity_net = '3-1'}
+box.cfg{cpu_affinity_wal = '0,'}
+box.cfg{cpu_affinity_relay = '100000'}
+box.cfg.cpu_affinity_net
+
+-- The CPU the thread runs on is surely available.
+cpu = ffi.C.sched_getcpu()
+box.cfg{cpu_affinity_tx = tostring(cpu)}
+box.cfg.cpu_affinity_tx == tostring(cpu)
+fiber.yield()
+ffi.C.sched_getcpu() == cpu
+
+-- Threads started later are bound too.
+box.cfg{cpu_affinity_vinyl = tostring(cpu), cpu_affinity_coio = tostring(cpu)}
+s = box.schema.space.create('test', {engine = 'vinyl'})
+_ = s:create_index('pk')
+s:replace{1}
+box.snapshot()
+s:drop()
+
+-- An empty list unbinds the threads.
+box.cfg{cpu_affinity_tx = '', cpu_affinity_vinyl = '', cpu_affinity_coio = ''}
+box.cfg.cpu_affinity_tx
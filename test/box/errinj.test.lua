@@ -662,3 +662,20 @@ fh:seek(-256, 'SEEK_END') ~= nil
 line = fh:read(256)
 fh:close()
 string.match(line, 'Failed to allocate') ~= nil
+
+--
+-- A connection which failed to start must not be left in the
+-- list of active connections walked by the idle timer.
+--
+box.cfg{iproto_buffer_idle_timeout = 0.01}
+errinj.set("ERRINJ_TESTING", true)
+cn = net_box.connect(box.cfg.listen)
+cn:ping()
+cn:close()
+errinj.set("ERRINJ_TESTING", false)
+-- Let the idle timer run.
+fiber.sleep(0.1)
+cn = net_box.connect(box.cfg.listen)
+cn:ping()
+cn:close()
+box.cfg{iproto_buffer_idle_timeout = 60}
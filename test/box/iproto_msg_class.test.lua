@@ -0,0 +1,80 @@
+test_run = require('test_run').new()
+fiber = require('fiber')
+net_box = require('net.box')
+
+--
+-- Request classes: pings, handshake and replication requests
+-- and requests of box.cfg.iproto_critical_users have a quota
+-- of their own and are not queued behind application requests
+-- when net_msg_max is reached.
+--
+box.cfg.iproto_critical_msg_max
+box.cfg.iproto_reject_overload
+box.cfg{iproto_critical_msg_max = 1}
+
+box.schema.user.create('critical', {password = 'secret'})
+box.schema.func.create('do_long_f')
+box.schema.func.create('do_quick_f')
+box.schema.user.grant('guest', 'execute', 'function', 'do_long_f')
+box.schema.user.grant('guest', 'execute', 'function', 'do_quick_f')
+box.schema.user.grant('critical', 'execute', 'function', 'do_quick_f')
+
+test_run:cmd("setopt delimiter ';'")
+active = 0;
+continue = false;
+errors = {};
+function do_long_f()
+    active = active + 1
+    while not continue do
+        fiber.sleep(0.01)
+    end
+    active = active - 1
+end;
+function do_quick_f()
+    return 42
+end;
+function do_long(c)
+    local ok, err = pcall(c.call, c, 'do_long_f')
+    if not ok then
+        table.insert(errors, err.code)
+    end
+end;
+test_run:cmd("setopt delimiter ''");
+
+old_msg_max = box.cfg.net_msg_max
+box.cfg{net_msg_max = 2, iproto_critical_users = 'critical'}
+conn = net_box.connect(box.cfg.listen)
+conn_ping = net_box.connect(box.cfg.listen)
+for i = 1, 10 do fiber.create(do_long, conn) end
+-- The input is stopped when net_msg_max + 1 requests are active.
+test_run:wait_cond(function() return active == 3 end)
+fiber.sleep(0.01)
+active
+
+-- Pings are not queued behind the application requests.
+conn_ping:ping()
+-- Neither are the requests of critical users.
+conn_critical = net_box.connect(box.cfg.listen, {user = 'critical', password = 'secret'})
+conn_critical:call('do_quick_f')
+
+--
+-- When iproto_reject_overload is set, the requests over the
+-- quota are rejected, including the ones of stopped connections.
+--
+box.cfg{iproto_reject_overload = true}
+test_run:wait_cond(function() return #errors == 7 end)
+errors[1] == box.error.REQUEST_OVERLOAD
+conn:call('do_quick_f')
+box.stat.net.REJECTED.total >= 8
+active
+continue = true
+test_run:wait_cond(function() return active == 0 end)
+conn:call('do_quick_f')
+
+conn:close()
+conn_ping:close()
+conn_critical:close()
+box.cfg{net_msg_max = old_msg_max, iproto_reject_overload = false, iproto_critical_users = ''}
+box.schema.user.drop('critical')
+box.schema.func.drop('do_long_f')
+box.schema.func.drop('do_quick_f')
@@ -0,0 +1,63 @@
+test_run = require('test_run').new()
+net = require('net.box')
+fio = require('fio')
+
+--
+-- iproto_shm_listen: local clients exchange iproto packets with
+-- the instance through shared memory rings instead of a socket.
+--
+path = fio.pathjoin(fio.cwd(), 'iproto_shm.sock')
+box.cfg{iproto_shm_listen = path}
+box.cfg.iproto_shm_listen == path
+fio.path.exists(path)
+box.schema.user.grant('guest', 'read,write,execute', 'universe')
+s = box.schema.space.create('test')
+_ = s:create_index('pk')
+
+conns = box.stat.net.CONNECTIONS.current
+c = net.connect('unix/:' .. path, {shm = true})
+c:ping()
+c.space.test:insert{1, 'small'}
+c.space.test:select{}
+c:eval('return 1 + 1')
+
+-- Packets bigger than a ring are passed in parts.
+big = string.rep('a', 3 * 1024 * 1024)
+c.space.test:replace{2, big}[2] == big
+c.space.test:get{2}[2] == big
+c:eval('return string.len(...)', {big})
+
+-- Many requests in flight.
+test_run:cmd("setopt delimiter ';'")
+futures = {};
+for i = 1, 100 do
+    futures[i] = c.space.test:replace({i + 100, i}, {is_async = true})
+end;
+ok = true;
+for i = 1, 100 do
+    if futures[i]:wait_result()[2] ~= i then ok = false end
+end;
+test_run:cmd("setopt delimiter ''");
+ok
+s:count()
+
+-- Compression works on top of the shared memory.
+z = net.connect('unix/:' .. path, {shm = true, compression = 'zstd'})
+z.space.test:get{2}[2] == big
+z:close()
+
+-- The instance notices the clients have gone.
+c:close()
+test_run:wait_cond(function()                                   \
+    return box.stat.net.CONNECTIONS.current == conns            \
+end)
+
+box.cfg{iproto_shm_listen = ''}
+box.cfg.iproto_shm_listen
+fio.path.exists(path)
+c = net.connect('unix/:' .. path, {shm = true})
+c:is_connected()
+c:close()
+
+s:drop()
+box.schema.user.revoke('guest', 'read,write,execute', 'universe')
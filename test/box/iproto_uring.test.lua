@@ -0,0 +1,58 @@
+test_run = require('test_run').new()
+net = require('net.box')
+fiber = require('fiber')
+
+--
+-- iproto_uring: socket reads and writes of the network threads
+-- are batched with io_uring, or done as usual if io_uring is
+-- unavailable. The results are the same in both cases.
+--
+test_run:cmd("create server uring with script='box/iproto_uring.lua'")
+test_run:cmd("start server uring")
+test_run:cmd("switch uring")
+box.cfg.iproto_uring
+s = box.schema.space.create('test')
+_ = s:create_index('pk')
+test_run:cmd("switch default")
+
+uri = test_run:eval('uring', 'return box.cfg.listen')[1]
+c = net.connect(uri)
+c.space.test:insert{1, 'small'}
+_ = c.space.test:insert{2, string.rep('a', 100000)}
+c.space.test:select{1}
+#c.space.test:select{2}[1][2]
+
+-- Many requests in flight over several connections.
+conns = {}
+for i = 1, 10 do conns[i] = net.connect(uri) end
+test_run:cmd("setopt delimiter ';'")
+ok = true
+fibers = {}
+for i = 1, 10 do
+    local f = fiber.new(function()
+        for j = 1, 100 do
+            local id = 1000 * i + j
+            local t = conns[i].space.test:replace{id, string.rep('x', j * 100)}
+            if conns[i].space.test:get{id}[2] ~= t[2] then
+                ok = false
+            end
+        end
+    end)
+    f:set_joinable(true)
+    table.insert(fibers, f)
+end;
+for _, f in ipairs(fibers) do f:join() end;
+test_run:cmd("setopt delimiter ''");
+ok
+c.space.test:count()
+for i = 1, 10 do conns[i]:close() end
+
+-- Compressed connection, its I/O is synchronous.
+z = net.connect(uri, {compression = 'zstd'})
+#z.space.test:select{2}[1][2]
+z:close()
+
+c:close()
+test_run:cmd("stop server uring")
+test_run:cmd("cleanup server uring")
+test_run:cmd("delete server uring")
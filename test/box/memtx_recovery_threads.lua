@@ -0,0 +1,9 @@
+#!/usr/bin/env tarantool
+os = require('os')
+
+box.cfg{
+    listen                  = os.getenv("LISTEN"),
+    memtx_recovery_threads  = 3,
+}
+
+require('console').listen(os.getenv('ADMIN'))
@@ -0,0 +1,50 @@
+test_run = require('test_run').new()
+
+--
+-- memtx_recovery_threads: the snapshot is read and decoded
+-- by a pipeline of threads, and the secondary keys are built
+-- in parallel.
+--
+test_run:cmd("create server recovery with script='box/memtx_recovery_threads.lua'")
+test_run:cmd("start server recovery")
+test_run:cmd("switch recovery")
+box.cfg.memtx_recovery_threads
+
+-- The option can't be changed dynamically.
+box.cfg{memtx_recovery_threads = 1}
+
+s = box.schema.space.create('test')
+_ = s:create_index('pk')
+_ = s:create_index('sk', {parts = {2, 'unsigned'}})
+_ = s:create_index('hash', {type = 'hash', parts = {2, 'unsigned'}})
+_ = s:create_index('rtree', {type = 'rtree', unique = false, parts = {4, 'array'}})
+_ = s:create_index('bitset', {type = 'bitset', unique = false, parts = {5, 'unsigned'}})
+seq = box.schema.space.create('seq')
+_ = seq:create_index('pk', {sequence = true})
+
+-- Enough rows for the workers to need more index memory
+-- than the slabs allocated on the snapshot load.
+box.begin() for i = 1, 200000 do s:insert{i, 200001 - i, string.rep('x', i % 100), {i, i}, i % 8} end box.commit()
+for i = 1, 100 do seq:insert{box.NULL, i} end
+box.snapshot()
+
+test_run:cmd("switch default")
+test_run:cmd("restart server recovery")
+test_run:cmd("switch recovery")
+s = box.space.test
+seq = box.space.seq
+s:count()
+s:get{1}[2]
+s:get{200000}[2]
+s.index.sk:get{1}[1]
+s.index.hash:get{2}[1]
+s.index.rtree:count({10, 10, 20, 20}, {iterator = 'le'})
+s.index.bitset:count(3, {iterator = 'bits_all_set'})
+s.index.sk:select({}, {limit = 1})[1][1]
+seq:count()
+seq:insert{box.NULL, 101}[1]
+
+test_run:cmd("switch default")
+test_run:cmd("stop server recovery")
+test_run:cmd("cleanup server recovery")
+test_run:cmd("delete server recovery")
@@ -0,0 +1,9 @@
+#!/usr/bin/env tarantool
+os = require('os')
+
+box.cfg{
+    listen                  = os.getenv("LISTEN"),
+    memtx_snap_index_order  = true,
+}
+
+require('console').listen(os.getenv('ADMIN'))
@@ -0,0 +1,71 @@
+test_run = require('test_run').new()
+
+--
+-- memtx_snap_index_order: the snapshot stores the order of
+-- secondary TREE keys, and recovery builds them without
+-- sorting.
+--
+test_run:cmd("create server order with script='box/memtx_snap_index_order.lua'")
+test_run:cmd("start server order")
+test_run:cmd("switch order")
+box.cfg.memtx_snap_index_order
+
+-- The option can't be changed dynamically.
+box.cfg{memtx_snap_index_order = false}
+
+s = box.schema.space.create('test')
+_ = s:create_index('pk')
+_ = s:create_index('sk', {parts = {{2, 'string'}, {3, 'string'}}})
+_ = s:create_index('nu', {unique = false, parts = {3, 'string'}})
+_ = s:create_index('mk', {unique = false, parts = {{'[4][*]', 'unsigned'}}})
+h = box.schema.space.create('hash')
+_ = h:create_index('pk', {type = 'hash'})
+_ = h:create_index('sk', {parts = {2, 'string'}})
+box.begin() for i = 1, 50000 do s:insert{i, tostring(i * 7919 % 10007), tostring(i % 7), {i % 3, i % 5}} h:insert{i, tostring(i)} end box.commit()
+
+function is_sorted(index, field) local prev = nil for _, t in index:pairs() do local k = t[field] if prev ~= nil and k < prev then return false end prev = k end return true end
+function check() return {s.index.sk:count(), is_sorted(s.index.sk, 2), s.index.nu:count(), is_sorted(s.index.nu, 3), s.index.mk:count({1}), h.index.sk:count(), is_sorted(h.index.sk, 2)} end
+check()
+box.snapshot()
+
+-- Only the secondary TREE keys of the space with a TREE
+-- primary key are stored, except for the multikey one.
+xlog = require('xlog')
+fio = require('fio')
+snap = fio.glob(fio.pathjoin(box.cfg.memtx_dir, '*.snap'))
+indexes = {}
+for _, row in xlog.pairs(snap[#snap]) do if row.HEADER.type == 'INDEXORDER' then local key = row.BODY['space id'] .. '/' .. row.BODY['index id'] indexes[key] = (indexes[key] or 0) + #row.BODY['order'] / 4 end end
+indexes[s.id .. '/1']
+indexes[s.id .. '/2']
+indexes[s.id .. '/3']
+indexes[h.id .. '/1']
+
+test_run:cmd("switch default")
+test_run:cmd("restart server order")
+test_run:cmd("switch order")
+s = box.space.test
+h = box.space.hash
+function is_sorted(index, field) local prev = nil for _, t in index:pairs() do local k = t[field] if prev ~= nil and k < prev then return false end prev = k end return true end
+function check() return {s.index.sk:count(), is_sorted(s.index.sk, 2), s.index.nu:count(), is_sorted(s.index.nu, 3), s.index.mk:count({1}), h.index.sk:count(), is_sorted(h.index.sk, 2)} end
+check()
+test_run:cmd("switch default")
+test_run:grep_log('order', 'order from the snapshot is out of date') == nil
+
+-- The order doesn't hold after the space is changed by WAL,
+-- the key is sorted then.
+test_run:cmd("switch order")
+for i = 1, 100 do box.space.test:update(i, {{'=', 2, 'x' .. i}}) end
+test_run:cmd("switch default")
+test_run:cmd("restart server order")
+test_run:cmd("switch order")
+s = box.space.test
+h = box.space.hash
+function is_sorted(index, field) local prev = nil for _, t in index:pairs() do local k = t[field] if prev ~= nil and k < prev then return false end prev = k end return true end
+function check() return {s.index.sk:count(), is_sorted(s.index.sk, 2), s.index.nu:count(), is_sorted(s.index.nu, 3), s.index.mk:count({1}), h.index.sk:count(), is_sorted(h.index.sk, 2)} end
+check()
+s.index.sk:get{'x1', '1'}[1]
+test_run:cmd("switch default")
+test_run:grep_log('order', "index 'sk' order from the snapshot is out of date") ~= nil
+test_run:cmd("stop server order")
+test_run:cmd("cleanup server order")
+test_run:cmd("delete server order")
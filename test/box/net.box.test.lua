@@ -259,6 +259,48 @@ res[2] == string.rep('a', 50000)
 
 box.schema.func.drop('long_rep')
 
+-- big select result tuples are written without copying
+_ = space:insert({1001, 'small'})
+_ = space:insert({1002, string.rep('b', 5000)})
+_ = space:insert({1003, 'small'})
+_ = space:insert({1004, string.rep('c', 50000)})
+res = cn.space.net_box_test_space:select({1001}, {iterator = 'GE', limit = 4})
+#res
+res[1][2] == 'small' and res[3][2] == 'small'
+res[2][2] == string.rep('b', 5000)
+res[4][2] == string.rep('c', 50000)
+for i = 1001, 1004 do space:delete{i} end
+
+-- compressed connection
+c = remote.connect(box.cfg.listen, {compression = 'zstd'})
+c.state
+c:ping()
+_ = space:replace({1001, string.rep('d', 50000)})
+c.space.net_box_test_space:get(1001)[2] == string.rep('d', 50000)
+_ = c.space.net_box_test_space:replace({1002, string.rep('e', 50000)})
+space:get(1002)[2] == string.rep('e', 50000)
+c.space.net_box_test_space:select({1001}, {iterator = 'GE'})[2][1]
+for i = 1001, 1002 do space:delete{i} end
+c:close()
+c = remote.connect(box.cfg.listen, {compression = 'lz4'})
+c.state
+c.error
+c:close()
+-- a compressed frame with a window over the limit is refused
+socket = require('socket')
+sock = socket.tcp_connect(LISTEN.host, LISTEN.service)
+#sock:read(128)
+header = msgpack.encode({[0x00] = 71, [0x01] = 1})
+body = msgpack.encode({[0x2d] = 'zstd'})
+sock:write(msgpack.encode(#header + #body) .. header .. body)
+len = msgpack.decode(sock:read(5))
+#sock:read(len) == len
+-- zstd frame header asking for a 128 MB window
+sock:write(string.fromhex('28B52FFD0088'))
+sock:read(1, 10)
+sock:close()
+test_run:wait_log('default', 'Frame requires too much memory', nil, 10) ~= nil
+
 -- a.b.c.d
 u = '84F7BCFA-079C-46CC-98B4-F0C821BE833E'
 X = {}
@@ -0,0 +1,46 @@
+fio = require('fio')
+clock = require('clock')
+
+--
+-- box.profiler: sampling CPU profiler writing folded stacks.
+--
+info = box.profiler.info()
+info.running, info.samples, info.dropped
+box.profiler.start({interval = 0})
+box.profiler.start({samples = 0})
+box.profiler.start({interval = 0.001})
+box.profiler.start()
+box.profiler.info().running
+
+function burn(t) local deadline = clock.proc() + t while clock.proc() < deadline do end end
+jit.off(burn, true)
+burn(0.5)
+box.profiler.stop()
+info = box.profiler.info()
+info.running
+info.samples > 0
+info.dropped
+
+path = fio.pathjoin(fio.cwd(), 'profiler.folded')
+box.profiler.dump(path) > 0
+f = fio.open(path)
+stacks = f:read()
+f:close()
+-- Every line is a stack of a cord followed by a count.
+lines = stacks:split('\n')
+bad = {}
+for _, l in ipairs(lines) do if l ~= '' and not l:match('^[^;]+;.* %d+$') then table.insert(bad, l) end end
+bad
+-- Lua frames are included.
+stacks:find('burn@', 1, true) ~= nil
+fio.unlink(path)
+
+-- Samples which do not fit are counted as dropped.
+box.profiler.start({interval = 0.001, samples = 1})
+burn(0.1)
+box.profiler.stop()
+box.profiler.info().samples
+box.profiler.info().dropped > 0
+ok, err = pcall(box.profiler.dump, '/no/such/dir/profiler.folded')
+ok, err.type
+box.profiler.stop()
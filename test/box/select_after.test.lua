@@ -0,0 +1,70 @@
+test_run = require('test_run').new()
+net_box = require('net.box')
+
+--
+-- Keyset pagination: select returns the position of the last
+-- tuple with fetch_pos and continues after a position with
+-- the after option.
+--
+s = box.schema.space.create('test')
+_ = s:create_index('pk')
+sk = s:create_index('sk', {parts = {2, 'unsigned'}, unique = false})
+for i = 1, 10 do s:insert{i, i % 3} end
+
+test_run:cmd("setopt delimiter ';'")
+function paginate(index, key, iterator, limit)
+    local pages = {}
+    local tuples, pos
+    repeat
+        tuples, pos = index:select(key, {iterator = iterator, limit = limit,
+                                         after = pos, fetch_pos = true})
+        local page = {}
+        for _, tuple in ipairs(tuples) do
+            table.insert(page, tuple[1])
+        end
+        table.insert(pages, box.tuple.new(page))
+    until pos == nil
+    return pages
+end;
+test_run:cmd("setopt delimiter ''");
+
+paginate(s.index.pk, {}, 'ALL', 4)
+paginate(s.index.pk, {5}, 'GE', 3)
+-- Equal keys of a non-unique index are not skipped or repeated.
+paginate(sk, {}, 'ALL', 4)
+paginate(sk, {1}, 'EQ', 2)
+paginate(sk, {1}, 'REQ', 3)
+paginate(sk, {2}, 'LT', 4)
+
+-- The tuple at the position may be deleted meanwhile.
+page, pos = sk:select({}, {limit = 2, fetch_pos = true})
+page
+s:delete{6}
+sk:select({}, {limit = 2, after = pos})
+
+-- A position of any tuple of the space.
+sk:tuple_pos(s:get{7}) == sk:tuple_pos({7, 1})
+sk:select({}, {limit = 2, after = sk:tuple_pos({1, 1})})
+f = function(tuple) return tuple[1] end
+box.tuple.new(sk:pairs({}, {after = sk:tuple_pos({7, 1})}):map(f):totable())
+box.tuple.new(sk:pairs({0}, {iterator = 'GE', after = pos}):map(f):totable())
+sk:pairs({0}, {iterator = 'GT', after = pos})
+
+s:select({}, {after = 1})
+s:select({}, {after = 'abc'})
+s:select({5}, {iterator = 'GT', after = s.index.pk:tuple_pos({3, 0})})
+sk:select({2}, {after = sk:tuple_pos({1, 1})})
+h = s:create_index('h', {type = 'hash'})
+h:select({}, {after = h:tuple_pos({1, 1})})
+h:drop()
+
+box.schema.user.grant('guest', 'read', 'space', 'test')
+c = net_box.connect(box.cfg.listen)
+paginate(c.space.test.index.sk, {}, 'ALL', 4)
+paginate(c.space.test.index.sk, {1}, 'REQ', 3)
+c.space.test.index.sk:select({}, {limit = 2, after = sk:tuple_pos({1, 1})})
+c.space.test:select({}, {after = 'abc'})
+c:close()
+box.schema.user.revoke('guest', 'read', 'space', 'test')
+
+s:drop()
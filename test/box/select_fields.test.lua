@@ -0,0 +1,34 @@
+net_box = require('net.box')
+
+--
+-- SELECT projection: only the requested fields of the tuples
+-- are returned, by field number, name or JSON path. A missing
+-- field is nil.
+--
+format = {{'id', 'unsigned'}, {'name', 'string'}, {'data', 'map'}}
+s = box.schema.space.create('test', {format = format})
+_ = s:create_index('pk')
+s:insert{1, 'a', {x = 10, y = {20, 30}}}
+s:insert{2, 'b', {x = 11}, 'extra'}
+
+s:select({}, {fields = {1, 3}})
+s:select({}, {fields = {'name', 'id'}})
+s:select({2}, {fields = {'data.x', '[3].y[2]', 4}})
+s.index.pk:select({1}, {fields = {5}})
+s:select({}, {fields = {}})
+
+s:select({}, {fields = 1})
+s:select({}, {fields = {1, ''}})
+s:select({}, {fields = {true}})
+
+box.schema.user.grant('guest', 'read', 'space', 'test')
+c = net_box.connect(box.cfg.listen)
+c.space.test:select({}, {fields = {1, 3}})
+c.space.test:select({}, {fields = {'name', 'id'}})
+c.space.test:select({2}, {fields = {'data.x', '[3].y[2]', 4}})
+c.space.test.index.pk:select({1}, {fields = {5}})
+c.space.test:select({}, {fields = {1, ''}})
+c:close()
+box.schema.user.revoke('guest', 'read', 'space', 'test')
+
+s:drop()
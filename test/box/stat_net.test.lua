@@ -53,6 +53,24 @@ future2:wait_result()
 test_run:wait_cond(function() return box.stat.net.REQUESTS.current == 0 end, WAIT_COND_TIMEOUT)
 box.stat.net.REQUESTS.total - requests_total_saved == 2
 
+-- latency
+latency = box.stat.latency()
+latency.CALL.net.p50 >= 0 and latency.CALL.wal.p50 >= 0
+-- tweedledee was blocked in tx for a while
+latency.CALL.tx.p999 >= latency.CALL.tx.p50 and latency.CALL.tx.p999 > 0
+latency.SELECT.flush.p99 >= 0
+latency.CALL_16
+
+-- buffers of idle connections are released
+box.stat.net.BUFFERS.current > 0
+box.stat.net.BUFFERS.per_connection == box.stat.net.BUFFERS.current
+box.stat.net.thread()[1].BUFFERS.current == box.stat.net.BUFFERS.current
+box.cfg{iproto_buffer_idle_timeout = 0.01}
+test_run:wait_cond(function() return box.stat.net.BUFFERS.current == 0 end, WAIT_COND_TIMEOUT)
+cn.space.tweedledum:select()
+box.stat.net.BUFFERS.current > 0
+box.cfg{iproto_buffer_idle_timeout = 60}
+
 -- reset
 box.stat.reset()
 box.stat.net.SENT.total
@@ -0,0 +1,9 @@
+#!/usr/bin/env tarantool
+os = require('os')
+
+box.cfg{
+    listen              = os.getenv("LISTEN"),
+    wal_mode            = 'fsync',
+}
+
+require('console').listen(os.getenv('ADMIN'))
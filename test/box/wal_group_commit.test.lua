@@ -0,0 +1,64 @@
+test_run = require('test_run').new()
+
+--
+-- wal_group_commit_window, wal_group_commit_size: in the fsync
+-- mode the WAL thread waits for more transactions to write and
+-- sync them at once. box.stat.wal() shows the batch sizes and
+-- the write times.
+--
+box.cfg{wal_group_commit_window = -1}
+box.cfg{wal_group_commit_window = 2}
+box.cfg{wal_group_commit_size = 0}
+box.cfg.wal_group_commit_window
+box.cfg.wal_group_commit_size
+
+test_run:cmd("create server group with script='box/wal_group_commit.lua'")
+test_run:cmd("start server group")
+test_run:cmd("switch group")
+fiber = require('fiber')
+s = box.schema.space.create('test')
+_ = s:create_index('pk')
+
+stat = box.stat.wal()
+stat.batch_size.count > 0
+stat.fsync_latency.count == stat.batch_size.count
+type(stat.batch_size.histogram)
+type(stat.fsync_latency.p99)
+
+-- Transactions committed within the window are written at once.
+box.cfg{wal_group_commit_window = 0.5, wal_group_commit_size = 1024 * 1024}
+box.stat.reset()
+test_run:cmd("setopt delimiter ';'")
+function write(n)
+    local fibers = {}
+    for i = 1, n do
+        local f = fiber.new(function()
+            fiber.sleep(i * 0.001)
+            s:replace{i}
+        end)
+        f:set_joinable(true)
+        table.insert(fibers, f)
+    end
+    for _, f in ipairs(fibers) do f:join() end
+end;
+test_run:cmd("setopt delimiter ''");
+write(10)
+s:count()
+box.stat.wal().batch_size.count < 10
+
+-- A batch of the size is written right away.
+box.cfg{wal_group_commit_size = 1}
+t = fiber.clock()
+s:replace{100}
+fiber.clock() - t < 0.5
+
+-- 0 window disables the wait.
+box.cfg{wal_group_commit_window = 0, wal_group_commit_size = 1024 * 1024}
+box.stat.reset()
+write(10)
+box.stat.wal().batch_size.count > 0
+
+test_run:cmd("switch default")
+test_run:cmd("stop server group")
+test_run:cmd("cleanup server group")
+test_run:cmd("delete server group")
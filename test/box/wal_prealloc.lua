@@ -0,0 +1,12 @@
+#!/usr/bin/env tarantool
+os = require('os')
+
+box.cfg{
+    listen              = os.getenv("LISTEN"),
+    wal_mode            = 'fsync',
+    wal_max_size        = 16 * 1024,
+    wal_prealloc_count  = 2,
+    checkpoint_count    = 1,
+}
+
+require('console').listen(os.getenv('ADMIN'))
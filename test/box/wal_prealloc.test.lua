@@ -0,0 +1,99 @@
+test_run = require('test_run').new()
+
+--
+-- wal_prealloc_count: new WAL files are created from
+-- preallocated files filled with zeros.
+--
+test_run:cmd("create server prealloc with script='box/wal_prealloc.lua'")
+test_run:cmd("start server prealloc")
+test_run:cmd("switch prealloc")
+fio = require('fio')
+box.cfg.wal_prealloc_count
+
+-- The option can't be changed dynamically.
+box.cfg{wal_prealloc_count = 1}
+
+test_run:wait_cond(function() return #fio.glob('*.spare') == 2 end)
+
+s = box.schema.space.create('test')
+_ = s:create_index('pk')
+for i = 1, 200 do s:replace{i, string.rep('x', 200)} end
+s:count()
+
+-- The WAL has rotated to the preallocated files, and the
+-- pool is refilled.
+xlogs = fio.glob('*.xlog')
+#xlogs > 2
+f = fio.open(xlogs[#xlogs])
+f:read(512):find('Preallocated: true') ~= nil
+f:close()
+test_run:wait_cond(function() return #fio.glob('*.spare') == 2 end)
+
+-- The files removed by garbage collection are reused.
+box.snapshot()
+#fio.glob('*.xlog') < #xlogs
+test_run:wait_cond(function() return #fio.glob('*.spare') == 2 end)
+#fio.glob('*.spare.inprogress')
+
+-- Recovery stops at the zeros after the last row of a file
+-- which wasn't closed.
+for i = 1, 100 do s:update({i}, {{'=', 2, i}}) end
+s:get{100}
+test_run:cmd("switch default")
+test_run:cmd("stop server prealloc with signal=KILL")
+test_run:cmd("start server prealloc")
+test_run:cmd("switch prealloc")
+fio = require('fio')
+s = box.space.test
+s:count()
+s:get{1}
+s:get{100}
+s:get{101}[1]
+
+-- Writes after recovery go on.
+for i = 101, 200 do s:update({i}, {{'=', 2, i}}) end
+test_run:cmd("switch default")
+test_run:cmd("restart server prealloc")
+test_run:cmd("switch prealloc")
+s = box.space.test
+s:count()
+s:get{200}
+
+-- A broken transaction in the middle of a preallocated file
+-- is an error rather than the end of the data written so far.
+fio = require('fio')
+test_run:wait_cond(function() return #fio.glob('*.spare') == 2 end)
+box.snapshot()
+for i = 1, 20 do s:update({i}, {{'=', 2, 'y'}}) end
+xlogs = fio.glob('*.xlog')
+path = fio.abspath(xlogs[#xlogs])
+test_run:cmd("switch default")
+fio = require('fio')
+path = test_run:eval('prealloc', 'path')[1]
+logfile = test_run:eval('prealloc', 'box.cfg.log')[1]
+test_run:cmd("stop server prealloc")
+f = fio.open(path, {'O_RDWR'})
+data = f:read(f:stat().size)
+data:find('Preallocated: true') ~= nil
+markers = {}
+pos = data:find('\213\186\011\171', 1, true)
+while pos ~= nil do table.insert(markers, pos) pos = data:find('\213\186\011\171', pos + 1, true) end
+#markers > 2
+offset = markers[2] + 24
+byte = data:sub(offset, offset)
+f:pwrite(string.char(255 - byte:byte()), offset - 1)
+test_run:cmd("start server prealloc with crash_expected=True")
+log = fio.open(logfile)
+log:read(log:stat().size):find('tx checksum mismatch') ~= nil
+log:close()
+
+f:pwrite(byte, offset - 1)
+f:close()
+test_run:cmd("start server prealloc")
+test_run:cmd("switch prealloc")
+box.space.test:get{20}
+
+test_run:cmd("switch default")
+test_run:cmd("stop server prealloc")
+test_run:cmd("cleanup server prealloc")
+test_run:cmd("delete server prealloc")
@@ -0,0 +1,22 @@
+#!/usr/bin/env tarantool
+os = require('os')
+fio = require('fio')
+
+-- The WAL is striped over the default wal_dir and two more
+-- directories, unless other arguments are given.
+local dir_count = tonumber(arg[1]) or 2
+local wal_mode = arg[2] or 'fsync'
+local dirs = {}
+for i = 1, dir_count do
+    fio.mkdir('wal' .. i)
+    table.insert(dirs, 'wal' .. i)
+end
+
+box.cfg{
+    listen              = os.getenv("LISTEN"),
+    wal_mode            = wal_mode,
+    wal_max_size        = 8 * 1024,
+    wal_stripe_dirs     = dirs,
+}
+
+require('console').listen(os.getenv('ADMIN'))
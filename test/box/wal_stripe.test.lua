@@ -0,0 +1,98 @@
+test_run = require('test_run').new()
+fiber = require('fiber')
+
+--
+-- wal_stripe_dirs: WAL rows are spread over several
+-- directories and merged back in the original order on
+-- recovery.
+--
+test_run:cmd("create server stripe with script='box/wal_stripe.lua'")
+test_run:cmd("start server stripe")
+test_run:cmd("switch stripe")
+fio = require('fio')
+fiber = require('fiber')
+box.cfg.wal_stripe_dirs
+
+-- The option can't be changed dynamically.
+box.cfg{wal_stripe_dirs = {'wal1'}}
+
+s = box.schema.space.create('test')
+_ = s:create_index('pk')
+
+-- Single row transactions, written concurrently to make
+-- batches span several stripes.
+test_run:cmd("setopt delimiter ';'")
+fibers = {}
+for i = 1, 10 do
+    local f = fiber.new(function()
+        for j = 1, 100 do
+            s:replace{i * 1000 + j, i, string.rep('x', j)}
+        end
+    end)
+    f:set_joinable(true)
+    table.insert(fibers, f)
+end;
+for _, f in ipairs(fibers) do f:join() end;
+-- Multi-statement transactions and updates of the same keys,
+-- which must be replayed in order.
+for i = 1, 100 do
+    box.begin()
+    s:update({1000 + i}, {{'+', 2, 1}})
+    s:update({2000 + i}, {{'+', 2, 1}})
+    box.commit()
+end;
+test_run:cmd("setopt delimiter ''");
+s:count()
+s:get{1001}
+s:get{2100}[2]
+
+-- All directories have WAL files, rotated at the same vclocks.
+#fio.glob('*.xlog') > 1
+#fio.glob('wal1/*.xlog') == #fio.glob('*.xlog')
+#fio.glob('wal2/*.xlog') == #fio.glob('*.xlog')
+
+test_run:cmd("switch default")
+test_run:cmd("restart server stripe")
+test_run:cmd("switch stripe")
+s = box.space.test
+s:count()
+s:get{1001}
+s:get{2100}[2]
+s:select({}, {limit = 3})
+
+-- Writes after recovery go on.
+for i = 1, 10 do s:update({1000 + i}, {{'+', 2, 1}}) end
+s:get{1001}
+test_run:cmd("switch default")
+test_run:cmd("restart server stripe")
+test_run:cmd("switch stripe")
+box.space.test:count()
+box.space.test:get{1001}
+
+test_run:cmd("switch default")
+fio = require('fio')
+logfile = test_run:eval('stripe', 'box.cfg.log')[1]
+test_run:cmd("stop server stripe")
+
+-- A striped WAL requires the fsync mode, since a batch is
+-- atomic across the stripes only if they are synced in order.
+test_run:cmd("start server stripe with args='2 write', crash_expected=True")
+log = fio.open(logfile)
+log:read(log:stat().size):find("a striped WAL requires wal_mode = 'fsync'", 1, true) ~= nil
+log:close()
+
+-- A directory can't be removed from wal_stripe_dirs while
+-- there are files striped over it.
+test_run:cmd("start server stripe with args='1 fsync', crash_expected=True")
+log = fio.open(logfile)
+log:read(log:stat().size):find('striped over 3 directories, but 2 are configured', 1, true) ~= nil
+log:close()
+
+test_run:cmd("start server stripe with args='2 fsync'")
+test_run:cmd("switch stripe")
+box.space.test:count()
+
+test_run:cmd("switch default")
+test_run:cmd("stop server stripe")
+test_run:cmd("cleanup server stripe")
+test_run:cmd("delete server stripe")
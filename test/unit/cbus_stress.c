@@ -1,13 +1,16 @@
 #include <assert.h>
+#include <pthread.h>
 #include <stdarg.h>
 #include <stddef.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <time.h>
 
 #include "memory.h"
 #include "fiber.h"
 #include "cbus.h"
+#include "clock.h"
 #include "unit.h"
 
 /*
@@ -27,6 +30,15 @@ static const int connect_prob = 30;
 /* Chance of disconnecting from a random neighbor in a loop iteration. */
 static const int disconnect_prob = 20;
 
+/* Number of threads flooding the main thread in the benchmark. */
+static const int bench_producer_count = 4;
+
+/* Number of messages sent by each of them. */
+static const int bench_msg_count = 200000;
+
+/* Print the benchmark results, set with -v. */
+static bool verbose = false;
+
 /* This structure represents a connection to a test thread. */
 struct conn {
 	bool active;
@@ -325,6 +337,197 @@ thread_func(va_list ap)
 	return 0;
 }
 
+/*
+ * Throughput benchmark: producer threads flood the main thread
+ * with messages. Each message is checked to arrive in the order
+ * it was sent by its producer. The messages go either through
+ * cbus or, as a baseline, through the mutex protected queue
+ * cbus endpoints used before, see bench_mutex_endpoint.
+ */
+struct bench_msg {
+	struct cmsg cmsg;
+	int producer_id;
+	int seq;
+};
+
+struct bench_producer {
+	int id;
+	char name[32];
+	struct cord cord;
+	/* Max staged input of the pipe to the main thread. */
+	int max_input;
+	/* Send the messages through bench_mutex_endpoint. */
+	bool use_mutex;
+	struct bench_msg *msgs;
+};
+
+/*
+ * The old cbus endpoint queue: a pipe flush splices the staged
+ * messages onto the output list under the mutex and notifies
+ * the consumer if the list was empty, the consumer fetches the
+ * whole list under the mutex.
+ */
+struct bench_mutex_endpoint {
+	pthread_mutex_t mutex;
+	struct stailq output;
+	ev_loop *consumer;
+	ev_async async;
+};
+
+static struct bench_mutex_endpoint bench_mutex_endpoint;
+
+static void
+bench_mutex_flush(struct stailq *input)
+{
+	struct bench_mutex_endpoint *endpoint = &bench_mutex_endpoint;
+	pthread_mutex_lock(&endpoint->mutex);
+	bool output_was_empty = stailq_empty(&endpoint->output);
+	stailq_concat(&endpoint->output, input);
+	pthread_mutex_unlock(&endpoint->mutex);
+	if (output_was_empty)
+		ev_async_send(endpoint->consumer, &endpoint->async);
+}
+
+static void
+bench_mutex_process(void)
+{
+	struct bench_mutex_endpoint *endpoint = &bench_mutex_endpoint;
+	struct stailq output;
+	stailq_create(&output);
+	pthread_mutex_lock(&endpoint->mutex);
+	stailq_concat(&output, &endpoint->output);
+	pthread_mutex_unlock(&endpoint->mutex);
+	while (!stailq_empty(&output)) {
+		struct cmsg *msg = stailq_shift_entry(&output, struct cmsg,
+						      fifo);
+		cmsg_deliver(msg);
+	}
+}
+
+/* Producer id => sequence number of the last received message. */
+static int *bench_last_seq;
+static int bench_received;
+static bool bench_order_ok;
+
+static void
+bench_msg_cb(struct cmsg *cmsg)
+{
+	struct bench_msg *msg = container_of(cmsg, struct bench_msg, cmsg);
+	if (msg->seq != bench_last_seq[msg->producer_id] + 1)
+		bench_order_ok = false;
+	bench_last_seq[msg->producer_id] = msg->seq;
+	bench_received++;
+}
+
+static int
+bench_producer_func(va_list ap)
+{
+	struct bench_producer *p = va_arg(ap, struct bench_producer *);
+	static struct cmsg_hop route[] = {
+		{ bench_msg_cb, NULL }
+	};
+	if (p->use_mutex) {
+		struct stailq input;
+		stailq_create(&input);
+		int n_input = 0;
+		for (int i = 0; i < bench_msg_count; i++) {
+			struct bench_msg *msg = &p->msgs[i];
+			cmsg_init(&msg->cmsg, route);
+			msg->producer_id = p->id;
+			msg->seq = i;
+			stailq_add_tail_entry(&input, &msg->cmsg, fifo);
+			if (++n_input >= p->max_input) {
+				bench_mutex_flush(&input);
+				n_input = 0;
+			}
+		}
+		if (n_input > 0)
+			bench_mutex_flush(&input);
+		return 0;
+	}
+	struct cpipe pipe;
+	cpipe_create(&pipe, "main");
+	cpipe_set_max_input(&pipe, p->max_input);
+	for (int i = 0; i < bench_msg_count; i++) {
+		struct bench_msg *msg = &p->msgs[i];
+		cmsg_init(&msg->cmsg, route);
+		msg->producer_id = p->id;
+		msg->seq = i;
+		cpipe_push_input(&pipe, &msg->cmsg);
+	}
+	/* Flushes the rest of the input. */
+	cpipe_destroy(&pipe);
+	return 0;
+}
+
+static void
+bench_run(struct cbus_endpoint *endpoint, int max_input, bool use_mutex)
+{
+	struct bench_producer *producers =
+		calloc(bench_producer_count, sizeof(*producers));
+	assert(producers != NULL);
+	bench_last_seq = calloc(bench_producer_count,
+				sizeof(*bench_last_seq));
+	assert(bench_last_seq != NULL);
+	bench_received = 0;
+	bench_order_ok = true;
+	if (use_mutex) {
+		struct bench_mutex_endpoint *e = &bench_mutex_endpoint;
+		pthread_mutex_init(&e->mutex, NULL);
+		stailq_create(&e->output);
+		e->consumer = loop();
+		ev_async_init(&e->async,
+			      (void (*)(ev_loop *, struct ev_async *, int))
+			      fiber_schedule_cb);
+		e->async.data = fiber();
+		ev_async_start(e->consumer, &e->async);
+	}
+
+	const int total = bench_producer_count * bench_msg_count;
+	double start = clock_monotonic();
+	for (int i = 0; i < bench_producer_count; i++) {
+		struct bench_producer *p = &producers[i];
+		p->id = i;
+		p->max_input = max_input;
+		p->use_mutex = use_mutex;
+		bench_last_seq[i] = -1;
+		snprintf(p->name, sizeof(p->name), "producer_%d", i);
+		p->msgs = calloc(bench_msg_count, sizeof(*p->msgs));
+		assert(p->msgs != NULL);
+		if (cord_costart(&p->cord, p->name,
+				 bench_producer_func, p) != 0)
+			unreachable();
+	}
+	while (bench_received < total) {
+		if (use_mutex)
+			bench_mutex_process();
+		else
+			cbus_process(endpoint);
+		if (bench_received < total)
+			fiber_yield();
+	}
+	double elapsed = clock_monotonic() - start;
+
+	for (int i = 0; i < bench_producer_count; i++) {
+		if (cord_join(&producers[i].cord) != 0)
+			unreachable();
+		free(producers[i].msgs);
+	}
+	assert(bench_order_ok);
+	if (use_mutex) {
+		struct bench_mutex_endpoint *e = &bench_mutex_endpoint;
+		ev_async_stop(e->consumer, &e->async);
+		pthread_mutex_destroy(&e->mutex);
+	}
+	if (verbose) {
+		printf("%s, max_input %d: %d messages in %.3f sec, "
+		       "%.0f messages/sec\n", use_mutex ? "mutex" : "cbus",
+		       max_input, total, elapsed, total / elapsed);
+	}
+	free(bench_last_seq);
+	free(producers);
+}
+
 static int
 main_func(va_list ap)
 {
@@ -353,6 +556,15 @@ main_func(va_list ap)
 	}
 	assert(sent == received);
 
+	/*
+	 * A message per flush, and batches of messages, each
+	 * with the old mutex queue as a baseline.
+	 */
+	bench_run(&endpoint, 1, true);
+	bench_run(&endpoint, 1, false);
+	bench_run(&endpoint, 64, true);
+	bench_run(&endpoint, 64, false);
+
 	cbus_endpoint_destroy(&endpoint, cbus_process);
 
 	free(threads);
@@ -364,8 +576,11 @@ main_func(va_list ap)
 }
 
 int
-main()
+main(int argc, char **argv)
 {
+	if (argc > 1 && strcmp(argv[1], "-v") == 0)
+		verbose = true;
+
 	srand(time(NULL));
 
 	memory_init();
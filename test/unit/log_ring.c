@@ -0,0 +1,140 @@
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "trivia/util.h"
+#include "log_ring.h"
+#include "unit.h"
+
+static void
+test_order(void)
+{
+	header();
+	plan(4);
+
+	struct log_ring ring;
+	log_ring_create(&ring, 4096);
+	is(ring.size, 4096, "size");
+
+	/* Wrap around the ring many times with varying records. */
+	char msg[512];
+	int next_put = 0, next_get = 0;
+	bool is_ok = true;
+	while (next_get < 1000) {
+		while (next_put < 1000) {
+			int len = snprintf(msg, sizeof(msg), "%d:%*s", next_put,
+					   next_put % 300, "");
+			if (log_ring_put(&ring, msg, len) != 0)
+				break;
+			next_put++;
+		}
+		size_t len;
+		const char *rec;
+		while ((rec = log_ring_get(&ring, &len)) != NULL) {
+			int expected_len = snprintf(msg, sizeof(msg), "%d:%*s",
+						    next_get, next_get % 300,
+						    "");
+			if ((int)len != expected_len ||
+			    memcmp(rec, msg, len) != 0)
+				is_ok = false;
+			log_ring_next(&ring);
+			next_get++;
+		}
+	}
+	ok(is_ok, "records are consumed in order");
+	ok(log_ring_is_empty(&ring), "empty");
+
+	/* The ring is full, then a record is consumed. */
+	memset(msg, 'x', sizeof(msg));
+	int count = 0;
+	while (log_ring_put(&ring, msg, 100) == 0)
+		count++;
+	size_t len;
+	while (log_ring_get(&ring, &len) != NULL)
+		log_ring_next(&ring);
+	ok(count > 0 && log_ring_put(&ring, msg, 100) == 0, "full");
+
+	log_ring_destroy(&ring);
+	check_plan();
+	footer();
+}
+
+enum {
+	PRODUCER_COUNT = 4,
+	RECORD_COUNT = 100000,
+};
+
+static struct log_ring stress_ring;
+
+static void *
+producer_f(void *arg)
+{
+	int id = (int)(intptr_t)arg;
+	char msg[64];
+	for (int i = 0; i < RECORD_COUNT; i++) {
+		int len = snprintf(msg, sizeof(msg), "%d %d", id, i);
+		while (log_ring_put(&stress_ring, msg, len) != 0)
+			sched_yield();
+	}
+	return NULL;
+}
+
+static void
+test_producers(void)
+{
+	header();
+	plan(2);
+
+	log_ring_create(&stress_ring, 8192);
+	pthread_t threads[PRODUCER_COUNT];
+	for (int i = 0; i < PRODUCER_COUNT; i++) {
+		pthread_create(&threads[i], NULL, producer_f,
+			       (void *)(intptr_t)i);
+	}
+	int next[PRODUCER_COUNT] = {0};
+	int total = 0;
+	bool is_ok = true;
+	while (total < PRODUCER_COUNT * RECORD_COUNT) {
+		size_t len;
+		const char *rec = log_ring_get(&stress_ring, &len);
+		if (rec == NULL) {
+			sched_yield();
+			continue;
+		}
+		char msg[64];
+		memcpy(msg, rec, len);
+		msg[len] = '\0';
+		int id, seq;
+		if (sscanf(msg, "%d %d", &id, &seq) != 2 ||
+		    id < 0 || id >= PRODUCER_COUNT || next[id] != seq)
+			is_ok = false;
+		else
+			next[id]++;
+		log_ring_next(&stress_ring);
+		total++;
+	}
+	for (int i = 0; i < PRODUCER_COUNT; i++)
+		pthread_join(threads[i], NULL);
+	ok(is_ok, "records of each producer are consumed in order");
+	ok(log_ring_is_empty(&stress_ring), "empty");
+	log_ring_destroy(&stress_ring);
+
+	check_plan();
+	footer();
+}
+
+int
+main(void)
+{
+	header();
+	plan(2);
+
+	test_order();
+	test_producers();
+
+	int rc = check_plan();
+	footer();
+	return rc;
+}
@@ -251,7 +251,6 @@ main(int argc, char *argv[])
 
 	fiber_init(fiber_c_invoke);
 	popen_init();
-	coio_init();
 	coio_enable();
 
 	if (!loop())
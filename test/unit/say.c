@@ -234,7 +234,6 @@ int main()
 	}
 	log_destroy(&test_log);
 
-	coio_init();
 	coio_enable();
 
 	struct fiber *test = fiber_new("loggers", main_f);
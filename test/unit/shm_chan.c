@@ -0,0 +1,135 @@
+/*
+ * Copyright 2010-2020, Tarantool AUTHORS, please see AUTHORS file.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "unit.h"
+#include "memory.h"
+#include "fiber.h"
+#include "shm_chan.h"
+
+/** Create a channel and pass it from the server to the client. */
+static void
+chan_pair_create(struct shm_chan *server, struct shm_chan *client)
+{
+	int sv[2];
+	fail_if(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0);
+	fail_if(shm_chan_create(server, 4096) != 0);
+	fail_if(shm_chan_send(server, sv[0]) != 0);
+	fail_if(shm_chan_recv(client, sv[1]) != 0);
+	close(sv[0]);
+	close(sv[1]);
+}
+
+static void
+test_transfer(void)
+{
+	header();
+	plan(4);
+	struct shm_chan server, client;
+	chan_pair_create(&server, &client);
+	char buf[16];
+	is(shm_chan_write(&client, "hello", 5), 5, "client write");
+	ok(shm_chan_read(&server, buf, sizeof(buf)) == 5 &&
+	   memcmp(buf, "hello", 5) == 0, "server read");
+	is(shm_chan_write(&server, "world", 5), 5, "server write");
+	ok(shm_chan_read(&client, buf, sizeof(buf)) == 5 &&
+	   memcmp(buf, "world", 5) == 0, "client read");
+	shm_chan_destroy(&client);
+	shm_chan_destroy(&server);
+	check_plan();
+	footer();
+}
+
+/**
+ * The client puts bogus positions to the rings of the server.
+ * ring[0] is the client output, ring[1] the server output.
+ */
+static void
+test_broken(void)
+{
+	header();
+	plan(10);
+	struct shm_chan server, client;
+	char buf[16];
+
+	/* The tail of the input is too far ahead of the head. */
+	chan_pair_create(&server, &client);
+	client.hdr->ring[0].tail = 2 * (uint64_t) server.ring_size;
+	is(shm_chan_read(&server, buf, sizeof(buf)), 0, "read too much");
+	ok(shm_chan_is_broken(&server), "broken");
+	ok(shm_chan_is_closed(&server), "broken is closed");
+	ok(!shm_chan_prepare_wait(&server, true, true),
+	   "broken is not waited for");
+	shm_chan_destroy(&client);
+	shm_chan_destroy(&server);
+
+	/* The tail of the input is moved back behind the head. */
+	chan_pair_create(&server, &client);
+	is(shm_chan_write(&client, "hello", 5), 5, "client write");
+	is(shm_chan_read(&server, buf, sizeof(buf)), 5, "server read");
+	client.hdr->ring[0].tail = 1;
+	is(shm_chan_read(&server, buf, sizeof(buf)), 0, "read behind");
+	ok(shm_chan_is_broken(&server), "broken");
+	shm_chan_destroy(&client);
+	shm_chan_destroy(&server);
+
+	/* The head of the output is moved ahead of the tail. */
+	chan_pair_create(&server, &client);
+	client.hdr->ring[1].head = 100;
+	is(shm_chan_write(&server, "hello", 5), 0, "write ahead");
+	ok(shm_chan_is_broken(&server), "broken");
+	shm_chan_destroy(&client);
+	shm_chan_destroy(&server);
+
+	check_plan();
+	footer();
+}
+
+int
+main(void)
+{
+	memory_init();
+	fiber_init(fiber_c_invoke);
+
+	header();
+	plan(2);
+	test_transfer();
+	test_broken();
+	int rc = check_plan();
+	footer();
+
+	fiber_free();
+	memory_free();
+	return rc;
+}
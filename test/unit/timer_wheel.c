@@ -0,0 +1,259 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "memory.h"
+#include "fiber.h"
+#include "timer_wheel.h"
+#include "clock.h"
+#include "unit.h"
+
+/* Print the benchmark results, set with -v. */
+static bool verbose = false;
+
+struct test_timer {
+	struct wheel_timer timer;
+	/* Loop time when the timer must fire, not earlier. */
+	double deadline;
+	/* Position in the order of firing, -1 if not fired. */
+	int order;
+};
+
+static int fired_count;
+static bool fired_early;
+
+static void
+test_timer_cb(struct wheel_timer *timer)
+{
+	struct test_timer *t = (struct test_timer *) timer->data;
+	if (ev_monotonic_now(loop()) < t->deadline)
+		fired_early = true;
+	t->order = fired_count++;
+}
+
+static void
+test_timer_start(struct timer_wheel *wheel, struct test_timer *t,
+		 double delay)
+{
+	wheel_timer_create(&t->timer, test_timer_cb, t);
+	t->deadline = ev_monotonic_now(loop()) + delay;
+	t->order = -1;
+	timer_wheel_start(wheel, &t->timer, delay);
+}
+
+static void
+wait_fired(int count)
+{
+	while (fired_count < count)
+		fiber_sleep(0.001);
+}
+
+static void
+test_order(struct timer_wheel *wheel)
+{
+	header();
+	plan(4);
+
+	static const double delays[] = {0.05, 0, 0.01, 0.03, 0.002};
+	static const int order[] = {4, 0, 2, 3, 1};
+	enum { count = lengthof(delays) };
+	struct test_timer timers[count];
+	fired_count = 0;
+	fired_early = false;
+	for (int i = 0; i < count; i++)
+		test_timer_start(wheel, &timers[i], delays[i]);
+	is(wheel->count, (uint32_t) count, "timers are armed");
+	wait_fired(count);
+	bool in_order = true;
+	for (int i = 0; i < count; i++) {
+		if (timers[i].order != order[i])
+			in_order = false;
+	}
+	ok(in_order, "timers fire in the order of their timeouts");
+	ok(!fired_early, "timers don't fire early");
+	is(wheel->count, 0u, "no timers left");
+
+	check_plan();
+	footer();
+}
+
+static void
+test_stop(struct timer_wheel *wheel)
+{
+	header();
+	plan(3);
+
+	struct test_timer t1, t2, t3;
+	fired_count = 0;
+	test_timer_start(wheel, &t1, 0.01);
+	test_timer_start(wheel, &t2, 0);
+	test_timer_start(wheel, &t3, 0.02);
+	timer_wheel_stop(wheel, &t1.timer);
+	timer_wheel_stop(wheel, &t2.timer);
+	ok(!wheel_timer_is_active(&t1.timer), "stopped timer is inactive");
+	wait_fired(1);
+	fiber_sleep(0.02);
+	ok(t1.order == -1 && t2.order == -1, "stopped timers don't fire");
+	is(t3.order, 0, "other timers fire");
+
+	check_plan();
+	footer();
+}
+
+static void
+test_many(struct timer_wheel *wheel)
+{
+	header();
+	plan(3);
+
+	enum { count = 10000 };
+	struct test_timer *timers = calloc(count, sizeof(*timers));
+	fail_if(timers == NULL);
+	fired_count = 0;
+	fired_early = false;
+	for (int i = 0; i < count; i++) {
+		double delay = (rand() % 200) / 1000.0;
+		test_timer_start(wheel, &timers[i], delay);
+		/* Stop every third timer. */
+		if (i % 3 == 0)
+			timer_wheel_stop(wheel, &timers[i].timer);
+	}
+	int expected = count - (count + 2) / 3;
+	wait_fired(expected);
+	fiber_sleep(0.01);
+	is(fired_count, expected, "all armed timers fire");
+	ok(!fired_early, "timers don't fire early");
+	is(wheel->count, 0u, "no timers left");
+	free(timers);
+
+	check_plan();
+	footer();
+}
+
+static void
+test_fiber_sleep(void)
+{
+	header();
+	plan(2);
+
+	double start = ev_monotonic_now(loop());
+	fiber_sleep(0.01);
+	ok(ev_monotonic_now(loop()) - start >= 0.01, "fiber sleep");
+	ok(fiber_yield_timeout(0.01), "fiber yield timeout");
+
+	check_plan();
+	footer();
+}
+
+/*
+ * Benchmark: arm and cancel a timer while a lot of other timers
+ * are armed, as it happens to fiber timeouts, with the timing
+ * wheel and with libev timers.
+ */
+enum {
+	BENCH_PENDING = 200000,
+	BENCH_ITERATIONS = 1000000,
+};
+
+static void
+bench_ev_cb(ev_loop *loop, struct ev_timer *watcher, int revents)
+{
+	(void) loop;
+	(void) watcher;
+	(void) revents;
+}
+
+static void
+bench_wheel_cb(struct wheel_timer *timer)
+{
+	(void) timer;
+}
+
+static void
+bench(struct timer_wheel *wheel)
+{
+	struct ev_timer *ev_timers = calloc(BENCH_PENDING,
+					    sizeof(*ev_timers));
+	struct wheel_timer *wheel_timers = calloc(BENCH_PENDING,
+						  sizeof(*wheel_timers));
+	double *delays = calloc(BENCH_ITERATIONS, sizeof(*delays));
+	fail_if(ev_timers == NULL || wheel_timers == NULL || delays == NULL);
+	for (int i = 0; i < BENCH_ITERATIONS; i++)
+		delays[i] = 1 + rand() % 10;
+
+	for (int i = 0; i < BENCH_PENDING; i++) {
+		ev_timer_init(&ev_timers[i], bench_ev_cb,
+			      100 + rand() % 1000, 0);
+		ev_timer_start(loop(), &ev_timers[i]);
+	}
+	double start = clock_monotonic();
+	for (int i = 0; i < BENCH_ITERATIONS; i++) {
+		struct ev_timer t;
+		ev_timer_init(&t, bench_ev_cb, delays[i], 0);
+		ev_timer_start(loop(), &t);
+		ev_timer_stop(loop(), &t);
+	}
+	double ev_time = clock_monotonic() - start;
+	for (int i = 0; i < BENCH_PENDING; i++)
+		ev_timer_stop(loop(), &ev_timers[i]);
+
+	for (int i = 0; i < BENCH_PENDING; i++) {
+		wheel_timer_create(&wheel_timers[i], bench_wheel_cb, NULL);
+		timer_wheel_start(wheel, &wheel_timers[i],
+				  100 + rand() % 1000);
+	}
+	start = clock_monotonic();
+	for (int i = 0; i < BENCH_ITERATIONS; i++) {
+		struct wheel_timer t;
+		wheel_timer_create(&t, bench_wheel_cb, NULL);
+		timer_wheel_start(wheel, &t, delays[i]);
+		timer_wheel_stop(wheel, &t);
+	}
+	double wheel_time = clock_monotonic() - start;
+	for (int i = 0; i < BENCH_PENDING; i++)
+		timer_wheel_stop(wheel, &wheel_timers[i]);
+
+	if (verbose) {
+		printf("%d timers armed, %d arm/cancel: "
+		       "ev_timer %.3f sec, timer wheel %.3f sec\n",
+		       BENCH_PENDING, BENCH_ITERATIONS, ev_time, wheel_time);
+	}
+	free(delays);
+	free(ev_timers);
+	free(wheel_timers);
+}
+
+static int
+main_f(va_list ap)
+{
+	(void) ap;
+	struct timer_wheel *wheel = &cord()->timer_wheel;
+	test_order(wheel);
+	test_stop(wheel);
+	test_many(wheel);
+	test_fiber_sleep();
+	bench(wheel);
+	ev_break(loop(), EVBREAK_ALL);
+	return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+	if (argc > 1 && strcmp(argv[1], "-v") == 0)
+		verbose = true;
+
+	header();
+	plan(4);
+
+	memory_init();
+	fiber_init(fiber_c_invoke);
+	struct fiber *f = fiber_new("main", main_f);
+	fiber_wakeup(f);
+	ev_run(loop(), 0);
+	fiber_free();
+	memory_free();
+
+	int rc = check_plan();
+	footer();
+	return rc;
+}